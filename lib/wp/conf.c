@@ -16,6 +16,9 @@
 #include <pipewire/pipewire.h>
 #include <spa/utils/result.h>
 
+#include <errno.h>
+#include <sys/stat.h>
+
 WP_DEFINE_LOCAL_LOG_TOPIC ("wp-conf")
 
 #define OVERRIDE_SECTION_PREFIX "override."
@@ -26,6 +29,13 @@ WP_DEFINE_LOCAL_LOG_TOPIC ("wp-conf")
  *
  * WpConf allows accessing the different sections of the wireplumber
  * configuration.
+ *
+ * The configuration file and its fragments are merged into a cache, stored
+ * under $XDG_CACHE_HOME/wireplumber/conf, which is memory-mapped instead of
+ * parsing and merging the files again the next time the same configuration
+ * is opened. The cache is discarded when any of the files that contributed
+ * to it is added, removed or modified. Set the "no-cache" key in the
+ * properties given to wp_conf_new() to bypass it.
  */
 
 typedef struct _WpConfSection WpConfSection;
@@ -192,6 +202,286 @@ wp_conf_new_open (const gchar * name, WpProperties * properties, GError ** error
   return g_steal_pointer (&self);
 }
 
+/*
+ * The config cache holds the merged value of every section. It starts with
+ * a ConfCacheHeader, followed by a ConfCacheFile for every file that
+ * contributed to the configuration, in load order, a ConfCacheSection for
+ * every section and the strings area that the entries point to. Paths and
+ * section names are NUL-terminated, section values are JSON text followed
+ * by a NUL. All integers are little-endian.
+ */
+
+#define CACHE_MAGIC "WPCC"
+#define CACHE_VERSION 1
+
+typedef struct {
+  gchar magic[4];
+  guint32 version;
+  guint32 n_files;
+  guint32 n_sections;
+} ConfCacheHeader;
+
+typedef struct {
+  guint64 mtime;  /* in nanoseconds */
+  guint64 size;
+  guint64 inode;
+  guint32 path;   /* offset in the strings area */
+  guint32 reserved;
+} ConfCacheFile;
+
+typedef struct {
+  guint32 name;   /* offsets in the strings area */
+  guint32 value;
+  guint32 value_size;
+  guint32 reserved;
+} ConfCacheSection;
+
+G_STATIC_ASSERT (sizeof (ConfCacheHeader) == 16);
+G_STATIC_ASSERT (sizeof (ConfCacheFile) == 32);
+G_STATIC_ASSERT (sizeof (ConfCacheSection) == 16);
+
+static gchar *
+conf_cache_get_location (WpConf * self, gboolean no_frags)
+{
+  const gchar *base = g_getenv ("XDG_CACHE_HOME");
+  g_autofree gchar *home_cache = NULL;
+  g_autofree gchar *key = NULL;
+  g_autofree gchar *checksum = NULL;
+  g_autofree gchar *filename = NULL;
+
+  if (!base || !g_path_is_absolute (base))
+    base = home_cache = g_build_filename (g_get_home_dir (), ".cache", NULL);
+
+  key = g_strdup_printf ("%s%s", self->name, no_frags ? ":no-fragments" : "");
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, key, -1);
+  filename = g_strdup_printf ("%s.cache", checksum);
+  return g_build_filename (base, "wireplumber", "conf", filename, NULL);
+}
+
+/* stats the files that make up the configuration, in host byte order */
+static GArray *
+conf_cache_stat_files (GPtrArray * paths)
+{
+  g_autoptr (GArray) files = g_array_sized_new (FALSE, TRUE,
+      sizeof (ConfCacheFile), paths->len);
+
+  for (guint i = 0; i < paths->len; i++) {
+    ConfCacheFile entry = { 0, };
+    struct stat st;
+
+    if (stat (g_ptr_array_index (paths, i), &st) < 0)
+      return NULL;
+
+    entry.mtime = (guint64) st.st_mtim.tv_sec * G_GUINT64_CONSTANT (1000000000)
+        + st.st_mtim.tv_nsec;
+    entry.size = st.st_size;
+    entry.inode = st.st_ino;
+    g_array_append_val (files, entry);
+  }
+  return g_steal_pointer (&files);
+}
+
+static gboolean
+conf_cache_load (WpConf * self, const gchar *location, GPtrArray * paths,
+    GArray * files)
+{
+  g_autoptr (GMappedFile) file = NULL;
+  g_autoptr (GArray) sections = NULL;
+  ConfCacheHeader header;
+  const gchar *data, *entries, *strings;
+  gsize size, strings_size;
+  guint32 n_files, n_sections;
+
+  file = g_mapped_file_new (location, FALSE, NULL);
+  if (!file)
+    return FALSE;
+
+  data = g_mapped_file_get_contents (file);
+  size = g_mapped_file_get_length (file);
+  if (size < sizeof (header))
+    goto corrupted;
+
+  memcpy (&header, data, sizeof (header));
+  n_files = GUINT32_FROM_LE (header.n_files);
+  n_sections = GUINT32_FROM_LE (header.n_sections);
+  if (memcmp (header.magic, CACHE_MAGIC, 4) != 0 ||
+      GUINT32_FROM_LE (header.version) != CACHE_VERSION)
+    goto corrupted;
+
+  /* a different number of files is the most common way to become stale */
+  if (n_files != files->len)
+    goto stale;
+
+  entries = data + sizeof (header);
+  if (n_files > (size - sizeof (header)) / sizeof (ConfCacheFile) ||
+      n_sections > (size - sizeof (header) - n_files * sizeof (ConfCacheFile))
+          / sizeof (ConfCacheSection))
+    goto corrupted;
+  strings = entries + n_files * sizeof (ConfCacheFile) +
+      n_sections * sizeof (ConfCacheSection);
+  strings_size = data + size - strings;
+
+  for (guint32 i = 0; i < n_files; i++) {
+    ConfCacheFile *current = &g_array_index (files, ConfCacheFile, i);
+    ConfCacheFile entry;
+    guint32 p;
+
+    memcpy (&entry, entries + i * sizeof (entry), sizeof (entry));
+    p = GUINT32_FROM_LE (entry.path);
+    if (p >= strings_size || !memchr (strings + p, '\0', strings_size - p))
+      goto corrupted;
+
+    if (GUINT64_FROM_LE (entry.mtime) != current->mtime ||
+        GUINT64_FROM_LE (entry.size) != current->size ||
+        GUINT64_FROM_LE (entry.inode) != current->inode ||
+        !g_str_equal (strings + p, g_ptr_array_index (paths, i)))
+      goto stale;
+  }
+
+  sections = g_array_sized_new (FALSE, FALSE, sizeof (WpConfSection),
+      n_sections);
+  g_array_set_clear_func (sections, (GDestroyNotify) wp_conf_section_clear);
+
+  entries += n_files * sizeof (ConfCacheFile);
+  for (guint32 i = 0; i < n_sections; i++) {
+    ConfCacheSection entry;
+    WpConfSection section = { 0, };
+    guint32 n, v, v_size;
+
+    memcpy (&entry, entries + i * sizeof (entry), sizeof (entry));
+    n = GUINT32_FROM_LE (entry.name);
+    v = GUINT32_FROM_LE (entry.value);
+    v_size = GUINT32_FROM_LE (entry.value_size);
+    if (n >= strings_size || !memchr (strings + n, '\0', strings_size - n) ||
+        v >= strings_size || v_size >= strings_size - v ||
+        strings[v + v_size] != '\0')
+      goto corrupted;
+
+    /* the sections are stored already merged, so they have no location */
+    section.name = g_strdup (strings + n);
+    section.value = wp_spa_json_new_wrap_stringn (strings + v, v_size);
+    g_array_append_val (sections, section);
+  }
+
+  /* the stored WpSpaJson point to the data in the GMappedFile */
+  g_ptr_array_add (self->files, g_steal_pointer (&file));
+  g_array_append_vals (self->conf_sections, sections->data, sections->len);
+  g_array_set_clear_func (sections, NULL);
+
+  wp_info_object (self, "loaded %u sections from config cache: %s",
+      n_sections, location);
+  return TRUE;
+
+corrupted:
+  wp_notice_object (self, "%s: corrupted config cache, ignoring", location);
+  return FALSE;
+
+stale:
+  wp_debug_object (self, "%s: config cache is out of date", location);
+  return FALSE;
+}
+
+static WpSpaJson * ensure_merged_section (WpConf * self, const gchar *section);
+
+static void
+conf_cache_save (WpConf * self, const gchar *location, GPtrArray * paths,
+    GArray * files)
+{
+  g_autoptr (GByteArray) data = g_byte_array_new ();
+  g_autoptr (GByteArray) strings = g_byte_array_new ();
+  g_autoptr (GPtrArray) names = g_ptr_array_new ();
+  g_autoptr (GPtrArray) values =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) wp_spa_json_unref);
+  g_autoptr (GHashTable) seen = g_hash_table_new (g_str_hash, g_str_equal);
+  g_autofree gchar *dir = NULL;
+  g_autoptr (GError) error = NULL;
+  ConfCacheHeader header = { 0, };
+  guint n_loaded = self->conf_sections->len;
+  gsize offset;
+
+  /* merge all sections now; merging appends new entries to conf_sections,
+     which are not iterated, but section names stay valid as they are
+     allocated separately */
+  for (guint i = 0; i < n_loaded; i++) {
+    const gchar *name =
+        g_array_index (self->conf_sections, WpConfSection, i).name;
+    WpSpaJson *value;
+
+    if (g_str_has_prefix (name, OVERRIDE_SECTION_PREFIX))
+      name += strlen (OVERRIDE_SECTION_PREFIX);
+    if (!g_hash_table_add (seen, (gpointer) name))
+      continue;
+
+    value = ensure_merged_section (self, name);
+    if (value) {
+      g_ptr_array_add (names, (gpointer) name);
+      g_ptr_array_add (values, value);
+    }
+  }
+
+  g_byte_array_set_size (data, sizeof (header) +
+      files->len * sizeof (ConfCacheFile) +
+      names->len * sizeof (ConfCacheSection));
+  offset = sizeof (header);
+
+  for (guint i = 0; i < files->len; i++) {
+    ConfCacheFile *current = &g_array_index (files, ConfCacheFile, i);
+    const gchar *path = g_ptr_array_index (paths, i);
+    ConfCacheFile entry = { 0, };
+
+    entry.mtime = GUINT64_TO_LE (current->mtime);
+    entry.size = GUINT64_TO_LE (current->size);
+    entry.inode = GUINT64_TO_LE (current->inode);
+    entry.path = GUINT32_TO_LE (strings->len);
+    g_byte_array_append (strings, (const guint8 *) path, strlen (path) + 1);
+
+    memcpy (data->data + offset, &entry, sizeof (entry));
+    offset += sizeof (entry);
+  }
+
+  for (guint i = 0; i < names->len; i++) {
+    const gchar *name = g_ptr_array_index (names, i);
+    WpSpaJson *value = g_ptr_array_index (values, i);
+    gsize value_size = wp_spa_json_get_size (value);
+    ConfCacheSection entry = { 0, };
+
+    entry.name = GUINT32_TO_LE (strings->len);
+    g_byte_array_append (strings, (const guint8 *) name, strlen (name) + 1);
+    entry.value = GUINT32_TO_LE (strings->len);
+    entry.value_size = GUINT32_TO_LE (value_size);
+    g_byte_array_append (strings,
+        (const guint8 *) wp_spa_json_get_data (value), value_size);
+    g_byte_array_append (strings, (const guint8 *) "", 1);
+
+    memcpy (data->data + offset, &entry, sizeof (entry));
+    offset += sizeof (entry);
+  }
+  g_byte_array_append (data, strings->data, strings->len);
+
+  memcpy (header.magic, CACHE_MAGIC, sizeof (header.magic));
+  header.version = GUINT32_TO_LE (CACHE_VERSION);
+  header.n_files = GUINT32_TO_LE (files->len);
+  header.n_sections = GUINT32_TO_LE (names->len);
+  memcpy (data->data, &header, sizeof (header));
+
+  dir = g_path_get_dirname (location);
+  if (g_mkdir_with_parents (dir, 0700) < 0) {
+    wp_notice_object (self, "failed to create directory %s: %s", dir,
+        g_strerror (errno));
+    return;
+  }
+
+  if (!g_file_set_contents (location, (const gchar *) data->data, data->len,
+          &error)) {
+    wp_notice_object (self, "failed to save config cache: %s",
+        error->message);
+    return;
+  }
+
+  wp_info_object (self, "saved %u sections to config cache: %s",
+      names->len, location);
+}
+
 static gboolean
 detect_old_conf_format (WpConf * self, GMappedFile *file)
 {
@@ -331,43 +621,72 @@ gboolean
 wp_conf_open (WpConf * self, GError ** error)
 {
   const gchar *no_frags = NULL;
+  const gchar *no_cache = NULL;
+  const gchar *as_section = NULL;
+  gboolean has_main = FALSE;
+  gboolean cacheable = TRUE;
 
   g_return_val_if_fail (WP_IS_CONF (self), FALSE);
 
   g_autofree gchar *path = NULL;
+  g_autofree gchar *cache_location = NULL;
+  g_autoptr (GPtrArray) paths = g_ptr_array_new_with_free_func (g_free);
+  g_autoptr (GArray) files = NULL;
   g_autoptr (WpIterator) iterator = NULL;
   g_auto (GValue) value = G_VALUE_INIT;
 
   if (self->properties) {
     no_frags = wp_properties_get (self->properties, "no-fragments");
+    no_cache = wp_properties_get (self->properties, "no-cache");
+    as_section = wp_properties_get (self->properties, "as-section");
   }
 
   /*
-   * open the config file - if the path supplied is absolute,
+   * locate the config file - if the path supplied is absolute,
    * wp_base_dirs_find_file will ignore WP_BASE_DIRS_CONFIGURATION
    */
   path = wp_base_dirs_find_file (WP_BASE_DIRS_CONFIGURATION, NULL, self->name);
   if (path) {
-    wp_info_object (self, "opening config file: %s", path);
-    if (!open_and_load_sections (self, path, error))
-      return FALSE;
+    g_ptr_array_add (paths, g_steal_pointer (&path));
+    has_main = TRUE;
   }
-  g_clear_pointer (&path, g_free);
 
-  /* open the .conf.d/ fragments */
+  /* locate the .conf.d/ fragments */
   if (!no_frags) {
     path = g_strdup_printf ("%s.d", self->name);
     iterator = wp_base_dirs_new_files_iterator (WP_BASE_DIRS_CONFIGURATION, path,
         ".conf");
 
-    for (; wp_iterator_next (iterator, &value); g_value_unset (&value)) {
-      const gchar *filename = g_value_get_string (&value);
+    for (; wp_iterator_next (iterator, &value); g_value_unset (&value))
+      g_ptr_array_add (paths, g_value_dup_string (&value));
+  }
 
-      wp_info_object (self, "opening fragment file: %s", filename);
+  /* try the cache first; single-section files are not parsed, so there
+     is no point in caching them */
+  if (!no_cache && !as_section && paths->len > 0) {
+    files = conf_cache_stat_files (paths);
+    if (files) {
+      cache_location = conf_cache_get_location (self, no_frags != NULL);
+      if (conf_cache_load (self, cache_location, paths, files))
+        return TRUE;
+    }
+  }
 
+  for (guint i = 0; i < paths->len; i++) {
+    const gchar *filename = g_ptr_array_index (paths, i);
+
+    if (i == 0 && has_main) {
+      wp_info_object (self, "opening config file: %s", filename);
+      if (!open_and_load_sections (self, filename, error))
+        return FALSE;
+    } else {
       g_autoptr (GError) e = NULL;
+
+      wp_info_object (self, "opening fragment file: %s", filename);
       if (!open_and_load_sections (self, filename, &e)) {
         wp_warning_object (self, "failed to open '%s': %s", filename, e->message);
+        /* do not cache, so that the warning is shown again next time */
+        cacheable = FALSE;
         continue;
       }
     }
@@ -379,6 +698,9 @@ wp_conf_open (WpConf * self, GError ** error)
     return FALSE;
   }
 
+  if (cache_location && cacheable)
+    conf_cache_save (self, cache_location, paths, files);
+
   return TRUE;
 }
 
@@ -520,6 +842,32 @@ wp_conf_get_section (WpConf *self, const gchar *section)
   return ensure_merged_section (self, section);
 }
 
+/*!
+ * \brief Gets a specific section of the configuration as compiled match rules
+ *
+ * The section must be an array of rules in the format accepted by
+ * wp_json_utils_match_rules(). The rules are compiled only the first time
+ * this is called for a section; subsequent calls return the same object.
+ *
+ * \ingroup wpconf
+ * \param self the configuration
+ * \param section the section name
+ * \returns (transfer full) (nullable): the compiled rules of the section or
+ *   NULL if the section does not exist
+ * \since 0.5.16
+ */
+WpMatchRules *
+wp_conf_get_section_match_rules (WpConf *self, const gchar *section)
+{
+  g_autoptr (WpSpaJson) json = NULL;
+
+  g_return_val_if_fail (WP_IS_CONF (self), NULL);
+  g_return_val_if_fail (section, NULL);
+
+  json = ensure_merged_section (self, section);
+  return json ? wp_match_rules_new (json) : NULL;
+}
+
 /*!
  * \brief Updates the given properties with the values of a specific section
  * from the configuration.
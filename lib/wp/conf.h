@@ -11,6 +11,7 @@
 
 #include "spa-json.h"
 #include "properties.h"
+#include "json-utils.h"
 
 G_BEGIN_DECLS
 
@@ -47,6 +48,10 @@ const gchar * wp_conf_get_name (WpConf * self);
 WP_API
 WpSpaJson * wp_conf_get_section (WpConf *self, const gchar *section);
 
+WP_API
+WpMatchRules * wp_conf_get_section_match_rules (WpConf *self,
+    const gchar *section);
+
 WP_API
 gint wp_conf_section_update_props (WpConf * self, const gchar * section,
     WpProperties * props);
@@ -372,6 +372,9 @@ wp_core_constructed (GObject *object)
       if (!wp_log_set_level (str))
         wp_warning ("ignoring invalid log.level in config file: %s", str);
     }
+    if (!g_getenv ("WIREPLUMBER_LOG_ASYNC") &&
+        (str = pw_properties_get (p, "log.async")) != NULL)
+      wp_log_set_async (spa_atob (str));
 
     /* parse pw_context specific configuration sections */
     if (self->conf)
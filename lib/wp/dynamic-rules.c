@@ -53,6 +53,21 @@ WP_DEFINE_LOCAL_LOG_TOPIC ("wp-dynamic-rules")
  *
  * Use wp_object_activate() with #WP_DYNAMIC_RULES_LOADED to activate.
  * Call wp_dynamic_rules_add_object() to register subject objects to evaluate.
+ *
+ * Re-evaluation is incremental: each JSON condition keeps track of the
+ * external objects that match it, so when objects appear or disappear only
+ * the rules whose conditions became satisfied or unsatisfied are evaluated
+ * again, and only against the subjects that they already match. Rules with
+ * condition callbacks are evaluated again on every change, as their
+ * dependencies are unknown.
+ *
+ * \gproperties
+ *
+ * \gproperty{n-evaluations, guint64, G_PARAM_READABLE,
+ *   The number of (rule\, subject) evaluations done so far}
+ *
+ * \gproperty{n-skipped-evaluations, guint64, G_PARAM_READABLE,
+ *   The number of (rule\, subject) evaluations avoided on condition changes}
  */
 
 static guint
@@ -66,6 +81,8 @@ get_next_rule_id (void)
 typedef struct {
   WpSpaJson *match_json;
   GClosure *closure;
+  /* the condition objects that match match_json */
+  GHashTable *matched;
 } DynamicCondition;
 
 static void
@@ -73,6 +90,7 @@ dynamic_condition_free (DynamicCondition *self)
 {
   g_clear_pointer (&self->match_json, wp_spa_json_unref);
   g_clear_pointer (&self->closure, g_closure_unref);
+  g_clear_pointer (&self->matched, g_hash_table_unref);
   g_free (self);
 }
 
@@ -82,6 +100,8 @@ dynamic_condition_new (WpSpaJson *match_json, GClosure *closure)
   DynamicCondition *self = g_new0 (DynamicCondition, 1);
   self->match_json = match_json ? wp_spa_json_ref (match_json) : NULL;
   self->closure = closure ? g_closure_ref (closure) : NULL;
+  if (match_json)
+    self->matched = g_hash_table_new (g_direct_hash, g_direct_equal);
   return self;
 }
 
@@ -91,6 +111,9 @@ typedef struct {
   WpObjectInterest *match_interest;
   WpSpaJson *actions;
   GPtrArray *conditions;
+  /* the conditions may have changed since the last evaluation */
+  gboolean dirty;
+  gboolean has_closure;
 } DynamicRule;
 
 static void
@@ -141,6 +164,16 @@ struct _WpDynamicRules {
   GPtrArray *rules;
   GPtrArray *objects;
   GHashTable *state;
+
+  /* (rule, object) pairs evaluated and skipped on condition changes */
+  guint64 n_evaluations;
+  guint64 n_skipped_evaluations;
+};
+
+enum {
+  PROP_0,
+  PROP_N_EVALUATIONS,
+  PROP_N_SKIPPED_EVALUATIONS,
 };
 
 G_DEFINE_TYPE (WpDynamicRules, wp_dynamic_rules, WP_TYPE_OBJECT)
@@ -170,7 +203,15 @@ static void
 wp_dynamic_rules_get_property (GObject * object, guint property_id,
     GValue * value, GParamSpec * pspec)
 {
+  WpDynamicRules *self = WP_DYNAMIC_RULES (object);
+
   switch (property_id) {
+  case PROP_N_EVALUATIONS:
+    g_value_set_uint64 (value, self->n_evaluations);
+    break;
+  case PROP_N_SKIPPED_EVALUATIONS:
+    g_value_set_uint64 (value, self->n_skipped_evaluations);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -341,30 +382,52 @@ rules_match_properties (WpSpaJson *rules, WpProperties *props)
   return matched;
 }
 
+static WpProperties *
+get_object_properties (WpGlobalProxy *obj)
+{
+  if (WP_IS_PIPEWIRE_OBJECT (obj))
+    return wp_pipewire_object_get_properties (WP_PIPEWIRE_OBJECT (obj));
+  return wp_global_proxy_get_global_properties (obj);
+}
+
+static gboolean
+condition_matches_object (DynamicCondition *cond, WpGlobalProxy *obj)
+{
+  g_autoptr (WpProperties) props = get_object_properties (obj);
+  gboolean found = FALSE;
+
+  if (props)
+    wp_json_utils_match_rules (cond->match_json, props, condition_check_cb,
+        &found, NULL);
+  return found;
+}
+
 static gboolean
 condition_is_satisfied (WpDynamicRules *self, DynamicCondition *cond)
+{
+  return g_hash_table_size (cond->matched) > 0;
+}
+
+/* fills the matched set of the JSON conditions of a rule from scratch */
+static void
+rule_track_conditions (WpDynamicRules *self, DynamicRule *rule)
 {
   g_autoptr (WpIterator) it = NULL;
   g_auto (GValue) val = G_VALUE_INIT;
 
+  if (!self->condition_om)
+    return;
+
   it = wp_object_manager_new_iterator (self->condition_om);
   for (; wp_iterator_next (it, &val); g_value_unset (&val)) {
     WpGlobalProxy *obj = g_value_get_object (&val);
-    g_autoptr (WpProperties) props = NULL;
-    gboolean found = FALSE;
-
-    if (WP_IS_PIPEWIRE_OBJECT (obj))
-      props = wp_pipewire_object_get_properties (WP_PIPEWIRE_OBJECT (obj));
-    else
-      props = wp_global_proxy_get_global_properties (obj);
 
-    wp_json_utils_match_rules (cond->match_json, props, condition_check_cb,
-          &found, NULL);
-    if (found)
-      return TRUE;
+    for (guint i = 0; i < rule->conditions->len; i++) {
+      DynamicCondition *cond = g_ptr_array_index (rule->conditions, i);
+      if (cond->matched && condition_matches_object (cond, obj))
+        g_hash_table_add (cond->matched, obj);
+    }
   }
-
-  return FALSE;
 }
 
 static gboolean
@@ -452,41 +515,60 @@ emit_actions (WpDynamicRules *self, guint rule_id, WpGlobalProxy *subject,
 }
 
 static void
-evaluate_object (WpDynamicRules *self, WpGlobalProxy *obj)
+evaluate_rule_for_object (WpDynamicRules *self, WpGlobalProxy *obj,
+    GArray *rule_state, guint i, WpProperties *props)
 {
-  GArray *rule_state;
-  g_autoptr (WpProperties) props = NULL;
+  DynamicRule *rule = g_ptr_array_index (self->rules, i);
+  WpRulesConditionState prev = g_array_index (rule_state,
+      WpRulesConditionState, i);
+  WpRulesConditionState new_state;
+  gboolean new_satisfied;
 
-  /* Get state */
-  rule_state = get_or_create_rule_state (self, obj);
+  self->n_evaluations++;
+
+  if (prev == WP_RULES_CONDITION_STATE_UNMATCHED &&
+    !rule_matches_subject (rule, obj, props))
+    return;
+
+  new_satisfied = rule_conditions_satisfied (self, rule, obj);
+  new_state = new_satisfied ? WP_RULES_CONDITION_STATE_SATISFIED :
+      WP_RULES_CONDITION_STATE_UNSATISFIED;
+  if (prev == WP_RULES_CONDITION_STATE_UNMATCHED || new_state != prev) {
+    g_array_index (rule_state, WpRulesConditionState, i) = new_state;
+    emit_actions (self, rule->id, obj, rule->actions, new_satisfied);
+  }
+}
+
+static GArray *
+get_rule_state (WpDynamicRules *self, WpGlobalProxy *obj)
+{
+  GArray *rule_state = get_or_create_rule_state (self, obj);
   if (rule_state->len < self->rules->len)
     g_array_set_size (rule_state, self->rules->len);
+  return rule_state;
+}
 
-  /* Get the properties */
-  if (WP_IS_PIPEWIRE_OBJECT (obj))
-    props = wp_pipewire_object_get_properties (WP_PIPEWIRE_OBJECT (obj));
-  else
-    props = wp_global_proxy_get_global_properties (obj);
+static void
+evaluate_object (WpDynamicRules *self, WpGlobalProxy *obj)
+{
+  GArray *rule_state = get_rule_state (self, obj);
+  g_autoptr (WpProperties) props = get_object_properties (obj);
 
   /* Check if the object matches the rules and conditions */
-  for (guint i = 0; i < self->rules->len; i++) {
-    DynamicRule *rule = g_ptr_array_index (self->rules, i);
-    WpRulesConditionState prev = g_array_index (rule_state,
-        WpRulesConditionState, i);
-    WpRulesConditionState new_state;
-    gboolean new_satisfied;
+  for (guint i = 0; i < self->rules->len; i++)
+    evaluate_rule_for_object (self, obj, rule_state, i, props);
+}
 
-    if (prev == WP_RULES_CONDITION_STATE_UNMATCHED &&
-      !rule_matches_subject (rule, obj, props))
-      continue;
+/* evaluates a single rule, e.g. a newly added one, against all objects */
+static void
+evaluate_rule (WpDynamicRules *self, guint i)
+{
+  for (guint j = 0; j < self->objects->len; j++) {
+    WpGlobalProxy *obj = g_ptr_array_index (self->objects, j);
+    GArray *rule_state = get_rule_state (self, obj);
+    g_autoptr (WpProperties) props = get_object_properties (obj);
 
-    new_satisfied = rule_conditions_satisfied (self, rule, obj);
-    new_state = new_satisfied ? WP_RULES_CONDITION_STATE_SATISFIED :
-        WP_RULES_CONDITION_STATE_UNSATISFIED;
-    if (prev == WP_RULES_CONDITION_STATE_UNMATCHED || new_state != prev) {
-      g_array_index (rule_state, WpRulesConditionState, i) = new_state;
-      emit_actions (self, rule->id, obj, rule->actions, new_satisfied);
-    }
+    evaluate_rule_for_object (self, obj, rule_state, i, props);
   }
 }
 
@@ -497,10 +579,74 @@ evaluate_all_objects (WpDynamicRules *self)
     evaluate_object (self, g_ptr_array_index (self->objects, i));
 }
 
+static void
+on_condition_object_added (WpObjectManager *om, WpGlobalProxy *obj,
+    WpDynamicRules *self)
+{
+  for (guint i = 0; i < self->rules->len; i++) {
+    DynamicRule *rule = g_ptr_array_index (self->rules, i);
+
+    for (guint j = 0; j < rule->conditions->len; j++) {
+      DynamicCondition *cond = g_ptr_array_index (rule->conditions, j);
+      if (cond->matched && condition_matches_object (cond, obj)) {
+        g_hash_table_add (cond->matched, obj);
+        if (g_hash_table_size (cond->matched) == 1)
+          rule->dirty = TRUE;
+      }
+    }
+  }
+}
+
+static void
+on_condition_object_removed (WpObjectManager *om, WpGlobalProxy *obj,
+    WpDynamicRules *self)
+{
+  for (guint i = 0; i < self->rules->len; i++) {
+    DynamicRule *rule = g_ptr_array_index (self->rules, i);
+
+    for (guint j = 0; j < rule->conditions->len; j++) {
+      DynamicCondition *cond = g_ptr_array_index (rule->conditions, j);
+      if (cond->matched && g_hash_table_remove (cond->matched, obj) &&
+          g_hash_table_size (cond->matched) == 0)
+        rule->dirty = TRUE;
+    }
+  }
+}
+
 static void
 on_conditions_changed (WpObjectManager *om, WpDynamicRules *self)
 {
-  evaluate_all_objects (self);
+  guint64 evaluated = self->n_evaluations;
+  guint64 skipped = 0;
+
+  for (guint i = 0; i < self->rules->len; i++) {
+    DynamicRule *rule = g_ptr_array_index (self->rules, i);
+
+    if (!rule->dirty && !rule->has_closure) {
+      skipped += self->objects->len;
+      continue;
+    }
+    rule->dirty = FALSE;
+
+    /* a condition change cannot make a subject match a rule, so only
+       the subjects that already match the rule need to be evaluated */
+    for (guint j = 0; j < self->objects->len; j++) {
+      WpGlobalProxy *obj = g_ptr_array_index (self->objects, j);
+      GArray *rule_state = get_rule_state (self, obj);
+
+      if (g_array_index (rule_state, WpRulesConditionState, i) ==
+          WP_RULES_CONDITION_STATE_UNMATCHED) {
+        skipped++;
+        continue;
+      }
+      evaluate_rule_for_object (self, obj, rule_state, i, NULL);
+    }
+  }
+
+  self->n_skipped_evaluations += skipped;
+  wp_debug_object (self, "conditions changed: %" G_GUINT64_FORMAT
+      " evaluations, %" G_GUINT64_FORMAT " skipped",
+      self->n_evaluations - evaluated, skipped);
 }
 
 static void
@@ -529,6 +675,10 @@ wp_dynamic_rules_activate_execute_step (WpObject *object,
           WP_TYPE_GLOBAL_PROXY, NULL);
       wp_object_manager_request_object_features (self->condition_om,
           WP_TYPE_GLOBAL_PROXY, WP_OBJECT_FEATURES_ALL);
+      g_signal_connect_object (self->condition_om, "object-added",
+          G_CALLBACK (on_condition_object_added), self, 0);
+      g_signal_connect_object (self->condition_om, "object-removed",
+          G_CALLBACK (on_condition_object_removed), self, 0);
       g_signal_connect_object (self->condition_om, "objects-changed",
           G_CALLBACK (on_conditions_changed), self, 0);
       g_signal_connect_object (self->condition_om, "installed",
@@ -551,6 +701,15 @@ wp_dynamic_rules_deactivate (WpObject *object, WpObjectFeatures features)
 
   /* Reset state */
   g_hash_table_remove_all (self->state);
+  for (guint i = 0; i < self->rules->len; i++) {
+    DynamicRule *rule = g_ptr_array_index (self->rules, i);
+    for (guint j = 0; j < rule->conditions->len; j++) {
+      DynamicCondition *cond = g_ptr_array_index (rule->conditions, j);
+      if (cond->matched)
+        g_hash_table_remove_all (cond->matched);
+    }
+    rule->dirty = FALSE;
+  }
 
   /* Activation */
   g_clear_object (&self->condition_om);
@@ -588,6 +747,16 @@ wp_dynamic_rules_class_init (WpDynamicRulesClass *klass)
       wp_dynamic_rules_activate_execute_step;
   wpobject_class->deactivate = wp_dynamic_rules_deactivate;
 
+  g_object_class_install_property (object_class, PROP_N_EVALUATIONS,
+      g_param_spec_uint64 ("n-evaluations", "n-evaluations",
+          "The number of (rule, subject) evaluations", 0, G_MAXUINT64, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (object_class, PROP_N_SKIPPED_EVALUATIONS,
+      g_param_spec_uint64 ("n-skipped-evaluations", "n-skipped-evaluations",
+          "The number of (rule, subject) evaluations avoided", 0, G_MAXUINT64,
+          0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   signals[SIGNAL_APPLY_ACTIONS] = g_signal_new ("apply-actions",
       G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL,
       G_TYPE_NONE, 4, G_TYPE_UINT, G_TYPE_STRING, WP_TYPE_SPA_JSON,
@@ -726,11 +895,12 @@ wp_dynamic_rules_add_condition_rule_closure (WpDynamicRules *self,
     return SPA_ID_INVALID;
   }
   g_ptr_array_add (rule->conditions, parse_condition_closure (c));
+  rule->has_closure = TRUE;
   g_ptr_array_add (self->rules, rule);
 
   if (wp_object_get_active_features (WP_OBJECT (self)) &
       WP_DYNAMIC_RULES_LOADED)
-    evaluate_all_objects (self);
+    evaluate_rule (self, self->rules->len - 1);
 
   return id;
 }
@@ -759,10 +929,11 @@ wp_dynamic_rules_add_json_rule (WpDynamicRules *self, WpSpaJson *json_rule)
     return SPA_ID_INVALID;
 
   g_ptr_array_add (self->rules, rule);
+  rule_track_conditions (self, rule);
 
   if (wp_object_get_active_features (WP_OBJECT (self)) &
       WP_DYNAMIC_RULES_LOADED)
-    evaluate_all_objects (self);
+    evaluate_rule (self, self->rules->len - 1);
 
   return rule->id;
 }
@@ -831,5 +1002,6 @@ wp_dynamic_rules_remove_object (WpDynamicRules *self, WpGlobalProxy *object)
   g_return_if_fail (WP_IS_DYNAMIC_RULES (self));
   g_return_if_fail (WP_IS_GLOBAL_PROXY (object));
 
+  g_hash_table_remove (self->state, object);
   g_ptr_array_remove (self->objects, object);
 }
@@ -9,6 +9,8 @@
 #include "event-dispatcher.h"
 #include "log.h"
 
+#include <string.h>
+
 #include <spa/support/plugin.h>
 #include <spa/support/system.h>
 #include <pipewire/pipewire.h>
@@ -170,6 +172,133 @@ sort_hooks (GPtrArray *hooks)
   return TRUE;
 }
 
+/* event properties that hooks commonly constrain with '=' or 'c';
+   used to pre-filter the hooks before running the full interest matching */
+static const gchar * const filter_keys[] = {
+  "event.subject.type",
+  "media.class",
+  "event.subject.param-id",
+};
+#define N_FILTER_KEYS G_N_ELEMENTS (filter_keys)
+
+/* A decision table over a sorted hooks array. For each filter key, it maps
+   each defined value to a bitset of the hooks that accept it and keeps
+   another bitset of the hooks that accept any value */
+typedef struct _HookFilter HookFilter;
+struct _HookFilter
+{
+  guint n_hooks;
+  guint n_words;
+  GHashTable *values[N_FILTER_KEYS];  /* value -> guint64 bitset */
+  guint64 *any[N_FILTER_KEYS];
+};
+
+static HookFilter *
+hook_filter_new (GPtrArray *hooks)
+{
+  HookFilter *self = g_new0 (HookFilter, 1);
+  self->n_hooks = hooks->len;
+  self->n_words = (hooks->len + 63) / 64;
+
+  for (guint k = 0; k < N_FILTER_KEYS; k++) {
+    self->values[k] = g_hash_table_new_full (g_str_hash, g_str_equal,
+        g_free, g_free);
+    self->any[k] = g_new0 (guint64, self->n_words);
+
+    for (guint i = 0; i < hooks->len; i++) {
+      WpEventHook *hook = g_ptr_array_index (hooks, i);
+      g_autoptr (GPtrArray) values =
+          wp_event_hook_get_defined_values (hook, filter_keys[k]);
+      guint64 bit = G_GUINT64_CONSTANT (1) << (i % 64);
+
+      if (!values) {
+        self->any[k][i / 64] |= bit;
+        continue;
+      }
+
+      for (guint j = 0; j < values->len; j++) {
+        const gchar *v = g_ptr_array_index (values, j);
+        guint64 *bits = g_hash_table_lookup (self->values[k], v);
+        if (!bits) {
+          bits = g_new0 (guint64, self->n_words);
+          g_hash_table_insert (self->values[k], g_strdup (v), bits);
+        }
+        bits[i / 64] |= bit;
+      }
+    }
+  }
+  return self;
+}
+
+static void
+hook_filter_free (HookFilter *self)
+{
+  for (guint k = 0; k < N_FILTER_KEYS; k++) {
+    g_clear_pointer (&self->values[k], g_hash_table_unref);
+    g_clear_pointer (&self->any[k], g_free);
+  }
+  g_free (self);
+}
+
+static void
+hook_filter_select (HookFilter *self, GPtrArray *hooks, WpProperties *props,
+    GPtrArray *result)
+{
+  g_autofree guint64 *mask = g_new (guint64, self->n_words);
+
+  memset (mask, 0xff, self->n_words * sizeof (guint64));
+
+  for (guint k = 0; k < N_FILTER_KEYS; k++) {
+    const gchar *v = props ? wp_properties_get (props, filter_keys[k]) : NULL;
+    const guint64 *bits = v ? g_hash_table_lookup (self->values[k], v) : NULL;
+
+    for (guint w = 0; w < self->n_words; w++)
+      mask[w] &= self->any[k][w] | (bits ? bits[w] : 0);
+  }
+
+  for (guint w = 0; w < self->n_words; w++) {
+    guint64 word = mask[w];
+    while (word) {
+      guint i = w * 64 + __builtin_ctzll (word);
+      word &= word - 1;
+      if (i < self->n_hooks)
+        g_ptr_array_add (result, g_object_ref (g_ptr_array_index (hooks, i)));
+    }
+  }
+}
+
+/* Accumulated durations, in microseconds */
+typedef struct _StatsCounter StatsCounter;
+struct _StatsCounter
+{
+  guint64 count;
+  gint64 total;
+  gint64 max;
+};
+
+static inline void
+stats_counter_add (StatsCounter *self, gint64 duration)
+{
+  self->count++;
+  self->total += duration;
+  self->max = MAX (self->max, duration);
+}
+
+typedef struct _HookStats HookStats;
+struct _HookStats
+{
+  StatsCounter time;           /* from starting the hook until it is done */
+  StatsCounter blocking_time;  /* spent synchronously in wp_event_hook_run() */
+};
+
+typedef struct _EventTypeStats EventTypeStats;
+struct _EventTypeStats
+{
+  StatsCounter wait_time;      /* from pushing until the first hook runs */
+  StatsCounter dispatch_time;  /* from the first hook until the last is done */
+  guint64 n_coalesced;
+};
+
 typedef struct _EventData EventData;
 struct _EventData
 {
@@ -177,6 +306,11 @@ struct _EventData
   WpIterator *hooks_iter;
   WpEventHook *current_hook_in_async;
   gint64 seq;
+  guint heap_idx;       /* position in the events heap */
+  gchar *coalesce_key;  /* set while the event can still be coalesced */
+  gint64 push_time;
+  gint64 start_time;    /* time the first hook started, 0 if not yet */
+  gint64 hook_start_time;
 };
 
 static inline EventData *
@@ -187,6 +321,7 @@ event_data_new (WpEvent * event)
   event_data->event = wp_event_ref (event);
   event_data->hooks_iter = wp_event_new_hooks_iterator (event);
   event_data->seq = seqn++;
+  event_data->push_time = g_get_monotonic_time ();
   return event_data;
 }
 
@@ -196,6 +331,7 @@ event_data_free (EventData * self)
   g_clear_pointer (&self->event, wp_event_unref);
   g_clear_pointer (&self->hooks_iter, wp_iterator_unref);
   g_clear_object (&self->current_hook_in_async);
+  g_free (self->coalesce_key);
   g_free (self);
 }
 
@@ -206,14 +342,135 @@ struct _WpEventDispatcher
   GWeakRef core;
   GHashTable *defined_hooks;  /* registered hooks for defined events */
   GPtrArray *undefined_hooks;  /* registered hooks for undefined events */
+  GHashTable *hook_filters;  /* hooks array -> HookFilter, built on demand */
+  GHashTable *unsorted_hooks;  /* hooks array -> n of sorted hooks + 1 */
+  GHashTable *unconfirmed_hooks;  /* hook -> n of arrays not sorted yet */
   GSource *source;  /* the event loop source */
-  GList *events;    /* the events stack */
+  GPtrArray *events;  /* the events heap, highest priority first */
+  GHashTable *coalescing_types;  /* event types that may be coalesced */
+  GHashTable *pending_events;  /* coalesce key -> EventData, not started yet */
+  GHashTable *hook_stats;  /* hook name -> HookStats */
+  GHashTable *event_type_stats;  /* event type -> EventTypeStats */
   struct spa_system *system;
   int eventfd;
 };
 
 G_DEFINE_TYPE (WpEventDispatcher, wp_event_dispatcher, G_TYPE_OBJECT)
 
+static gint
+event_cmp_func (const EventData *a, const EventData *b)
+{
+  gint c = wp_event_get_priority (b->event) - wp_event_get_priority (a->event);
+  return (c != 0) ? c : (a->seq < b->seq ? -1 : (a->seq > b->seq));
+}
+
+static inline void
+events_heap_set (GPtrArray *heap, guint idx, EventData *event_data)
+{
+  heap->pdata[idx] = event_data;
+  event_data->heap_idx = idx;
+}
+
+static void
+events_heap_sift_up (GPtrArray *heap, guint idx)
+{
+  EventData *event_data = g_ptr_array_index (heap, idx);
+
+  while (idx > 0) {
+    guint parent = (idx - 1) / 2;
+    EventData *p = g_ptr_array_index (heap, parent);
+    if (event_cmp_func (event_data, p) >= 0)
+      break;
+    events_heap_set (heap, idx, p);
+    idx = parent;
+  }
+  events_heap_set (heap, idx, event_data);
+}
+
+static void
+events_heap_sift_down (GPtrArray *heap, guint idx)
+{
+  EventData *event_data = g_ptr_array_index (heap, idx);
+
+  for (;;) {
+    guint child = 2 * idx + 1;
+    EventData *c;
+
+    if (child >= heap->len)
+      break;
+    if (child + 1 < heap->len &&
+        event_cmp_func (g_ptr_array_index (heap, child + 1),
+            g_ptr_array_index (heap, child)) < 0)
+      child++;
+
+    c = g_ptr_array_index (heap, child);
+    if (event_cmp_func (c, event_data) >= 0)
+      break;
+    events_heap_set (heap, idx, c);
+    idx = child;
+  }
+  events_heap_set (heap, idx, event_data);
+}
+
+static void
+events_heap_push (GPtrArray *heap, EventData *event_data)
+{
+  g_ptr_array_add (heap, event_data);
+  events_heap_sift_up (heap, heap->len - 1);
+}
+
+static void
+events_heap_remove (GPtrArray *heap, EventData *event_data)
+{
+  guint idx = event_data->heap_idx;
+  EventData *last;
+
+  g_assert (idx < heap->len && g_ptr_array_index (heap, idx) == event_data);
+
+  last = g_ptr_array_steal_index_fast (heap, heap->len - 1);
+  if (last != event_data) {
+    events_heap_set (heap, idx, last);
+    events_heap_sift_up (heap, idx);
+    events_heap_sift_down (heap, last->heap_idx);
+  }
+}
+
+static inline EventData *
+events_heap_peek (GPtrArray *heap)
+{
+  return heap->len > 0 ? g_ptr_array_index (heap, 0) : NULL;
+}
+
+static HookStats *
+get_hook_stats (WpEventDispatcher * self, WpEventHook * hook)
+{
+  const gchar *name = wp_event_hook_get_name (hook);
+  HookStats *stats = g_hash_table_lookup (self->hook_stats, name);
+  if (!stats) {
+    stats = g_new0 (HookStats, 1);
+    g_hash_table_insert (self->hook_stats, g_strdup (name), stats);
+  }
+  return stats;
+}
+
+static EventTypeStats *
+get_event_type_stats (WpEventDispatcher * self, WpEvent * event)
+{
+  g_autoptr (WpProperties) props = wp_event_get_properties (event);
+  const gchar *event_type = wp_properties_get (props, "event.type");
+  EventTypeStats *stats;
+
+  if (!event_type)
+    event_type = "";
+
+  stats = g_hash_table_lookup (self->event_type_stats, event_type);
+  if (!stats) {
+    stats = g_new0 (EventTypeStats, 1);
+    g_hash_table_insert (self->event_type_stats, g_strdup (event_type), stats);
+  }
+  return stats;
+}
+
 #define WP_EVENT_SOURCE_DISPATCHER(x) \
     WP_EVENT_DISPATCHER (((WpEventSource *) x)->dispatcher)
 
@@ -228,8 +485,8 @@ static gboolean
 wp_event_source_check (GSource * s)
 {
   WpEventDispatcher *d = WP_EVENT_SOURCE_DISPATCHER (s);
-  return d && d->events &&
-      !((EventData *) g_list_first (d->events)->data)->current_hook_in_async;
+  EventData *event_data = d ? events_heap_peek (d->events) : NULL;
+  return event_data && !event_data->current_hook_in_async;
 }
 
 static void
@@ -245,6 +502,9 @@ on_event_hook_done (WpEventHook * hook, GAsyncResult * res, EventData * data)
       error->domain != G_IO_ERROR && error->code != G_IO_ERROR_CANCELLED)
     wp_notice_object (hook, "failed: %s", error->message);
 
+  stats_counter_add (&get_hook_stats (dispatcher, hook)->time,
+      g_get_monotonic_time () - data->hook_start_time);
+
   g_clear_object (&data->current_hook_in_async);
   spa_system_eventfd_write (dispatcher->system, dispatcher->eventfd, 1);
 }
@@ -259,9 +519,8 @@ wp_event_source_dispatch (GSource * s, GSourceFunc callback, gpointer user_data)
   spa_system_eventfd_read (d->system, d->eventfd, &count);
 
   /* get the highest priority event */
-  GList *levent = g_list_first (d->events);
-  if (levent) {
-    EventData *event_data = (EventData *) (levent->data);
+  EventData *event_data = events_heap_peek (d->events);
+  if (event_data) {
     WpEvent *event = event_data->event;
     GCancellable *cancellable = wp_event_get_cancellable (event);
     g_auto (GValue) value = G_VALUE_INIT;
@@ -284,7 +543,19 @@ wp_event_source_dispatch (GSource * s, GSourceFunc callback, gpointer user_data)
       WpEventHook *hook = g_value_get_object (&value);
       const gchar *name = wp_event_hook_get_name (hook);
 
+      /* hooks have started running; a new event must not replace it now */
+      if (event_data->coalesce_key) {
+        g_hash_table_remove (d->pending_events, event_data->coalesce_key);
+        g_clear_pointer (&event_data->coalesce_key, g_free);
+      }
+
       event_data->current_hook_in_async = g_object_ref (hook);
+      event_data->hook_start_time = g_get_monotonic_time ();
+      if (!event_data->start_time) {
+        event_data->start_time = event_data->hook_start_time;
+        stats_counter_add (&get_event_type_stats (d, event)->wait_time,
+            event_data->start_time - event_data->push_time);
+      }
 
       wp_trace_object(d, "dispatching event (%s) running hook <%p>(%s)",
           wp_event_get_name(event), hook, name);
@@ -292,15 +563,24 @@ wp_event_source_dispatch (GSource * s, GSourceFunc callback, gpointer user_data)
       /* execute the hook, possibly async */
       wp_event_hook_run (hook, event, cancellable,
           (GAsyncReadyCallback) on_event_hook_done, event_data);
+
+      stats_counter_add (&get_hook_stats (d, hook)->blocking_time,
+          g_get_monotonic_time () - event_data->hook_start_time);
     } else {
+      if (event_data->start_time)
+        stats_counter_add (&get_event_type_stats (d, event)->dispatch_time,
+            g_get_monotonic_time () - event_data->start_time);
+
       /* clear the event after all hooks are done */
-      d->events = g_list_delete_link (d->events, g_steal_pointer (&levent));
+      events_heap_remove (d->events, event_data);
+      if (event_data->coalesce_key)
+        g_hash_table_remove (d->pending_events, event_data->coalesce_key);
       g_clear_pointer (&event_data, event_data_free);
     }
 
     /* get the next event */
-    levent = g_list_first (d->events);
-    if (levent && !((EventData *) levent->data)->current_hook_in_async)
+    event_data = events_heap_peek (d->events);
+    if (event_data && !event_data->current_hook_in_async)
       spa_system_eventfd_write (d->system, d->eventfd, 1);
   }
 
@@ -321,6 +601,18 @@ wp_event_dispatcher_init (WpEventDispatcher * self)
   self->defined_hooks = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
       (GDestroyNotify)g_ptr_array_unref);
   self->undefined_hooks = g_ptr_array_new_with_free_func (g_object_unref);
+  self->events = g_ptr_array_new ();
+  self->coalescing_types = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, NULL);
+  self->pending_events = g_hash_table_new (g_str_hash, g_str_equal);
+  self->hook_stats = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, g_free);
+  self->event_type_stats = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, g_free);
+  self->hook_filters = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) hook_filter_free);
+  self->unsorted_hooks = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->unconfirmed_hooks = g_hash_table_new (g_direct_hash, g_direct_equal);
 
   self->source = g_source_new (&source_funcs, sizeof (WpEventSource));
   ((WpEventSource *) self->source)->dispatcher = self;
@@ -335,8 +627,12 @@ wp_event_dispatcher_finalize (GObject * object)
 {
   WpEventDispatcher *self = WP_EVENT_DISPATCHER (object);
 
-  g_list_free_full (g_steal_pointer (&self->events),
-      (GDestroyNotify) event_data_free);
+  g_clear_pointer (&self->pending_events, g_hash_table_unref);
+  g_clear_pointer (&self->hook_stats, g_hash_table_unref);
+  g_clear_pointer (&self->event_type_stats, g_hash_table_unref);
+  g_clear_pointer (&self->coalescing_types, g_hash_table_unref);
+  g_ptr_array_foreach (self->events, (GFunc) event_data_free, NULL);
+  g_clear_pointer (&self->events, g_ptr_array_unref);
 
   ((WpEventSource *) self->source)->dispatcher = NULL;
   g_source_destroy (self->source);
@@ -344,6 +640,9 @@ wp_event_dispatcher_finalize (GObject * object)
 
   close (self->eventfd);
 
+  g_clear_pointer (&self->hook_filters, g_hash_table_unref);
+  g_clear_pointer (&self->unsorted_hooks, g_hash_table_unref);
+  g_clear_pointer (&self->unconfirmed_hooks, g_hash_table_unref);
   g_clear_pointer (&self->defined_hooks, g_hash_table_unref);
   g_clear_pointer (&self->undefined_hooks, g_ptr_array_unref);
   g_weak_ref_clear (&self->core);
@@ -399,16 +698,60 @@ wp_event_dispatcher_get_instance (WpCore * core)
   return dispatcher;
 }
 
-static gint
-event_cmp_func (const EventData *a, const EventData *b)
+static gchar *
+make_coalesce_key (WpEvent * event)
 {
-  gint c = wp_event_get_priority (b->event) - wp_event_get_priority (a->event);
-  return (c != 0) ? c : (gint)(a->seq - b->seq);
+  g_autoptr (WpProperties) props = wp_event_get_properties (event);
+  g_autoptr (GObject) subject = wp_event_get_subject (event);
+  const gchar *param_id = wp_properties_get (props, "event.subject.param-id");
+  const gchar *key = wp_properties_get (props, "event.subject.key");
+
+  return g_strdup_printf ("%s|%p|%s|%s",
+      wp_properties_get (props, "event.type"), subject,
+      param_id ? param_id : "", key ? key : "");
+}
+
+static gboolean
+try_coalesce_event (WpEventDispatcher * self, WpEvent * event,
+    gchar ** coalesce_key)
+{
+  g_autoptr (WpProperties) props = wp_event_get_properties (event);
+  const gchar *event_type = wp_properties_get (props, "event.type");
+  EventData *pending;
+
+  if (!event_type || !g_hash_table_contains (self->coalescing_types, event_type))
+    return FALSE;
+
+  *coalesce_key = make_coalesce_key (event);
+  pending = g_hash_table_lookup (self->pending_events, *coalesce_key);
+  if (!pending)
+    return FALSE;
+
+  /* take over the pending event's slot in the queue; its hooks have not
+     started yet, so the new event can simply be dispatched in its place */
+  wp_debug_object (self, "coalescing event (%s) into pending event (%s)",
+      wp_event_get_name (event), wp_event_get_name (pending->event));
+  get_event_type_stats (self, event)->n_coalesced++;
+
+  g_clear_pointer (&pending->event, wp_event_unref);
+  g_clear_pointer (&pending->hooks_iter, wp_iterator_unref);
+  pending->event = wp_event_ref (event);
+  pending->hooks_iter = wp_event_new_hooks_iterator (event);
+
+  /* the priority may be different */
+  events_heap_sift_up (self->events, pending->heap_idx);
+  events_heap_sift_down (self->events, pending->heap_idx);
+  return TRUE;
 }
 
 /*!
  * \brief Pushes a new event onto the event stack for dispatching only if there
  * are any hooks are available for it.
+ *
+ * If coalescing is enabled for the event's type (see
+ * wp_event_dispatcher_set_coalescing()) and an equivalent event is still
+ * waiting in the queue, the new event replaces it instead of being queued.
+ *
  * \ingroup wpeventdispatcher
  *
  * \param self the dispatcher
@@ -421,10 +764,21 @@ wp_event_dispatcher_push_event (WpEventDispatcher * self, WpEvent * event)
   g_return_if_fail (event != NULL);
 
   if (wp_event_collect_hooks (event, self)) {
-    EventData *event_data = event_data_new (event);
+    g_autofree gchar *coalesce_key = NULL;
+    EventData *event_data;
+
+    if (try_coalesce_event (self, event, &coalesce_key)) {
+      wp_event_unref (event);
+      return;
+    }
 
-    self->events = g_list_insert_sorted (self->events, event_data,
-        (GCompareFunc) event_cmp_func);
+    event_data = event_data_new (event);
+    events_heap_push (self->events, event_data);
+    if (coalesce_key) {
+      event_data->coalesce_key = g_steal_pointer (&coalesce_key);
+      g_hash_table_insert (self->pending_events, event_data->coalesce_key,
+          event_data);
+    }
     wp_debug_object (self, "pushed event (%s)", wp_event_get_name (event));
 
     /* wakeup the GSource */
@@ -434,8 +788,151 @@ wp_event_dispatcher_push_event (WpEventDispatcher * self, WpEvent * event)
   wp_event_unref (event);
 }
 
+/*!
+ * \brief Enables or disables coalescing of events of the given type
+ *
+ * When enabled, pushing an event of this type while another event with the
+ * same type, subject, "event.subject.param-id" and "event.subject.key" is
+ * still waiting to be dispatched (none of its hooks has run yet) replaces
+ * the waiting event with the new one. The new event takes over the position
+ * of the old one in the queue. This is useful for events that only notify
+ * about a change of state, where the hooks are only interested in the
+ * latest state.
+ *
+ * \ingroup wpeventdispatcher
+ * \param self the event dispatcher
+ * \param event_type the event type
+ * \param enabled whether to coalesce events of this type
+ * \since 0.5.16
+ */
+void
+wp_event_dispatcher_set_coalescing (WpEventDispatcher * self,
+    const gchar * event_type, gboolean enabled)
+{
+  g_return_if_fail (WP_IS_EVENT_DISPATCHER (self));
+  g_return_if_fail (event_type != NULL);
+
+  if (enabled)
+    g_hash_table_add (self->coalescing_types, g_strdup (event_type));
+  else
+    g_hash_table_remove (self->coalescing_types, event_type);
+}
+
+/* Marks \a hooks as needing to be sorted before it is used again; hooks that
+   are appended after the first \a n_sorted ones are the newly registered */
+static void
+mark_unsorted (WpEventDispatcher * self, GPtrArray * hooks, guint n_sorted)
+{
+  if (!g_hash_table_contains (self->unsorted_hooks, hooks))
+    g_hash_table_insert (self->unsorted_hooks, hooks,
+        GUINT_TO_POINTER (n_sorted + 1));
+}
+
+/* Counts one more hooks array that \a hook waits to be sorted in */
+static void
+add_unconfirmed (WpEventDispatcher * self, WpEventHook * hook)
+{
+  guint n = GPOINTER_TO_UINT (
+      g_hash_table_lookup (self->unconfirmed_hooks, hook));
+  g_hash_table_insert (self->unconfirmed_hooks, hook, GUINT_TO_POINTER (n + 1));
+}
+
+/* Called when \a hook has been sorted successfully into one of its hooks
+   arrays; the registration is reported once it is sorted into all of them */
+static void
+confirm_hook (WpEventDispatcher * self, WpEventHook * hook)
+{
+  guint n = GPOINTER_TO_UINT (
+      g_hash_table_lookup (self->unconfirmed_hooks, hook));
+
+  if (n > 1) {
+    g_hash_table_insert (self->unconfirmed_hooks, hook,
+        GUINT_TO_POINTER (n - 1));
+  } else if (n == 1) {
+    g_hash_table_remove (self->unconfirmed_hooks, hook);
+    wp_info_object (self, "Registered hook %s successfully",
+        wp_event_hook_get_name (hook));
+  }
+}
+
+static void
+ensure_sorted (WpEventDispatcher * self, GPtrArray * hooks)
+{
+  g_autoptr (GPtrArray) added = NULL;
+  g_autoptr (GPtrArray) rejected = NULL;
+  gpointer value;
+  guint n_sorted;
+
+  if (!g_hash_table_lookup_extended (self->unsorted_hooks, hooks, NULL, &value))
+    return;
+  g_hash_table_remove (self->unsorted_hooks, hooks);
+  n_sorted = GPOINTER_TO_UINT (value) - 1;
+
+  /* the newly registered hooks, in registration order */
+  added = g_ptr_array_new_with_free_func (g_object_unref);
+  for (guint i = n_sorted; i < hooks->len; i++)
+    g_ptr_array_add (added, g_object_ref (g_ptr_array_index (hooks, i)));
+
+  if (G_LIKELY (sort_hooks (hooks))) {
+    for (guint i = 0; i < added->len; i++)
+      confirm_hook (self, g_ptr_array_index (added, i));
+    return;
+  }
+
+  /* Some of the newly registered hooks introduced circular dependencies;
+     add them back one by one, in registration order, to find which.
+     The first n_sorted hooks are known to be sortable on their own */
+  rejected = g_ptr_array_new_with_free_func (g_object_unref);
+  g_ptr_array_set_size (hooks, n_sorted);
+
+  for (guint i = 0; i < added->len; i++) {
+    WpEventHook *hook = g_ptr_array_index (added, i);
+    g_ptr_array_add (hooks, g_object_ref (hook));
+    if (!sort_hooks (hooks)) {
+      g_ptr_array_remove_index (hooks, hooks->len - 1);
+      g_ptr_array_add (rejected, g_object_ref (hook));
+    } else {
+      confirm_hook (self, hook);
+    }
+  }
+
+  for (guint i = 0; i < rejected->len; i++) {
+    WpEventHook *hook = g_ptr_array_index (rejected, i);
+    g_autoptr (WpEventDispatcher) d = wp_event_hook_get_dispatcher (hook);
+
+    wp_warning_object (self,
+        "Could not register hook %s because of circular dependencies",
+        wp_event_hook_get_name (hook));
+    if (d == self)
+      wp_event_dispatcher_unregister_hook (self, hook);
+  }
+}
+
+static void
+ensure_all_sorted (WpEventDispatcher * self)
+{
+  GHashTableIter iter;
+  gpointer hooks;
+
+  /* ensure_sorted() removes the entry, so restart the iteration each time */
+  for (;;) {
+    g_hash_table_iter_init (&iter, self->unsorted_hooks);
+    if (!g_hash_table_iter_next (&iter, &hooks, NULL))
+      break;
+    ensure_sorted (self, hooks);
+  }
+}
+
 /*!
  * \brief Registers an event hook
+ *
+ * The hooks are sorted according to their before/after dependencies lazily,
+ * the next time that the hooks are needed for dispatching an event, so that
+ * registering many hooks in a row does not sort them over and over. As a
+ * consequence, a hook that introduces circular dependencies is only rejected
+ * (and unregistered, with a warning) at that point, and the successful
+ * registration of a hook is also only logged once it has been sorted.
+ *
  * \ingroup wpeventdispatcher
  *
  * \param self the event dispatcher
@@ -458,6 +955,9 @@ wp_event_dispatcher_register_hook (WpEventDispatcher * self,
 
   wp_event_hook_set_dispatcher (hook, self);
 
+  /* the hooks arrays are about to change */
+  g_hash_table_remove_all (self->hook_filters);
+
   /* Register the event hook in the defined hooks table if it is defined */
   hook_name = wp_event_hook_get_name (hook);
   event_types = wp_event_hook_get_matching_event_types (hook);
@@ -472,24 +972,26 @@ wp_event_dispatcher_register_hook (WpEventDispatcher * self,
       /* Check if the event type was registered in the hash table */
       hooks = g_hash_table_lookup (self->defined_hooks, event_type);
       if (hooks) {
+        mark_unsorted (self, hooks, hooks->len);
         g_ptr_array_add (hooks, g_object_ref (hook));
-        if (!sort_hooks (hooks))
-          goto sort_error;
       } else {
         GPtrArray *new_hooks = g_ptr_array_new_with_free_func (g_object_unref);
-        /* Add undefined hooks */
+        /* Add undefined hooks; the ones that are not confirmed yet
+           also wait to be sorted in this new array */
         for (guint i = 0; i < self->undefined_hooks->len; i++) {
           WpEventHook *uh = g_ptr_array_index (self->undefined_hooks, i);
           g_ptr_array_add (new_hooks, g_object_ref (uh));
+          if (g_hash_table_contains (self->unconfirmed_hooks, uh))
+            add_unconfirmed (self, uh);
         }
         /* Add current hook */
         g_ptr_array_add (new_hooks, g_object_ref (hook));
         g_hash_table_insert (self->defined_hooks, g_strdup (event_type),
             new_hooks);
-        if (!sort_hooks (new_hooks))
-          goto sort_error;
+        mark_unsorted (self, new_hooks, 0);
       }
 
+      add_unconfirmed (self, hook);
       is_defined = TRUE;
     }
   }
@@ -506,25 +1008,34 @@ wp_event_dispatcher_register_hook (WpEventDispatcher * self,
     g_hash_table_iter_init (&iter, self->defined_hooks);
     while (g_hash_table_iter_next (&iter, NULL, &value)) {
       GPtrArray *defined_hooks = value;
+      mark_unsorted (self, defined_hooks, defined_hooks->len);
       g_ptr_array_add (defined_hooks, g_object_ref (hook));
-      if (!sort_hooks (defined_hooks))
-        goto sort_error;
+      add_unconfirmed (self, hook);
     }
 
     /* Add it to the undefined hooks */
+    mark_unsorted (self, self->undefined_hooks, self->undefined_hooks->len);
     g_ptr_array_add (self->undefined_hooks, g_object_ref (hook));
-    if (!sort_hooks (self->undefined_hooks))
-      goto sort_error;
+    add_unconfirmed (self, hook);
   }
+}
+
+static void
+remove_hook (WpEventDispatcher * self, GPtrArray * hooks, WpEventHook * hook)
+{
+  gpointer value;
+  guint idx;
+
+  if (!g_ptr_array_find (hooks, hook, &idx))
+    return;
 
-  wp_info_object (self, "Registered hook %s successfully", hook_name);
-  return;
+  /* keep track of where the newly registered hooks start */
+  if (g_hash_table_lookup_extended (self->unsorted_hooks, hooks, NULL, &value) &&
+      idx < GPOINTER_TO_UINT (value) - 1)
+    g_hash_table_insert (self->unsorted_hooks, hooks,
+        GUINT_TO_POINTER (GPOINTER_TO_UINT (value) - 1));
 
-sort_error:
-  /* Unregister hook */
-  wp_event_dispatcher_unregister_hook (self, hook);
-  wp_warning_object (self,
-      "Could not register hook %s because of circular dependencies", hook_name);
+  g_ptr_array_remove_index (hooks, idx);
 }
 
 /*!
@@ -549,14 +1060,16 @@ wp_event_dispatcher_unregister_hook (WpEventDispatcher * self,
   g_return_if_fail (already_registered_dispatcher == self);
 
   wp_event_hook_set_dispatcher (hook, NULL);
+  g_hash_table_remove_all (self->hook_filters);
+  g_hash_table_remove (self->unconfirmed_hooks, hook);
 
   /* Remove hook from defined table and undefined list */
   g_hash_table_iter_init (&iter, self->defined_hooks);
   while (g_hash_table_iter_next (&iter, NULL, &value)) {
     GPtrArray *defined_hooks = value;
-    g_ptr_array_remove (defined_hooks, hook);
+    remove_hook (self, defined_hooks, hook);
   }
-  g_ptr_array_remove (self->undefined_hooks, hook);
+  remove_hook (self, self->undefined_hooks, hook);
 }
 
 static void
@@ -584,6 +1097,8 @@ wp_event_dispatcher_new_hooks_iterator (WpEventDispatcher * self)
   GHashTableIter iter;
   gpointer value;
 
+  ensure_all_sorted (self);
+
   /* Add all defined hooks */
   g_hash_table_iter_init (&iter, self->defined_hooks);
   while (g_hash_table_iter_next (&iter, NULL, &value)) {
@@ -630,6 +1145,197 @@ wp_event_dispatcher_new_hooks_for_event_type_iterator (
         hooks->len, event_type);
   }
 
+  ensure_sorted (self, hooks);
+
   items = g_ptr_array_copy (hooks, (GCopyFunc) g_object_ref, NULL);
   return wp_iterator_new_ptr_array (items, WP_TYPE_EVENT_HOOK);
 }
+
+static GPtrArray *
+get_hooks_for_event_type (WpEventDispatcher * self, const gchar *event_type)
+{
+  GPtrArray *hooks = event_type ?
+      g_hash_table_lookup (self->defined_hooks, event_type) : NULL;
+  hooks = hooks ? hooks : self->undefined_hooks;
+  ensure_sorted (self, hooks);
+  return hooks;
+}
+
+/*!
+ * \brief Returns the registered hooks that may run for an event with the
+ *   given properties, in the order they are meant to run
+ *
+ * Hooks are selected by event type first and then by the values of a few
+ * commonly constrained event properties, without evaluating their interests.
+ * The result is a superset of the hooks that will actually run; the caller
+ * still needs to check wp_event_hook_runs_for_event() on each of them.
+ *
+ * \ingroup wpeventdispatcher
+ * \param self the event dispatcher
+ * \param properties (nullable): the event properties
+ * \return (element-type WpEventHook) (transfer full): the candidate hooks
+ */
+GPtrArray *
+wp_event_dispatcher_get_candidate_hooks (WpEventDispatcher * self,
+    WpProperties * properties)
+{
+  const gchar *event_type =
+      properties ? wp_properties_get (properties, "event.type") : NULL;
+  GPtrArray *hooks = get_hooks_for_event_type (self, event_type);
+  GPtrArray *res = g_ptr_array_new_with_free_func (g_object_unref);
+  HookFilter *filter;
+
+  g_return_val_if_fail (WP_IS_EVENT_DISPATCHER (self), res);
+
+  if (hooks->len == 0)
+    return res;
+
+  filter = g_hash_table_lookup (self->hook_filters, hooks);
+  if (!filter) {
+    filter = hook_filter_new (hooks);
+    g_hash_table_insert (self->hook_filters, hooks, filter);
+  }
+
+  hook_filter_select (filter, hooks, properties, res);
+
+  wp_trace_object (self, "selected %u out of %u hooks for event type %s",
+      res->len, hooks->len, event_type);
+  return res;
+}
+
+static void
+add_stats_counter (WpSpaJsonBuilder * b, const gchar * name,
+    const StatsCounter * counter)
+{
+  g_autofree gchar *total = g_strdup_printf ("%s-total-ms", name);
+  g_autofree gchar *max = g_strdup_printf ("%s-max-ms", name);
+
+  wp_spa_json_builder_add_property (b, total);
+  wp_spa_json_builder_add_float (b, counter->total / 1000.0f);
+  wp_spa_json_builder_add_property (b, max);
+  wp_spa_json_builder_add_float (b, counter->max / 1000.0f);
+}
+
+/*!
+ * \brief Gets statistics about the hooks and events that have been
+ *   dispatched so far
+ *
+ * The returned JSON object has the following members:
+ *   - "hooks": an array with an object for each hook that has run, holding
+ *     its "name", the number of "invocations" and the total and maximum
+ *     "time" (from starting the hook until it finishes, including any
+ *     asynchronous operation) and "blocking-time" (spent synchronously in
+ *     the event loop), in milliseconds
+ *   - "events": an array with an object for each event type that has been
+ *     dispatched, holding its "type", the number of dispatched events
+ *     ("count"), the number of events that were coalesced into already
+ *     queued ones ("coalesced") and the total and maximum "wait-time" (from
+ *     pushing the event until its first hook runs) and "dispatch-time" (from
+ *     its first hook starting until the last one finishes), in milliseconds
+ *   - "queued": the number of events waiting to be dispatched
+ *   - "running-hook" (optional): if the highest priority event is currently
+ *     waiting for an asynchronous hook, an object with the hook's "name",
+ *     the "event" name and the "elapsed-ms" time since the hook started
+ *
+ * \ingroup wpeventdispatcher
+ * \param self the event dispatcher
+ * \returns (transfer full): the statistics as a JSON object
+ * \since 0.5.16
+ */
+WpSpaJson *
+wp_event_dispatcher_get_stats (WpEventDispatcher * self)
+{
+  g_autoptr (WpSpaJsonBuilder) b = wp_spa_json_builder_new_object ();
+  EventData *event_data;
+  GHashTableIter iter;
+  gpointer key, value;
+  gint64 now = g_get_monotonic_time ();
+
+  g_return_val_if_fail (WP_IS_EVENT_DISPATCHER (self), NULL);
+
+  wp_spa_json_builder_add_property (b, "hooks");
+  {
+    g_autoptr (WpSpaJsonBuilder) arr = wp_spa_json_builder_new_array ();
+    g_hash_table_iter_init (&iter, self->hook_stats);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+      const HookStats *stats = value;
+      g_autoptr (WpSpaJsonBuilder) o = wp_spa_json_builder_new_object ();
+      g_autoptr (WpSpaJson) json = NULL;
+
+      wp_spa_json_builder_add_property (o, "name");
+      wp_spa_json_builder_add_string (o, key);
+      wp_spa_json_builder_add_property (o, "invocations");
+      wp_spa_json_builder_add_int (o, stats->blocking_time.count);
+      add_stats_counter (o, "time", &stats->time);
+      add_stats_counter (o, "blocking-time", &stats->blocking_time);
+      json = wp_spa_json_builder_end (o);
+      wp_spa_json_builder_add_json (arr, json);
+    }
+    g_autoptr (WpSpaJson) json = wp_spa_json_builder_end (arr);
+    wp_spa_json_builder_add_json (b, json);
+  }
+
+  wp_spa_json_builder_add_property (b, "events");
+  {
+    g_autoptr (WpSpaJsonBuilder) arr = wp_spa_json_builder_new_array ();
+    g_hash_table_iter_init (&iter, self->event_type_stats);
+    while (g_hash_table_iter_next (&iter, &key, &value)) {
+      const EventTypeStats *stats = value;
+      g_autoptr (WpSpaJsonBuilder) o = wp_spa_json_builder_new_object ();
+      g_autoptr (WpSpaJson) json = NULL;
+
+      wp_spa_json_builder_add_property (o, "type");
+      wp_spa_json_builder_add_string (o, key);
+      wp_spa_json_builder_add_property (o, "count");
+      wp_spa_json_builder_add_int (o, stats->dispatch_time.count);
+      wp_spa_json_builder_add_property (o, "coalesced");
+      wp_spa_json_builder_add_int (o, stats->n_coalesced);
+      add_stats_counter (o, "wait-time", &stats->wait_time);
+      add_stats_counter (o, "dispatch-time", &stats->dispatch_time);
+      json = wp_spa_json_builder_end (o);
+      wp_spa_json_builder_add_json (arr, json);
+    }
+    g_autoptr (WpSpaJson) json = wp_spa_json_builder_end (arr);
+    wp_spa_json_builder_add_json (b, json);
+  }
+
+  wp_spa_json_builder_add_property (b, "queued");
+  wp_spa_json_builder_add_int (b, self->events->len);
+
+  event_data = events_heap_peek (self->events);
+  if (event_data && event_data->current_hook_in_async) {
+    g_autoptr (WpSpaJsonBuilder) o = wp_spa_json_builder_new_object ();
+    g_autoptr (WpSpaJson) json = NULL;
+
+    wp_spa_json_builder_add_property (o, "name");
+    wp_spa_json_builder_add_string (o,
+        wp_event_hook_get_name (event_data->current_hook_in_async));
+    wp_spa_json_builder_add_property (o, "event");
+    wp_spa_json_builder_add_string (o, wp_event_get_name (event_data->event));
+    wp_spa_json_builder_add_property (o, "elapsed-ms");
+    wp_spa_json_builder_add_float (o,
+        (now - event_data->hook_start_time) / 1000.0f);
+    json = wp_spa_json_builder_end (o);
+
+    wp_spa_json_builder_add_property (b, "running-hook");
+    wp_spa_json_builder_add_json (b, json);
+  }
+
+  return wp_spa_json_builder_end (b);
+}
+
+/*!
+ * \brief Resets the statistics returned by wp_event_dispatcher_get_stats()
+ *
+ * \ingroup wpeventdispatcher
+ * \param self the event dispatcher
+ * \since 0.5.16
+ */
+void
+wp_event_dispatcher_reset_stats (WpEventDispatcher * self)
+{
+  g_return_if_fail (WP_IS_EVENT_DISPATCHER (self));
+
+  g_hash_table_remove_all (self->hook_stats);
+  g_hash_table_remove_all (self->event_type_stats);
+}
@@ -12,6 +12,7 @@
 #include "core.h"
 #include "event.h"
 #include "event-hook.h"
+#include "spa-json.h"
 
 G_BEGIN_DECLS
 
@@ -32,6 +33,10 @@ WpEventDispatcher * wp_event_dispatcher_get_instance (WpCore * core);
 WP_API
 void wp_event_dispatcher_push_event (WpEventDispatcher * self, WpEvent * event);
 
+WP_API
+void wp_event_dispatcher_set_coalescing (WpEventDispatcher * self,
+    const gchar * event_type, gboolean enabled);
+
 WP_API
 void wp_event_dispatcher_register_hook (WpEventDispatcher * self,
     WpEventHook * hook);
@@ -48,6 +53,18 @@ WP_API
 WpIterator * wp_event_dispatcher_new_hooks_for_event_type_iterator (
     WpEventDispatcher * self, const gchar *event_type);
 
+WP_API
+WpSpaJson * wp_event_dispatcher_get_stats (WpEventDispatcher * self);
+
+WP_API
+void wp_event_dispatcher_reset_stats (WpEventDispatcher * self);
+
+/* private */
+
+WP_PRIVATE_API
+GPtrArray * wp_event_dispatcher_get_candidate_hooks (WpEventDispatcher * self,
+    WpProperties * properties);
+
 G_END_DECLS
 
 #endif
@@ -397,6 +397,73 @@ wp_interest_event_hook_get_matching_event_types (WpEventHook * hook)
   return g_steal_pointer (&res);
 }
 
+static gboolean
+collect_defined_values (WpObjectInterest * interest, WpConstraintType type,
+    const gchar * key, GPtrArray * res, gboolean * defined)
+{
+  g_autoptr (GPtrArray) values =
+      wp_object_interest_find_defined_constraint_values (interest, type, key);
+
+  for (guint i = 0; i < values->len; i++) {
+    GVariant *v = g_ptr_array_index (values, i);
+    if (!g_variant_is_of_type (v, G_VARIANT_TYPE_STRING))
+      return FALSE;
+    add_unique (res, g_variant_get_string (v, NULL));
+    *defined = TRUE;
+  }
+  return TRUE;
+}
+
+/*!
+ * \brief Gets the string values that the event property \a key must have
+ *   for this hook to possibly run
+ *
+ * This is used by the event dispatcher to pre-filter hooks before calling
+ * wp_event_hook_runs_for_event(). A NULL return value means that the hook
+ * may run regardless of the value of \a key (or its absence).
+ *
+ * \ingroup wpeventhook
+ * \param self the event hook
+ * \param key the event property name
+ * \returns (element-type gchar*) (transfer full) (nullable): the possible
+ *   values of \a key, or NULL if the hook does not restrict it
+ */
+GPtrArray *
+wp_event_hook_get_defined_values (WpEventHook * self, const gchar * key)
+{
+  g_autoptr (GPtrArray) res = NULL;
+  WpInterestEventHookPrivate *priv;
+
+  g_return_val_if_fail (WP_IS_EVENT_HOOK (self), NULL);
+
+  /* only interest hooks declare their constraints upfront */
+  if (!WP_IS_INTEREST_EVENT_HOOK (self))
+    return NULL;
+
+  priv = wp_interest_event_hook_get_instance_private (
+      WP_INTEREST_EVENT_HOOK (self));
+  res = g_ptr_array_new_with_free_func (g_free);
+
+  for (guint i = 0; i < priv->interests->len; i++) {
+    WpObjectInterest *interest = g_ptr_array_index (priv->interests, i);
+    gboolean defined = FALSE;
+
+    /* event properties are matched as both global and non-global
+       properties; G_PROPERTY constraints apply to the subject instead */
+    if (!collect_defined_values (interest,
+            WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, key, res, &defined) ||
+        !collect_defined_values (interest,
+            WP_CONSTRAINT_TYPE_PW_PROPERTY, key, res, &defined))
+      return NULL;
+
+    /* one interest without a defined value makes the whole hook "any" */
+    if (!defined)
+      return NULL;
+  }
+
+  return g_steal_pointer (&res);
+}
+
 static void
 wp_interest_event_hook_class_init (WpInterestEventHookClass * klass)
 {
@@ -61,6 +61,10 @@ WP_PRIVATE_API
 void wp_event_hook_set_dispatcher (WpEventHook * self,
     WpEventDispatcher * dispatcher);
 
+WP_PRIVATE_API
+GPtrArray * wp_event_hook_get_defined_values (WpEventHook * self,
+    const gchar * key);
+
 WP_API
 gboolean wp_event_hook_runs_for_event (WpEventHook * self, WpEvent * event);
 
@@ -310,8 +310,7 @@ wp_event_get_data (WpEvent * self, const gchar * key)
 gboolean
 wp_event_collect_hooks (WpEvent * event, WpEventDispatcher * dispatcher)
 {
-  g_autoptr (WpIterator) all_hooks = NULL;
-  g_auto (GValue) value = G_VALUE_INIT;
+  g_autoptr (GPtrArray) candidates = NULL;
   const gchar *event_type = NULL;
 
   g_return_val_if_fail (event != NULL, FALSE);
@@ -325,17 +324,17 @@ wp_event_collect_hooks (WpEvent * event, WpEventDispatcher * dispatcher)
   wp_debug_object (dispatcher, "Collecting hooks for event %s with type %s",
       event->name, event_type);
 
-  /* Collect hooks that run for this event */
-  all_hooks = wp_event_dispatcher_new_hooks_for_event_type_iterator (dispatcher,
-      event_type);
-  while (wp_iterator_next (all_hooks, &value)) {
-    WpEventHook *hook = g_value_get_object (&value);
+  /* Collect hooks that run for this event; the dispatcher has already
+     discarded the ones whose interests cannot possibly match */
+  candidates = wp_event_dispatcher_get_candidate_hooks (dispatcher,
+      event->properties);
+  for (guint i = 0; i < candidates->len; i++) {
+    WpEventHook *hook = g_ptr_array_index (candidates, i);
     if (wp_event_hook_runs_for_event (hook, event)) {
       g_ptr_array_add (event->hooks, g_object_ref (hook));
       wp_debug_boxed (WP_TYPE_EVENT, event, "added "WP_OBJECT_FORMAT"(%s)",
           WP_OBJECT_ARGS (hook), wp_event_hook_get_name (hook));
     }
-    g_value_unset (&value);
   }
 
   return event->hooks->len > 0;
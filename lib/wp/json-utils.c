@@ -10,6 +10,8 @@
 #include "error.h"
 #include "log.h"
 
+#include <regex.h>
+
 #include <pipewire/pipewire.h>
 #include <spa/utils/result.h>
 
@@ -17,20 +19,559 @@ WP_DEFINE_LOCAL_LOG_TOPIC ("wp-json-utils")
 
 /*! \defgroup wpjsonutils Json Utilities */
 
-struct match_rules_cb_data
+/*!
+ * \struct WpMatchRules
+ *
+ * WpMatchRules is a set of match rules, in the format accepted by
+ * wp_json_utils_match_rules(), compiled into a form that is fast to evaluate.
+ *
+ * Compiling parses the rules, unescapes all the keys and values and compiles
+ * the regular expressions once. In addition, every "matches" object that has
+ * at least one plain equality condition is indexed on the key that is shared
+ * by most of the objects, so that evaluating the rules against a set of
+ * properties only needs to check the objects that can possibly match.
+ * Objects with only regular expressions, negations or null values are
+ * checked every time.
+ *
+ * \since 0.5.16
+ */
+
+typedef enum {
+  MATCH_CONDITION_EQUALS,
+  MATCH_CONDITION_REGEX,
+  MATCH_CONDITION_NULL,
+} MatchConditionType;
+
+typedef struct _MatchCondition MatchCondition;
+struct _MatchCondition
+{
+  gchar *key;
+  gchar *value;
+  MatchConditionType type;
+  gboolean negate;
+  gboolean regex_valid;
+  regex_t regex;
+};
+
+/* one of the objects in a rule's "matches" array */
+typedef struct _MatchObject MatchObject;
+struct _MatchObject
+{
+  guint rule;
+  GArray *conditions; /* element-type: MatchCondition */
+};
+
+typedef struct _MatchAction MatchAction;
+struct _MatchAction
+{
+  gchar *name;
+  WpSpaJson *value;
+};
+
+struct _WpMatchRules
+{
+  guint n_rules;
+  GArray *actions; /* element-type: GArray of MatchAction, one per rule */
+  GArray *objects; /* element-type: MatchObject */
+
+  /* key -> (value -> GArray of object indices) */
+  GHashTable *index;
+  GArray *unindexed; /* element-type: guint, object indices */
+};
+
+G_DEFINE_BOXED_TYPE (WpMatchRules, wp_match_rules,
+    wp_match_rules_ref, wp_match_rules_unref)
+
+static void
+match_condition_clear (MatchCondition * cond)
+{
+  g_free (cond->key);
+  g_free (cond->value);
+  if (cond->regex_valid)
+    regfree (&cond->regex);
+}
+
+static void
+match_object_clear (MatchObject * obj)
+{
+  g_clear_pointer (&obj->conditions, g_array_unref);
+}
+
+static void
+match_action_clear (MatchAction * action)
+{
+  g_free (action->name);
+  g_clear_pointer (&action->value, wp_spa_json_unref);
+}
+
+static void
+action_array_clear (GArray ** actions)
+{
+  g_clear_pointer (actions, g_array_unref);
+}
+
+static void
+wp_match_rules_free (WpMatchRules * self)
+{
+  g_clear_pointer (&self->index, g_hash_table_unref);
+  g_clear_pointer (&self->unindexed, g_array_unref);
+  g_clear_pointer (&self->objects, g_array_unref);
+  g_clear_pointer (&self->actions, g_array_unref);
+}
+
+static gchar *
+token_dup_string (const WpSpaJsonToken * token)
+{
+  gchar *str = g_malloc (token->size + 1);
+  if (!wp_spa_json_token_parse_string (token, str, token->size + 1))
+    g_clear_pointer (&str, g_free);
+  return str;
+}
+
+static gboolean
+compile_condition (const WpSpaJsonToken * key, const WpSpaJsonToken * value,
+    MatchCondition * cond)
+{
+  const gchar *str;
+
+  if (!(cond->key = token_dup_string (key)))
+    return FALSE;
+
+  if (value->type == WP_SPA_JSON_TOKEN_TYPE_NULL) {
+    cond->type = MATCH_CONDITION_NULL;
+    return TRUE;
+  }
+
+  if (!(cond->value = token_dup_string (value)))
+    return FALSE;
+
+  str = cond->value;
+  if (str[0] == '!') {
+    cond->negate = TRUE;
+    str++;
+  }
+  if (str[0] == '~') {
+    gint res;
+
+    cond->type = MATCH_CONDITION_REGEX;
+    res = regcomp (&cond->regex, str + 1, REG_EXTENDED | REG_NOSUB);
+    if (res != 0) {
+      gchar errbuf[256];
+      regerror (res, &cond->regex, errbuf, sizeof (errbuf));
+      wp_warning ("invalid regex %s: %s", str + 1, errbuf);
+    } else {
+      cond->regex_valid = TRUE;
+    }
+  } else {
+    cond->type = MATCH_CONDITION_EQUALS;
+    if (cond->negate)
+      memmove (cond->value, str, strlen (str) + 1);
+  }
+  return TRUE;
+}
+
+static void
+compile_matches (WpMatchRules * self, guint rule, const WpSpaJsonToken * matches)
+{
+  WpSpaJsonCursor it;
+  WpSpaJsonToken obj_token;
+
+  wp_spa_json_cursor_init (&it, matches->data, matches->size);
+  while (wp_spa_json_cursor_next (&it, &obj_token)) {
+    WpSpaJsonCursor oit;
+    WpSpaJsonToken key, value;
+    MatchObject obj = { rule, NULL };
+
+    if (obj_token.type != WP_SPA_JSON_TOKEN_TYPE_OBJECT)
+      continue;
+
+    obj.conditions = g_array_new (FALSE, TRUE, sizeof (MatchCondition));
+    g_array_set_clear_func (obj.conditions,
+        (GDestroyNotify) match_condition_clear);
+
+    wp_spa_json_cursor_init (&oit, obj_token.data, obj_token.size);
+    while (wp_spa_json_cursor_next (&oit, &key) &&
+           wp_spa_json_cursor_next (&oit, &value)) {
+      MatchCondition cond = { 0, };
+      if (compile_condition (&key, &value, &cond))
+        g_array_append_val (obj.conditions, cond);
+      else
+        match_condition_clear (&cond);
+    }
+
+    /* objects without conditions never match */
+    if (obj.conditions->len > 0)
+      g_array_append_val (self->objects, obj);
+    else
+      match_object_clear (&obj);
+  }
+}
+
+static void
+compile_actions (WpMatchRules * self, const WpSpaJsonToken * actions_token)
+{
+  WpSpaJsonCursor it;
+  WpSpaJsonToken key, value;
+  GArray *actions;
+
+  actions = g_array_new (FALSE, TRUE, sizeof (MatchAction));
+  g_array_set_clear_func (actions, (GDestroyNotify) match_action_clear);
+
+  wp_spa_json_cursor_init (&it, actions_token->data, actions_token->size);
+  while (wp_spa_json_cursor_next (&it, &key) &&
+         wp_spa_json_cursor_next (&it, &value)) {
+    MatchAction action = { token_dup_string (&key), NULL };
+    if (!action.name)
+      continue;
+    /* copied, because the callback may keep a reference to it */
+    action.value = wp_spa_json_new_from_stringn (value.data, value.size);
+    g_array_append_val (actions, action);
+  }
+
+  g_array_append_val (self->actions, actions);
+}
+
+static void
+build_index (WpMatchRules * self)
+{
+  g_autoptr (GHashTable) key_counts =
+      g_hash_table_new (g_str_hash, g_str_equal);
+
+  /* count how many objects could be indexed by each key */
+  for (guint i = 0; i < self->objects->len; i++) {
+    MatchObject *obj = &g_array_index (self->objects, MatchObject, i);
+    for (guint j = 0; j < obj->conditions->len; j++) {
+      MatchCondition *c = &g_array_index (obj->conditions, MatchCondition, j);
+      if (c->type == MATCH_CONDITION_EQUALS && !c->negate) {
+        guint n = GPOINTER_TO_UINT (g_hash_table_lookup (key_counts, c->key));
+        g_hash_table_insert (key_counts, c->key, GUINT_TO_POINTER (n + 1));
+      }
+    }
+  }
+
+  /* index each object on its most shared key, so that evaluating
+     the rules needs to look up as few keys as possible */
+  for (guint i = 0; i < self->objects->len; i++) {
+    MatchObject *obj = &g_array_index (self->objects, MatchObject, i);
+    MatchCondition *best = NULL;
+    guint best_count = 0;
+    GHashTable *values;
+    GArray *indices;
+
+    for (guint j = 0; j < obj->conditions->len; j++) {
+      MatchCondition *c = &g_array_index (obj->conditions, MatchCondition, j);
+      if (c->type == MATCH_CONDITION_EQUALS && !c->negate) {
+        guint n = GPOINTER_TO_UINT (g_hash_table_lookup (key_counts, c->key));
+        if (n > best_count) {
+          best = c;
+          best_count = n;
+        }
+      }
+    }
+
+    if (!best) {
+      g_array_append_val (self->unindexed, i);
+      continue;
+    }
+
+    values = g_hash_table_lookup (self->index, best->key);
+    if (!values) {
+      values = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+          (GDestroyNotify) g_array_unref);
+      g_hash_table_insert (self->index, best->key, values);
+    }
+    indices = g_hash_table_lookup (values, best->value);
+    if (!indices) {
+      indices = g_array_new (FALSE, FALSE, sizeof (guint));
+      g_hash_table_insert (values, best->value, indices);
+    }
+    g_array_append_val (indices, i);
+  }
+}
+
+static WpMatchRules *
+wp_match_rules_compile (WpSpaJson * json)
+{
+  WpMatchRules *self = g_rc_box_new0 (WpMatchRules);
+  WpSpaJsonCursor it;
+  WpSpaJsonToken rule_token;
+
+  self->actions = g_array_new (FALSE, TRUE, sizeof (GArray *));
+  g_array_set_clear_func (self->actions, (GDestroyNotify) action_array_clear);
+  self->objects = g_array_new (FALSE, TRUE, sizeof (MatchObject));
+  g_array_set_clear_func (self->objects, (GDestroyNotify) match_object_clear);
+  self->index = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+      (GDestroyNotify) g_hash_table_unref);
+  self->unindexed = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  if (!wp_spa_json_is_array (json)) {
+    wp_debug ("match rules are not an array; nothing will match");
+    return self;
+  }
+
+  wp_spa_json_cursor_init (&it, wp_spa_json_get_data (json),
+      wp_spa_json_get_size (json));
+  while (wp_spa_json_cursor_next (&it, &rule_token)) {
+    WpSpaJsonCursor rit;
+    WpSpaJsonToken key, value, matches = { 0, }, actions = { 0, };
+
+    if (rule_token.type != WP_SPA_JSON_TOKEN_TYPE_OBJECT)
+      continue;
+
+    wp_spa_json_cursor_init (&rit, rule_token.data, rule_token.size);
+    while (wp_spa_json_cursor_next (&rit, &key) &&
+           wp_spa_json_cursor_next (&rit, &value)) {
+      if (wp_spa_json_token_equals_string (&key, "matches"))
+        matches = value;
+      else if (wp_spa_json_token_equals_string (&key, "actions"))
+        actions = value;
+    }
+
+    /* rules that cannot match or do nothing are skipped */
+    if (matches.type != WP_SPA_JSON_TOKEN_TYPE_ARRAY ||
+        actions.type != WP_SPA_JSON_TOKEN_TYPE_OBJECT)
+      continue;
+
+    compile_matches (self, self->n_rules, &matches);
+    compile_actions (self, &actions);
+    self->n_rules++;
+  }
+
+  build_index (self);
+  return self;
+}
+
+/*!
+ * \brief Compiles a set of match rules
+ *
+ * The compiled rules are cached on \a json, so calling this again on the
+ * same JSON object (like a configuration section obtained from
+ * wp_conf_get_section()) returns the same rules without compiling them again.
+ *
+ * \ingroup wpjsonutils
+ * \param json a JSON array containing rules in the format accepted by
+ *    wp_json_utils_match_rules()
+ * \returns (transfer full): the compiled rules
+ * \since 0.5.16
+ */
+WpMatchRules *
+wp_match_rules_new (WpSpaJson * json)
+{
+  WpMatchRules *self;
+
+  g_return_val_if_fail (json != NULL, NULL);
+
+  self = wp_spa_json_get_compiled_data (json);
+  if (!self) {
+    self = wp_match_rules_compile (json);
+    wp_spa_json_set_compiled_data (json, self,
+        (GDestroyNotify) wp_match_rules_unref);
+  }
+  return wp_match_rules_ref (self);
+}
+
+/*!
+ * \brief Increases the reference count of a match rules object
+ * \ingroup wpjsonutils
+ * \param self a match rules object
+ * \returns (transfer full): \a self with an additional reference count on it
+ * \since 0.5.16
+ */
+WpMatchRules *
+wp_match_rules_ref (WpMatchRules * self)
+{
+  return g_rc_box_acquire (self);
+}
+
+/*!
+ * \brief Decreases the reference count on \a self and frees it when the ref
+ * count reaches zero.
+ * \ingroup wpjsonutils
+ * \param self (transfer full): a match rules object
+ * \since 0.5.16
+ */
+void
+wp_match_rules_unref (WpMatchRules * self)
+{
+  g_rc_box_release_full (self, (GDestroyNotify) wp_match_rules_free);
+}
+
+static gboolean
+match_object_matches (MatchObject * obj, WpProperties * props)
+{
+  for (guint i = 0; i < obj->conditions->len; i++) {
+    MatchCondition *c = &g_array_index (obj->conditions, MatchCondition, i);
+    const gchar *str = wp_properties_get (props, c->key);
+    gboolean success;
+
+    switch (c->type) {
+      case MATCH_CONDITION_NULL:
+        success = (str == NULL);
+        break;
+      case MATCH_CONDITION_REGEX:
+        success = str && c->regex_valid &&
+            regexec (&c->regex, str, 0, NULL, 0) == 0;
+        break;
+      default:
+        success = str && g_str_equal (str, c->value);
+        break;
+    }
+
+    if (c->negate)
+      success = !success;
+    if (!success)
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* Finds which of the rules starting from \a first match \a props;
+ * the index is used to skip the objects that cannot match */
+static void
+find_matching_rules (WpMatchRules * self, WpProperties * props, guint first,
+    guint8 * hits)
 {
-  WpRuleMatchCallback callback;
-  gpointer data;
-  GError **error;
+  GHashTableIter iter;
+  gpointer key, values;
+
+  memset (hits + first, 0, self->n_rules - first);
+
+  /* objects indexed by the value of one of their keys */
+  g_hash_table_iter_init (&iter, self->index);
+  while (g_hash_table_iter_next (&iter, &key, &values)) {
+    const gchar *value = wp_properties_get (props, key);
+    GArray *indices;
+
+    if (!value || !(indices = g_hash_table_lookup (values, value)))
+      continue;
+
+    for (guint i = 0; i < indices->len; i++) {
+      MatchObject *obj = &g_array_index (self->objects, MatchObject,
+          g_array_index (indices, guint, i));
+      if (obj->rule >= first && !hits[obj->rule] &&
+          match_object_matches (obj, props))
+        hits[obj->rule] = TRUE;
+    }
+  }
+
+  /* objects that cannot be indexed */
+  for (guint i = 0; i < self->unindexed->len; i++) {
+    MatchObject *obj = &g_array_index (self->objects, MatchObject,
+        g_array_index (self->unindexed, guint, i));
+    if (obj->rule >= first && !hits[obj->rule] &&
+        match_object_matches (obj, props))
+      hits[obj->rule] = TRUE;
+  }
+}
+
+#define MAX_STACK_RULES 256
+
+/*!
+ * \brief Matches the given properties against compiled rules and calls the
+ * given callback to perform actions on a successful match.
+ *
+ * This behaves exactly like wp_json_utils_match_rules(). Rules are evaluated
+ * in the order in which they are defined and each rule sees the changes that
+ * the actions of the previous rules made on \a match_props.
+ *
+ * \ingroup wpjsonutils
+ * \param self the compiled rules
+ * \param match_props (transfer none): the properties to match against the rules
+ * \param callback (scope call)(closure data): a function to call for each action on a successful match
+ * \param data data to be passed to \a callback
+ * \param error (out)(optional): the error that occurred, if any
+ * \returns FALSE if an error occurred, TRUE otherwise
+ * \since 0.5.16
+ */
+gboolean
+wp_match_rules_match (WpMatchRules * self, WpProperties * match_props,
+    WpRuleMatchCallback callback, gpointer data, GError ** error)
+{
+  guint8 stack_hits[MAX_STACK_RULES];
+  g_autofree guint8 *heap_hits = NULL;
+  guint8 *hits = stack_hits;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (match_props != NULL, FALSE);
+  g_return_val_if_fail (callback != NULL, FALSE);
+
+  if (self->n_rules == 0)
+    return TRUE;
+
+  if (self->n_rules > MAX_STACK_RULES)
+    hits = heap_hits = g_new0 (guint8, self->n_rules);
+
+  find_matching_rules (self, match_props, 0, hits);
+
+  for (guint r = 0; r < self->n_rules; r++) {
+    GArray *actions;
+
+    if (!hits[r])
+      continue;
+
+    actions = g_array_index (self->actions, GArray *, r);
+    for (guint i = 0; i < actions->len; i++) {
+      MatchAction *a = &g_array_index (actions, MatchAction, i);
+      g_autoptr (GError) cb_error = NULL;
+
+      if (!callback (data, a->name, a->value, &cb_error)) {
+        if (cb_error)
+          g_propagate_error (error, g_steal_pointer (&cb_error));
+        else
+          g_set_error (error, WP_DOMAIN_LIBRARY,
+              WP_LIBRARY_ERROR_OPERATION_FAILED,
+              "match rules error: %s", spa_strerror (-EPIPE));
+        return FALSE;
+      }
+    }
+
+    /* the actions may have changed the properties that the following
+       rules are matched against */
+    if (actions->len > 0 && r + 1 < self->n_rules)
+      find_matching_rules (self, match_props, r + 1, hits);
+  }
+
+  return TRUE;
+}
+
+struct update_props_cb_data
+{
+  WpProperties *props;
+  gint count;
 };
 
-static int
-match_rules_cb (void *data, const char *location, const char *action,
-    const char *str, size_t len)
+static gboolean
+update_props_cb (gpointer data, const gchar * action, WpSpaJson * value,
+    GError ** error)
 {
-  struct match_rules_cb_data *cb_data = data;
-  g_autoptr (WpSpaJson) json = wp_spa_json_new_wrap_stringn (str, len);
-  return cb_data->callback (cb_data->data, action, json, cb_data->error) ? 0 : -EPIPE;
+  struct update_props_cb_data *cb_data = data;
+  if (g_str_equal (action, "update-props"))
+    cb_data->count += wp_properties_update_from_json (cb_data->props, value);
+  return TRUE;
+}
+
+/*!
+ * \brief Matches the given properties against compiled rules and updates the
+ * properties if the rule actions include the "update-props" action.
+ *
+ * \ingroup wpjsonutils
+ * \param self the compiled rules
+ * \param props (transfer none): the properties to match against the rules
+ *    and also update, acting on the "update-props" action
+ * \returns the number of properties that were updated
+ * \since 0.5.16
+ */
+gint
+wp_match_rules_update_properties (WpMatchRules * self, WpProperties * props)
+{
+  g_autoptr (GError) cb_error = NULL;
+  struct update_props_cb_data cb_data = { props, 0 };
+
+  wp_match_rules_match (self, props, update_props_cb, &cb_data, &cb_error);
+  if (cb_error)
+    wp_notice ("%s", cb_error->message);
+
+  return cb_data.count;
 }
 
 /*!
@@ -48,6 +589,15 @@ match_rules_cb (void *data, const char *location, const char *action,
  * and the value can be any valid JSON. Both the action name and the value are
  * passed as-is on the \a callback.
  *
+ * A match value of null matches when the property is not set. A value that
+ * starts with '!' matches when the rest of it does not match, which includes
+ * the case where the property is not set. A value that starts with '~'
+ * (after the optional '!') is an extended POSIX regular expression.
+ *
+ * The rules are compiled into a WpMatchRules the first time they are used
+ * and the result is cached on \a json, so matching many objects against the
+ * same rules (like a configuration section) does not parse them again.
+ *
  * \verbatim
  * [
  *     {
@@ -81,39 +631,8 @@ gboolean
 wp_json_utils_match_rules (WpSpaJson *json, WpProperties *match_props,
     WpRuleMatchCallback callback, gpointer data, GError ** error)
 {
-  g_autoptr (GError) cb_error = NULL;
-  struct match_rules_cb_data cb_data = { callback, data, &cb_error };
-
-  int res = pw_conf_match_rules (wp_spa_json_get_data (json),
-      wp_spa_json_get_size (json), NULL, wp_properties_peek_dict (match_props),
-      match_rules_cb, &cb_data);
-
-  if (res < 0) {
-    if (cb_error)
-      g_propagate_error (error, g_steal_pointer (&cb_error));
-    else
-      g_set_error (error, WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_OPERATION_FAILED,
-          "match rules error: %s", spa_strerror (res));
-    return FALSE;
-  }
-
-  return TRUE;
-}
-
-struct update_props_cb_data
-{
-  WpProperties *props;
-  gint count;
-};
-
-static gboolean
-update_props_cb (gpointer data, const gchar * action, WpSpaJson * value,
-    GError ** error)
-{
-  struct update_props_cb_data *cb_data = data;
-  if (g_str_equal (action, "update-props"))
-    cb_data->count += wp_properties_update_from_json (cb_data->props, value);
-  return TRUE;
+  g_autoptr (WpMatchRules) rules = wp_match_rules_new (json);
+  return wp_match_rules_match (rules, match_props, callback, data, error);
 }
 
 /*!
@@ -131,101 +650,138 @@ update_props_cb (gpointer data, const gchar * action, WpSpaJson * value,
 gint
 wp_json_utils_match_rules_update_properties (WpSpaJson *json, WpProperties *props)
 {
-  g_autoptr (GError) cb_error = NULL;
-  struct update_props_cb_data cb_data = { props, 0 };
+  g_autoptr (WpMatchRules) rules = wp_match_rules_new (json);
+  return wp_match_rules_update_properties (rules, props);
+}
 
-  wp_json_utils_match_rules (json, props, update_props_cb, &cb_data, &cb_error);
-  if (cb_error)
-    wp_notice ("%s", cb_error->message);
 
-  return cb_data.count;
+#define OVERRIDE_SECTION_PREFIX "override."
+#define KEY_BUF_SIZE 256
+
+/* Unescapes the key in \a token, using \a buf if it is big enough;
+ * \a alloc is set to a heap copy otherwise */
+static const gchar *
+get_key_string (const WpSpaJsonToken *token, gchar *buf, gchar **alloc)
+{
+  if (token->size < KEY_BUF_SIZE) {
+    if (!wp_spa_json_token_parse_string (token, buf, KEY_BUF_SIZE))
+      return NULL;
+    return buf;
+  }
+
+  *alloc = g_malloc (token->size + 1);
+  if (!wp_spa_json_token_parse_string (token, *alloc, token->size + 1))
+    return NULL;
+  return *alloc;
 }
 
+/* Looks up \a key or its "override." variant in the \a json object */
+static gboolean
+lookup_merge_key (WpSpaJson *json, const gchar *key, WpSpaJsonToken *value)
+{
+  WpSpaJsonCursor cursor;
+  WpSpaJsonToken k;
+  gsize prefix_len = strlen (OVERRIDE_SECTION_PREFIX);
+  gboolean found = FALSE;
+
+  wp_spa_json_cursor_init (&cursor, wp_spa_json_get_data (json),
+      wp_spa_json_get_size (json));
+  while (wp_spa_json_cursor_next (&cursor, &k)) {
+    WpSpaJsonToken v;
+
+    if (!wp_spa_json_cursor_next (&cursor, &v))
+      break;
+
+    if (wp_spa_json_token_equals_string (&k, key)) {
+      *value = v;
+      return TRUE;
+    }
 
-#define OVERRIDE_SECTION_PREFIX "override."
+    /* remember the first "override." match, but keep looking for
+       the plain key, which takes precedence */
+    if (!found && k.size > prefix_len &&
+        memchr (k.data, '.', k.size) != NULL) {
+      gchar buf[KEY_BUF_SIZE];
+      g_autofree gchar *alloc = NULL;
+      const gchar *str = get_key_string (&k, buf, &alloc);
+
+      if (str && g_str_has_prefix (str, OVERRIDE_SECTION_PREFIX) &&
+          g_str_equal (str + prefix_len, key)) {
+        *value = v;
+        found = TRUE;
+      }
+    }
+  }
+  return found;
+}
 
 static WpSpaJson *
 merge_json_objects (WpSpaJson *a, WpSpaJson *b)
 {
   g_autoptr (WpSpaJsonBuilder) builder = NULL;
+  WpSpaJsonCursor it;
+  WpSpaJsonToken key, val, j;
 
   builder = wp_spa_json_builder_new_object ();
 
   /* Add all properties from 'a' that don't exist in 'b' */
-  {
-    g_autoptr (WpIterator) it = wp_spa_json_new_iterator (a);
-    g_auto (GValue) item = G_VALUE_INIT;
-    for (; wp_iterator_next (it, &item); g_value_unset (&item)) {
-      g_autoptr (WpSpaJson) key = NULL;
-      g_autoptr (WpSpaJson) val = NULL;
-      g_autoptr (WpSpaJson) j = NULL;
-      g_autofree gchar *str = NULL;
-      const gchar *key_str;
-      g_autofree gchar *override_key_str = NULL;
-      gboolean override;
-
-      key = g_value_dup_boxed (&item);
-      key_str = str = wp_spa_json_parse_string (key);
-      g_return_val_if_fail (key_str, NULL);
-      override = g_str_has_prefix (str, OVERRIDE_SECTION_PREFIX);
-      if (override)
-        key_str += strlen (OVERRIDE_SECTION_PREFIX);
-      override_key_str = g_strdup_printf (OVERRIDE_SECTION_PREFIX "%s", key_str);
-
-      g_value_unset (&item);
-      g_return_val_if_fail (wp_iterator_next (it, &item), NULL);
-      val = g_value_dup_boxed (&item);
-
-      if (!wp_spa_json_object_get (b, key_str, "J", &j, NULL) &&
-          !wp_spa_json_object_get (b, override_key_str, "J", &j, NULL)) {
-        wp_spa_json_builder_add_property (builder, key_str);
-        wp_spa_json_builder_add_json (builder, val);
-      }
+  wp_spa_json_cursor_init (&it, wp_spa_json_get_data (a),
+      wp_spa_json_get_size (a));
+  while (wp_spa_json_cursor_next (&it, &key)) {
+    gchar buf[KEY_BUF_SIZE];
+    g_autofree gchar *alloc = NULL;
+    const gchar *key_str;
+
+    key_str = get_key_string (&key, buf, &alloc);
+    g_return_val_if_fail (key_str, NULL);
+    if (g_str_has_prefix (key_str, OVERRIDE_SECTION_PREFIX))
+      key_str += strlen (OVERRIDE_SECTION_PREFIX);
+
+    g_return_val_if_fail (wp_spa_json_cursor_next (&it, &val), NULL);
+
+    if (!lookup_merge_key (b, key_str, &j)) {
+      wp_spa_json_builder_add_property (builder, key_str);
+      wp_spa_json_builder_add_from_stringn (builder, val.data, val.size);
     }
   }
 
   /* Add properties from 'b' that don't exist in 'a'. If a property
    * exists in 'a' and does not have the 'override.' prefix, recursively
    * merge it before adding it. Otherwise override it. */
-  {
-    g_autoptr (WpIterator) it = wp_spa_json_new_iterator (b);
-    g_auto (GValue) item = G_VALUE_INIT;
-    for (; wp_iterator_next (it, &item); g_value_unset (&item)) {
-      g_autoptr (WpSpaJson) key = NULL;
-      g_autoptr (WpSpaJson) val = NULL;
-      g_autoptr (WpSpaJson) j = NULL;
-      g_autofree gchar *str = NULL;
-      const gchar *key_str;
-      g_autofree gchar *override_key_str = NULL;
-      gboolean override;
-
-      key = g_value_dup_boxed (&item);
-      key_str = str = wp_spa_json_parse_string (key);
-      g_return_val_if_fail (key_str, NULL);
-      override = g_str_has_prefix (str, OVERRIDE_SECTION_PREFIX);
-      if (override)
-        key_str += strlen (OVERRIDE_SECTION_PREFIX);
-      override_key_str = g_strdup_printf (OVERRIDE_SECTION_PREFIX "%s", key_str);
-
-      g_value_unset (&item);
-      g_return_val_if_fail (wp_iterator_next (it, &item), NULL);
-      val = g_value_dup_boxed (&item);
-
-      if (!override && wp_spa_json_is_container (val) &&
-          (wp_spa_json_object_get (a, key_str, "J", &j, NULL) ||
-           wp_spa_json_object_get (a, override_key_str, "J", &j, NULL))) {
-        g_autoptr (WpSpaJson) merged = wp_json_utils_merge_containers (j, val);
-        if (!merged) {
-          wp_warning ("skipping merge of %s as JSON values are not compatible containers",
-              key_str);
-          continue;
-        }
-        wp_spa_json_builder_add_property (builder, key_str);
-        wp_spa_json_builder_add_json (builder, merged);
-      } else {
-        wp_spa_json_builder_add_property (builder, key_str);
-        wp_spa_json_builder_add_json (builder, val);
+  wp_spa_json_cursor_init (&it, wp_spa_json_get_data (b),
+      wp_spa_json_get_size (b));
+  while (wp_spa_json_cursor_next (&it, &key)) {
+    gchar buf[KEY_BUF_SIZE];
+    g_autofree gchar *alloc = NULL;
+    const gchar *key_str;
+    gboolean override;
+
+    key_str = get_key_string (&key, buf, &alloc);
+    g_return_val_if_fail (key_str, NULL);
+    override = g_str_has_prefix (key_str, OVERRIDE_SECTION_PREFIX);
+    if (override)
+      key_str += strlen (OVERRIDE_SECTION_PREFIX);
+
+    g_return_val_if_fail (wp_spa_json_cursor_next (&it, &val), NULL);
+
+    if (!override &&
+        (val.type == WP_SPA_JSON_TOKEN_TYPE_ARRAY ||
+         val.type == WP_SPA_JSON_TOKEN_TYPE_OBJECT) &&
+        lookup_merge_key (a, key_str, &j)) {
+      g_autoptr (WpSpaJson) aj = wp_spa_json_new_wrap_stringn (j.data, j.size);
+      g_autoptr (WpSpaJson) bj =
+          wp_spa_json_new_wrap_stringn (val.data, val.size);
+      g_autoptr (WpSpaJson) merged = wp_json_utils_merge_containers (aj, bj);
+      if (!merged) {
+        wp_warning ("skipping merge of %s as JSON values are not compatible containers",
+            key_str);
+        continue;
       }
+      wp_spa_json_builder_add_property (builder, key_str);
+      wp_spa_json_builder_add_json (builder, merged);
+    } else {
+      wp_spa_json_builder_add_property (builder, key_str);
+      wp_spa_json_builder_add_from_stringn (builder, val.data, val.size);
     }
   }
 
@@ -236,28 +792,22 @@ static WpSpaJson *
 merge_json_arrays (WpSpaJson * a, WpSpaJson * b)
 {
   g_autoptr (WpSpaJsonBuilder) builder = NULL;
+  WpSpaJsonCursor it;
+  WpSpaJsonToken val;
 
   builder = wp_spa_json_builder_new_array ();
 
   /* Add all elements from 'a' */
-  {
-    g_autoptr (WpIterator) it = wp_spa_json_new_iterator (a);
-    g_auto (GValue) item = G_VALUE_INIT;
-    for (; wp_iterator_next (it, &item); g_value_unset (&item)) {
-      WpSpaJson *j = g_value_get_boxed (&item);
-      wp_spa_json_builder_add_json (builder, j);
-    }
-  }
+  wp_spa_json_cursor_init (&it, wp_spa_json_get_data (a),
+      wp_spa_json_get_size (a));
+  while (wp_spa_json_cursor_next (&it, &val))
+    wp_spa_json_builder_add_from_stringn (builder, val.data, val.size);
 
   /* Add all elements from 'b' */
-  {
-    g_autoptr (WpIterator) it = wp_spa_json_new_iterator (b);
-    g_auto (GValue) item = G_VALUE_INIT;
-    for (; wp_iterator_next (it, &item); g_value_unset (&item)) {
-      WpSpaJson *j = g_value_get_boxed (&item);
-      wp_spa_json_builder_add_json (builder, j);
-    }
-  }
+  wp_spa_json_cursor_init (&it, wp_spa_json_get_data (b),
+      wp_spa_json_get_size (b));
+  while (wp_spa_json_cursor_next (&it, &val))
+    wp_spa_json_builder_add_from_stringn (builder, val.data, val.size);
 
   return wp_spa_json_builder_end (builder);
 }
@@ -26,6 +26,36 @@ G_BEGIN_DECLS
 typedef gboolean (*WpRuleMatchCallback) (gpointer data, const gchar * action,
     WpSpaJson * value, GError ** error);
 
+/*!
+ * \brief The WpMatchRules GType
+ * \ingroup wpjsonutils
+ * \since 0.5.16
+ */
+#define WP_TYPE_MATCH_RULES (wp_match_rules_get_type ())
+WP_API
+GType wp_match_rules_get_type (void);
+
+typedef struct _WpMatchRules WpMatchRules;
+
+WP_API
+WpMatchRules * wp_match_rules_new (WpSpaJson * json);
+
+WP_API
+WpMatchRules * wp_match_rules_ref (WpMatchRules * self);
+
+WP_API
+void wp_match_rules_unref (WpMatchRules * self);
+
+WP_API
+gboolean wp_match_rules_match (WpMatchRules * self, WpProperties * match_props,
+    WpRuleMatchCallback callback, gpointer data, GError ** error);
+
+WP_API
+gint wp_match_rules_update_properties (WpMatchRules * self,
+    WpProperties * props);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (WpMatchRules, wp_match_rules_unref)
+
 WP_API
 gboolean wp_json_utils_match_rules (WpSpaJson * json, WpProperties * match_props,
     WpRuleMatchCallback callback, gpointer data, GError ** error);
@@ -588,6 +588,10 @@ wp_log_init (gint flags)
     wp_log_set_level (NULL);
   }
 
+  if ((flags & WP_INIT_SET_GLIB_LOG) && g_getenv ("WIREPLUMBER_LOG_ASYNC") &&
+      spa_atob (g_getenv ("WIREPLUMBER_LOG_ASYNC")))
+    wp_log_set_async (TRUE);
+
   if (log_state.set_pw_log) {
     /* always set PIPEWIRE_DEBUG for 2 reasons:
      * 1. to overwrite it from the environment, in case the user has set it
@@ -749,8 +753,8 @@ wp_log_fields_init_from_glib (WpLogFields *lf, GLogLevelFlags log_level_flags,
   }
 }
 
-static void
-wp_log_fields_write_to_stream (WpLogFields *lf, FILE *s)
+static gchar *
+wp_log_fields_format_line (WpLogFields *lf)
 {
   gint64 now;
   time_t now_secs;
@@ -762,7 +766,7 @@ wp_log_fields_write_to_stream (WpLogFields *lf, FILE *s)
   localtime_r (&now_secs, &now_tm);
   strftime (time_buf, sizeof (time_buf), "%H:%M:%S", &now_tm);
 
-  fprintf (s, "%s%c %s.%06d %s%18.18s %s%s:%s:%s:%s %s\n",
+  return g_strdup_printf ("%s%c %s.%06d %s%18.18s %s%s:%s:%s:%s %s\n",
       /* level */
       log_state.use_color ? log_level_info[lf->log_level].color : "",
       log_level_info[lf->log_level].name,
@@ -780,18 +784,27 @@ wp_log_fields_write_to_stream (WpLogFields *lf, FILE *s)
       log_state.use_color ? RESET_COLOR : "",
       /* message */
       lf->message);
+}
+
+static void
+wp_log_fields_write_to_stream (WpLogFields *lf, FILE *s)
+{
+  g_autofree gchar *line = wp_log_fields_format_line (lf);
+
+  fputs (line, s);
   fflush (s);
 }
 
-static gboolean
-wp_log_fields_write_to_journal (WpLogFields *lf)
+#define JOURNAL_MAX_FIELDS 10
+
+/* fills @fields with copies of the journal fields of @lf; the values must be
+   freed with journal_fields_clear() */
+static gsize
+wp_log_fields_to_journal_fields (WpLogFields *lf,
+    GLogField fields[JOURNAL_MAX_FIELDS])
 {
-  GLogField fields[10];
   gsize n_fields = 0;
-  g_autofree gchar *full_message = NULL;
-  const gchar *message = lf->message ? lf->message : "";
-  g_autofree gchar *pid = g_strdup_printf("%d", getpid());
-  g_autofree gchar *tid = g_strdup_printf("%d", gettid());
+  gchar *message = NULL;
 #ifdef HAS_SHORT_NAME
   const gchar *syslog_identifier = program_invocation_short_name;
 #else
@@ -802,41 +815,379 @@ wp_log_fields_write_to_journal (WpLogFields *lf)
     if (lf->file && lf->line && lf->func) {
       g_autofree gchar *file = g_path_get_basename(lf->file);
 
-      message = full_message = g_strdup_printf("%c %s%s[%s:%s:%s]: %s",
+      message = g_strdup_printf("%c %s%s[%s:%s:%s]: %s",
           log_level_info[lf->log_level].name,
           lf->log_topic ? lf->log_topic : "",
           lf->log_topic ? " " : "",
-          file, lf->line, lf->func, message);
+          file, lf->line, lf->func, lf->message ? lf->message : "");
     } else {
-      message = full_message = g_strdup_printf("%c %s%s%s",
+      message = g_strdup_printf("%c %s%s%s",
           log_level_info[lf->log_level].name,
           lf->log_topic ? lf->log_topic : "",
           lf->log_topic ? ": " : "",
-          message);
+          lf->message ? lf->message : "");
     }
   } else if (lf->log_topic) {
-    message = full_message = g_strdup_printf("%s: %s", lf->log_topic, message);
+    message = g_strdup_printf("%s: %s", lf->log_topic,
+        lf->message ? lf->message : "");
+  } else {
+    message = g_strdup (lf->message ? lf->message : "");
   }
 
-  fields[n_fields++] = (GLogField) { "SYSLOG_PID", pid, -1 };
-  fields[n_fields++] = (GLogField) { "TID", tid, -1 };
-  fields[n_fields++] = (GLogField) { "SYSLOG_IDENTIFIER", syslog_identifier, -1 };
-  fields[n_fields++] = (GLogField) { "SYSLOG_FACILITY", "3", -1 };
-  fields[n_fields++] = (GLogField) { "PRIORITY", log_level_info[lf->log_level].priority, -1 };
+  fields[n_fields++] = (GLogField) { "SYSLOG_PID", g_strdup_printf("%d", getpid()), -1 };
+  fields[n_fields++] = (GLogField) { "TID", g_strdup_printf("%d", gettid()), -1 };
+  fields[n_fields++] = (GLogField) { "SYSLOG_IDENTIFIER", g_strdup (syslog_identifier), -1 };
+  fields[n_fields++] = (GLogField) { "SYSLOG_FACILITY", g_strdup ("3"), -1 };
+  fields[n_fields++] = (GLogField) { "PRIORITY", g_strdup (log_level_info[lf->log_level].priority), -1 };
   if (lf->file)
-    fields[n_fields++] = (GLogField) { "CODE_FILE", lf->file, -1 };
+    fields[n_fields++] = (GLogField) { "CODE_FILE", g_strdup (lf->file), -1 };
   if (lf->line)
-    fields[n_fields++] = (GLogField) { "CODE_LINE", lf->line, -1 };
+    fields[n_fields++] = (GLogField) { "CODE_LINE", g_strdup (lf->line), -1 };
   if (lf->func)
-    fields[n_fields++] = (GLogField) { "CODE_FUNC", lf->func, -1 };
+    fields[n_fields++] = (GLogField) { "CODE_FUNC", g_strdup (lf->func), -1 };
   if (lf->log_topic)
-    fields[n_fields++] = (GLogField) { "TOPIC", lf->log_topic, -1 };
+    fields[n_fields++] = (GLogField) { "TOPIC", g_strdup (lf->log_topic), -1 };
   fields[n_fields++] = (GLogField) { "MESSAGE", message, -1 };
 
+  return n_fields;
+}
+
+static void
+journal_fields_clear (GLogField *fields, gsize n_fields)
+{
+  for (gsize i = 0; i < n_fields; i++)
+    g_free ((gpointer) fields[i].value);
+}
+
+static gboolean
+journal_write_fields (const GLogField *fields, gsize n_fields)
+{
   /* the log level flags are not used in this function, so we can pass 0 */
   return (g_log_writer_journald (0, fields, n_fields, NULL) == G_LOG_WRITER_HANDLED);
 }
 
+static gboolean
+wp_log_fields_write_to_journal (WpLogFields *lf)
+{
+  GLogField fields[JOURNAL_MAX_FIELDS];
+  gsize n_fields = wp_log_fields_to_journal_fields (lf, fields);
+  gboolean ret = journal_write_fields (fields, n_fields);
+
+  journal_fields_clear (fields, n_fields);
+  return ret;
+}
+
+/*
+ * Asynchronous output: the calling thread only formats the line (or the
+ * journal fields) and queues it in a bounded multi-producer ring, without
+ * taking any lock. A writer thread drains the ring and writes the lines in
+ * batches, or sends the entries to the journal. When the ring is full,
+ * messages are dropped and counted, and the writer reports how many were
+ * lost. Warnings and more severe messages flush the ring and are written
+ * synchronously, so that they are never lost and appear in order.
+ */
+
+#define ASYNC_RING_SIZE 4096  /* must be a power of 2 */
+#define ASYNC_BATCH_DELAY_USEC (10 * 1000)
+#define ASYNC_LOG_LEVEL_MIN 4  /* notice; more severe messages are synchronous */
+
+typedef struct {
+  gchar *line;  /* for stderr */
+  GLogField fields[JOURNAL_MAX_FIELDS];  /* for the journal, if !line */
+  gsize n_fields;
+} AsyncLogEntry;
+
+static AsyncLogEntry *
+async_log_entry_new (WpLogFields *lf)
+{
+  AsyncLogEntry *entry = g_new (AsyncLogEntry, 1);
+
+  if (log_state.output_is_journal) {
+    entry->line = NULL;
+    entry->n_fields = wp_log_fields_to_journal_fields (lf, entry->fields);
+  } else {
+    entry->line = wp_log_fields_format_line (lf);
+    entry->n_fields = 0;
+  }
+  return entry;
+}
+
+static void
+async_log_entry_free (AsyncLogEntry *entry)
+{
+  g_free (entry->line);
+  journal_fields_clear (entry->fields, entry->n_fields);
+  g_free (entry);
+}
+
+/* the positions are unsigned and wrap around; they are stored as gint
+   for the atomic operations */
+typedef struct {
+  gint seq;
+  AsyncLogEntry *entry;
+} AsyncLogSlot;
+
+static struct {
+  gint enabled;
+  AsyncLogSlot *slots;
+  gint head;          /* next slot to read; advanced only by the writer */
+  guint written;      /* messages before this position have been written;
+                         protected by the lock */
+  gint tail;          /* next slot to reserve */
+  gint dropped;
+  gint n_producers;   /* threads that may be pushing right now */
+  gint writer_idle;
+  gint n_flushing;
+  gboolean stop;
+  GThread *thread;
+  GMutex lock;
+  GCond wake_cond;
+  GCond flushed_cond; /* signalled when 'written' or 'n_producers' change */
+} async_log;
+
+static gboolean
+async_log_push (AsyncLogEntry *entry)
+{
+  guint pos = (guint) g_atomic_int_get (&async_log.tail);
+
+  for (;;) {
+    AsyncLogSlot *slot = &async_log.slots[pos & (ASYNC_RING_SIZE - 1)];
+    gint diff = (gint) ((guint) g_atomic_int_get (&slot->seq) - pos);
+
+    /* the ring is full */
+    if (diff < 0)
+      return FALSE;
+
+    if (diff == 0 && g_atomic_int_compare_and_exchange (&async_log.tail,
+            (gint) pos, (gint) (pos + 1))) {
+      slot->entry = entry;
+      g_atomic_int_set (&slot->seq, (gint) (pos + 1));
+      break;
+    }
+
+    /* another thread reserved this slot first */
+    pos = (guint) g_atomic_int_get (&async_log.tail);
+  }
+
+  /* wake up the writer if it went to sleep */
+  if (g_atomic_int_get (&async_log.writer_idle) &&
+      g_atomic_int_compare_and_exchange (&async_log.writer_idle, TRUE, FALSE)) {
+    g_mutex_lock (&async_log.lock);
+    g_cond_signal (&async_log.wake_cond);
+    g_mutex_unlock (&async_log.lock);
+  }
+  return TRUE;
+}
+
+/* writer thread only */
+static gboolean
+async_log_ready (void)
+{
+  guint pos = (guint) async_log.head;
+  AsyncLogSlot *slot = &async_log.slots[pos & (ASYNC_RING_SIZE - 1)];
+  return (guint) g_atomic_int_get (&slot->seq) == pos + 1;
+}
+
+/* writer thread only */
+static AsyncLogEntry *
+async_log_pop (void)
+{
+  guint pos = (guint) async_log.head;
+  AsyncLogSlot *slot = &async_log.slots[pos & (ASYNC_RING_SIZE - 1)];
+  AsyncLogEntry *entry;
+
+  if (!async_log_ready ())
+    return NULL;
+
+  entry = g_steal_pointer (&slot->entry);
+  g_atomic_int_set (&slot->seq, (gint) (pos + ASYNC_RING_SIZE));
+  g_atomic_int_set (&async_log.head, (gint) (pos + 1));
+  return entry;
+}
+
+static void
+async_log_write_entry (AsyncLogEntry *entry, GString *batch)
+{
+  if (entry->line) {
+    g_string_append (batch, entry->line);
+  } else if (!journal_write_fields (entry->fields, entry->n_fields)) {
+    /* the MESSAGE field is always the last one */
+    g_string_append (batch, entry->fields[entry->n_fields - 1].value);
+    g_string_append_c (batch, '\n');
+  }
+  async_log_entry_free (entry);
+}
+
+static void
+async_log_write_batch (GString *batch)
+{
+  AsyncLogEntry *entry;
+  gint dropped;
+
+  while ((entry = async_log_pop ()))
+    async_log_write_entry (entry, batch);
+
+  do {
+    dropped = g_atomic_int_get (&async_log.dropped);
+  } while (dropped &&
+      !g_atomic_int_compare_and_exchange (&async_log.dropped, dropped, 0));
+
+  if (dropped > 0) {
+    WpLogFields lf = {0};
+    g_autofree gchar *message = g_strdup_printf (
+        "dropped %d log messages because the log buffer was full", dropped);
+
+    wp_log_fields_init (&lf, WP_LOCAL_LOG_TOPIC->topic_name,
+        level_index_from_flags (G_LOG_LEVEL_WARNING), FALSE,
+        __FILE__, G_STRINGIFY (__LINE__), G_STRFUNC, 0, NULL, message);
+    async_log_write_entry (async_log_entry_new (&lf), batch);
+  }
+
+  if (batch->len > 0) {
+    fwrite (batch->str, 1, batch->len, stderr);
+    fflush (stderr);
+    g_string_truncate (batch, 0);
+  }
+}
+
+static gpointer
+async_log_writer_thread (gpointer data)
+{
+  g_autoptr (GString) batch = g_string_sized_new (4096);
+  gboolean stop = FALSE;
+
+  while (!stop) {
+    g_mutex_lock (&async_log.lock);
+
+    /* sleep until a producer queues a message */
+    while (!async_log.stop && !async_log_ready ()) {
+      g_atomic_int_set (&async_log.writer_idle, TRUE);
+      if (async_log_ready ())
+        break;
+      while (g_atomic_int_get (&async_log.writer_idle) && !async_log.stop)
+        g_cond_wait (&async_log.wake_cond, &async_log.lock);
+    }
+    g_atomic_int_set (&async_log.writer_idle, FALSE);
+    stop = async_log.stop;
+    g_mutex_unlock (&async_log.lock);
+
+    /* let more messages accumulate, unless someone is waiting for them */
+    if (!stop && g_atomic_int_get (&async_log.n_flushing) == 0)
+      g_usleep (ASYNC_BATCH_DELAY_USEC);
+
+    async_log_write_batch (batch);
+
+    /* everything popped so far has reached the output */
+    g_mutex_lock (&async_log.lock);
+    async_log.written = (guint) async_log.head;
+    g_cond_broadcast (&async_log.flushed_cond);
+    g_mutex_unlock (&async_log.lock);
+  }
+
+  return NULL;
+}
+
+/* waits until all the messages queued so far have been written */
+static void
+async_log_flush (void)
+{
+  guint target = (guint) g_atomic_int_get (&async_log.tail);
+
+  g_atomic_int_inc (&async_log.n_flushing);
+  g_mutex_lock (&async_log.lock);
+  while (async_log.thread && !async_log.stop &&
+         (gint) (async_log.written - target) < 0) {
+    g_atomic_int_set (&async_log.writer_idle, FALSE);
+    g_cond_signal (&async_log.wake_cond);
+    g_cond_wait (&async_log.flushed_cond, &async_log.lock);
+  }
+  g_mutex_unlock (&async_log.lock);
+  g_atomic_int_add (&async_log.n_flushing, -1);
+}
+
+static void
+async_log_producer_done (void)
+{
+  /* wake up wp_log_set_async(), if it waits for the last producer */
+  if (g_atomic_int_dec_and_test (&async_log.n_producers) &&
+      !g_atomic_int_get (&async_log.enabled)) {
+    g_mutex_lock (&async_log.lock);
+    g_cond_broadcast (&async_log.flushed_cond);
+    g_mutex_unlock (&async_log.lock);
+  }
+}
+
+static void
+async_log_atexit (void)
+{
+  if (g_atomic_int_get (&async_log.enabled))
+    async_log_flush ();
+}
+
+/*!
+ * \brief Enables or disables asynchronous log output
+ *
+ * In asynchronous mode, messages are formatted on the calling thread and
+ * handed over to a dedicated writer thread through a lock-free ring buffer.
+ * The writer thread writes them to stderr in batches, or sends them to the
+ * journal, if that is where the log goes. If the ring buffer fills up,
+ * messages are dropped and a warning reports how many were lost. Warnings
+ * and more severe messages are always written synchronously, after flushing
+ * the ring buffer. When asynchronous mode is disabled, all the messages that
+ * were queued until then are written before this function returns.
+ *
+ * This is enabled on startup if the WIREPLUMBER_LOG_ASYNC environment
+ * variable is set to a true value, or by "log.async" in the
+ * "context.properties" configuration section.
+ *
+ * \ingroup wplog
+ * \param async whether to enable asynchronous log output
+ * \since 0.5.16
+ */
+void
+wp_log_set_async (gboolean async)
+{
+  static gsize init = 0;
+
+  if (g_once_init_enter (&init)) {
+    async_log.slots = g_new0 (AsyncLogSlot, ASYNC_RING_SIZE);
+    for (guint i = 0; i < ASYNC_RING_SIZE; i++)
+      async_log.slots[i].seq = (gint) i;
+    atexit (async_log_atexit);
+    g_once_init_leave (&init, 1);
+  }
+
+  g_mutex_lock (&async_log.lock);
+
+  if (async && !async_log.thread) {
+    async_log.stop = FALSE;
+    async_log.thread = g_thread_new ("wp-log-writer",
+        async_log_writer_thread, NULL);
+    g_atomic_int_set (&async_log.enabled, TRUE);
+  }
+  else if (!async && async_log.thread) {
+    GThread *thread = g_steal_pointer (&async_log.thread);
+
+    /* new messages are written synchronously from now on */
+    g_atomic_int_set (&async_log.enabled, FALSE);
+
+    /* wait for the threads that saw the async mode enabled to finish
+       queueing their messages; the writer then drains the ring before
+       exiting */
+    while (g_atomic_int_get (&async_log.n_producers) > 0)
+      g_cond_wait (&async_log.flushed_cond, &async_log.lock);
+
+    async_log.stop = TRUE;
+    g_cond_signal (&async_log.wake_cond);
+    g_cond_broadcast (&async_log.flushed_cond);
+    g_mutex_unlock (&async_log.lock);
+    g_thread_join (thread);
+    return;
+  }
+
+  g_mutex_unlock (&async_log.lock);
+}
+
 static inline gchar *
 wp_log_fields_format_message (WpLogFields *lf)
 {
@@ -885,6 +1236,27 @@ wp_log_fields_log (WpLogFields *lf)
     lf->message = full_message = wp_log_fields_format_message (lf);
   }
 
+  /* wp_log_set_async() waits for n_producers to drop to zero after it
+     disables the async mode, so that no message is left in the ring */
+  g_atomic_int_inc (&async_log.n_producers);
+  if (g_atomic_int_get (&async_log.enabled)) {
+    if (lf->log_level >= ASYNC_LOG_LEVEL_MIN) {
+      AsyncLogEntry *entry = async_log_entry_new (lf);
+      if (!async_log_push (entry)) {
+        async_log_entry_free (entry);
+        g_atomic_int_inc (&async_log.dropped);
+      }
+      async_log_producer_done ();
+      return G_LOG_WRITER_HANDLED;
+    }
+    async_log_producer_done ();
+
+    /* keep the order of the messages that are already queued */
+    async_log_flush ();
+  } else {
+    async_log_producer_done ();
+  }
+
   /* write complete field information to the journal if we are logging to it */
   if (log_state.output_is_journal && wp_log_fields_write_to_journal (lf))
     return G_LOG_WRITER_HANDLED;
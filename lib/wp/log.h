@@ -40,6 +40,9 @@ void wp_log_init (gint flags);
 WP_API
 gboolean wp_log_set_level (const gchar *log_level);
 
+WP_API
+void wp_log_set_async (gboolean async);
+
 /*!
  * \brief WpLogTopic flags
  * \ingroup wplog
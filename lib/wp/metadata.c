@@ -61,74 +61,191 @@ static guint32 signals[N_SIGNALS] = {0};
 
 /* data structure */
 
+/* Items are reference counted, so that iterators and WpMetadataItem can keep
+ * them alive after they are removed from the cache. The type and value are
+ * reference counted strings, so that a WpMetadataItem can keep the ones it
+ * was created with after the item is updated */
 struct item
 {
+  grefcount ref;
+  gboolean removed;
   uint32_t subject;
   gchar *key;
-  gchar *type;
-  gchar *value;
+  gchar *type;   /* GRefString */
+  gchar *value;  /* GRefString */
+  GList link;          /* in the list of all items */
+  GList subject_link;  /* in the list of the items of the same subject */
 };
 
+/* Items are kept in insertion order, both globally and per subject, and are
+ * indexed by (subject, key) */
+struct items
+{
+  GQueue all;
+  GHashTable *subjects;  /* subject -> GQueue of items */
+  GHashTable *index;     /* set of items, hashed by (subject, key) */
+};
+
+static guint
+item_hash (gconstpointer p)
+{
+  const struct item *item = p;
+  return g_str_hash (item->key) * 31 + item->subject;
+}
+
+static gboolean
+item_equal (gconstpointer a, gconstpointer b)
+{
+  const struct item *ia = a, *ib = b;
+  return ia->subject == ib->subject && g_str_equal (ia->key, ib->key);
+}
+
+static struct item *
+item_ref (struct item * item)
+{
+  g_ref_count_inc (&item->ref);
+  return item;
+}
+
+static void
+item_unref (struct item * item)
+{
+  if (!g_ref_count_dec (&item->ref))
+    return;
+
+  g_free (item->key);
+  g_ref_string_release (item->type);
+  g_ref_string_release (item->value);
+  g_free (item);
+}
+
+/* drops the reference of the cache; iterators that still hold the item
+ * skip it from now on */
 static void
-set_item (struct item * item, uint32_t subject, const char * key,
+item_release (struct item * item)
+{
+  item->removed = TRUE;
+  item_unref (item);
+}
+
+static void
+items_init (struct items * items)
+{
+  g_queue_init (&items->all);
+  items->subjects = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) g_queue_free);
+  items->index = g_hash_table_new (item_hash, item_equal);
+}
+
+static GQueue *
+items_get_subject (struct items * items, uint32_t subject)
+{
+  return g_hash_table_lookup (items->subjects, GUINT_TO_POINTER (subject));
+}
+
+static struct item *
+find_item (struct items * items, uint32_t subject, const char * key)
+{
+  struct item lookup = { .subject = subject, .key = (gchar *) key };
+  return g_hash_table_lookup (items->index, &lookup);
+}
+
+static struct item *
+add_item (struct items * items, uint32_t subject, const char * key,
     const char * type, const char * value)
 {
+  struct item *item = g_new0 (struct item, 1);
+  GQueue *sq = items_get_subject (items, subject);
+
+  g_ref_count_init (&item->ref);
   item->subject = subject;
   item->key = g_strdup (key);
-  item->type = g_strdup (type);
-  item->value = g_strdup (value);
+  item->type = g_ref_string_new (type);
+  item->value = g_ref_string_new (value);
+  item->link.data = item;
+  item->subject_link.data = item;
+
+  if (!sq) {
+    sq = g_queue_new ();
+    g_hash_table_insert (items->subjects, GUINT_TO_POINTER (subject), sq);
+  }
+  g_queue_push_tail_link (&items->all, &item->link);
+  g_queue_push_tail_link (sq, &item->subject_link);
+  g_hash_table_add (items->index, item);
+  return item;
 }
 
 static void
-clear_item (struct item * item)
+set_item (struct item * item, const char * type, const char * value)
 {
-  g_free (item->key);
-  g_free (item->type);
-  g_free (item->value);
-  spa_zero (*item);
+  g_ref_string_release (item->type);
+  g_ref_string_release (item->value);
+  item->type = g_ref_string_new (type);
+  item->value = g_ref_string_new (value);
 }
 
-static struct item *
-find_item (struct pw_array * metadata, uint32_t subject, const char * key)
+static void
+remove_item (struct items * items, struct item * item)
 {
-  struct item *item;
+  GQueue *sq = items_get_subject (items, item->subject);
 
-  pw_array_for_each (item, metadata) {
-    if (item->subject == subject && (key == NULL || !strcmp (item->key, key))) {
-      return item;
-    }
-  }
-  return NULL;
+  g_hash_table_remove (items->index, item);
+  g_queue_unlink (&items->all, &item->link);
+  g_queue_unlink (sq, &item->subject_link);
+  if (g_queue_is_empty (sq))
+    g_hash_table_remove (items->subjects, GUINT_TO_POINTER (item->subject));
+  item_release (item);
 }
 
 static int
-clear_subject (struct pw_array * metadata, uint32_t subject)
+clear_subject (struct items * items, uint32_t subject)
 {
-  struct item *item;
+  GQueue *sq = items_get_subject (items, subject);
   uint32_t removed = 0;
 
-  while (true) {
-    item = find_item (metadata, subject, NULL);
-    if (item == NULL)
-      break;
-    clear_item (item);
-    pw_array_remove (metadata, item);
+  if (sq == NULL)
+    return 0;
+
+  g_hash_table_steal (items->subjects, GUINT_TO_POINTER (subject));
+  while (!g_queue_is_empty (sq)) {
+    struct item *item = g_queue_pop_head_link (sq)->data;
+    g_hash_table_remove (items->index, item);
+    g_queue_unlink (&items->all, &item->link);
+    item_release (item);
     removed++;
   }
+  g_queue_free (sq);
 
   return removed;
 }
 
 static void
-clear_items (struct pw_array * metadata)
-{
-  struct item *item;
-
-  pw_array_consume (item, metadata) {
-    clear_item (item);
-    pw_array_remove (metadata, item);
+clear_items (struct items * items)
+{
+  GHashTableIter iter;
+  GQueue *sq;
+  GList *link;
+
+  /* the links of the subject queues are embedded in the items, so they must
+     be unlinked before the queues are freed */
+  g_hash_table_iter_init (&iter, items->subjects);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &sq)) {
+    while (g_queue_pop_head_link (sq))
+      ;
   }
-  pw_array_reset (metadata);
+
+  g_hash_table_remove_all (items->index);
+  g_hash_table_remove_all (items->subjects);
+  while ((link = g_queue_pop_head_link (&items->all)))
+    item_release (link->data);
+}
+
+static void
+items_clear (struct items * items)
+{
+  clear_items (items);
+  g_clear_pointer (&items->subjects, g_hash_table_unref);
+  g_clear_pointer (&items->index, g_hash_table_unref);
 }
 
 typedef struct _WpMetadataPrivate WpMetadataPrivate;
@@ -136,7 +253,7 @@ struct _WpMetadataPrivate
 {
   struct pw_metadata *iface;
   struct spa_hook listener;
-  struct pw_array metadata;
+  struct items metadata;
   gboolean remove_listener;
 };
 
@@ -146,7 +263,7 @@ static void
 wp_metadata_init (WpMetadata * self)
 {
   WpMetadataPrivate *priv = wp_metadata_get_instance_private (self);
-  pw_array_init (&priv->metadata, 4096);
+  items_init (&priv->metadata);
 }
 
 static void
@@ -155,7 +272,7 @@ wp_metadata_finalize (GObject * object)
   WpMetadataPrivate *priv =
       wp_metadata_get_instance_private (WP_METADATA (object));
 
-  pw_array_clear (&priv->metadata);
+  items_clear (&priv->metadata);
 
   G_OBJECT_CLASS (wp_metadata_parent_class)->finalize (object);
 }
@@ -222,25 +339,21 @@ metadata_event_property (void *object, uint32_t subject, const char *key,
   }
 
   item = find_item (&priv->metadata, subject, key);
-  if (item == NULL) {
-    if (value == NULL)
-      return 0;
-    item = pw_array_add (&priv->metadata, sizeof (*item));
-    if (item == NULL)
-      return -errno;
-  } else {
-    clear_item (item);
-  }
 
   if (value != NULL) {
     if (type == NULL)
       type = "string";
-    set_item (item, subject, key, type, value);
+    if (item)
+      set_item (item, type, value);
+    else
+      add_item (&priv->metadata, subject, key, type, value);
     wp_debug_object (self, "add id:%d key:%s type:%s value:%s",
         subject, key, type, value);
   } else {
+    if (item == NULL)
+      return 0;
     type = NULL;
-    pw_array_remove (&priv->metadata, item);
+    remove_item (&priv->metadata, item);
     wp_debug_object (self, "remove id:%d key:%s", subject, key);
   }
 
@@ -322,30 +435,30 @@ wp_metadata_class_init (WpMetadataClass * klass)
 /*!
  * \struct WpMetadataItem
  *
- * WpMetadataItem holds the subject, key, type and value of a metadata entry.
+ * WpMetadataItem holds the subject, key, type and value of a metadata entry,
+ * as they were when it was returned by the iterator. They remain valid for as
+ * long as the WpMetadataItem is held, even if the entry is updated or removed
+ * in the meantime.
  */
 struct _WpMetadataItem
 {
   WpMetadata *metadata;
-  guint32 subject;
-  const gchar *key;
-  const gchar *type;
-  const gchar *value;
+  struct item *item;
+  gchar *type;   /* GRefString */
+  gchar *value;  /* GRefString */
 };
 
 G_DEFINE_BOXED_TYPE (WpMetadataItem, wp_metadata_item,
     wp_metadata_item_ref, wp_metadata_item_unref)
 
 static WpMetadataItem *
-wp_metadata_item_new (WpMetadata *metadata, guint32 subject, const gchar *key,
-    const gchar *type, const gchar *value)
+wp_metadata_item_new (WpMetadata *metadata, struct item *item)
 {
   WpMetadataItem *self = g_rc_box_new0 (WpMetadataItem);
   self->metadata = g_object_ref (metadata);
-  self->subject = subject;
-  self->key = key;
-  self->type = type;
-  self->value = value;
+  self->item = item_ref (item);
+  self->type = g_ref_string_acquire (item->type);
+  self->value = g_ref_string_acquire (item->value);
   return self;
 }
 
@@ -354,6 +467,9 @@ wp_metadata_item_free (gpointer p)
 {
   WpMetadataItem *self = p;
   g_clear_object (&self->metadata);
+  g_clear_pointer (&self->item, item_unref);
+  g_clear_pointer (&self->type, g_ref_string_release);
+  g_clear_pointer (&self->value, g_ref_string_release);
 }
 
 /*!
@@ -394,7 +510,7 @@ wp_metadata_item_unref (WpMetadataItem *self)
 guint32
 wp_metadata_item_get_subject (WpMetadataItem * self)
 {
-  return self->subject;
+  return self->item->subject;
 }
 
 /*!
@@ -409,7 +525,7 @@ wp_metadata_item_get_subject (WpMetadataItem * self)
 const gchar *
 wp_metadata_item_get_key (WpMetadataItem * self)
 {
-  return self->key;
+  return self->item->key;
 }
 
 /*!
@@ -442,42 +558,60 @@ wp_metadata_item_get_value (WpMetadataItem * self)
   return self->value;
 }
 
+/* The iterator works on a snapshot of the items that are cached when it is
+ * created (or reset), holding a reference on each of them. Items that are
+ * removed from the cache in the meantime are skipped. */
 struct metadata_iterator_data
 {
   WpMetadata *metadata;
-  const struct item *item;
   guint32 subject;
+  GPtrArray *items;
+  guint index;
 };
 
+static GPtrArray *
+metadata_iterator_snapshot (struct metadata_iterator_data *it_data)
+{
+  WpMetadataPrivate *priv =
+      wp_metadata_get_instance_private (it_data->metadata);
+  GQueue *q;
+  GPtrArray *items;
+
+  if (it_data->subject == PW_ID_ANY)
+    q = &priv->metadata.all;
+  else
+    q = items_get_subject (&priv->metadata, it_data->subject);
+
+  items = g_ptr_array_new_full (q ? q->length : 0,
+      (GDestroyNotify) item_unref);
+  for (GList *link = q ? q->head : NULL; link; link = link->next)
+    g_ptr_array_add (items, item_ref (link->data));
+  return items;
+}
+
 static void
 metadata_iterator_reset (WpIterator *it)
 {
   struct metadata_iterator_data *it_data = wp_iterator_get_user_data (it);
-  WpMetadataPrivate *priv =
-      wp_metadata_get_instance_private (it_data->metadata);
 
-  it_data->item = pw_array_first (&priv->metadata);
+  g_clear_pointer (&it_data->items, g_ptr_array_unref);
+  it_data->items = metadata_iterator_snapshot (it_data);
+  it_data->index = 0;
 }
 
 static gboolean
 metadata_iterator_next (WpIterator *it, GValue *item)
 {
   struct metadata_iterator_data *it_data = wp_iterator_get_user_data (it);
-  WpMetadataPrivate *priv =
-      wp_metadata_get_instance_private (it_data->metadata);
 
-  while (pw_array_check (&priv->metadata, it_data->item)) {
-    if ((it_data->subject == PW_ID_ANY ||
-            it_data->subject == it_data->item->subject)) {
-      g_autoptr (WpMetadataItem) mi = wp_metadata_item_new (it_data->metadata,
-          it_data->item->subject, it_data->item->key, it_data->item->type,
-          it_data->item->value);
-      g_value_init (item, WP_TYPE_METADATA_ITEM);
-      g_value_take_boxed (item, g_steal_pointer (&mi));
-      it_data->item++;
-      return TRUE;
-    }
-    it_data->item++;
+  while (it_data->index < it_data->items->len) {
+    struct item *i = g_ptr_array_index (it_data->items, it_data->index++);
+    if (i->removed)
+      continue;
+
+    g_value_init (item, WP_TYPE_METADATA_ITEM);
+    g_value_take_boxed (item, wp_metadata_item_new (it_data->metadata, i));
+    return TRUE;
   }
   return FALSE;
 }
@@ -487,22 +621,19 @@ metadata_iterator_fold (WpIterator *it, WpIteratorFoldFunc func, GValue *ret,
     gpointer data)
 {
   struct metadata_iterator_data *it_data = wp_iterator_get_user_data (it);
-  WpMetadataPrivate *priv =
-      wp_metadata_get_instance_private (it_data->metadata);
-  const struct item *i;
-
-  pw_array_for_each (i, &priv->metadata) {
-    if ((it_data->subject == PW_ID_ANY ||
-            it_data->subject == it_data->item->subject)) {
-      g_auto (GValue) item = G_VALUE_INIT;
-      g_autoptr (WpMetadataItem) mi = wp_metadata_item_new (it_data->metadata,
-          it_data->item->subject, it_data->item->key, it_data->item->type,
-          it_data->item->value);
-      g_value_init (&item, WP_TYPE_METADATA_ITEM);
-      g_value_take_boxed (&item, g_steal_pointer (&mi));
-      if (!func (&item, ret, data))
-        return FALSE;
-    }
+  g_autoptr (GPtrArray) items = metadata_iterator_snapshot (it_data);
+
+  for (guint idx = 0; idx < items->len; idx++) {
+    struct item *i = g_ptr_array_index (items, idx);
+    g_auto (GValue) item = G_VALUE_INIT;
+
+    if (i->removed)
+      continue;
+
+    g_value_init (&item, WP_TYPE_METADATA_ITEM);
+    g_value_take_boxed (&item, wp_metadata_item_new (it_data->metadata, i));
+    if (!func (&item, ret, data))
+      return FALSE;
   }
   return TRUE;
 }
@@ -511,6 +642,7 @@ static void
 metadata_iterator_finalize (WpIterator *it)
 {
   struct metadata_iterator_data *it_data = wp_iterator_get_user_data (it);
+  g_clear_pointer (&it_data->items, g_ptr_array_unref);
   g_object_unref (it_data->metadata);
 }
 
@@ -532,6 +664,10 @@ static const WpIteratorMethods metadata_iterator_methods = {
  * with wp_metadata_set(), this cache will be updated on the next round-trip
  * with the pipewire server.
  *
+ * The metadata may safely change while iterating. Items that are removed
+ * from the cache are skipped and items that are added after the iterator was
+ * created (or reset) are not visited.
+ *
  * \ingroup wpmetadata
  * \param self a metadata object
  * \param subject the metadata subject id, or -1 (PW_ID_ANY)
@@ -541,19 +677,17 @@ static const WpIteratorMethods metadata_iterator_methods = {
 WpIterator *
 wp_metadata_new_iterator (WpMetadata * self, guint32 subject)
 {
-  WpMetadataPrivate *priv;
   g_autoptr (WpIterator) it = NULL;
   struct metadata_iterator_data *it_data;
 
   g_return_val_if_fail (self != NULL, NULL);
-  priv = wp_metadata_get_instance_private (self);
 
   it = wp_iterator_new (&metadata_iterator_methods,
       sizeof (struct metadata_iterator_data));
   it_data = wp_iterator_get_user_data (it);
   it_data->metadata = g_object_ref (self);
-  it_data->item = pw_array_first (&priv->metadata);
   it_data->subject = subject;
+  it_data->items = metadata_iterator_snapshot (it_data);
   return g_steal_pointer (&it);
 }
 
@@ -562,7 +696,8 @@ wp_metadata_new_iterator (WpMetadata * self, guint32 subject)
  *
  * \ingroup wpmetadata
  * \param self a metadata object
- * \param subject the metadata subject id
+ * \param subject the metadata subject id, or -1 (PW_ID_ANY) to find the first
+ *   item with \a key of any subject
  * \param key the metadata key name
  * \param type (out)(optional): the metadata type name
  * \returns the metadata string value, or NULL if not found.
@@ -571,22 +706,34 @@ const gchar *
 wp_metadata_find (WpMetadata * self, guint32 subject, const gchar * key,
   const gchar ** type)
 {
-  g_autoptr (WpIterator) it = NULL;
-  g_auto (GValue) val = G_VALUE_INIT;
-  it = wp_metadata_new_iterator (self, subject);
-  for (; wp_iterator_next (it, &val); g_value_unset (&val)) {
-    WpMetadataItem *mi = g_value_get_boxed (&val);
-    const gchar *k = wp_metadata_item_get_key (mi);
-    const gchar *t = wp_metadata_item_get_value_type (mi);
-    const gchar *v = wp_metadata_item_get_value (mi);
-    if (g_strcmp0 (k, key) == 0) {
-      if (type)
-        *type = t;
-      g_value_unset (&val);
-      return v;
+  WpMetadataPrivate *priv;
+  const struct item *item;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  priv = wp_metadata_get_instance_private (self);
+
+  if (!key)
+    return NULL;
+
+  if (subject == PW_ID_ANY) {
+    /* PW_ID_ANY matches the first item with this key, of any subject */
+    item = NULL;
+    for (GList *link = priv->metadata.all.head; link; link = link->next) {
+      const struct item *i = link->data;
+      if (g_str_equal (i->key, key)) {
+        item = i;
+        break;
+      }
     }
+  } else {
+    item = find_item (&priv->metadata, subject, key);
   }
-  return NULL;
+  if (!item)
+    return NULL;
+
+  if (type)
+    *type = item->type;
+  return item->value;
 }
 
 /*!
@@ -31,13 +31,32 @@ WP_DEFINE_LOCAL_LOG_TOPIC ("wp-object-interest")
  * are satisfied.
  */
 
+/* a constraint value or a subject value, converted to the subject_type */
+union constraint_value
+{
+  gboolean b;
+  gint i;
+  guint u;
+  gint64 x;
+  guint64 t;
+  gdouble d;
+  const gchar *s;
+};
+
 struct constraint
 {
   WpConstraintType type;
   WpConstraintVerb verb;
   gchar subject_type; /* a basic GVariantType as a single char */
-  gchar *subject;
+  const gchar *subject; /* interned */
   GVariant *value;
+
+  /* compiled by _validate(): the value as native values (1 for equals,
+     2 for the range minimum and maximum, any number for in-list) and
+     the compiled pattern for the 'matches' verb */
+  union constraint_value *values;
+  guint n_values;
+  GPatternSpec *pattern;
 };
 
 struct _WpObjectInterest
@@ -238,8 +257,11 @@ wp_object_interest_add_constraint (WpObjectInterest * self,
   c->verb = verb;
   /* subject_type is filled in by _validate() */
   c->subject_type = '\0';
-  c->subject = g_strdup (subject);
+  c->subject = subject ? g_intern_string (subject) : NULL;
   c->value = value ? g_variant_ref_sink (value) : NULL;
+  c->values = NULL;
+  c->n_values = 0;
+  c->pattern = NULL;
 
   /* mark as invalid to force validation */
   self->valid = FALSE;
@@ -258,6 +280,18 @@ wp_object_interest_ref (WpObjectInterest *self)
   return self;
 }
 
+static void
+constraint_clear_compiled (struct constraint * c)
+{
+  if (c->subject_type == 's') {
+    for (guint i = 0; i < c->n_values; i++)
+      g_free ((gchar *) c->values[i].s);
+  }
+  g_clear_pointer (&c->values, g_free);
+  c->n_values = 0;
+  g_clear_pointer (&c->pattern, g_pattern_spec_free);
+}
+
 static void
 wp_object_interest_free (WpObjectInterest * self)
 {
@@ -266,7 +300,7 @@ wp_object_interest_free (WpObjectInterest * self)
   g_return_if_fail (self != NULL);
 
   pw_array_for_each (c, &self->constraints) {
-    g_clear_pointer (&c->subject, g_free);
+    constraint_clear_compiled (c);
     g_clear_pointer (&c->value, g_variant_unref);
   }
   pw_array_clear (&self->constraints);
@@ -287,10 +321,61 @@ wp_object_interest_unref (WpObjectInterest * self)
     wp_object_interest_free (self);
 }
 
+static void
+variant_to_constraint_value (gchar subj_type, GVariant * variant,
+    union constraint_value * val)
+{
+  switch (subj_type) {
+    case 'b': val->b = g_variant_get_boolean (variant); break;
+    case 'i': val->i = g_variant_get_int32 (variant); break;
+    case 'u': val->u = g_variant_get_uint32 (variant); break;
+    case 'x': val->x = g_variant_get_int64 (variant); break;
+    case 't': val->t = g_variant_get_uint64 (variant); break;
+    case 'd': val->d = g_variant_get_double (variant); break;
+    case 's': val->s = g_variant_dup_string (variant, NULL); break;
+    default: g_return_if_reached ();
+  }
+}
+
+/* converts the constraint's GVariant value to native values once, so that
+   matching does not need to go through GVariant for every object */
+static void
+constraint_compile (struct constraint * c)
+{
+  constraint_clear_compiled (c);
+
+  switch (c->verb) {
+    case WP_CONSTRAINT_VERB_EQUALS:
+    case WP_CONSTRAINT_VERB_NOT_EQUALS:
+      c->n_values = 1;
+      c->values = g_new0 (union constraint_value, 1);
+      variant_to_constraint_value (c->subject_type, c->value, &c->values[0]);
+      break;
+    case WP_CONSTRAINT_VERB_IN_LIST:
+    case WP_CONSTRAINT_VERB_IN_RANGE:
+      c->n_values = g_variant_n_children (c->value);
+      c->values = g_new0 (union constraint_value, c->n_values);
+      for (guint i = 0; i < c->n_values; i++) {
+        g_autoptr (GVariant) child = g_variant_get_child_value (c->value, i);
+        variant_to_constraint_value (c->subject_type, child, &c->values[i]);
+      }
+      break;
+    case WP_CONSTRAINT_VERB_MATCHES:
+      c->pattern = g_pattern_spec_new (g_variant_get_string (c->value, NULL));
+      break;
+    default:
+      break;
+  }
+}
+
 /*!
  * \brief Validates the interest, ensuring that the interest GType
  * is a valid object and that all the constraints have been expressed properly.
  *
+ * Validation also prepares the constraints for matching: the constraint
+ * values are converted once to native values and 'matches' patterns are
+ * compiled, so that each match only needs to convert the subject value.
+ *
  * \remark This is called internally when \a self is first used to find a match,
  * so it is not necessary to call it explicitly
  *
@@ -507,6 +592,8 @@ wp_object_interest_validate (WpObjectInterest * self, GError ** error)
     /* cache the type that the property must have */
     if (value_type)
       c->subject_type = *g_variant_type_peek_string (value_type);
+
+    constraint_compile (c);
   }
 
   return (self->valid = TRUE);
@@ -528,26 +615,25 @@ subject_type_to_gtype (gchar type)
 }
 
 static inline gboolean
-property_string_to_gvalue (gchar subj_type, const gchar * str, GValue * val)
+property_string_to_value (gchar subj_type, const gchar * str,
+    union constraint_value * val)
 {
-  g_value_init (val, subject_type_to_gtype (subj_type));
-
   switch (subj_type) {
     case 'b':
       if (!strcmp (str, "true") || !strcmp (str, "1"))
-        g_value_set_boolean (val, TRUE);
+        val->b = TRUE;
       else if (!strcmp (str, "false") || !strcmp (str, "0"))
-        g_value_set_boolean (val, FALSE);
+        val->b = FALSE;
       else {
         wp_trace ("failed to convert '%s' to boolean", str);
         return FALSE;
       }
       break;
     case 's':
-      g_value_set_static_string (val, str);
+      val->s = str;
       break;
 
-#define CASE_NUMBER(l, T, convert) \
+#define CASE_NUMBER(l, m, T, convert) \
     case l: { \
       g##T number; \
       errno = 0; \
@@ -556,14 +642,14 @@ property_string_to_gvalue (gchar subj_type, const gchar * str, GValue * val)
         wp_trace ("failed to convert '%s' to " #T, str); \
         return FALSE; \
       } \
-      g_value_set_##T (val, number); \
+      val->m = number; \
       break; \
     }
-    CASE_NUMBER ('i', int, strtol (str, NULL, 10))
-    CASE_NUMBER ('u', uint, strtoul (str, NULL, 10))
-    CASE_NUMBER ('x', int64, strtoll (str, NULL, 10))
-    CASE_NUMBER ('t', uint64, strtoull (str, NULL, 10))
-    CASE_NUMBER ('d', double, strtod (str, NULL))
+    CASE_NUMBER ('i', i, int, strtol (str, NULL, 10))
+    CASE_NUMBER ('u', u, uint, strtoul (str, NULL, 10))
+    CASE_NUMBER ('x', x, int64, strtoll (str, NULL, 10))
+    CASE_NUMBER ('t', t, uint64, strtoull (str, NULL, 10))
+    CASE_NUMBER ('d', d, double, strtod (str, NULL))
 #undef CASE_NUMBER
     default:
       g_return_val_if_reached (FALSE);
@@ -571,27 +657,39 @@ property_string_to_gvalue (gchar subj_type, const gchar * str, GValue * val)
   return TRUE;
 }
 
+static inline void
+gvalue_to_value (gchar subj_type, const GValue * gval,
+    union constraint_value * val)
+{
+  switch (subj_type) {
+    case 'b': val->b = g_value_get_boolean (gval); break;
+    case 'i': val->i = g_value_get_int (gval); break;
+    case 'u': val->u = g_value_get_uint (gval); break;
+    case 'x': val->x = g_value_get_int64 (gval); break;
+    case 't': val->t = g_value_get_uint64 (gval); break;
+    case 'd': val->d = g_value_get_double (gval); break;
+    case 's': val->s = g_value_get_string (gval); break;
+    default: g_return_if_reached ();
+  }
+}
+
 static inline gboolean
-constraint_verb_equals (gchar subj_type, const GValue * subj_val,
-    GVariant * check_val)
+constraint_value_equals (gchar subj_type, const union constraint_value * a,
+    const union constraint_value * b)
 {
   switch (subj_type) {
-    case 'd': {
-      gdouble a = g_value_get_double (subj_val);
-      gdouble b = g_variant_get_double (check_val);
-      return G_APPROX_VALUE (a, b, FLT_EPSILON);
-    }
+    case 'd':
+      return G_APPROX_VALUE (a->d, b->d, FLT_EPSILON);
     case 's':
-      return !g_strcmp0 (g_value_get_string (subj_val),
-                         g_variant_get_string (check_val, NULL));
-#define CASE_BASIC(l, T, R) \
+      return !g_strcmp0 (a->s, b->s);
+#define CASE_BASIC(l, m) \
     case l: \
-      return (g_value_get_##T (subj_val) == g_variant_get_##R (check_val));
-    CASE_BASIC ('b', boolean, boolean)
-    CASE_BASIC ('i', int, int32)
-    CASE_BASIC ('u', uint, uint32)
-    CASE_BASIC ('x', int64, int64)
-    CASE_BASIC ('t', uint64, uint64)
+      return (a->m == b->m);
+    CASE_BASIC ('b', b)
+    CASE_BASIC ('i', i)
+    CASE_BASIC ('u', u)
+    CASE_BASIC ('x', x)
+    CASE_BASIC ('t', t)
 #undef CASE_BASIC
     default:
       g_return_val_if_reached (FALSE);
@@ -599,58 +697,55 @@ constraint_verb_equals (gchar subj_type, const GValue * subj_val,
 }
 
 static inline gboolean
-constraint_verb_matches (gchar subj_type, const GValue * subj_val,
-    GVariant * check_val)
+constraint_verb_equals (const struct constraint * c,
+    const union constraint_value * subj_val)
 {
-  switch (subj_type) {
-    case 's': {
-      const gchar *check_str = g_variant_get_string (check_val, NULL);
-      const gchar *subj_str = g_value_get_string (subj_val);
-      if (!check_str || !subj_str)
+  return constraint_value_equals (c->subject_type, subj_val, &c->values[0]);
+}
+
+static inline gboolean
+constraint_verb_matches (const struct constraint * c,
+    const union constraint_value * subj_val)
+{
+  switch (c->subject_type) {
+    case 's':
+      if (!subj_val->s)
         return FALSE;
-      return g_pattern_match_simple (check_str, subj_str);
-    }
+      return g_pattern_match_string (c->pattern, subj_val->s);
     default:
       g_return_val_if_reached (FALSE);
   }
-  return TRUE;
 }
 
 static inline gboolean
-constraint_verb_in_list (gchar subj_type, const GValue * subj_val,
-    GVariant * check_val)
+constraint_verb_in_list (const struct constraint * c,
+    const union constraint_value * subj_val)
 {
-  GVariantIter iter;
-  g_autoptr (GVariant) child = NULL;
-
-  g_variant_iter_init (&iter, check_val);
-  while ((child = g_variant_iter_next_value (&iter))) {
-    if (constraint_verb_equals (subj_type, subj_val, child))
+  for (guint i = 0; i < c->n_values; i++) {
+    if (constraint_value_equals (c->subject_type, subj_val, &c->values[i]))
       return TRUE;
-    g_variant_unref (child);
   }
   return FALSE;
 }
 
 static inline gboolean
-constraint_verb_in_range (gchar subj_type, const GValue * subj_val,
-    GVariant * check_val)
+constraint_verb_in_range (const struct constraint * c,
+    const union constraint_value * subj_val)
 {
-  switch (subj_type) {
-#define CASE_RANGE(l, t, T) \
-    case l: { \
-      g##T val, min, max; \
-      g_variant_get (check_val, "("#t#t")", &min, &max); \
-      val = g_value_get_##T (subj_val); \
-      if (val < min || val > max) \
+  const union constraint_value *min = &c->values[0];
+  const union constraint_value *max = &c->values[1];
+
+  switch (c->subject_type) {
+#define CASE_RANGE(l, m) \
+    case l: \
+      if (subj_val->m < min->m || subj_val->m > max->m) \
         return FALSE; \
-      break; \
-    }
-    CASE_RANGE('i', i, int)
-    CASE_RANGE('u', u, uint)
-    CASE_RANGE('x', x, int64)
-    CASE_RANGE('t', t, uint64)
-    CASE_RANGE('d', d, double)
+      break;
+    CASE_RANGE ('i', i)
+    CASE_RANGE ('u', u)
+    CASE_RANGE ('x', x)
+    CASE_RANGE ('t', t)
+    CASE_RANGE ('d', d)
 #undef CASE_RANGE
     default:
       g_return_val_if_reached (FALSE);
@@ -778,7 +873,8 @@ wp_object_interest_matches_full (WpObjectInterest * self,
   /* check all constraints; if any of them fails at any point, fail the match */
   pw_array_for_each (c, &self->constraints) {
     WpProperties *lookup_props = pw_global_props;
-    g_auto (GValue) value = G_VALUE_INIT;
+    g_auto (GValue) gvalue = G_VALUE_INIT;
+    union constraint_value value = { 0 };
     gboolean exists = FALSE;
 
     /* return early if the match failed and CHECK_ALL is not specified */
@@ -799,7 +895,7 @@ wp_object_interest_matches_full (WpObjectInterest * self,
           exists = !!(lookup_str = wp_properties_get (lookup_props, c->subject));
 
         if (exists && c->subject_type)
-          property_string_to_gvalue (c->subject_type, lookup_str, &value);
+          property_string_to_value (c->subject_type, lookup_str, &value);
         break;
       }
       case WP_CONSTRAINT_TYPE_G_PROPERTY: {
@@ -811,9 +907,9 @@ wp_object_interest_matches_full (WpObjectInterest * self,
               G_OBJECT_GET_CLASS (object), c->subject));
 
         if (exists && c->subject_type) {
-          g_value_init (&value, pspec->value_type);
-          g_object_get_property (object, c->subject, &value);
-          value_type = G_VALUE_TYPE (&value);
+          g_value_init (&gvalue, pspec->value_type);
+          g_object_get_property (object, c->subject, &gvalue);
+          value_type = G_VALUE_TYPE (&gvalue);
 
           /* transform if not compatible */
           if (value_type != subject_type_to_gtype (c->subject_type)) {
@@ -821,16 +917,18 @@ wp_object_interest_matches_full (WpObjectInterest * self,
                     subject_type_to_gtype (c->subject_type))) {
               g_auto (GValue) orig = G_VALUE_INIT;
               g_value_init (&orig, value_type);
-              g_value_copy (&value, &orig);
-              g_value_unset (&value);
-              g_value_init (&value, subject_type_to_gtype (c->subject_type));
-              g_value_transform (&orig, &value);
+              g_value_copy (&gvalue, &orig);
+              g_value_unset (&gvalue);
+              g_value_init (&gvalue, subject_type_to_gtype (c->subject_type));
+              g_value_transform (&orig, &gvalue);
             }
             else {
               result &= ~(1 << c->type);
               continue;
             }
           }
+
+          gvalue_to_value (c->subject_type, &gvalue, &value);
         }
 
         break;
@@ -843,28 +941,23 @@ wp_object_interest_matches_full (WpObjectInterest * self,
        according to the operation defined by the verb */
     switch (c->verb) {
       case WP_CONSTRAINT_VERB_EQUALS:
-        if (!exists ||
-            !constraint_verb_equals (c->subject_type, &value, c->value))
+        if (!exists || !constraint_verb_equals (c, &value))
           result &= ~(1 << c->type);
         break;
       case WP_CONSTRAINT_VERB_NOT_EQUALS:
-        if (exists &&
-            constraint_verb_equals (c->subject_type, &value, c->value))
+        if (exists && constraint_verb_equals (c, &value))
           result &= ~(1 << c->type);
         break;
       case WP_CONSTRAINT_VERB_MATCHES:
-        if (!exists ||
-            !constraint_verb_matches (c->subject_type, &value, c->value))
+        if (!exists || !constraint_verb_matches (c, &value))
           result &= ~(1 << c->type);
         break;
       case WP_CONSTRAINT_VERB_IN_LIST:
-        if (!exists ||
-            !constraint_verb_in_list (c->subject_type, &value, c->value))
+        if (!exists || !constraint_verb_in_list (c, &value))
           result &= ~(1 << c->type);
         break;
       case WP_CONSTRAINT_VERB_IN_RANGE:
-        if (!exists ||
-            !constraint_verb_in_range (c->subject_type, &value, c->value))
+        if (!exists || !constraint_verb_in_range (c, &value))
           result &= ~(1 << c->type);
         break;
       case WP_CONSTRAINT_VERB_IS_PRESENT:
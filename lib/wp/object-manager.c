@@ -9,6 +9,7 @@
 #include "object-manager.h"
 #include "log.h"
 #include "proxy-interfaces.h"
+#include "session-item.h"
 #include "private/registry.h"
 
 #include <pipewire/pipewire.h>
@@ -38,6 +39,13 @@ WP_DEFINE_LOCAL_LOG_TOPIC ("wp-object-manager")
  *     WP_PROXY_FEATURE_BOUND is enabled)
  *   * WirePlumber-specific objects, such as plugins, factories and session items
  *
+ * Lookups and filtered iterations that contain an "equals" or "in-list"
+ * constraint on an indexed subject are served from a secondary index instead
+ * of scanning all the managed objects. By default, the \c bound-id GObject
+ * property and the \c object.id, \c object.serial and \c node.name PipeWire
+ * global properties are indexed; more subjects can be indexed with
+ * wp_object_manager_add_index().
+ *
  * To start an object manager, you first need to declare interest in a certain
  * kind of object by calling wp_object_manager_add_interest() and then install
  * it on the WpCore with wp_core_install_object_manager().
@@ -139,6 +147,10 @@ struct _WpObjectManager
   GHashTable *features;
   /* objects that we are interested in, without a ref */
   GPtrArray *objects;
+  /* element-type: <object, guint>, the position of each object in objects */
+  GHashTable *positions;
+  /* element-type: struct om_index* */
+  GPtrArray *indexes;
 
   gboolean installed;
   gboolean changed;
@@ -163,6 +175,370 @@ static guint signals[LAST_SIGNAL] = { 0 };
 
 G_DEFINE_TYPE (WpObjectManager, wp_object_manager, G_TYPE_OBJECT)
 
+/*
+ * A secondary index maps the value of a single subject (a property of a
+ * certain constraint type) to the managed objects that have this value.
+ *
+ * The index is only used to narrow down the list of candidate objects;
+ * the full interest is always evaluated on the candidates afterwards,
+ * so it only needs to guarantee that it never misses a matching object.
+ * Objects whose subject value may change without any notification are
+ * therefore kept in the "unindexed" list and are always candidates.
+ */
+struct om_index
+{
+  WpConstraintType type;
+  gchar *subject;
+  /* element-type: <gchar *, GPtrArray *>, the objects that have each value */
+  GHashTable *buckets;
+  /* element-type: <object, gchar *>, the value each indexed object has;
+     the value may be NULL if the object does not have the subject */
+  GHashTable *values;
+  /* objects that cannot be indexed reliably, without a ref */
+  GPtrArray *unindexed;
+  /* number of indexed values that strtol() and friends would not parse
+     to exactly the number that their decimal representation shows */
+  guint n_unsafe_numbers;
+};
+
+static struct om_index *
+om_index_new (WpConstraintType type, const gchar * subject)
+{
+  struct om_index *idx = g_slice_new0 (struct om_index);
+  idx->type = type;
+  idx->subject = g_strdup (subject);
+  idx->buckets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) g_ptr_array_unref);
+  idx->values = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
+      g_free);
+  idx->unindexed = g_ptr_array_new ();
+  return idx;
+}
+
+static void om_index_on_notify (GObject * object, GParamSpec * pspec,
+    struct om_index * idx);
+
+static void
+om_index_free (struct om_index * idx)
+{
+  GHashTableIter iter;
+  gpointer object;
+
+  /* the managed objects outlive us; stop watching them */
+  g_hash_table_iter_init (&iter, idx->values);
+  while (g_hash_table_iter_next (&iter, &object, NULL))
+    g_signal_handlers_disconnect_by_func (object, om_index_on_notify, idx);
+
+  g_clear_pointer (&idx->subject, g_free);
+  g_clear_pointer (&idx->buckets, g_hash_table_unref);
+  g_clear_pointer (&idx->values, g_hash_table_unref);
+  g_clear_pointer (&idx->unindexed, g_ptr_array_unref);
+  g_slice_free (struct om_index, idx);
+}
+
+/* "0" or [1-9][0-9]* up to G_MAXINT32; every strto*() function used by
+   the interest matcher parses such a string to the same number */
+static gboolean
+is_safe_index_number (const gchar * str)
+{
+  guint len = 0;
+
+  if (str[0] == '0')
+    return str[1] == '\0';
+  if (str[0] < '1' || str[0] > '9')
+    return FALSE;
+  while (g_ascii_isdigit (str[len]))
+    len++;
+  return str[len] == '\0' && len <= 10 &&
+      g_ascii_strtoull (str, NULL, 10) <= G_MAXINT32;
+}
+
+/* retrieves the value of the indexed subject on @object; returns FALSE
+   if the value may change without the index being able to notice */
+static gboolean
+om_index_get_object_value (struct om_index * idx, gpointer object,
+    gchar ** value)
+{
+  *value = NULL;
+
+  switch (idx->type) {
+    case WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY:
+      /* global properties are immutable */
+      if (WP_IS_GLOBAL_PROXY (object)) {
+        g_autoptr (WpProperties) props =
+            wp_global_proxy_get_global_properties (WP_GLOBAL_PROXY (object));
+        if (props)
+          *value = g_strdup (wp_properties_get (props, idx->subject));
+        return TRUE;
+      }
+      /* session item properties can be replaced silently */
+      return !WP_IS_SESSION_ITEM (object);
+
+    case WP_CONSTRAINT_TYPE_PW_PROPERTY:
+      /* changes are watched with notify::properties */
+      if (WP_IS_PIPEWIRE_OBJECT (object)) {
+        if (wp_object_test_active_features (WP_OBJECT (object),
+                WP_PIPEWIRE_OBJECT_FEATURE_INFO)) {
+          g_autoptr (WpProperties) props =
+              wp_pipewire_object_get_properties (WP_PIPEWIRE_OBJECT (object));
+          if (props)
+            *value = g_strdup (wp_properties_get (props, idx->subject));
+        }
+        return TRUE;
+      }
+      return !WP_IS_SESSION_ITEM (object);
+
+    case WP_CONSTRAINT_TYPE_G_PROPERTY: {
+      g_auto (GValue) v = G_VALUE_INIT;
+      GParamSpec *pspec = g_object_class_find_property (
+          G_OBJECT_GET_CLASS (object), idx->subject);
+
+      if (!pspec)
+        return TRUE;
+      if (!(pspec->flags & G_PARAM_READABLE))
+        return FALSE;
+
+      g_value_init (&v, pspec->value_type);
+      g_object_get_property (object, idx->subject, &v);
+
+      /* values are stored as they would be transformed to a string */
+      switch (G_TYPE_FUNDAMENTAL (pspec->value_type)) {
+        case G_TYPE_STRING:
+          *value = g_value_dup_string (&v);
+          break;
+        case G_TYPE_INT:
+          *value = g_strdup_printf ("%d", g_value_get_int (&v));
+          break;
+        case G_TYPE_UINT:
+          *value = g_strdup_printf ("%u", g_value_get_uint (&v));
+          break;
+        case G_TYPE_INT64:
+          *value = g_strdup_printf ("%" G_GINT64_FORMAT, g_value_get_int64 (&v));
+          break;
+        case G_TYPE_UINT64:
+          *value = g_strdup_printf ("%" G_GUINT64_FORMAT,
+              g_value_get_uint64 (&v));
+          break;
+        default:
+          return FALSE;
+      }
+      return TRUE;
+    }
+    default:
+      g_return_val_if_reached (FALSE);
+  }
+}
+
+static void
+om_index_file (struct om_index * idx, gpointer object)
+{
+  g_autofree gchar *value = NULL;
+
+  if (!om_index_get_object_value (idx, object, &value)) {
+    g_ptr_array_add (idx->unindexed, object);
+    return;
+  }
+
+  if (value) {
+    GPtrArray *bucket = g_hash_table_lookup (idx->buckets, value);
+    if (!bucket) {
+      bucket = g_ptr_array_new ();
+      g_hash_table_insert (idx->buckets, g_strdup (value), bucket);
+    }
+    g_ptr_array_add (bucket, object);
+
+    if (!is_safe_index_number (value))
+      idx->n_unsafe_numbers++;
+  }
+  g_hash_table_insert (idx->values, object, g_steal_pointer (&value));
+}
+
+static void
+om_index_unfile (struct om_index * idx, gpointer object)
+{
+  const gchar *value = NULL;
+
+  if (g_ptr_array_remove_fast (idx->unindexed, object))
+    return;
+
+  if (!g_hash_table_lookup_extended (idx->values, object, NULL,
+          (gpointer *) &value))
+    return;
+
+  if (value) {
+    GPtrArray *bucket = g_hash_table_lookup (idx->buckets, value);
+    if (bucket) {
+      g_ptr_array_remove (bucket, object);
+      if (bucket->len == 0)
+        g_hash_table_remove (idx->buckets, value);
+    }
+
+    if (!is_safe_index_number (value))
+      idx->n_unsafe_numbers--;
+  }
+  g_hash_table_remove (idx->values, object);
+}
+
+static void
+om_index_on_notify (GObject * object, GParamSpec * pspec,
+    struct om_index * idx)
+{
+  om_index_unfile (idx, object);
+  om_index_file (idx, object);
+}
+
+static void
+om_index_add_object (struct om_index * idx, gpointer object)
+{
+  om_index_file (idx, object);
+
+  /* watch values that are mutable, but notify when they change */
+  if (g_hash_table_contains (idx->values, object)) {
+    if (idx->type == WP_CONSTRAINT_TYPE_PW_PROPERTY &&
+        WP_IS_PIPEWIRE_OBJECT (object)) {
+      g_signal_connect (object, "notify::properties",
+          G_CALLBACK (om_index_on_notify), idx);
+      g_signal_connect (object, "notify::active-features",
+          G_CALLBACK (om_index_on_notify), idx);
+    }
+    /* bound-id never changes while the proxy is bound */
+    else if (idx->type == WP_CONSTRAINT_TYPE_G_PROPERTY &&
+        !(WP_IS_PROXY (object) && !g_strcmp0 (idx->subject, "bound-id")) &&
+        g_object_class_find_property (G_OBJECT_GET_CLASS (object),
+            idx->subject)) {
+      g_autofree gchar *signal = g_strdup_printf ("notify::%s", idx->subject);
+      g_signal_connect (object, signal, G_CALLBACK (om_index_on_notify), idx);
+    }
+  }
+}
+
+static void
+om_index_rm_object (struct om_index * idx, gpointer object)
+{
+  if (g_hash_table_contains (idx->values, object))
+    g_signal_handlers_disconnect_by_func (object, om_index_on_notify, idx);
+  om_index_unfile (idx, object);
+}
+
+/* converts a constraint value to the form that values are stored in */
+static gboolean
+om_index_variant_to_value (GVariant * variant, gchar ** value,
+    gboolean * is_number)
+{
+  *is_number = TRUE;
+
+  switch (g_variant_classify (variant)) {
+    case G_VARIANT_CLASS_STRING:
+      *value = g_variant_dup_string (variant, NULL);
+      *is_number = FALSE;
+      return TRUE;
+    case G_VARIANT_CLASS_INT32:
+      *value = g_strdup_printf ("%d", g_variant_get_int32 (variant));
+      return TRUE;
+    case G_VARIANT_CLASS_UINT32:
+      *value = g_strdup_printf ("%u", g_variant_get_uint32 (variant));
+      return TRUE;
+    case G_VARIANT_CLASS_INT64:
+      *value = g_strdup_printf ("%" G_GINT64_FORMAT,
+          g_variant_get_int64 (variant));
+      return TRUE;
+    case G_VARIANT_CLASS_UINT64:
+      *value = g_strdup_printf ("%" G_GUINT64_FORMAT,
+          g_variant_get_uint64 (variant));
+      return TRUE;
+    default:
+      /* doubles and booleans have too many string representations */
+      return FALSE;
+  }
+}
+
+/* collects the objects that may match @interest through @idx; returns NULL
+   if the interest has no "equals" or "in-list" constraint on the subject
+   of this index or if the index cannot be used to serve it */
+static GPtrArray *
+om_index_find_candidates (struct om_index * idx, WpObjectInterest * interest)
+{
+  g_autoptr (GPtrArray) values = NULL;
+  g_autoptr (GPtrArray) buckets = NULL;
+  GPtrArray *res;
+  guint n_candidates = idx->unindexed->len;
+
+  values = wp_object_interest_find_defined_constraint_values (interest,
+      idx->type, idx->subject);
+  if (values->len == 0)
+    return NULL;
+
+  buckets = g_ptr_array_new ();
+  for (guint i = 0; i < values->len; i++) {
+    g_autofree gchar *value = NULL;
+    gboolean is_number;
+    GPtrArray *bucket;
+
+    if (!om_index_variant_to_value (g_ptr_array_index (values, i), &value,
+            &is_number))
+      return NULL;
+    if (is_number && idx->n_unsafe_numbers > 0)
+      return NULL;
+
+    bucket = g_hash_table_lookup (idx->buckets, value);
+    if (bucket && !g_ptr_array_find (buckets, bucket, NULL)) {
+      g_ptr_array_add (buckets, bucket);
+      n_candidates += bucket->len;
+    }
+  }
+
+  res = g_ptr_array_sized_new (n_candidates);
+  for (guint i = 0; i < buckets->len; i++) {
+    GPtrArray *bucket = g_ptr_array_index (buckets, i);
+    g_ptr_array_extend (res, bucket, NULL, NULL);
+  }
+  g_ptr_array_extend (res, idx->unindexed, NULL, NULL);
+  return res;
+}
+
+static gint
+compare_object_positions (gconstpointer a, gconstpointer b, gpointer data)
+{
+  GHashTable *positions = data;
+  guint pos_a = GPOINTER_TO_UINT (
+      g_hash_table_lookup (positions, *(gpointer *) a));
+  guint pos_b = GPOINTER_TO_UINT (
+      g_hash_table_lookup (positions, *(gpointer *) b));
+  return (pos_a > pos_b) - (pos_a < pos_b);
+}
+
+/* returns the smallest set of objects that may match @interest, using the
+   indexes, or a copy of all the managed objects if no index can be used;
+   either way, the objects are in the order in which they are managed, so
+   that lookups find the same first match as a full scan would */
+static GPtrArray *
+wp_object_manager_find_candidates (WpObjectManager * self,
+    WpObjectInterest * interest)
+{
+  GPtrArray *res = NULL;
+
+  for (guint i = 0; i < self->indexes->len; i++) {
+    struct om_index *idx = g_ptr_array_index (self->indexes, i);
+    GPtrArray *candidates = om_index_find_candidates (idx, interest);
+
+    if (candidates && (!res || candidates->len < res->len)) {
+      g_clear_pointer (&res, g_ptr_array_unref);
+      res = candidates;
+    } else if (candidates) {
+      g_ptr_array_unref (candidates);
+    }
+  }
+
+  if (res) {
+    g_ptr_array_sort_with_data (res, compare_object_positions,
+        self->positions);
+    wp_trace_object (self, "interest served from index: %u of %u objects",
+        res->len, self->objects->len);
+  }
+
+  return res ? res : g_ptr_array_copy (self->objects, NULL, NULL);
+}
+
 static void
 wp_object_manager_init (WpObjectManager * self)
 {
@@ -171,9 +547,21 @@ wp_object_manager_init (WpObjectManager * self)
       (GDestroyNotify) wp_object_interest_unref);
   self->features = g_hash_table_new (g_direct_hash, g_direct_equal);
   self->objects = g_ptr_array_new ();
+  self->positions = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->indexes = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) om_index_free);
   self->installed = FALSE;
   self->changed = FALSE;
   self->pending_objects = 0;
+
+  wp_object_manager_add_index (self, WP_CONSTRAINT_TYPE_G_PROPERTY,
+      "bound-id");
+  wp_object_manager_add_index (self, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      PW_KEY_OBJECT_ID);
+  wp_object_manager_add_index (self, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      PW_KEY_OBJECT_SERIAL);
+  wp_object_manager_add_index (self, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      PW_KEY_NODE_NAME);
 }
 
 static void
@@ -185,6 +573,8 @@ wp_object_manager_finalize (GObject * object)
     g_source_destroy (self->idle_source);
     g_clear_pointer (&self->idle_source, g_source_unref);
   }
+  g_clear_pointer (&self->indexes, g_ptr_array_unref);
+  g_clear_pointer (&self->positions, g_hash_table_unref);
   g_clear_pointer (&self->objects, g_ptr_array_unref);
   g_clear_pointer (&self->features, g_hash_table_unref);
   g_clear_pointer (&self->interests, g_ptr_array_unref);
@@ -365,6 +755,48 @@ wp_object_manager_request_object_features (WpObjectManager *self,
   store_children_object_features (self->features, object_type, wanted_features);
 }
 
+/*!
+ * \brief Indexes the managed objects on the specified \a subject.
+ *
+ * Lookups and filtered iterators whose interest has an "equals" or "in-list"
+ * constraint of the same \a type on this \a subject will only evaluate the
+ * objects that have a matching value, instead of all the managed objects.
+ * This is transparent; results are the same with or without the index.
+ *
+ * Indexing pays off for subjects that have mostly unique values and that are
+ * looked up frequently. Values of WP_CONSTRAINT_TYPE_G_PROPERTY subjects must
+ * be strings or integers and their changes must be signalled with
+ * \c notify, otherwise the objects are evaluated on every lookup.
+ *
+ * \ingroup wpobjectmanager
+ * \param self the object manager
+ * \param type the constraint type that the subject applies to
+ * \param subject the property to index
+ * \since 0.5.16
+ */
+void
+wp_object_manager_add_index (WpObjectManager * self, WpConstraintType type,
+    const gchar * subject)
+{
+  struct om_index *idx;
+
+  g_return_if_fail (WP_IS_OBJECT_MANAGER (self));
+  g_return_if_fail (type > WP_CONSTRAINT_TYPE_NONE &&
+      type <= WP_CONSTRAINT_TYPE_G_PROPERTY);
+  g_return_if_fail (subject != NULL);
+
+  for (guint i = 0; i < self->indexes->len; i++) {
+    idx = g_ptr_array_index (self->indexes, i);
+    if (idx->type == type && g_str_equal (idx->subject, subject))
+      return;
+  }
+
+  idx = om_index_new (type, subject);
+  for (guint i = 0; i < self->objects->len; i++)
+    om_index_add_object (idx, g_ptr_array_index (self->objects, i));
+  g_ptr_array_add (self->indexes, idx);
+}
+
 /*!
  * \brief Gets the number of objects managed by the object manager.
  * \ingroup wpobjectmanager
@@ -539,7 +971,7 @@ wp_object_manager_new_filtered_iterator_full (WpObjectManager * self,
   it = wp_iterator_new (&om_iterator_methods, sizeof (struct om_iterator_data));
   it_data = wp_iterator_get_user_data (it);
   it_data->om = g_object_ref (self);
-  it_data->objects = g_ptr_array_copy (self->objects, NULL, NULL);
+  it_data->objects = wp_object_manager_find_candidates (self, interest);
   it_data->interest = interest;
   it_data->index = 0;
   return it;
@@ -743,7 +1175,11 @@ wp_object_manager_add_object (WpObjectManager * self, gpointer object)
 {
   if (wp_object_manager_is_interested_in_object (self, object)) {
     wp_trace_object (self, "added: " WP_OBJECT_FORMAT, WP_OBJECT_ARGS (object));
+    g_hash_table_insert (self->positions, object,
+        GUINT_TO_POINTER (self->objects->len));
     g_ptr_array_add (self->objects, object);
+    for (guint i = 0; i < self->indexes->len; i++)
+      om_index_add_object (g_ptr_array_index (self->indexes, i), object);
     g_signal_emit (self, signals[SIGNAL_OBJECT_ADDED], 0, object);
     self->changed = TRUE;
   }
@@ -760,9 +1196,17 @@ wp_object_manager_add_object (WpObjectManager * self, gpointer object)
 void
 wp_object_manager_rm_object (WpObjectManager * self, gpointer object)
 {
-  guint index;
-  if (g_ptr_array_find (self->objects, object, &index)) {
+  gpointer pos;
+  if (g_hash_table_lookup_extended (self->positions, object, NULL, &pos)) {
+    guint index = GPOINTER_TO_UINT (pos);
+    g_hash_table_remove (self->positions, object);
     g_ptr_array_remove_index_fast (self->objects, index);
+    /* the last object was moved to fill the gap */
+    if (index < self->objects->len)
+      g_hash_table_insert (self->positions,
+          g_ptr_array_index (self->objects, index), GUINT_TO_POINTER (index));
+    for (guint i = 0; i < self->indexes->len; i++)
+      om_index_rm_object (g_ptr_array_index (self->indexes, i), object);
     g_signal_emit (self, signals[SIGNAL_OBJECT_REMOVED], 0, object);
     self->changed = TRUE;
   }
@@ -822,6 +1266,53 @@ wp_object_manager_add_global (WpObjectManager * self, WpGlobal * global)
   }
 }
 
+static gboolean
+wp_object_manager_is_interested_in_type (WpObjectManager * self, GType type)
+{
+  for (guint i = 0; i < self->interests->len; i++) {
+    WpObjectInterest *interest = g_ptr_array_index (self->interests, i);
+    if (wp_object_interest_matches_full (interest,
+            WP_INTEREST_MATCH_FLAGS_NONE, type, NULL, NULL, NULL) &
+        WP_INTEREST_MATCH_GTYPE)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+/*
+ * Equivalent to calling wp_object_manager_add_global() on each of the
+ * \a globals (skipping NULL gaps and the ones that have been removed),
+ * but the interests are checked against each GType only once per batch,
+ * so that globals of types that this manager is not interested in are
+ * discarded without evaluating any constraints
+ */
+void
+wp_object_manager_add_globals (WpObjectManager * self, GPtrArray * globals)
+{
+  g_autoptr (GHashTable) interesting_types =
+      g_hash_table_new (g_direct_hash, g_direct_equal);
+
+  for (guint i = 0; i < globals->len; i++) {
+    WpGlobal *g = g_ptr_array_index (globals, i);
+    gpointer interested;
+
+    /* skip gaps and globals that were already removed */
+    if (!g || g->flags == 0 || g->id == SPA_ID_INVALID)
+      continue;
+
+    if (!g_hash_table_lookup_extended (interesting_types,
+            GSIZE_TO_POINTER (g->type), NULL, &interested)) {
+      interested = GINT_TO_POINTER (
+          wp_object_manager_is_interested_in_type (self, g->type));
+      g_hash_table_insert (interesting_types, GSIZE_TO_POINTER (g->type),
+          interested);
+    }
+
+    if (interested)
+      wp_object_manager_add_global (self, g);
+  }
+}
+
 /*!
  * \brief Installs the object manager on this core, activating its internal
  * management engine.
@@ -48,6 +48,12 @@ WP_API
 void wp_object_manager_request_object_features (WpObjectManager *self,
     GType object_type, WpObjectFeatures wanted_features);
 
+/* indexes */
+
+WP_API
+void wp_object_manager_add_index (WpObjectManager * self,
+    WpConstraintType type, const gchar * subject);
+
 /* object inspection */
 
 WP_API
@@ -88,6 +94,10 @@ void wp_object_manager_rm_object (WpObjectManager * self, gpointer object);
 WP_PRIVATE_API
 void wp_object_manager_add_global (WpObjectManager * self, WpGlobal * global);
 
+WP_PRIVATE_API
+void wp_object_manager_add_globals (WpObjectManager * self,
+    GPtrArray * globals);
+
 G_END_DECLS
 
 #endif
@@ -28,6 +28,10 @@ WP_DEFINE_LOCAL_LOG_TOPIC ("wp-permission-manager")
  * permissions on interested objects every time they are added or removed for
  * a particular client.
  *
+ * The permissions last sent to each client are remembered, so that only the
+ * permissions of the objects that were added, or whose permissions changed,
+ * are sent to the client afterwards.
+ *
  * WpPermissionManager API.
  *
  * \gsignals
@@ -96,6 +100,33 @@ permission_interest_free (PermissionMatch *self)
   g_free (self);
 }
 
+/* The permissions that were last sent to a client */
+typedef struct _ClientPermissions ClientPermissions;
+struct _ClientPermissions
+{
+  gboolean synced;
+  guint32 default_perms;
+  guint32 core_perms;
+  GHashTable *perms;  /* object bound ID -> permissions */
+};
+
+static ClientPermissions *
+client_permissions_new (void)
+{
+  ClientPermissions *cp = g_new0 (ClientPermissions, 1);
+  cp->default_perms = PW_PERM_INVALID;
+  cp->core_perms = PW_PERM_INVALID;
+  cp->perms = g_hash_table_new (g_direct_hash, g_direct_equal);
+  return cp;
+}
+
+static void
+client_permissions_free (ClientPermissions *cp)
+{
+  g_clear_pointer (&cp->perms, g_hash_table_unref);
+  g_free (cp);
+}
+
 struct _WpPermissionManager
 {
   WpObject parent;
@@ -104,8 +135,11 @@ struct _WpPermissionManager
   guint32 core_perms;
   GPtrArray *clients;
   GHashTable *matches;
+  GHashTable *client_perms;
 
   WpObjectManager *om;
+  GHashTable *object_ids;
+  GPtrArray *pending_objects;
 };
 
 G_DEFINE_TYPE (WpPermissionManager, wp_permission_manager, WP_TYPE_OBJECT)
@@ -126,6 +160,15 @@ wp_permission_manager_init (WpPermissionManager * self)
   /* Init clients list */
   self->clients = g_ptr_array_new_with_free_func (
       (GDestroyNotify) g_object_unref);
+
+  /* Init the permissions last sent to each client */
+  self->client_perms = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+      NULL, (GDestroyNotify) client_permissions_free);
+
+  /* Init the bound IDs of the OM objects and the newly added objects */
+  self->object_ids = g_hash_table_new (g_direct_hash, g_direct_equal);
+  self->pending_objects = g_ptr_array_new_with_free_func (
+      (GDestroyNotify) g_object_unref);
 }
 
 enum {
@@ -289,139 +332,219 @@ get_matched_object_permissions (WpPermissionManager *self, PermissionMatch *m,
   return FALSE;
 }
 
-static GArray *
-build_permissions_array (WpPermissionManager *self, WpClient *client)
+static gboolean
+get_object_permissions (WpPermissionManager *self, WpClient *client,
+    WpGlobalProxy *object, guint32 *perms)
 {
-  g_autoptr (WpIterator) it = NULL;
-  g_auto (GValue) value = G_VALUE_INIT;
-  struct pw_permission def_perm = { PW_ID_ANY, self->default_perms };
-  GArray *arr = g_array_new (FALSE, FALSE, sizeof (struct pw_permission));
-
-  /* Add default permissions */
-  g_array_append_val (arr, def_perm);
-
-  /* Add core permissions if explicitly set (core is not in the OM since it is
-   * implicit in the PipeWire connection and not sent through the registry) */
-  if (self->core_perms != PW_PERM_INVALID) {
-    struct pw_permission core_perm = { PW_ID_CORE, self->core_perms };
-    g_array_append_val (arr, core_perm);
-  }
+  GHashTableIter iter;
+  PermissionMatch *match = NULL;
+  gboolean matched = FALSE;
 
-  /* Add object specific permissions in the array */
-  it = wp_object_manager_new_iterator (self->om);
-  for (; wp_iterator_next (it, &value); g_value_unset (&value)) {
-    WpGlobalProxy *object = g_value_get_object (&value);
-    GHashTableIter iter;
-    PermissionMatch *match = NULL;
-    g_hash_table_iter_init (&iter, self->matches);
-    while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&match)) {
-      guint32 perms = PW_PERM_INVALID;
-      if (get_matched_object_permissions (self, match, client, object, &perms)
-          && perms != PW_PERM_INVALID) {
-        struct pw_permission obj_perm = { 0, };
-        obj_perm.id = wp_proxy_get_bound_id (WP_PROXY (object));
-        obj_perm.permissions = perms;
-        g_array_append_val (arr, obj_perm);;
-      }
+  /* Merge the permissions of all the matches */
+  *perms = 0;
+  g_hash_table_iter_init (&iter, self->matches);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&match)) {
+    guint32 p = PW_PERM_INVALID;
+    if (get_matched_object_permissions (self, match, client, object, &p)
+        && p != PW_PERM_INVALID) {
+      *perms |= p;
+      matched = TRUE;
     }
   }
 
-  /* Merge permissions with same object ID */
-  for (guint i = 0; i < arr->len; i++) {
-    for (guint j = i + 1; j < arr->len; ) {
-      struct pw_permission *a = &g_array_index (arr, struct pw_permission, i);
-      struct pw_permission *b = &g_array_index (arr, struct pw_permission, j);
-      if (a->id == b->id) {
-        a->permissions |= b->permissions;
-        g_array_remove_index (arr, j);
-      } else {
-        j++;
-      }
-    }
-  }
+  return matched;
+}
 
-  return arr;
+static void
+append_permission (GArray *arr, guint32 id, guint32 permissions)
+{
+  struct pw_permission perm = { id, permissions };
+  g_array_append_val (arr, perm);
 }
 
 static void
-update_client_permissions (WpPermissionManager *self, WpClient *client)
+diff_object_permissions (WpPermissionManager *self, WpClient *client,
+    ClientPermissions *cp, WpGlobalProxy *object, GArray *delta)
+{
+  guint32 id = wp_proxy_get_bound_id (WP_PROXY (object));
+  gpointer sent = NULL;
+  gboolean was_sent;
+  guint32 perms = 0;
+
+  was_sent = g_hash_table_lookup_extended (cp->perms, GUINT_TO_POINTER (id),
+      NULL, &sent);
+
+  if (get_object_permissions (self, client, object, &perms)) {
+    if (!was_sent || GPOINTER_TO_UINT (sent) != perms) {
+      g_hash_table_insert (cp->perms, GUINT_TO_POINTER (id),
+          GUINT_TO_POINTER (perms));
+      append_permission (delta, id, perms);
+    }
+  } else if (was_sent) {
+    /* The object does not match anymore; make it inherit the defaults */
+    g_hash_table_remove (cp->perms, GUINT_TO_POINTER (id));
+    append_permission (delta, id, PW_PERM_INVALID);
+  }
+}
+
+static ClientPermissions *
+get_client_permissions (WpPermissionManager *self, WpClient *client)
 {
-  guint32 bound_id = 0;
-  g_autoptr (GArray) perms = NULL;
+  ClientPermissions *cp;
 
   /* Dont do anything if the permission manager is not activated */
   if (!(wp_object_get_active_features (WP_OBJECT (self)) &
       WP_PERMISSION_MANAGER_LOADED))
-    return;
+    return NULL;
 
   /* Make sure the client proxy is still valid */
   if (!wp_proxy_get_pw_proxy (WP_PROXY (client)))
-    return;
+    return NULL;
 
-  bound_id = wp_proxy_get_bound_id (WP_PROXY (client));
-  perms = build_permissions_array (self, client);
+  cp = g_hash_table_lookup (self->client_perms, client);
+  if (!cp) {
+    cp = client_permissions_new ();
+    g_hash_table_insert (self->client_perms, client, cp);
+  }
+  return cp;
+}
+
+static void
+send_client_permissions (WpPermissionManager *self, WpClient *client,
+    GArray *delta)
+{
+  if (delta->len == 0)
+    return;
 
   wp_info_object (self,
       "Updating permissions on client %u: any=%c%c%c%c%c len=%u",
-      bound_id,
+      wp_proxy_get_bound_id (WP_PROXY (client)),
       !!(self->default_perms & PW_PERM_R) ? 'r' : '-',
       !!(self->default_perms & PW_PERM_W) ? 'w' : '-',
       !!(self->default_perms & PW_PERM_X) ? 'x' : '-',
       !!(self->default_perms & PW_PERM_M) ? 'm' : '-',
       !!(self->default_perms & PW_PERM_L) ? 'l' : '-',
-      perms->len);
+      delta->len);
 
-  wp_client_update_permissions_array (client, perms->len,
-      (const struct pw_permission *) perms->data);
+  wp_client_update_permissions_array (client, delta->len,
+      (const struct pw_permission *) delta->data);
 }
 
-static gboolean
-has_object_match (WpPermissionManager *self, WpGlobalProxy *object)
+static void
+update_client_permissions (WpPermissionManager *self, WpClient *client,
+    gboolean check_objects)
 {
-  GHashTableIter iter;
-  PermissionMatch *m = NULL;
+  ClientPermissions *cp = NULL;
+  g_autoptr (GArray) delta = NULL;
 
-  g_hash_table_iter_init (&iter, self->matches);
-  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&m)) {
-    if (m->interest && wp_object_interest_matches (m->interest, object))
-      return TRUE;
-    if (m->rules && get_rules_matched_object_permissions (self, m->rules,
-        object, NULL))
-      return TRUE;
+  cp = get_client_permissions (self, client);
+  if (!cp)
+    return;
+
+  /* All objects need to be checked if nothing was sent yet */
+  if (!cp->synced)
+    check_objects = TRUE;
+
+  delta = g_array_new (FALSE, FALSE, sizeof (struct pw_permission));
+
+  /* Default permissions */
+  if (!cp->synced || cp->default_perms != self->default_perms) {
+    append_permission (delta, PW_ID_ANY, self->default_perms);
+    cp->default_perms = self->default_perms;
+    cp->synced = TRUE;
   }
 
-  return FALSE;
+  /* Core permissions, if explicitly set (core is not in the OM since it is
+   * implicit in the PipeWire connection and not sent through the registry) */
+  if (cp->core_perms != self->core_perms) {
+    append_permission (delta, PW_ID_CORE, self->core_perms);
+    cp->core_perms = self->core_perms;
+  }
+
+  /* Object specific permissions */
+  if (check_objects) {
+    g_autoptr (WpIterator) it = NULL;
+    g_auto (GValue) value = G_VALUE_INIT;
+
+    it = wp_object_manager_new_iterator (self->om);
+    for (; wp_iterator_next (it, &value); g_value_unset (&value)) {
+      WpGlobalProxy *object = g_value_get_object (&value);
+      diff_object_permissions (self, client, cp, object, delta);
+    }
+  }
+
+  send_client_permissions (self, client, delta);
 }
 
 static void
-update_permissions (WpPermissionManager *self)
+update_permissions (WpPermissionManager *self, gboolean check_objects)
 {
   for (guint i = 0; i < self->clients->len; i++) {
     WpClient *client = g_ptr_array_index (self->clients, i);
-    update_client_permissions (self, client);
+    update_client_permissions (self, client, check_objects);
   }
 }
 
+static void
+on_object_added (WpObjectManager *om, WpGlobalProxy *object, gpointer d)
+{
+  WpPermissionManager * self = WP_PERMISSION_MANAGER (d);
+
+  g_hash_table_insert (self->object_ids, object,
+      GUINT_TO_POINTER (wp_proxy_get_bound_id (WP_PROXY (object))));
+  g_ptr_array_add (self->pending_objects, g_object_ref (object));
+}
+
+static void
+on_object_removed (WpObjectManager *om, WpGlobalProxy *object, gpointer d)
+{
+  WpPermissionManager * self = WP_PERMISSION_MANAGER (d);
+  GHashTableIter iter;
+  ClientPermissions *cp = NULL;
+  gpointer id = NULL;
+
+  g_ptr_array_remove_fast (self->pending_objects, object);
+
+  /* PipeWire forgets the permissions of destroyed globals, and their IDs may
+   * be reused later, so forget them too */
+  if (!g_hash_table_steal_extended (self->object_ids, object, NULL, &id))
+    return;
+
+  g_hash_table_iter_init (&iter, self->client_perms);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&cp))
+    g_hash_table_remove (cp->perms, id);
+}
+
 static void
 on_objects_changed (WpObjectManager *om, gpointer d)
 {
   WpPermissionManager * self = WP_PERMISSION_MANAGER (d);
-  g_autoptr (WpIterator) it = NULL;
-  g_auto (GValue) value = G_VALUE_INIT;
-  gboolean update = FALSE;
-
-  it = wp_object_manager_new_iterator (self->om);
-  for (; wp_iterator_next (it, &value); g_value_unset (&value)) {
-    WpGlobalProxy *object = g_value_get_object (&value);
-    if (has_object_match (self, object)) {
-      update = TRUE;
-      g_value_unset (&value);
-      break;
+
+  /* Only check the objects that were added since the last change, and only
+   * send the permissions that changed */
+  for (guint i = 0; i < self->clients->len &&
+      self->pending_objects->len > 0; i++) {
+    WpClient *client = g_ptr_array_index (self->clients, i);
+    ClientPermissions *cp = get_client_permissions (self, client);
+    g_autoptr (GArray) delta = NULL;
+
+    if (!cp)
+      continue;
+
+    if (!cp->synced) {
+      update_client_permissions (self, client, TRUE);
+      continue;
+    }
+
+    delta = g_array_new (FALSE, FALSE, sizeof (struct pw_permission));
+    for (guint j = 0; j < self->pending_objects->len; j++) {
+      WpGlobalProxy *object = g_ptr_array_index (self->pending_objects, j);
+      diff_object_permissions (self, client, cp, object, delta);
     }
+    send_client_permissions (self, client, delta);
   }
 
-  if (update)
-    update_permissions (self);
+  g_ptr_array_set_size (self->pending_objects, 0);
 }
 
 static void
@@ -431,6 +554,9 @@ on_object_manager_installed (WpObjectManager *om, gpointer d)
   WpPermissionManager * self = wp_transition_get_source_object (transition);
 
   wp_object_update_features (WP_OBJECT (self), WP_PERMISSION_MANAGER_LOADED, 0);
+
+  /* Send the permissions to the clients that were added before activation */
+  update_permissions (self, TRUE);
 }
 
 static void
@@ -449,6 +575,10 @@ wp_permission_manager_activate_execute_step (WpObject * object,
       wp_object_manager_add_interest (self->om, WP_TYPE_GLOBAL_PROXY, NULL);
       wp_object_manager_request_object_features (self->om,
           WP_TYPE_GLOBAL_PROXY, WP_PIPEWIRE_OBJECT_FEATURES_MINIMAL);
+      g_signal_connect_object (self->om, "object-added",
+          G_CALLBACK (on_object_added), self, 0);
+      g_signal_connect_object (self->om, "object-removed",
+          G_CALLBACK (on_object_removed), self, 0);
       g_signal_connect_object (self->om, "objects-changed",
           G_CALLBACK (on_objects_changed), self, 0);
       g_signal_connect_object (self->om, "installed",
@@ -470,6 +600,11 @@ wp_permission_manager_deactivate (WpObject * object, WpObjectFeatures features)
   WpPermissionManager *self = WP_PERMISSION_MANAGER (object);
 
   g_clear_object (&self->om);
+  g_hash_table_remove_all (self->object_ids);
+  g_ptr_array_set_size (self->pending_objects, 0);
+
+  /* Send everything again if the permission manager is activated again */
+  g_hash_table_remove_all (self->client_perms);
 
   wp_object_update_features (WP_OBJECT (self), 0, WP_OBJECT_FEATURES_ALL);
 }
@@ -481,8 +616,11 @@ wp_permission_manager_finalize (GObject * object)
 
   g_clear_pointer (&self->clients, g_ptr_array_unref);
   g_clear_pointer (&self->matches, g_hash_table_unref);
+  g_clear_pointer (&self->client_perms, g_hash_table_unref);
 
   g_clear_object (&self->om);
+  g_clear_pointer (&self->object_ids, g_hash_table_unref);
+  g_clear_pointer (&self->pending_objects, g_ptr_array_unref);
 
   G_OBJECT_CLASS (wp_permission_manager_parent_class)->finalize (object);
 }
@@ -522,7 +660,7 @@ wp_permission_manager_add_client (WpPermissionManager *self, WpClient *client)
   g_return_if_fail (WP_IS_PERMISSION_MANAGER (self));
 
   g_ptr_array_add (self->clients, g_object_ref (client));
-  update_client_permissions (self, client);
+  update_client_permissions (self, client, TRUE);
 
   g_signal_connect_object (client, "notify::properties",
       G_CALLBACK (on_client_properties_changed), self, 0);
@@ -536,8 +674,8 @@ wp_permission_manager_remove_client (WpPermissionManager *self,
 {
   g_return_if_fail (WP_IS_PERMISSION_MANAGER (self));
 
+  g_hash_table_remove (self->client_perms, client);
   g_ptr_array_remove_fast (self->clients, client);
-  update_client_permissions (self, client);
 
   g_signal_handlers_disconnect_by_data (client, self);
 }
@@ -573,7 +711,7 @@ wp_permission_manager_set_default_permissions (WpPermissionManager *self,
 
   if (self->default_perms != permissions) {
     self->default_perms = permissions;
-    update_permissions (self);
+    update_permissions (self, FALSE);
   }
 }
 
@@ -615,7 +753,7 @@ wp_permission_manager_set_core_permissions (WpPermissionManager *self,
 
   if (self->core_perms != permissions) {
     self->core_perms = permissions;
-    update_permissions (self);
+    update_permissions (self, FALSE);
   }
 }
 
@@ -625,7 +763,7 @@ wp_permission_manager_add_match (WpPermissionManager *self,
 {
   guint id = match->id;
   g_hash_table_insert (self->matches, GUINT_TO_POINTER (id), match);
-  update_permissions (self);
+  update_permissions (self, TRUE);
   return id;
 }
 
@@ -754,7 +892,7 @@ wp_permission_manager_remove_match (WpPermissionManager *self, guint32 match_id)
   g_return_if_fail (match_id != SPA_ID_INVALID);
 
   g_hash_table_remove (self->matches, GUINT_TO_POINTER (match_id));
-  update_permissions (self);
+  update_permissions (self, TRUE);
 }
 
 /*!
@@ -763,7 +901,8 @@ wp_permission_manager_remove_match (WpPermissionManager *self, guint32 match_id)
  * The permission manager already updates permissions on all clients
  * automatically when a new client or object is added, however, this might be
  * needed if interests with closures or callbacks were added and something
- * changed externally.
+ * changed externally. Only the permissions that differ from the ones that
+ * were last sent are updated on each client.
  *
  * \ingroup wppermissionmanager
  * \param self the permission manager
@@ -773,5 +912,5 @@ wp_permission_manager_update_permissions (WpPermissionManager *self)
 {
   g_return_if_fail (WP_IS_PERMISSION_MANAGER (self));
 
-  update_permissions (self);
+  update_permissions (self, TRUE);
 }
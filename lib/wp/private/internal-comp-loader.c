@@ -49,6 +49,17 @@ struct _ComponentData
     dependency chain (i.e. there is a required component that requires
     this one, directly or indirectly) */
   ComponentData *required_by;
+
+  /* the components that load after this one */
+  GPtrArray *dependents;  /* value-type: ComponentData* (unowned) */
+  /* the number of components that must finish loading before this one */
+  guint n_pending_deps;
+  /* the last dependency to finish loading, i.e. the previous component
+     in the critical path that leads to this one */
+  ComponentData *critical_dep;
+  /* when loading started and finished, in monotonic time */
+  gint64 start_time;
+  gint64 end_time;
 };
 
 static void component_data_free (ComponentData * self);
@@ -179,6 +190,7 @@ component_data_new_from_json (WpSpaJson * json, WpProperties * features,
   comp->wants = g_ptr_array_new_with_free_func (g_free);
   comp->before = g_ptr_array_new_with_free_func (g_free);
   comp->after = g_ptr_array_new_with_free_func (g_free);
+  comp->dependents = g_ptr_array_new ();
 
   props = wp_properties_new_json (json);
   if (rules && !wp_json_utils_match_rules (rules, props, component_rule_match_cb,
@@ -270,6 +282,7 @@ component_data_free (ComponentData * self)
   g_clear_pointer (&self->wants, g_ptr_array_unref);
   g_clear_pointer (&self->before, g_ptr_array_unref);
   g_clear_pointer (&self->after, g_ptr_array_unref);
+  g_clear_pointer (&self->dependents, g_ptr_array_unref);
   g_free (self);
 }
 
@@ -288,16 +301,15 @@ struct _WpComponentArrayLoadTask
   GHashTable *feat_components;
   /* the final sorted list of components to load */
   GPtrArray *components;
-  /* iterator in the components array above */
-  ComponentData **components_iter;
-  /* the current component being loaded */
-  ComponentData *curr_component;
+  /* the number of components that have finished loading, or were skipped */
+  guint n_finished;
+  /* when loading started, in monotonic time */
+  gint64 start_time;
 };
 
 enum {
   STEP_PARSE = WP_TRANSITION_STEP_CUSTOM_START,
-  STEP_GET_NEXT,
-  STEP_LOAD_NEXT,
+  STEP_LOAD,
 };
 
 G_DECLARE_FINAL_TYPE (WpComponentArrayLoadTask, wp_component_array_load_task,
@@ -317,10 +329,11 @@ wp_component_array_load_task_get_next_step (WpTransition * transition, guint ste
 
   switch (step) {
   case WP_TRANSITION_STEP_NONE:     return STEP_PARSE;
-  case STEP_PARSE:                  return STEP_GET_NEXT;
-  case STEP_GET_NEXT:
-    return (self->curr_component) ? STEP_LOAD_NEXT : WP_TRANSITION_STEP_NONE;
-  case STEP_LOAD_NEXT:              return STEP_GET_NEXT;
+  case STEP_PARSE:                  return STEP_LOAD;
+  case STEP_LOAD:
+    /* stay here until all components have finished loading */
+    return (self->n_finished < self->components->len) ?
+        STEP_LOAD : WP_TRANSITION_STEP_NONE;
   default:
     g_return_val_if_reached (WP_TRANSITION_STEP_ERROR);
   }
@@ -495,6 +508,37 @@ add_component (ComponentData * comp, gboolean strongly_required,
   return TRUE;
 }
 
+/* links each component to the components that must load after it; "after"
+   has all the dependencies at this point, including "requires", "wants"
+   and the reverse of "before" */
+static void
+build_dependency_graph (WpComponentArrayLoadTask * self)
+{
+  g_autoptr (GHashTable) loaded = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (guint i = 0; i < self->components->len; i++) {
+    ComponentData *comp = g_ptr_array_index (self->components, i);
+    g_hash_table_insert (loaded, comp->provides, comp);
+  }
+
+  for (guint i = 0; i < self->components->len; i++) {
+    ComponentData *comp = g_ptr_array_index (self->components, i);
+
+    for (guint j = 0; j < comp->after->len; j++) {
+      const gchar *dep_provides = g_ptr_array_index (comp->after, j);
+      ComponentData *dep = g_hash_table_lookup (loaded, dep_provides);
+
+      /* dependencies that are not going to be loaded are satisfied */
+      if (!dep || dep == comp ||
+          g_ptr_array_find (dep->dependents, comp, NULL))
+        continue;
+
+      g_ptr_array_add (dep->dependents, comp);
+      comp->n_pending_deps++;
+    }
+  }
+}
+
 static gboolean
 parse_components (WpComponentArrayLoadTask * self, GError ** error)
 {
@@ -550,107 +594,180 @@ parse_components (WpComponentArrayLoadTask * self, GError ** error)
   if (!sort_components_before_after (self, error))
     return FALSE;
 
-  /* terminate the array with NULL */
-  g_ptr_array_add (self->components, NULL);
+  build_dependency_graph (self);
 
   /* clear feat_components, they are no longer needed */
   g_clear_pointer (&self->feat_components, g_hash_table_unref);
   return TRUE;
 }
 
+typedef struct {
+  WpComponentArrayLoadTask *task;
+  ComponentData *comp;
+} ComponentLoad;
+
+static void load_component (WpComponentArrayLoadTask * self,
+    ComponentData * comp);
+
+static void
+log_critical_path (WpComponentArrayLoadTask * self)
+{
+  ComponentData *last = NULL;
+  g_autoptr (GString) str = g_string_new (NULL);
+
+  for (guint i = 0; i < self->components->len; i++) {
+    ComponentData *comp = g_ptr_array_index (self->components, i);
+    if (!last || comp->end_time > last->end_time)
+      last = comp;
+  }
+  if (!last)
+    return;
+
+  /* follow the chain of dependencies that finished last backwards */
+  for (ComponentData *comp = last; comp; comp = comp->critical_dep) {
+    g_autofree gchar *item = g_strdup_printf ("%s (%.1f ms)",
+        comp->printable_id, (comp->end_time - comp->start_time) / 1000.0);
+    if (str->len > 0)
+      g_string_prepend (str, " -> ");
+    g_string_prepend (str, item);
+  }
+
+  wp_info_object (self, "loaded %u components in %.1f ms, critical path: %s",
+      self->components->len, (last->end_time - self->start_time) / 1000.0,
+      str->str);
+}
+
+static void
+component_finished (WpComponentArrayLoadTask * self, ComponentData * comp)
+{
+  comp->end_time = g_get_monotonic_time ();
+  self->n_finished++;
+
+  wp_debug_object (self, "component '%s' finished in %.1f ms",
+      comp->printable_id, (comp->end_time - comp->start_time) / 1000.0);
+
+  /* start the components that were waiting only for this one */
+  for (guint i = 0; i < comp->dependents->len; i++) {
+    ComponentData *dependent = g_ptr_array_index (comp->dependents, i);
+    if (--dependent->n_pending_deps == 0) {
+      dependent->critical_dep = comp;
+      load_component (self, dependent);
+    }
+  }
+
+  if (self->n_finished == self->components->len)
+    log_critical_path (self);
+}
+
 static void
 on_component_loaded (WpCore *core, GAsyncResult *res, gpointer data)
 {
-  WpComponentArrayLoadTask *self = WP_COMPONENT_ARRAY_LOAD_TASK (data);
+  ComponentLoad *load = data;
+  g_autoptr (WpComponentArrayLoadTask) self = load->task;
+  g_autoptr (ComponentData) comp = load->comp;
   g_autoptr (GError) error = NULL;
+  gboolean loaded;
 
-  g_return_if_fail (self->curr_component);
+  g_free (load);
+  loaded = wp_core_load_component_finish (core, res, &error);
+
+  /* another component may have failed while this one was loading */
+  if (wp_transition_get_completed (WP_TRANSITION (self)))
+    return;
 
-  if (!wp_core_load_component_finish (core, res, &error)) {
+  if (!loaded) {
     // if it was required, fail
-    if (self->curr_component->state == FEATURE_STATE_REQUIRED) {
+    if (comp->state == FEATURE_STATE_REQUIRED) {
       wp_transition_return_error (WP_TRANSITION (self), g_error_new (
           WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_OPERATION_FAILED,
           "failed to load required component '%s': %s",
-          self->curr_component->printable_id, error->message));
+          comp->printable_id, error->message));
       return;
     }
     // if it was optional, check if strongly_required
-    else if (self->curr_component->state == FEATURE_STATE_OPTIONAL &&
-             self->curr_component->required_by) {
-      g_autofree gchar *dep_chain = print_dep_chain (self->curr_component);
+    else if (comp->state == FEATURE_STATE_OPTIONAL && comp->required_by) {
+      g_autofree gchar *dep_chain = print_dep_chain (comp);
       wp_transition_return_error (WP_TRANSITION (self), g_error_new (
           WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_OPERATION_FAILED,
           "failed to load component '%s' (required by %s): %s",
-          self->curr_component->printable_id, dep_chain, error->message));
+          comp->printable_id, dep_chain, error->message));
       return;
     }
     else {
       wp_notice_object (core, "optional component '%s' failed to load: %s",
-          self->curr_component->printable_id, error->message);
+          comp->printable_id, error->message);
     }
   }
 
+  component_finished (self, comp);
   wp_transition_advance (WP_TRANSITION (self));
 }
 
+static void
+load_component (WpComponentArrayLoadTask * self, ComponentData * comp)
+{
+  WpCore *core = wp_transition_get_data (WP_TRANSITION (self));
+  ComponentLoad *load;
+
+  comp->start_time = g_get_monotonic_time ();
+
+  /* verify that dependencies have been loaded */
+  for (guint i = 0; i < comp->requires->len; i++) {
+    const gchar *dependency = g_ptr_array_index (comp->requires, i);
+    if (!wp_core_test_feature (core, dependency)) {
+      /* this component must be optional, because if it wasn't, the dependency
+         failing to load would have caused an error earlier */
+      g_assert (comp->state == FEATURE_STATE_OPTIONAL);
+      wp_notice_object (core, "skipping component '%s' because some of its "
+          "dependencies were not loaded", comp->printable_id);
+      component_finished (self, comp);
+      return;
+    }
+  }
+
+  /* Load the component; other components may be loading concurrently */
+  wp_debug_object (self, "loading component '%s'", comp->printable_id);
+  load = g_new0 (ComponentLoad, 1);
+  load->task = g_object_ref (self);
+  load->comp = component_data_ref (comp);
+  wp_core_load_component (core, comp->name, comp->type, comp->arguments,
+      comp->provides, NULL, (GAsyncReadyCallback) on_component_loaded, load);
+}
+
 static void
 wp_component_array_load_task_execute_step (WpTransition * transition, guint step)
 {
   WpComponentArrayLoadTask *self = WP_COMPONENT_ARRAY_LOAD_TASK (transition);
-  WpCore *core = wp_transition_get_data(transition);
 
   switch (step) {
   case STEP_PARSE: {
     g_autoptr (GError) error = NULL;
     if (parse_components (self, &error)) {
-      self->components_iter =
-          (ComponentData **) &g_ptr_array_index (self->components, 0);
       wp_transition_advance (transition);
     } else {
       wp_transition_return_error (transition, g_steal_pointer (&error));
     }
     break;
   }
-  case STEP_GET_NEXT:
-    /* get the next enabled component */
-    do {
-      self->curr_component = (ComponentData *) *self->components_iter;
-      self->components_iter++;
-    } while (self->curr_component &&
-             self->curr_component->state == FEATURE_STATE_DISABLED);
-    wp_transition_advance (transition);
-    break;
-
-  case STEP_LOAD_NEXT: {
-    /* verify that dependencies have been loaded */
-    gboolean dependencies_ok = TRUE;
-    for (guint i = 0; i < self->curr_component->requires->len; i++) {
-      const gchar *dependency =
-          g_ptr_array_index (self->curr_component->requires, i);
-      if (!wp_core_test_feature (core, dependency)) {
-        dependencies_ok = FALSE;
-        break;
-      }
+  case STEP_LOAD: {
+    g_autoptr (GPtrArray) ready = g_ptr_array_new ();
+
+    /* start all the components that do not depend on others, in the sorted
+       order; the rest start as soon as their dependencies finish loading.
+       Collect them first, as skipped components finish immediately and
+       start their dependents from within load_component() */
+    self->start_time = g_get_monotonic_time ();
+    for (guint i = 0; i < self->components->len; i++) {
+      ComponentData *comp = g_ptr_array_index (self->components, i);
+      if (comp->n_pending_deps == 0)
+        g_ptr_array_add (ready, comp);
     }
+    for (guint i = 0; i < ready->len; i++)
+      load_component (self, g_ptr_array_index (ready, i));
 
-    if (!dependencies_ok) {
-      /* this component must be optional, because if it wasn't, the dependency
-         failing to load would have caused an error earlier */
-      g_assert (self->curr_component->state == FEATURE_STATE_OPTIONAL);
-      wp_notice_object (core, "skipping component '%s' because some of its "
-          "dependencies were not loaded", self->curr_component->printable_id);
+    /* complete now if there was nothing to wait for */
+    if (!wp_transition_get_completed (transition))
       wp_transition_advance (transition);
-      return;
-    }
-
-    /* Load the component */
-    wp_debug_object (self, "loading component '%s'",
-        self->curr_component->printable_id);
-    wp_core_load_component (core, self->curr_component->name,
-        self->curr_component->type, self->curr_component->arguments,
-        self->curr_component->provides, NULL,
-        (GAsyncReadyCallback) on_component_loaded, self);
     break;
   }
   case WP_TRANSITION_STEP_ERROR:
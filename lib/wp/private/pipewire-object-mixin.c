@@ -381,6 +381,7 @@ wp_pw_object_mixin_data_free (gpointer data)
   g_clear_pointer (&d->properties, wp_properties_unref);
   g_list_free_full (d->params, wp_pw_object_mixin_param_store_free);
   g_clear_pointer (&d->subscribed_ids, g_array_unref);
+  g_clear_pointer (&d->cache_enums, g_array_unref);
   g_warn_if_fail (d->enum_params_tasks == NULL);
   g_slice_free (WpPwObjectMixinData, d);
 }
@@ -595,6 +596,63 @@ wp_pw_object_mixin_activate_get_next_step (WpObject * object,
   /* returning to STEP_NONE is handled by WpFeatureActivationTransition */
 }
 
+static WpPwObjectMixinCacheEnum *
+find_cache_enum (WpPwObjectMixinData * d, guint32 id, guint * index)
+{
+  if (!d->cache_enums)
+    return NULL;
+
+  for (guint i = 0; i < d->cache_enums->len; i++) {
+    WpPwObjectMixinCacheEnum *e =
+        &g_array_index (d->cache_enums, WpPwObjectMixinCacheEnum, i);
+    if (e->id == id) {
+      if (index)
+        *index = i;
+      return e;
+    }
+  }
+  return NULL;
+}
+
+static void enum_params_for_cache_done (GObject * object, GAsyncResult * res,
+    gpointer data);
+
+/*
+ * Enumerates params @em id to refresh the params cache. All callers of this
+ * (feature activation, param_info changes) want the same unfiltered result,
+ * so if an enumeration of the same id is already in flight, the request
+ * joins it instead of issuing another round-trip to the server.
+ * If @em refresh is set, the params are known to have changed after the
+ * in-flight request was sent, so exactly one more enumeration is issued
+ * when it finishes, no matter how many changes arrive in the meantime.
+ */
+static void
+cache_params_enum (gpointer obj, guint32 id, gboolean refresh)
+{
+  WpPwObjectMixinData *d = wp_pw_object_mixin_get_data (obj);
+  WpPwObjectMixinCacheEnum *e = find_cache_enum (d, id, NULL);
+
+  if (e) {
+    if (refresh && !e->refresh) {
+      e->refresh = TRUE;
+    } else {
+      d->n_cache_enums_saved++;
+      wp_debug_object (obj, "coalesced enum id %u with in-flight request "
+          "(%u round-trips saved)", id, d->n_cache_enums_saved);
+    }
+    return;
+  }
+
+  if (!d->cache_enums)
+    d->cache_enums = g_array_new (FALSE, FALSE,
+        sizeof (WpPwObjectMixinCacheEnum));
+  g_array_append_val (d->cache_enums,
+      ((WpPwObjectMixinCacheEnum) { .id = id, .refresh = FALSE }));
+
+  wp_pw_object_mixin_enum_params_unchecked (obj, id, NULL, NULL,
+      enum_params_for_cache_done, GUINT_TO_POINTER (id));
+}
+
 static void
 enum_params_for_cache_done (GObject * object, GAsyncResult * res, gpointer data)
 {
@@ -603,6 +661,16 @@ enum_params_for_cache_done (GObject * object, GAsyncResult * res, gpointer data)
   g_autoptr (GError) error = NULL;
   g_autoptr (GPtrArray) params = NULL;
   const gchar *name = NULL;
+  WpPwObjectMixinCacheEnum *e = NULL;
+  gboolean refresh = FALSE;
+  guint index;
+
+  /* the request is no longer in flight */
+  e = find_cache_enum (d, param_id, &index);
+  if (e) {
+    refresh = e->refresh;
+    g_array_remove_index_fast (d->cache_enums, index);
+  }
 
   params = g_task_propagate_pointer (G_TASK (res), &error);
   if (error) {
@@ -623,6 +691,10 @@ enum_params_for_cache_done (GObject * object, GAsyncResult * res, gpointer data)
       g_steal_pointer (&params));
 
   g_signal_emit_by_name (object, "params-changed", name);
+
+  /* params changed while we were waiting; fetch them once more */
+  if (refresh)
+    cache_params_enum (object, param_id, FALSE);
 }
 
 G_DEFINE_QUARK (WpPwObjectMixinParamCacheActivatedFeatures, activated_features)
@@ -650,18 +722,12 @@ wp_pw_object_mixin_cache_params (WpObject * object, WpObjectFeatures missing)
   for (guint i = 0; i < G_N_ELEMENTS (params_features); i++) {
     if (missing & params_features[i].feature) {
       param_info = find_param_info (object, params_features[i].param_ids[0]);
-      if (param_info && param_info->flags & SPA_PARAM_INFO_READ) {
-        wp_pw_object_mixin_enum_params_unchecked (object,
-            param_info->id, NULL, NULL, enum_params_for_cache_done,
-            GUINT_TO_POINTER (param_info->id));
-      }
+      if (param_info && param_info->flags & SPA_PARAM_INFO_READ)
+        cache_params_enum (object, param_info->id, FALSE);
 
       param_info = find_param_info (object, params_features[i].param_ids[1]);
-      if (param_info && param_info->flags & SPA_PARAM_INFO_READ) {
-        wp_pw_object_mixin_enum_params_unchecked (object,
-            param_info->id, NULL, NULL, enum_params_for_cache_done,
-            GUINT_TO_POINTER (param_info->id));
-      }
+      if (param_info && param_info->flags & SPA_PARAM_INFO_READ)
+        cache_params_enum (object, param_info->id, FALSE);
 
       activated |= params_features[i].feature;
     }
@@ -731,6 +797,8 @@ wp_pw_object_mixin_handle_pw_proxy_destroyed (WpProxy * proxy)
           WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_OPERATION_FAILED,
           "pipewire proxy destroyed before finishing");
     }
+    if (d->cache_enums)
+      g_array_set_size (d->cache_enums, 0);
   }
 
   wp_object_update_features (WP_OBJECT (proxy), 0,
@@ -787,9 +855,7 @@ wp_pw_object_mixin_handle_event_info (gpointer instance, gconstpointer update)
         if (active_ft & get_feature_for_param_id (param_info[i].id) &&
             param_info[i].flags & SPA_PARAM_INFO_READ)
         {
-          wp_pw_object_mixin_enum_params_unchecked (instance,
-              param_info[i].id, NULL, NULL, enum_params_for_cache_done,
-              GUINT_TO_POINTER (param_info[i].id));
+          cache_params_enum (instance, param_info[i].id, TRUE);
         }
       }
     }
@@ -118,6 +118,14 @@ void wp_pw_object_mixin_object_interface_init (WpPipewireObjectInterface * iface
 /********/
 /* DATA */
 
+/* an in-flight enum_params request that fills the params cache */
+typedef struct _WpPwObjectMixinCacheEnum WpPwObjectMixinCacheEnum;
+struct _WpPwObjectMixinCacheEnum
+{
+  guint32 id;
+  gboolean refresh;  /* params changed since the request was sent */
+};
+
 typedef struct _WpPwObjectMixinData WpPwObjectMixinData;
 struct _WpPwObjectMixinData
 {
@@ -129,6 +137,8 @@ struct _WpPwObjectMixinData
   GList *enum_params_tasks;  /* element-type: GTask* */
   GList *params;             /* element-type: WpPwObjectMixinParamStore* */
   GArray *subscribed_ids;    /* element-type: guint32 */
+  GArray *cache_enums;       /* element-type: WpPwObjectMixinCacheEnum */
+  guint n_cache_enums_saved; /* enum_params round-trips avoided by coalescing */
 };
 
 /* get mixin data (stored as qdata on the @em instance) */
@@ -70,27 +70,81 @@ object_manager_destroyed (gpointer data, GObject * om)
   g_ptr_array_remove_fast (self->object_managers, om);
 }
 
-/* find the subclass of WpPipewireGlobal that can handle
-   the given pipewire interface type of the given version */
-static inline GType
-find_proxy_instance_type (const char * type, guint32 version)
+typedef struct _ProxyTypeEntry ProxyTypeEntry;
+struct _ProxyTypeEntry
+{
+  guint32 version;
+  GType gtype;
+};
+
+/* (re)builds the pw interface type -> WpGlobalProxy subclass table */
+static void
+proxy_types_rebuild (WpRegistry * self)
 {
   g_autofree GType *children;
   guint n_children;
 
   children = g_type_children (WP_TYPE_GLOBAL_PROXY, &n_children);
+  g_hash_table_remove_all (self->proxy_types);
 
   for (guint i = 0; i < n_children; i++) {
     WpProxyClass *klass = (WpProxyClass *) g_type_class_ref (children[i]);
-    if (g_strcmp0 (klass->pw_iface_type, type) == 0 &&
-        klass->pw_iface_version == version) {
-      g_type_class_unref (klass);
-      return children[i];
+
+    if (klass->pw_iface_type) {
+      GArray *entries = g_hash_table_lookup (self->proxy_types,
+          klass->pw_iface_type);
+      gboolean found = FALSE;
+
+      if (!entries) {
+        entries = g_array_new (FALSE, FALSE, sizeof (ProxyTypeEntry));
+        g_hash_table_insert (self->proxy_types,
+            g_strdup (klass->pw_iface_type), entries);
+      }
+
+      /* the first registered subclass wins, as in g_type_children() order */
+      for (guint j = 0; j < entries->len && !found; j++)
+        found = g_array_index (entries, ProxyTypeEntry, j).version ==
+            klass->pw_iface_version;
+      if (!found) {
+        ProxyTypeEntry e = { klass->pw_iface_version, children[i] };
+        g_array_append_val (entries, e);
+      }
     }
 
     g_type_class_unref (klass);
   }
 
+  self->n_proxy_types = n_children;
+}
+
+/* find the subclass of WpPipewireGlobal that can handle
+   the given pipewire interface type of the given version */
+static inline GType
+find_proxy_instance_type (WpRegistry * self, const char * type,
+    guint32 version)
+{
+  for (guint pass = 0; pass < 2; pass++) {
+    GArray *entries = g_hash_table_lookup (self->proxy_types, type);
+
+    for (guint i = 0; entries && i < entries->len; i++) {
+      ProxyTypeEntry *e = &g_array_index (entries, ProxyTypeEntry, i);
+      if (e->version == version)
+        return e->gtype;
+    }
+
+    /* not found; rebuild the table if new subclasses have been registered
+       since it was built (for example, by a module that was just loaded) */
+    if (pass == 0) {
+      g_autofree GType *children = NULL;
+      guint n_children;
+
+      children = g_type_children (WP_TYPE_GLOBAL_PROXY, &n_children);
+      if (n_children == self->n_proxy_types)
+        break;
+      proxy_types_rebuild (self);
+    }
+  }
+
   return WP_TYPE_GLOBAL_PROXY;
 }
 
@@ -100,7 +154,7 @@ registry_global (void *data, uint32_t id, uint32_t permissions,
     const char *type, uint32_t version, const struct spa_dict *props)
 {
   WpRegistry *self = data;
-  GType gtype = find_proxy_instance_type (type, version);
+  GType gtype = find_proxy_instance_type (self, type, version);
 
   wp_debug_object (wp_registry_get_core (self),
       "global:%u perm:0x%x type:%s/%u -> %s",
@@ -122,13 +176,10 @@ registry_global_remove (void *data, uint32_t id)
 
   /* if not found, look in the tmp_globals, as it may still not be exposed */
   if (!global) {
-    for (guint i = 0; i < self->tmp_globals->len; i++) {
-      WpGlobal *g = g_ptr_array_index (self->tmp_globals, i);
-      if (g->id == id) {
-        global = g;
-        break;
-      }
-    }
+    WpGlobal *g = g_hash_table_lookup (self->tmp_globals_by_id,
+        GUINT_TO_POINTER (id));
+    if (g && g->id == id)
+      global = g;
   }
 
   g_return_if_fail (global &&
@@ -153,9 +204,13 @@ wp_registry_init (WpRegistry *self)
       g_ptr_array_new_with_free_func ((GDestroyNotify) wp_global_unref);
   self->tmp_globals =
       g_ptr_array_new_with_free_func ((GDestroyNotify) wp_global_unref);
+  self->tmp_globals_by_id = g_hash_table_new (g_direct_hash, g_direct_equal);
   self->objects = g_ptr_array_new_with_free_func (g_object_unref);
   self->object_managers = g_ptr_array_new ();
   self->features = g_ptr_array_new_with_free_func (g_free);
+  self->proxy_types = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      (GDestroyNotify) g_array_unref);
+  self->n_proxy_types = 0;
 }
 
 void
@@ -164,7 +219,9 @@ wp_registry_clear (WpRegistry *self)
   wp_registry_detach (self);
   g_clear_pointer (&self->globals, g_ptr_array_unref);
   g_clear_pointer (&self->tmp_globals, g_ptr_array_unref);
+  g_clear_pointer (&self->tmp_globals_by_id, g_hash_table_unref);
   g_clear_pointer (&self->features, g_ptr_array_unref);
+  g_clear_pointer (&self->proxy_types, g_hash_table_unref);
 
   /* make sure all objects are disabled before clearing the registry */
   for (guint i = 0; i < self->objects->len; i++) {
@@ -242,6 +299,8 @@ wp_registry_detach (WpRegistry *self)
   }
 
   /* drop tmp globals as well */
+  if (self->tmp_globals_by_id)
+    g_hash_table_remove_all (self->tmp_globals_by_id);
   objlist = self->tmp_globals;
   while (objlist && objlist->len > 0) {
     g_autoptr (WpGlobal) global = g_ptr_array_steal_index_fast (objlist,
@@ -265,6 +324,7 @@ expose_tmp_globals (WpCore *core)
   tmp_globals = self->tmp_globals;
   self->tmp_globals =
       g_ptr_array_new_with_free_func ((GDestroyNotify) wp_global_unref);
+  g_hash_table_remove_all (self->tmp_globals_by_id);
 
   wp_debug_object (core, "exposing %u new globals", tmp_globals->len);
 
@@ -299,19 +359,10 @@ expose_tmp_globals (WpCore *core)
       (GCopyFunc) g_object_ref, NULL);
   g_ptr_array_set_free_func (object_managers, g_object_unref);
 
-  /* notify object managers */
+  /* notify object managers; each of them gets the whole batch at once */
   for (guint i = 0; i < object_managers->len; i++) {
     WpObjectManager *om = g_ptr_array_index (object_managers, i);
-
-    for (guint i = 0; i < tmp_globals->len; i++) {
-      WpGlobal *g = g_ptr_array_index (tmp_globals, i);
-
-      /* if global was already removed, drop it */
-      if (g->flags == 0 || g->id == SPA_ID_INVALID)
-        continue;
-
-      wp_object_manager_add_global (om, g);
-    }
+    wp_object_manager_add_globals (om, tmp_globals);
     wp_object_manager_maybe_objects_changed (om);
   }
 
@@ -338,12 +389,12 @@ wp_registry_prepare_new_global (WpRegistry * self, guint32 id,
 
   g_return_if_fail (flag != 0);
 
-  for (guint i = 0; i < self->tmp_globals->len; i++) {
-    WpGlobal *g = g_ptr_array_index (self->tmp_globals, i);
-    if (g->id == id) {
+  {
+    WpGlobal *g = g_hash_table_lookup (self->tmp_globals_by_id,
+        GUINT_TO_POINTER (id));
+    /* the id is invalidated if the global was removed in the meantime */
+    if (g && g->id == id)
       global = wp_global_ref (g);
-      break;
-    }
   }
 
   wp_debug_object (core, "%s WpGlobal:%u type:%s proxy:%p",
@@ -360,6 +411,8 @@ wp_registry_prepare_new_global (WpRegistry * self, guint32 id,
         wp_properties_new_copy_dict (props) : wp_properties_new_empty ();
     global->proxy = proxy;
     g_ptr_array_add (self->tmp_globals, wp_global_ref (global));
+    g_hash_table_insert (self->tmp_globals_by_id, GUINT_TO_POINTER (id),
+        global);
 
     /* ensure we have 'object.id' so that we can filter by id on object managers */
     wp_properties_setf (global->properties, PW_KEY_OBJECT_ID, "%u", global->id);
@@ -425,12 +478,7 @@ wp_registry_install_object_manager (WpRegistry * self, WpObjectManager * om)
 
   /* add pre-existing objects to the object manager,
      in case it's interested in them */
-  for (i = 0; i < self->globals->len; i++) {
-    WpGlobal *g = g_ptr_array_index (self->globals, i);
-    /* check if null because the globals array can have gaps */
-    if (g)
-      wp_object_manager_add_global (om, g);
-  }
+  wp_object_manager_add_globals (om, self->globals);
   for (i = 0; i < self->objects->len; i++) {
     GObject *o = g_ptr_array_index (self->objects, i);
     wp_object_manager_add_object (om, o);
@@ -28,9 +28,14 @@ struct _WpRegistry
 
   GPtrArray *globals; // element-type: WpGlobal*
   GPtrArray *tmp_globals; // element-type: WpGlobal*
+  GHashTable *tmp_globals_by_id; // id -> WpGlobal* in tmp_globals, no ref
   GPtrArray *objects; // element-type: GObject*
   GPtrArray *object_managers; // element-type: WpObjectManager*
   GPtrArray *features; // element-type: gchar*
+
+  /* pw interface type -> GArray of (version, WpGlobalProxy subclass) */
+  GHashTable *proxy_types;
+  guint n_proxy_types; // number of subclasses when proxy_types was built
 };
 
 void wp_registry_init (WpRegistry *self);
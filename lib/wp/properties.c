@@ -43,6 +43,22 @@ WP_DEFINE_LOCAL_LOG_TOPIC ("wp-properties")
  *
  * WpProperties is reference-counted with wp_properties_ref() and
  * wp_properties_unref().
+ *
+ * Lookups in a `spa_dict` are linear scans, unless the dictionary is sorted.
+ * To keep wp_properties_get() cheap on the large property sets of nodes and
+ * devices, a WpProperties that owns its `struct pw_properties` builds a hash
+ * index of its items the first time it is queried with more than a few
+ * items in it. The index is kept up to date by wp_properties_set() and
+ * dropped by the bulk update functions, to be rebuilt on the next lookup.
+ * The `spa_dict` itself is never changed by this, so it can still be handed
+ * to PipeWire without a copy.
+ *
+ * Copies made with wp_properties_copy() (and therefore also by
+ * wp_properties_ensure_unique_owner()) are copy-on-write: the new object
+ * shares the `struct pw_properties` of the original one and the actual copy
+ * is only made when either of them is modified. Objects that merely read
+ * their properties, which is what happens with most of them, never pay for
+ * a copy of the strings.
  */
 
 enum {
@@ -50,6 +66,17 @@ enum {
   FLAG_NO_OWNERSHIP = (1<<2),
 };
 
+/* below this number of items, a linear scan is as fast as hashing */
+#define INDEX_MIN_ITEMS 16
+
+/* a pw_properties that is shared between copy-on-write copies */
+typedef struct _WpPropertiesStore WpPropertiesStore;
+struct _WpPropertiesStore
+{
+  gatomicrefcount ref;
+  struct pw_properties *props;
+};
+
 struct _WpProperties
 {
   grefcount ref;
@@ -58,6 +85,8 @@ struct _WpProperties
     struct pw_properties *props;
     const struct spa_dict *dict;
   };
+  WpPropertiesStore *store;  /* non-NULL if props may be shared */
+  GHashTable *index;  /* key -> const struct spa_dict_item * */
 };
 
 G_DEFINE_BOXED_TYPE(WpProperties, wp_properties, wp_properties_ref, wp_properties_unref)
@@ -302,6 +331,9 @@ wp_properties_new_copy_dict (const struct spa_dict * dict)
  * \brief Constructs and returns a new WpProperties object that contains a copy
  * of all the properties contained in \a other.
  *
+ * Unless \a other wraps a native structure, the copy shares its storage with
+ * \a other until one of the two is modified.
+ *
  * \ingroup wpproperties
  * \param other a properties object
  * \returns (transfer full): the newly constructed properties set
@@ -310,17 +342,111 @@ wp_properties_new_copy_dict (const struct spa_dict * dict)
 WpProperties *
 wp_properties_copy (WpProperties * other)
 {
-  return wp_properties_new_copy_dict (wp_properties_peek_dict (other));
+  WpPropertiesStore *store;
+  WpProperties *self;
+
+  g_return_val_if_fail (other != NULL, NULL);
+
+  /* wrapped structures may change externally, so they must be copied now */
+  if (other->flags & (FLAG_IS_DICT | FLAG_NO_OWNERSHIP))
+    return wp_properties_new_copy_dict (wp_properties_peek_dict (other));
+
+  store = g_atomic_pointer_get (&other->store);
+  if (!store) {
+    WpPropertiesStore *new_store = g_slice_new0 (WpPropertiesStore);
+    g_atomic_ref_count_init (&new_store->ref);
+    new_store->props = other->props;
+
+    if (g_atomic_pointer_compare_and_exchange (&other->store, NULL, new_store))
+      store = new_store;
+    else {
+      g_slice_free (WpPropertiesStore, new_store);
+      store = g_atomic_pointer_get (&other->store);
+    }
+  }
+
+  g_atomic_ref_count_inc (&store->ref);
+
+  self = g_slice_new0 (WpProperties);
+  g_ref_count_init (&self->ref);
+  self->flags = 0;
+  self->props = store->props;
+  self->store = store;
+  return self;
+}
+
+static void
+wp_properties_store_unref (WpPropertiesStore * store)
+{
+  if (g_atomic_ref_count_dec (&store->ref)) {
+    pw_properties_free (store->props);
+    g_slice_free (WpPropertiesStore, store);
+  }
 }
 
 static void
 wp_properties_free (WpProperties * self)
 {
-  if (!(self->flags & FLAG_NO_OWNERSHIP))
+  if (self->store)
+    wp_properties_store_unref (self->store);
+  else if (!(self->flags & FLAG_NO_OWNERSHIP))
     pw_properties_free (self->props);
+  g_clear_pointer (&self->index, g_hash_table_unref);
   g_slice_free (WpProperties, self);
 }
 
+static inline void
+wp_properties_invalidate_index (WpProperties * self)
+{
+  g_clear_pointer (&self->index, g_hash_table_unref);
+}
+
+/* makes sure that self->props is not shared with any copy of self */
+static void
+wp_properties_detach (WpProperties * self)
+{
+  WpPropertiesStore *store = self->store;
+
+  if (!store)
+    return;
+
+  self->store = NULL;
+
+  if (g_atomic_ref_count_compare (&store->ref, 1)) {
+    /* all the copies are gone, the props are ours again */
+    g_slice_free (WpPropertiesStore, store);
+  } else {
+    self->props = pw_properties_copy (store->props);
+    wp_properties_store_unref (store);
+    wp_properties_invalidate_index (self);
+  }
+}
+
+/* to be called before a bulk modification of self->props */
+static inline void
+wp_properties_prepare_write (WpProperties * self)
+{
+  wp_properties_detach (self);
+  wp_properties_invalidate_index (self);
+}
+
+static GHashTable *
+wp_properties_ensure_index (WpProperties * self)
+{
+  if (!self->index) {
+    const struct spa_dict_item *item;
+
+    self->index = g_hash_table_new (g_str_hash, g_str_equal);
+    spa_dict_for_each (item, &self->props->dict) {
+      /* like spa_dict_lookup(), the first item wins on duplicate keys */
+      if (!g_hash_table_contains (self->index, item->key))
+        g_hash_table_insert (self->index, (gpointer) item->key,
+            (gpointer) item);
+    }
+  }
+  return self->index;
+}
+
 /*!
  * \ingroup wpproperties
  * \param self a properties object
@@ -393,6 +519,7 @@ wp_properties_update (WpProperties * self, WpProperties * props)
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
+  wp_properties_prepare_write (self);
   return pw_properties_update (self->props, wp_properties_peek_dict (props));
 }
 
@@ -415,6 +542,7 @@ wp_properties_update_from_dict (WpProperties * self,
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
+  wp_properties_prepare_write (self);
   return pw_properties_update (self->props, dict);
 }
 
@@ -436,6 +564,7 @@ wp_properties_update_from_json (WpProperties * self, const WpSpaJson * json)
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
+  wp_properties_prepare_write (self);
   return pw_properties_update_string (self->props, wp_spa_json_get_data (json),
       wp_spa_json_get_size (json));
 }
@@ -453,6 +582,7 @@ wp_properties_clear (WpProperties *self)
   g_return_if_fail (!(self->flags & FLAG_IS_DICT));
   g_return_if_fail (!(self->flags & FLAG_NO_OWNERSHIP));
 
+  wp_properties_prepare_write (self);
   pw_properties_clear (self->props);
 }
 
@@ -475,6 +605,7 @@ wp_properties_add (WpProperties * self, WpProperties * props)
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
+  wp_properties_prepare_write (self);
   return pw_properties_add (self->props, wp_properties_peek_dict (props));
 }
 
@@ -498,6 +629,7 @@ wp_properties_add_from_dict (WpProperties * self,
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
+  wp_properties_prepare_write (self);
   return pw_properties_add (self->props, dict);
 }
 
@@ -589,6 +721,7 @@ wp_properties_update_keys_array (WpProperties * self, WpProperties * props,
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
+  wp_properties_prepare_write (self);
   return pw_properties_update_keys (self->props,
       wp_properties_peek_dict (props), keys);
 }
@@ -683,6 +816,7 @@ wp_properties_add_keys_array (WpProperties * self, WpProperties * props,
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
+  wp_properties_prepare_write (self);
   return pw_properties_add_keys (self->props,
       wp_properties_peek_dict (props), keys);
 }
@@ -702,6 +836,13 @@ wp_properties_get (WpProperties * self, const gchar * key)
   g_return_val_if_fail (self != NULL, NULL);
   g_return_val_if_fail (key != NULL, NULL);
 
+  if (!(self->flags & (FLAG_IS_DICT | FLAG_NO_OWNERSHIP)) &&
+      self->props->dict.n_items >= INDEX_MIN_ITEMS) {
+    const struct spa_dict_item *item =
+        g_hash_table_lookup (wp_properties_ensure_index (self), key);
+    return item ? item->value : NULL;
+  }
+
   return spa_dict_lookup (wp_properties_peek_dict (self), key);
 }
 
@@ -724,11 +865,42 @@ gint
 wp_properties_set (WpProperties * self, const gchar * key,
     const gchar * value)
 {
+  const struct spa_dict_item *items;
+  gboolean existed;
+  gint res;
+
   g_return_val_if_fail (self != NULL, -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
-  return pw_properties_set (self->props, key, value);
+  wp_properties_detach (self);
+
+  if (!self->index)
+    return pw_properties_set (self->props, key, value);
+
+  /* removing moves items around; the index is rebuilt on the next lookup */
+  if (!value) {
+    wp_properties_invalidate_index (self);
+    return pw_properties_set (self->props, key, value);
+  }
+
+  items = self->props->dict.items;
+  existed = g_hash_table_contains (self->index, key);
+
+  res = pw_properties_set (self->props, key, value);
+
+  /* replacing a value keeps the item in place; a new item is appended,
+     unless the array had to be reallocated */
+  if (res > 0 && !existed) {
+    const struct spa_dict_item *last =
+        &self->props->dict.items[self->props->dict.n_items - 1];
+
+    if (self->props->dict.items == items && g_str_equal (last->key, key))
+      g_hash_table_insert (self->index, (gpointer) last->key, (gpointer) last);
+    else
+      wp_properties_invalidate_index (self);
+  }
+  return res;
 }
 
 /*!
@@ -778,6 +950,7 @@ wp_properties_setf_valist (WpProperties * self, const gchar * key,
   g_return_val_if_fail (!(self->flags & FLAG_IS_DICT), -EINVAL);
   g_return_val_if_fail (!(self->flags & FLAG_NO_OWNERSHIP), -EINVAL);
 
+  wp_properties_prepare_write (self);
   return pw_properties_setva (self->props, key, format, args);
 }
 
@@ -981,6 +1154,7 @@ wp_properties_sort (WpProperties * self)
   g_return_if_fail (!(self->flags & FLAG_IS_DICT));
   g_return_if_fail (!(self->flags & FLAG_NO_OWNERSHIP));
 
+  wp_properties_prepare_write (self);
   return spa_dict_qsort (&self->props->dict);
 }
 
@@ -1034,6 +1208,7 @@ wp_properties_unref_and_take_pw_properties (WpProperties * self)
   g_return_val_if_fail (self != NULL, NULL);
 
   g_autoptr (WpProperties) unique = wp_properties_ensure_unique_owner (self);
+  wp_properties_detach (unique);
   /* set the flag so that unref-ing \a unique will not destroy unique->props */
   unique->flags = FLAG_NO_OWNERSHIP;
   return unique->props;
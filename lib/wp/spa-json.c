@@ -42,6 +42,9 @@ static WpSpaJsonBuilder *
 wp_spa_json_builder_new_formatted (const gchar *fmt, ...)
     G_GNUC_PRINTF (1, 2);
 
+static int
+check_nested_size (struct spa_json *parent, const gchar *data, int size);
+
 enum {
   FLAG_NO_OWNERSHIP = (1 << 0),
 };
@@ -61,6 +64,10 @@ struct _WpSpaJson
   gchar *data;
   size_t size;
   struct spa_json *json;
+
+  /* a compiled form of the data, see wp_spa_json_set_compiled_data() */
+  gpointer compiled;
+  GDestroyNotify compiled_destroy;
 };
 
 G_DEFINE_BOXED_TYPE (WpSpaJson, wp_spa_json, wp_spa_json_ref, wp_spa_json_unref)
@@ -87,6 +94,15 @@ struct _WpSpaJsonParser
 G_DEFINE_BOXED_TYPE (WpSpaJsonParser, wp_spa_json_parser,
     wp_spa_json_parser_ref, wp_spa_json_parser_unref)
 
+typedef struct _WpSpaJsonCursorReal WpSpaJsonCursorReal;
+struct _WpSpaJsonCursorReal
+{
+  struct spa_json data[2];
+  struct spa_json *pos;
+};
+
+G_STATIC_ASSERT (sizeof (WpSpaJsonCursorReal) <= sizeof (WpSpaJsonCursor));
+
 /*!
  * \brief Increases the reference count of a spa json object
  * \ingroup wpspajson
@@ -103,6 +119,8 @@ wp_spa_json_ref (WpSpaJson *self)
 static void
 wp_spa_json_free (WpSpaJson *self)
 {
+  if (self->compiled && self->compiled_destroy)
+    self->compiled_destroy (self->compiled);
   g_clear_pointer (&self->builder, wp_spa_json_builder_unref);
   g_slice_free (WpSpaJson, self);
 }
@@ -891,6 +909,23 @@ wp_spa_json_object_get (WpSpaJson *self, ...)
   return res;
 }
 
+static gboolean
+wp_spa_json_object_lookup (WpSpaJson *self, const gchar *key,
+    WpSpaJsonToken *value)
+{
+  WpSpaJsonCursor cursor;
+  WpSpaJsonToken k;
+
+  wp_spa_json_cursor_init (&cursor, self->data, self->size);
+  while (wp_spa_json_cursor_next (&cursor, &k)) {
+    if (!wp_spa_json_cursor_next (&cursor, value))
+      return FALSE;
+    if (wp_spa_json_token_equals_string (&k, key))
+      return TRUE;
+  }
+  return FALSE;
+}
+
 /*!
  * \brief This is the `va_list` version of wp_spa_json_object_get()
  *
@@ -902,47 +937,24 @@ wp_spa_json_object_get (WpSpaJson *self, ...)
 gboolean
 wp_spa_json_object_get_valist (WpSpaJson *self, va_list args)
 {
-  g_auto (GValue) item = G_VALUE_INIT;
-  g_autoptr (WpIterator) it = NULL;
   const gchar *lookup_key = NULL;
   const gchar *lookup_fmt = NULL;
+  WpSpaJsonToken value;
 
   g_return_val_if_fail (wp_spa_json_is_object (self), FALSE);
 
-  lookup_key = va_arg(args, const gchar *);
-  if (!lookup_key)
-    return TRUE;
-  lookup_fmt = va_arg(args, const gchar *);
-  if (!lookup_fmt)
-    return FALSE;
-
-  it = wp_spa_json_new_iterator (self);
-  for (; wp_iterator_next (it, &item); g_value_unset (&item)) {
-    WpSpaJson *key = g_value_get_boxed (&item);
-    g_autofree gchar *key_str = NULL;
-    WpSpaJson *value = NULL;
-
-    key_str = wp_spa_json_parse_string (key);
-    g_return_val_if_fail (key_str, FALSE);
-
-    g_value_unset (&item);
-    if (!wp_iterator_next (it, &item))
+  for (;;) {
+    lookup_key = va_arg(args, const gchar *);
+    if (!lookup_key)
+      return TRUE;
+    lookup_fmt = va_arg(args, const gchar *);
+    if (!lookup_fmt)
       return FALSE;
-    value = g_value_get_boxed (&item);
 
-    if (g_strcmp0 (key_str, lookup_key) == 0) {
-      wp_spa_json_parse_value (value->data, value->size, lookup_fmt, args);
-      lookup_key = va_arg(args, const gchar *);
-      if (!lookup_key)
-        return TRUE;
-      lookup_fmt = va_arg(args, const gchar *);
-      if (!lookup_fmt)
-        return FALSE;
-      wp_iterator_reset (it);
-    }
+    if (!wp_spa_json_object_lookup (self, lookup_key, &value))
+      return FALSE;
+    wp_spa_json_parse_value (value.data, value.size, lookup_fmt, args);
   }
-
-  return FALSE;
 }
 
 /*!
@@ -1706,3 +1718,276 @@ wp_spa_json_new_iterator (WpSpaJson *self)
 
   return it;
 }
+
+/*!
+ * \brief Initializes a cursor to walk the values of a JSON buffer
+ *
+ * If \a data is an array or an object, the cursor walks its children;
+ * for objects, keys and values are returned as separate tokens, one after
+ * the other. Otherwise, \a data is walked as a sequence of values, which is
+ * how the main configuration file (an object without the surrounding braces)
+ * can be parsed.
+ *
+ * The cursor does not allocate any memory and does not need to be cleared.
+ * It points into \a data, which must stay alive while the cursor and the
+ * tokens it returns are being used. The cursor must not be copied.
+ *
+ * To walk the children of a container token, initialize another cursor with
+ * the token's data and size.
+ *
+ * \ingroup wpspajson
+ * \param self (out caller-allocates): the cursor to initialize
+ * \param data the JSON data
+ * \param size the size of \a data
+ * \since 0.5.16
+ */
+void
+wp_spa_json_cursor_init (WpSpaJsonCursor *self, const gchar *data,
+    gsize size)
+{
+  WpSpaJsonCursorReal *real = (WpSpaJsonCursorReal *) self;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (data != NULL);
+
+  spa_json_init (&real->data[0], data, size);
+  real->pos = &real->data[0];
+
+  if (spa_json_is_object (data, size)) {
+    if (spa_json_enter_object (&real->data[0], &real->data[1]) > 0)
+      real->pos = &real->data[1];
+  } else if (spa_json_is_array (data, size)) {
+    if (spa_json_enter_array (&real->data[0], &real->data[1]) > 0)
+      real->pos = &real->data[1];
+  }
+}
+
+static WpSpaJsonTokenType
+wp_spa_json_token_type_of (const gchar *data, int size)
+{
+  if (spa_json_is_object (data, size))
+    return WP_SPA_JSON_TOKEN_TYPE_OBJECT;
+  if (spa_json_is_array (data, size))
+    return WP_SPA_JSON_TOKEN_TYPE_ARRAY;
+  if (spa_json_is_null (data, size))
+    return WP_SPA_JSON_TOKEN_TYPE_NULL;
+  if (spa_json_is_bool (data, size))
+    return WP_SPA_JSON_TOKEN_TYPE_BOOLEAN;
+  if (spa_json_is_int (data, size))
+    return WP_SPA_JSON_TOKEN_TYPE_INT;
+  if (spa_json_is_float (data, size))
+    return WP_SPA_JSON_TOKEN_TYPE_FLOAT;
+  return WP_SPA_JSON_TOKEN_TYPE_STRING;
+}
+
+/*!
+ * \brief Advances the cursor to the next value
+ *
+ * \ingroup wpspajson
+ * \param self the cursor
+ * \param token (out caller-allocates)(optional): the location to store the
+ *   value, borrowed from the buffer that is being walked
+ * \returns TRUE if there was a value, FALSE at the end of the data or if the
+ *   data is malformed
+ * \since 0.5.16
+ */
+gboolean
+wp_spa_json_cursor_next (WpSpaJsonCursor *self, WpSpaJsonToken *token)
+{
+  WpSpaJsonCursorReal *real = (WpSpaJsonCursorReal *) self;
+  const gchar *data = NULL;
+  int size, nested_size;
+
+  g_return_val_if_fail (self != NULL, FALSE);
+
+  size = spa_json_next (real->pos, &data);
+  if (size <= 0 || !data)
+    return FALSE;
+
+  /* if array or object, add the nested size */
+  nested_size = check_nested_size (real->pos, data, size);
+  if (nested_size < 0)
+    return FALSE;
+  size += nested_size;
+
+  if (token) {
+    token->data = data;
+    token->size = size;
+    token->type = wp_spa_json_token_type_of (data, size);
+  }
+  return TRUE;
+}
+
+/*!
+ * \brief Checks if a token is a string that is equal to \a str
+ *
+ * Escape sequences in quoted strings are decoded while comparing, without
+ * allocating a copy of the unescaped string. Bare (unquoted) tokens are
+ * compared as they are, the same way wp_spa_json_parse_string() would
+ * return them.
+ *
+ * \ingroup wpspajson
+ * \param token the token
+ * \param str the string to compare with
+ * \returns TRUE if the token's string value equals \a str
+ * \since 0.5.16
+ */
+gboolean
+wp_spa_json_token_equals_string (const WpSpaJsonToken *token,
+    const gchar *str)
+{
+  const gchar *p, *end;
+
+  g_return_val_if_fail (token != NULL, FALSE);
+  g_return_val_if_fail (str != NULL, FALSE);
+
+  p = token->data;
+  end = token->data + token->size;
+
+  if (token->size < 2 || p[0] != '"' || end[-1] != '"')
+    return strncmp (p, str, token->size) == 0 && str[token->size] == '\0';
+
+  for (p++, end--; p < end; p++) {
+    gchar c = *p;
+
+    if (c == '\\') {
+      if (++p >= end)
+        return FALSE;
+
+      switch (*p) {
+        case 'b': c = '\b'; break;
+        case 'f': c = '\f'; break;
+        case 'n': c = '\n'; break;
+        case 'r': c = '\r'; break;
+        case 't': c = '\t'; break;
+        case 'u': {
+          gunichar cp = 0;
+          gchar utf8[6];
+          gint len;
+
+          if (end - p < 5)
+            return FALSE;
+          for (gint i = 1; i <= 4; i++) {
+            gint v = g_ascii_xdigit_value (p[i]);
+            if (v < 0)
+              return FALSE;
+            cp = (cp << 4) | v;
+          }
+          len = g_unichar_to_utf8 (cp, utf8);
+          if (strncmp (str, utf8, len) != 0)
+            return FALSE;
+          str += len;
+          p += 4;
+          continue;
+        }
+        default: c = *p; break;
+      }
+    }
+
+    if (*str != c)
+      return FALSE;
+    str++;
+  }
+
+  return *str == '\0';
+}
+
+/*!
+ * \brief Parses the boolean value of a token
+ *
+ * \ingroup wpspajson
+ * \param token the token
+ * \param value (out): the boolean value
+ * \returns TRUE if the value was obtained, FALSE otherwise
+ * \since 0.5.16
+ */
+gboolean
+wp_spa_json_token_parse_boolean (const WpSpaJsonToken *token,
+    gboolean *value)
+{
+  g_return_val_if_fail (token != NULL, FALSE);
+  return wp_spa_json_parse_boolean_internal (token->data, token->size, value);
+}
+
+/*!
+ * \brief Parses the int value of a token
+ *
+ * \ingroup wpspajson
+ * \param token the token
+ * \param value (out): the int value
+ * \returns TRUE if the value was obtained, FALSE otherwise
+ * \since 0.5.16
+ */
+gboolean
+wp_spa_json_token_parse_int (const WpSpaJsonToken *token, gint *value)
+{
+  g_return_val_if_fail (token != NULL, FALSE);
+  return spa_json_parse_int (token->data, token->size, value) >= 0;
+}
+
+/*!
+ * \brief Parses the float value of a token
+ *
+ * \ingroup wpspajson
+ * \param token the token
+ * \param value (out): the float value
+ * \returns TRUE if the value was obtained, FALSE otherwise
+ * \since 0.5.16
+ */
+gboolean
+wp_spa_json_token_parse_float (const WpSpaJsonToken *token, float *value)
+{
+  g_return_val_if_fail (token != NULL, FALSE);
+  return spa_json_parse_float (token->data, token->size, value) >= 0;
+}
+
+/*!
+ * \brief Unescapes the string value of a token into a caller-provided buffer
+ *
+ * The unescaped string is never longer than the token, so a buffer of
+ * `token->size + 1` bytes is always big enough.
+ *
+ * \ingroup wpspajson
+ * \param token the token
+ * \param buf (out caller-allocates)(array length=size): the buffer to store
+ *   the NUL-terminated string into
+ * \param size the size of \a buf
+ * \returns TRUE if the string was stored, FALSE if \a buf is too small
+ * \since 0.5.16
+ */
+gboolean
+wp_spa_json_token_parse_string (const WpSpaJsonToken *token, gchar *buf,
+    gsize size)
+{
+  g_return_val_if_fail (token != NULL, FALSE);
+  g_return_val_if_fail (buf != NULL, FALSE);
+
+  if (size <= token->size)
+    return FALSE;
+  return spa_json_parse_stringn (token->data, token->size, buf, size) > 0;
+}
+
+/*
+ * Private API to attach a compiled form of the JSON data to \a self, so that
+ * it is computed only once for JSON objects that are kept around, such as
+ * the configuration sections. The data of a WpSpaJson never changes, so
+ * the compiled data stays valid for as long as \a self is alive.
+ */
+gpointer
+wp_spa_json_get_compiled_data (WpSpaJson *self)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+  return self->compiled;
+}
+
+void
+wp_spa_json_set_compiled_data (WpSpaJson *self, gpointer data,
+    GDestroyNotify destroy)
+{
+  g_return_if_fail (self != NULL);
+
+  if (self->compiled && self->compiled_destroy)
+    self->compiled_destroy (self->compiled);
+  self->compiled = data;
+  self->compiled_destroy = destroy;
+}
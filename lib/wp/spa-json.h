@@ -278,6 +278,89 @@ void wp_spa_json_parser_end (WpSpaJsonParser *self);
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (WpSpaJsonParser, wp_spa_json_parser_unref)
 
+/*!
+ * \brief The type of a token returned by wp_spa_json_cursor_next()
+ * \ingroup wpspajson
+ * \since 0.5.16
+ */
+typedef enum {
+  WP_SPA_JSON_TOKEN_TYPE_INVALID = 0,
+  WP_SPA_JSON_TOKEN_TYPE_NULL,
+  WP_SPA_JSON_TOKEN_TYPE_BOOLEAN,
+  WP_SPA_JSON_TOKEN_TYPE_INT,
+  WP_SPA_JSON_TOKEN_TYPE_FLOAT,
+  /*! a quoted or bare string */
+  WP_SPA_JSON_TOKEN_TYPE_STRING,
+  WP_SPA_JSON_TOKEN_TYPE_ARRAY,
+  WP_SPA_JSON_TOKEN_TYPE_OBJECT,
+} WpSpaJsonTokenType;
+
+/*!
+ * \brief A JSON value, borrowed from the buffer that is being walked by a
+ *   WpSpaJsonCursor
+ * \ingroup wpspajson
+ * \since 0.5.16
+ */
+typedef struct _WpSpaJsonToken WpSpaJsonToken;
+struct _WpSpaJsonToken
+{
+  /*! the start of the value in the buffer; this is not NUL-terminated */
+  const gchar *data;
+  /*! the size of the value, including the children of containers */
+  gsize size;
+  /*! the type of the value */
+  WpSpaJsonTokenType type;
+};
+
+/*!
+ * \brief A stack-allocated cursor that walks the values of a JSON buffer
+ * \ingroup wpspajson
+ * \since 0.5.16
+ */
+typedef struct _WpSpaJsonCursor WpSpaJsonCursor;
+struct _WpSpaJsonCursor
+{
+  /*< private >*/
+  gpointer _wp_reserved[16];
+};
+
+WP_API
+void wp_spa_json_cursor_init (WpSpaJsonCursor *self, const gchar *data,
+    gsize size);
+
+WP_API
+gboolean wp_spa_json_cursor_next (WpSpaJsonCursor *self,
+    WpSpaJsonToken *token);
+
+WP_API
+gboolean wp_spa_json_token_equals_string (const WpSpaJsonToken *token,
+    const gchar *str);
+
+WP_API
+gboolean wp_spa_json_token_parse_boolean (const WpSpaJsonToken *token,
+    gboolean *value);
+
+WP_API
+gboolean wp_spa_json_token_parse_int (const WpSpaJsonToken *token,
+    gint *value);
+
+WP_API
+gboolean wp_spa_json_token_parse_float (const WpSpaJsonToken *token,
+    float *value);
+
+WP_API
+gboolean wp_spa_json_token_parse_string (const WpSpaJsonToken *token,
+    gchar *buf, gsize size);
+
+/* private */
+
+WP_PRIVATE_API
+gpointer wp_spa_json_get_compiled_data (WpSpaJson *self);
+
+WP_PRIVATE_API
+void wp_spa_json_set_compiled_data (WpSpaJson *self, gpointer data,
+    GDestroyNotify destroy);
+
 G_END_DECLS
 
 #endif
@@ -78,17 +78,21 @@ struct _WpSpaPod
   } static_pod;              /* Only used for statically allocated pods */
   WpSpaPodBuilder *builder;  /* Only used for dynamically allocated pods */
   struct spa_pod *pod;
+  struct _WpSpaPodArena *arena;  /* Only used for pods allocated in an arena */
 };
 
 G_DEFINE_BOXED_TYPE (WpSpaPod, wp_spa_pod, wp_spa_pod_ref, wp_spa_pod_unref)
 
 struct _WpSpaPodBuilder
 {
+  grefcount ref;
   struct spa_pod_builder builder;
   struct spa_pod_frame frame;
   WpSpaType type;
   size_t size;
   guint8 *buf;
+  struct _WpSpaPodArena *arena;      /* Only used if allocated in an arena */
+  struct _WpSpaPodArena *buf_arena;  /* Only used if buf is in an arena */
 };
 
 G_DEFINE_BOXED_TYPE (WpSpaPodBuilder, wp_spa_pod_builder,
@@ -105,13 +109,194 @@ struct _WpSpaPodParser
 G_DEFINE_BOXED_TYPE (WpSpaPodParser, wp_spa_pod_parser,
     wp_spa_pod_parser_ref, wp_spa_pod_parser_unref)
 
+/* Scratch arenas: within a wp_spa_pod_arena_push() / wp_spa_pod_arena_pop()
+ * scope, pod wrappers, builders and builder buffers are carved out of fixed
+ * size chunks instead of being allocated one by one. Every allocation keeps a
+ * reference on its chunk, so a chunk is released (or kept for reuse) once the
+ * scope has moved past it and all the pods allocated from it are gone. */
+
+#define WP_SPA_POD_ARENA_CHUNK_SIZE (16 * 1024)
+#define WP_SPA_POD_ARENA_MAX_ALLOC (WP_SPA_POD_ARENA_CHUNK_SIZE / 4)
+
+typedef struct _WpSpaPodArena WpSpaPodArena;
+struct _WpSpaPodArena
+{
+  gint ref;
+  gsize used;
+  guint8 *last;  /* the last allocation, which can grow in place */
+  guint8 *data;
+};
+
+typedef struct _WpSpaPodArenaState WpSpaPodArenaState;
+struct _WpSpaPodArenaState
+{
+  guint depth;
+  WpSpaPodArena *current;  /* the chunk allocations are made from */
+  WpSpaPodArena *spare;    /* an unused chunk, kept for reuse */
+};
+
+static void
+wp_spa_pod_arena_state_free (WpSpaPodArenaState *state)
+{
+  if (state->current && g_atomic_int_dec_and_test (&state->current->ref))
+    g_free (state->current);
+  g_free (state->spare);
+  g_free (state);
+}
+
+static GPrivate arena_state_key =
+    G_PRIVATE_INIT ((GDestroyNotify) wp_spa_pod_arena_state_free);
+
+static WpSpaPodArena *
+wp_spa_pod_arena_new (WpSpaPodArenaState *state)
+{
+  WpSpaPodArena *self = g_steal_pointer (&state->spare);
+
+  if (!self) {
+    self = g_malloc (SPA_ROUND_UP_N (sizeof (WpSpaPodArena), 16) +
+        WP_SPA_POD_ARENA_CHUNK_SIZE);
+    self->data = SPA_PTROFF (self,
+        SPA_ROUND_UP_N (sizeof (WpSpaPodArena), 16), guint8);
+  }
+  self->ref = 1;
+  self->used = 0;
+  self->last = NULL;
+  return self;
+}
+
+static void
+wp_spa_pod_arena_unref (WpSpaPodArena *self)
+{
+  WpSpaPodArenaState *state;
+
+  if (!g_atomic_int_dec_and_test (&self->ref))
+    return;
+
+  /* keep one chunk around, so that the next scope does not allocate */
+  state = g_private_get (&arena_state_key);
+  if (state && !state->spare)
+    state->spare = self;
+  else
+    g_free (self);
+}
+
+/* Returns NULL if there is no active scope or if the allocation is too big;
+ * otherwise the returned memory holds a reference on the returned arena */
+static gpointer
+wp_spa_pod_arena_alloc (gsize size, WpSpaPodArena **arena)
+{
+  WpSpaPodArenaState *state = g_private_get (&arena_state_key);
+  WpSpaPodArena *a;
+  gpointer ret;
+
+  *arena = NULL;
+  if (!state || state->depth == 0 || size > WP_SPA_POD_ARENA_MAX_ALLOC)
+    return NULL;
+
+  size = SPA_ROUND_UP_N (size, 8);
+  a = state->current;
+  if (!a || a->used + size > WP_SPA_POD_ARENA_CHUNK_SIZE) {
+    g_clear_pointer (&state->current, wp_spa_pod_arena_unref);
+    a = state->current = wp_spa_pod_arena_new (state);
+  }
+
+  ret = a->data + a->used;
+  a->last = ret;
+  a->used += size;
+  g_atomic_int_inc (&a->ref);
+  *arena = a;
+  return ret;
+}
+
+/* Grows the last allocation of the current chunk of this thread in place */
+static gboolean
+wp_spa_pod_arena_grow (WpSpaPodArena *self, gpointer ptr, gsize new_size)
+{
+  WpSpaPodArenaState *state = g_private_get (&arena_state_key);
+  gsize offset = (guint8 *) ptr - self->data;
+
+  if (!state || state->current != self || self->last != ptr)
+    return FALSE;
+
+  new_size = SPA_ROUND_UP_N (new_size, 8);
+  if (offset + new_size > WP_SPA_POD_ARENA_CHUNK_SIZE)
+    return FALSE;
+
+  self->used = offset + new_size;
+  return TRUE;
+}
+
+/*!
+ * \brief Starts a scratch allocation scope for spa pods on the calling thread
+ *
+ * Until the matching wp_spa_pod_arena_pop(), the WpSpaPod and WpSpaPodBuilder
+ * objects created on this thread, including the pods returned by accessors
+ * and iterators, are allocated from a shared memory region instead of
+ * individually. The memory of the region is released at once, when the scope
+ * has ended and none of the pods allocated from it are referenced anymore.
+ *
+ * This is meant for code that creates many short-lived pods, like building a
+ * param that is sent right away or parsing values out of one. A scope should
+ * not wrap code that may keep pods, like callbacks of other components: every
+ * pod that is kept keeps its whole region alive. Pods that need to be kept
+ * should be copied with wp_spa_pod_copy() outside of a scope. Scopes can be
+ * nested.
+ *
+ * \ingroup wpspapod
+ * \since 0.5.16
+ */
+void
+wp_spa_pod_arena_push (void)
+{
+  WpSpaPodArenaState *state = g_private_get (&arena_state_key);
+
+  if (!state) {
+    state = g_new0 (WpSpaPodArenaState, 1);
+    g_private_set (&arena_state_key, state);
+  }
+  state->depth++;
+}
+
+/*!
+ * \brief Ends a scratch allocation scope started with wp_spa_pod_arena_push()
+ *
+ * \ingroup wpspapod
+ * \since 0.5.16
+ */
+void
+wp_spa_pod_arena_pop (void)
+{
+  WpSpaPodArenaState *state = g_private_get (&arena_state_key);
+
+  g_return_if_fail (state && state->depth > 0);
+
+  if (--state->depth == 0)
+    g_clear_pointer (&state->current, wp_spa_pod_arena_unref);
+}
+
 static int
 wp_spa_pod_builder_overflow (gpointer data, uint32_t size)
 {
   WpSpaPodBuilder *self = data;
-  const uint32_t next_size = self->size + WP_SPA_POD_BUILDER_REALLOC_STEP_SIZE;
+  const uint32_t next_size = MAX (self->size * 2,
+      self->size + WP_SPA_POD_BUILDER_REALLOC_STEP_SIZE);
   const uint32_t new_size = size > next_size ? size : next_size;
-  self->buf = g_realloc (self->buf, new_size);
+
+  if (self->buf_arena) {
+    /* grow in place if possible, otherwise move to a new allocation */
+    if (!wp_spa_pod_arena_grow (self->buf_arena, self->buf, new_size)) {
+      WpSpaPodArena *arena = NULL;
+      guint8 *buf = wp_spa_pod_arena_alloc (new_size, &arena);
+      if (!buf)
+        buf = g_malloc (new_size);
+      memcpy (buf, self->buf, self->size);
+      wp_spa_pod_arena_unref (self->buf_arena);
+      self->buf = buf;
+      self->buf_arena = arena;
+    }
+  } else {
+    self->buf = g_realloc (self->buf, new_size);
+  }
   self->builder.data = self->buf;
   self->builder.size = new_size;
   self->size = new_size;
@@ -126,9 +311,23 @@ static const struct spa_pod_builder_callbacks builder_callbacks = {
 static WpSpaPodBuilder *
 wp_spa_pod_builder_new (size_t size, WpSpaType type)
 {
-  WpSpaPodBuilder *self = g_rc_box_new0 (WpSpaPodBuilder);
+  WpSpaPodArena *arena = NULL;
+  WpSpaPodBuilder *self = wp_spa_pod_arena_alloc (sizeof (*self), &arena);
+
+  if (self) {
+    memset (self, 0, sizeof (*self));
+    self->arena = arena;
+  } else {
+    self = g_new0 (WpSpaPodBuilder, 1);
+  }
+  g_ref_count_init (&self->ref);
+
   self->size = size;
-  self->buf = g_new0 (guint8, self->size);
+  self->buf = wp_spa_pod_arena_alloc (self->size, &self->buf_arena);
+  if (self->buf)
+    memset (self->buf, 0, self->size);
+  else
+    self->buf = g_new0 (guint8, self->size);
   self->builder = SPA_POD_BUILDER_INIT (self->buf, self->size);
   self->type = type;
 
@@ -155,7 +354,26 @@ wp_spa_pod_free (WpSpaPod *self)
 {
   g_clear_pointer (&self->builder, wp_spa_pod_builder_unref);
   self->pod = NULL;
-  g_slice_free (WpSpaPod, self);
+  if (self->arena)
+    wp_spa_pod_arena_unref (self->arena);
+  else
+    g_slice_free (WpSpaPod, self);
+}
+
+static WpSpaPod *
+wp_spa_pod_alloc (void)
+{
+  WpSpaPodArena *arena = NULL;
+  WpSpaPod *self = wp_spa_pod_arena_alloc (sizeof (*self), &arena);
+
+  if (self) {
+    memset (self, 0, sizeof (*self));
+    self->arena = arena;
+  } else {
+    self = g_slice_new0 (WpSpaPod);
+  }
+  g_ref_count_init (&self->ref);
+  return self;
 }
 
 /*!
@@ -174,8 +392,7 @@ wp_spa_pod_unref (WpSpaPod *self)
 static WpSpaPod *
 wp_spa_pod_new (const struct spa_pod *pod, WpSpaPodType type, guint32 flags)
 {
-  WpSpaPod *self = g_slice_new0 (WpSpaPod);
-  g_ref_count_init (&self->ref);
+  WpSpaPod *self = wp_spa_pod_alloc ();
   self->flags = flags;
   self->type = type;
 
@@ -432,8 +649,7 @@ wp_spa_pod_ensure_unique_owner (WpSpaPod *self)
 WpSpaPod *
 wp_spa_pod_new_none (void)
 {
-  WpSpaPod *self = g_slice_new0 (WpSpaPod);
-  g_ref_count_init (&self->ref);
+  WpSpaPod *self = wp_spa_pod_alloc ();
   self->type = WP_SPA_POD_REGULAR;
   self->static_pod.pod_none = SPA_POD_INIT_None();
   self->pod = &self->static_pod.pod_none;
@@ -450,8 +666,7 @@ wp_spa_pod_new_none (void)
 WpSpaPod *
 wp_spa_pod_new_boolean (gboolean value)
 {
-  WpSpaPod *self = g_slice_new0 (WpSpaPod);
-  g_ref_count_init (&self->ref);
+  WpSpaPod *self = wp_spa_pod_alloc ();
   self->type = WP_SPA_POD_REGULAR;
   self->static_pod.pod_bool = SPA_POD_INIT_Bool (value ? true : false);
   self->pod = &self->static_pod.pod_bool.pod;
@@ -468,8 +683,7 @@ wp_spa_pod_new_boolean (gboolean value)
 WpSpaPod *
 wp_spa_pod_new_id (guint32 value)
 {
-  WpSpaPod *self = g_slice_new0 (WpSpaPod);
-  g_ref_count_init (&self->ref);
+  WpSpaPod *self = wp_spa_pod_alloc ();
   self->type = WP_SPA_POD_REGULAR;
   self->static_pod.pod_id = SPA_POD_INIT_Id (value);
   self->pod = &self->static_pod.pod_id.pod;
@@ -486,8 +700,7 @@ wp_spa_pod_new_id (guint32 value)
 WpSpaPod *
 wp_spa_pod_new_int (gint32 value)
 {
-  WpSpaPod *self = g_slice_new0 (WpSpaPod);
-  g_ref_count_init (&self->ref);
+  WpSpaPod *self = wp_spa_pod_alloc ();
   self->type = WP_SPA_POD_REGULAR;
   self->static_pod.pod_int = SPA_POD_INIT_Int (value);
   self->pod = &self->static_pod.pod_int.pod;
@@ -504,8 +717,7 @@ wp_spa_pod_new_int (gint32 value)
 WpSpaPod *
 wp_spa_pod_new_long (gint64 value)
 {
-  WpSpaPod *self = g_slice_new0 (WpSpaPod);
-  g_ref_count_init (&self->ref);
+  WpSpaPod *self = wp_spa_pod_alloc ();
   self->type = WP_SPA_POD_REGULAR;
   self->static_pod.pod_long = SPA_POD_INIT_Long (value);
   self->pod = &self->static_pod.pod_long.pod;
@@ -522,8 +734,7 @@ wp_spa_pod_new_long (gint64 value)
 WpSpaPod *
 wp_spa_pod_new_float (float value)
 {
-  WpSpaPod *self = g_slice_new0 (WpSpaPod);
-  g_ref_count_init (&self->ref);
+  WpSpaPod *self = wp_spa_pod_alloc ();
   self->type = WP_SPA_POD_REGULAR;
   self->static_pod.pod_float = SPA_POD_INIT_Float (value);
   self->pod = &self->static_pod.pod_float.pod;
@@ -540,8 +751,7 @@ wp_spa_pod_new_float (float value)
 WpSpaPod *
 wp_spa_pod_new_double (double value)
 {
-  WpSpaPod *self = g_slice_new0 (WpSpaPod);
-  g_ref_count_init (&self->ref);
+  WpSpaPod *self = wp_spa_pod_alloc ();
   self->type = WP_SPA_POD_REGULAR;
   self->static_pod.pod_double = SPA_POD_INIT_Double (value);
   self->pod = &self->static_pod.pod_double.pod;
@@ -560,8 +770,7 @@ wp_spa_pod_new_string (const char *value)
 {
   const uint32_t len = value ? strlen (value) : 0;
   const char *str = value ? value : "";
-  WpSpaPod *self = g_slice_new0 (WpSpaPod);
-  g_ref_count_init (&self->ref);
+  WpSpaPod *self = wp_spa_pod_alloc ();
   self->type = WP_SPA_POD_REGULAR;
 
   struct spa_pod_string p = SPA_POD_INIT_String (len + 1);
@@ -586,8 +795,7 @@ wp_spa_pod_new_string (const char *value)
 WpSpaPod *
 wp_spa_pod_new_bytes (gconstpointer value, guint32 len)
 {
-  WpSpaPod *self = g_slice_new0 (WpSpaPod);
-  g_ref_count_init (&self->ref);
+  WpSpaPod *self = wp_spa_pod_alloc ();
   self->type = WP_SPA_POD_REGULAR;
   const struct spa_pod_bytes p = SPA_POD_INIT_Bytes (len);
   self->builder = wp_spa_pod_builder_new (
@@ -615,8 +823,7 @@ wp_spa_pod_new_pointer (const char *type_name, gconstpointer value)
   WpSpaType type = wp_spa_type_from_name (type_name);
   g_return_val_if_fail (type != WP_SPA_TYPE_INVALID, NULL);
 
-  WpSpaPod *self = g_slice_new0 (WpSpaPod);
-  g_ref_count_init (&self->ref);
+  WpSpaPod *self = wp_spa_pod_alloc ();
   self->type = WP_SPA_POD_REGULAR;
   self->static_pod.pod_pointer = SPA_POD_INIT_Pointer (type, value);
   self->pod = &self->static_pod.pod_pointer.pod;
@@ -633,8 +840,7 @@ wp_spa_pod_new_pointer (const char *type_name, gconstpointer value)
 WpSpaPod *
 wp_spa_pod_new_fd (gint64 value)
 {
-  WpSpaPod *self = g_slice_new0 (WpSpaPod);
-  g_ref_count_init (&self->ref);
+  WpSpaPod *self = wp_spa_pod_alloc ();
   self->type = WP_SPA_POD_REGULAR;
   self->static_pod.pod_fd = SPA_POD_INIT_Fd (value);
   self->pod = &self->static_pod.pod_fd.pod;
@@ -652,8 +858,7 @@ wp_spa_pod_new_fd (gint64 value)
 WpSpaPod *
 wp_spa_pod_new_rectangle (guint32 width, guint32 height)
 {
-  WpSpaPod *self = g_slice_new0 (WpSpaPod);
-  g_ref_count_init (&self->ref);
+  WpSpaPod *self = wp_spa_pod_alloc ();
   self->type = WP_SPA_POD_REGULAR;
   self->static_pod.pod_rectangle =
       SPA_POD_INIT_Rectangle (SPA_RECTANGLE (width, height));
@@ -672,8 +877,7 @@ wp_spa_pod_new_rectangle (guint32 width, guint32 height)
 WpSpaPod *
 wp_spa_pod_new_fraction (guint32 num, guint32 denom)
 {
-  WpSpaPod *self = g_slice_new0 (WpSpaPod);
-  g_ref_count_init (&self->ref);
+  WpSpaPod *self = wp_spa_pod_alloc ();
   self->type = WP_SPA_POD_REGULAR;
   self->static_pod.pod_fraction =
       SPA_POD_INIT_Fraction (SPA_FRACTION (num, denom));
@@ -1798,6 +2002,109 @@ wp_spa_pod_get_array_child (WpSpaPod *self)
   return wp_spa_pod_new_wrap (SPA_POD_ARRAY_CHILD (self->pod));
 }
 
+static const struct spa_pod *
+lookup_path_segment (const struct spa_pod *pod, const gchar *segment)
+{
+  if (spa_pod_is_object (pod)) {
+    const struct spa_pod_object *obj = (const struct spa_pod_object *) pod;
+    const struct spa_pod_prop *prop;
+    guint key;
+
+    if (g_str_has_prefix (segment, "id-")) {
+      if (sscanf (segment, "id-%08x", &key) != 1)
+        return NULL;
+    } else {
+      WpSpaIdTable table = wp_spa_type_get_values_table (obj->body.type);
+      WpSpaIdValue id =
+          wp_spa_id_table_find_value_from_short_name (table, segment);
+      if (!id)
+        return NULL;
+      key = wp_spa_id_value_number (id);
+    }
+
+    prop = spa_pod_object_find_prop (obj, NULL, key);
+    return prop ? &prop->value : NULL;
+  }
+  else if (spa_pod_is_struct (pod)) {
+    const struct spa_pod *child;
+    gchar *end = NULL;
+    guint64 index = g_ascii_strtoull (segment, &end, 10);
+
+    if (end == segment || *end != '\0')
+      return NULL;
+
+    SPA_POD_STRUCT_FOREACH (pod, child) {
+      if (index-- == 0)
+        return child;
+    }
+  }
+  return NULL;
+}
+
+/*!
+ * \brief Looks up a value nested inside a spa pod
+ *
+ * The \a path is a list of segments separated by '/'. On objects, a segment
+ * is the short name of a property (or "id-%08x" for properties with no name);
+ * on structs, it is the 0-based index of a field. For example, the volumes
+ * of a Route param can be found with the "props/channelVolumes" path.
+ *
+ * No data is copied; the returned pod points inside the memory of \a self.
+ * If \a self owns that memory, because it was built or copied (for example
+ * with wp_spa_pod_copy()), or it was itself returned by this function on such
+ * a pod, the returned pod keeps the memory alive and remains valid after
+ * \a self is unreferenced. Otherwise, like for pods created with
+ * wp_spa_pod_new_wrap() or returned by accessors and iterators, the returned
+ * pod is only valid as long as the memory that \a self wraps.
+ *
+ * \ingroup wpspapod
+ * \param self a spa pod object or struct
+ * \param path the path of the value to look up
+ * \returns (transfer full) (nullable): the value at \a path, or NULL if
+ *   the path does not exist in \a self
+ * \since 0.5.16
+ */
+WpSpaPod *
+wp_spa_pod_lookup_path (WpSpaPod *self, const gchar *path)
+{
+  const struct spa_pod *pod;
+  WpSpaPod *ret;
+
+  g_return_val_if_fail (self, NULL);
+  g_return_val_if_fail (path, NULL);
+
+  pod = self->pod;
+  while (pod && *path) {
+    gchar segment[64];
+    gsize len = strcspn (path, "/");
+
+    if (len >= sizeof (segment))
+      return NULL;
+    if (len > 0) {
+      memcpy (segment, path, len);
+      segment[len] = '\0';
+      pod = lookup_path_segment (pod, segment);
+    }
+    path += len;
+    if (*path == '/')
+      path++;
+  }
+
+  if (!pod)
+    return NULL;
+  if (pod == self->pod)
+    return wp_spa_pod_ref (self);
+
+  ret = (self->flags & FLAG_CONSTANT) ?
+      wp_spa_pod_new_wrap_const (pod) :
+      wp_spa_pod_new_wrap ((struct spa_pod *) pod);
+  /* keep the memory alive if self owns it; wrapped memory has no owner that
+     could be referenced */
+  if (self->builder)
+    ret->builder = wp_spa_pod_builder_ref (self->builder);
+  return ret;
+}
+
 /*!
  * \brief Fixates choices in an object pod so that they only have one value
  *
@@ -1862,13 +2169,23 @@ wp_spa_pod_filter (WpSpaPod *self, WpSpaPod *filter)
 WpSpaPodBuilder *
 wp_spa_pod_builder_ref (WpSpaPodBuilder *self)
 {
-  return (WpSpaPodBuilder *) g_rc_box_acquire ((gpointer) self);
+  g_ref_count_inc (&self->ref);
+  return self;
 }
 
 static void
 wp_spa_pod_builder_free (WpSpaPodBuilder *self)
 {
-  g_clear_pointer (&self->buf, g_free);
+  if (self->buf_arena)
+    wp_spa_pod_arena_unref (self->buf_arena);
+  else
+    g_free (self->buf);
+  self->buf = NULL;
+
+  if (self->arena)
+    wp_spa_pod_arena_unref (self->arena);
+  else
+    g_free (self);
 }
 
 /*!
@@ -1881,7 +2198,8 @@ wp_spa_pod_builder_free (WpSpaPodBuilder *self)
 void
 wp_spa_pod_builder_unref (WpSpaPodBuilder *self)
 {
-  g_rc_box_release_full (self, (GDestroyNotify) wp_spa_pod_builder_free);
+  if (g_ref_count_dec (&self->ref))
+    wp_spa_pod_builder_free (self);
 }
 
 /*!
@@ -2366,8 +2684,7 @@ wp_spa_pod_builder_end (WpSpaPodBuilder *self)
   WpSpaPod *ret = NULL;
 
   /* Construct the pod */
-  ret = g_slice_new0 (WpSpaPod);
-  g_ref_count_init (&ret->ref);
+  ret = wp_spa_pod_alloc ();
   ret->type = WP_SPA_POD_REGULAR;
   ret->pod = spa_pod_builder_pop (&self->builder, &self->frame);
   ret->builder = wp_spa_pod_builder_ref (self);
@@ -35,6 +35,12 @@ WpSpaPod *wp_spa_pod_ref (WpSpaPod *self);
 WP_API
 void wp_spa_pod_unref (WpSpaPod *self);
 
+WP_API
+void wp_spa_pod_arena_push (void);
+
+WP_API
+void wp_spa_pod_arena_pop (void);
+
 WP_API
 WpSpaPod * wp_spa_pod_new_wrap (struct spa_pod *pod);
 
@@ -283,6 +289,9 @@ WpSpaPod *wp_spa_pod_get_choice_child (WpSpaPod *self);
 WP_API
 WpSpaPod *wp_spa_pod_get_array_child (WpSpaPod *self);
 
+WP_API
+WpSpaPod *wp_spa_pod_lookup_path (WpSpaPod *self, const gchar *path);
+
 WP_API
 WpIterator *wp_spa_pod_new_iterator (WpSpaPod *pod);
 
@@ -8,6 +8,9 @@
 
 #include <stdio.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "log.h"
 #include "state.h"
@@ -110,6 +113,758 @@ compress_string (const gchar *str)
   return res;
 }
 
+/*
+ * State files are written by a worker thread, so that saving never blocks
+ * the main loop. Every state has a keyfile, which holds a full snapshot,
+ * and a journal (the keyfile's location + ".journal"), to which only the
+ * changed keys are appended. When the journal grows larger than the state
+ * itself, the next save compacts it back into the keyfile.
+ *
+ * The journal looks like this:
+ *
+ *   @<epoch>
+ *   +<key>\t<value>
+ *   -<key>
+ *   .
+ *
+ * Keys and values are escaped with g_strescape(). Each save appends one
+ * batch of changes, terminated by a "." line; incomplete batches, left by a
+ * crash in the middle of a write, are ignored when loading. The epoch is
+ * also written in the first line of the keyfile and is incremented on every
+ * compaction, so that a journal that refers to an older keyfile is never
+ * replayed on top of a newer one.
+ *
+ * With WP_STATE_FORMAT_BINARY, the keyfile is replaced by a binary file
+ * (the keyfile's location + ".bin"), which is memory-mapped for reading.
+ * It consists of a StateBinaryHeader, followed by a table of
+ * StateBinaryEntry, sorted by key, followed by the NUL-terminated keys and
+ * values that the entries point to. All integers are little-endian and
+ * everything after the header is protected by a CRC-32.
+ *
+ * The binary file only makes loading cheaper: it needs no parsing and no
+ * unescaping, but all the entries are still copied into a WpProperties.
+ *
+ * A state that is found on disk only in the other format is migrated when
+ * it is loaded. The file in the other format is not removed, but it is not
+ * updated anymore either.
+ */
+
+#define JOURNAL_SUFFIX ".journal"
+#define JOURNAL_MIN_COMPACT_ENTRIES 64
+#define EPOCH_COMMENT "# journal-epoch="
+
+#define BINARY_SUFFIX ".bin"
+#define BINARY_MAGIC "WPST"
+#define BINARY_VERSION 1
+
+typedef struct {
+  gchar magic[4];
+  guint32 version;
+  guint64 epoch;
+  guint32 n_entries;
+  guint32 data_size;   /* size of everything after the header */
+  guint32 crc;         /* CRC-32 of everything after the header */
+  guint32 reserved;
+} StateBinaryHeader;
+
+typedef struct {
+  guint32 key;    /* offsets in the strings area */
+  guint32 value;
+} StateBinaryEntry;
+
+G_STATIC_ASSERT (sizeof (StateBinaryHeader) == 32);
+G_STATIC_ASSERT (sizeof (StateBinaryEntry) == 8);
+
+typedef struct _WpStateWriter WpStateWriter;
+struct _WpStateWriter
+{
+  gchar *name;
+  WpStateFormat format;
+  gchar *location;
+  gchar *journal_location;
+  gchar *alt_location;  /* where the state is stored in the other format */
+  gchar *alt_journal_location;
+
+  /* io_lock protects the files and the fields below */
+  GMutex io_lock;
+  GCond io_cond;
+  guint n_jobs;
+  guint64 epoch;
+
+  /* main thread only */
+  GHashTable *saved;  /* key -> value, as it will be once n_jobs is 0 */
+  WpProperties *queued_props;
+  gboolean in_flight;
+  guint journal_entries;
+};
+
+typedef struct {
+  WpStateWriter *writer;
+  WpProperties *full;  /* if set, rewrite the keyfile instead of appending */
+  GString *batch;
+} StateJob;
+
+static void
+state_writer_clear_func (WpStateWriter * self)
+{
+  g_clear_pointer (&self->name, g_free);
+  g_clear_pointer (&self->location, g_free);
+  g_clear_pointer (&self->journal_location, g_free);
+  g_clear_pointer (&self->alt_location, g_free);
+  g_clear_pointer (&self->alt_journal_location, g_free);
+  g_clear_pointer (&self->saved, g_hash_table_unref);
+  g_clear_pointer (&self->queued_props, wp_properties_unref);
+  g_mutex_clear (&self->io_lock);
+  g_cond_clear (&self->io_cond);
+}
+
+/* @keyfile_location is where the state is stored in the keyfile format */
+static WpStateWriter *
+state_writer_new (const gchar *name, const gchar *keyfile_location,
+    WpStateFormat format)
+{
+  WpStateWriter *self = g_atomic_rc_box_new0 (WpStateWriter);
+  g_autofree gchar *binary_location =
+      g_strconcat (keyfile_location, BINARY_SUFFIX, NULL);
+
+  self->name = g_strdup (name);
+  self->format = format;
+  if (format == WP_STATE_FORMAT_BINARY) {
+    self->location = g_steal_pointer (&binary_location);
+    self->alt_location = g_strdup (keyfile_location);
+  } else {
+    self->location = g_strdup (keyfile_location);
+    self->alt_location = g_steal_pointer (&binary_location);
+  }
+  self->journal_location = g_strconcat (self->location, JOURNAL_SUFFIX, NULL);
+  self->alt_journal_location =
+      g_strconcat (self->alt_location, JOURNAL_SUFFIX, NULL);
+  g_mutex_init (&self->io_lock);
+  g_cond_init (&self->io_cond);
+  return self;
+}
+
+static WpStateWriter *
+state_writer_ref (WpStateWriter * self)
+{
+  return g_atomic_rc_box_acquire (self);
+}
+
+static void
+state_writer_unref (WpStateWriter * self)
+{
+  g_atomic_rc_box_release_full (self,
+      (GDestroyNotify) state_writer_clear_func);
+}
+
+static void
+state_job_free (StateJob * job)
+{
+  g_clear_pointer (&job->writer, state_writer_unref);
+  g_clear_pointer (&job->full, wp_properties_unref);
+  if (job->batch)
+    g_string_free (job->batch, TRUE);
+  g_slice_free (StateJob, job);
+}
+
+/* must be called with io_lock held; waits until no job is running */
+static void
+state_writer_wait_locked (WpStateWriter * self)
+{
+  while (self->n_jobs > 0)
+    g_cond_wait (&self->io_cond, &self->io_lock);
+}
+
+static GHashTable *
+props_to_hash_table (WpProperties * props)
+{
+  GHashTable *ht = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, g_free);
+  g_autoptr (WpIterator) it = NULL;
+  g_auto (GValue) item = G_VALUE_INIT;
+
+  for (it = wp_properties_new_iterator (props);
+      wp_iterator_next (it, &item);
+      g_value_unset (&item)) {
+    WpPropertiesItem *pi = g_value_get_boxed (&item);
+    g_hash_table_insert (ht, g_strdup (wp_properties_item_get_key (pi)),
+        g_strdup (wp_properties_item_get_value (pi)));
+  }
+  return ht;
+}
+
+static gchar *
+state_keyfile_serialize (const gchar *name, WpProperties *props,
+    guint64 epoch)
+{
+  g_autoptr (GKeyFile) keyfile = g_key_file_new ();
+  g_autoptr (WpIterator) it = NULL;
+  g_auto (GValue) item = G_VALUE_INIT;
+  g_autofree gchar *data = NULL;
+
+  /* Set the properties */
+  for (it = wp_properties_new_iterator (props);
+      wp_iterator_next (it, &item);
+      g_value_unset (&item)) {
+    WpPropertiesItem *pi = g_value_get_boxed (&item);
+    const gchar *key = wp_properties_item_get_key (pi);
+    const gchar *val = wp_properties_item_get_value (pi);
+    g_autofree gchar *escaped_key = escape_string (key);
+    if (escaped_key)
+      g_key_file_set_string (keyfile, name, escaped_key, val);
+  }
+
+  data = g_key_file_to_data (keyfile, NULL, NULL);
+  return g_strdup_printf (EPOCH_COMMENT "%" G_GUINT64_FORMAT "\n%s",
+      epoch, data);
+}
+
+static guint32
+crc32 (const guint8 *data, gsize len)
+{
+  static guint32 table[256];
+  static gsize initialized = 0;
+  guint32 crc = 0xffffffff;
+
+  if (g_once_init_enter (&initialized)) {
+    for (guint32 i = 0; i < 256; i++) {
+      guint32 c = i;
+      for (guint j = 0; j < 8; j++)
+        c = (c & 1) ? (0xedb88320 ^ (c >> 1)) : (c >> 1);
+      table[i] = c;
+    }
+    g_once_init_leave (&initialized, 1);
+  }
+
+  for (gsize i = 0; i < len; i++)
+    crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return crc ^ 0xffffffff;
+}
+
+static gint
+props_item_cmp (gconstpointer a, gconstpointer b)
+{
+  return strcmp (wp_properties_item_get_key (*(WpPropertiesItem **) a),
+      wp_properties_item_get_key (*(WpPropertiesItem **) b));
+}
+
+static GBytes *
+state_binary_serialize (WpProperties *props, guint64 epoch)
+{
+  g_autoptr (GPtrArray) items =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) wp_properties_item_unref);
+  g_autoptr (GByteArray) strings = g_byte_array_new ();
+  g_autoptr (GByteArray) data = g_byte_array_new ();
+  g_autoptr (WpIterator) it = NULL;
+  g_auto (GValue) item = G_VALUE_INIT;
+  StateBinaryHeader header = { 0, };
+
+  for (it = wp_properties_new_iterator (props);
+      wp_iterator_next (it, &item);
+      g_value_unset (&item))
+    g_ptr_array_add (items, g_value_dup_boxed (&item));
+  g_ptr_array_sort (items, props_item_cmp);
+
+  g_byte_array_set_size (data, sizeof (StateBinaryHeader) +
+      items->len * sizeof (StateBinaryEntry));
+
+  for (guint i = 0; i < items->len; i++) {
+    WpPropertiesItem *pi = g_ptr_array_index (items, i);
+    const gchar *key = wp_properties_item_get_key (pi);
+    const gchar *value = wp_properties_item_get_value (pi);
+    StateBinaryEntry entry;
+
+    entry.key = GUINT32_TO_LE (strings->len);
+    g_byte_array_append (strings, (const guint8 *) key, strlen (key) + 1);
+    entry.value = GUINT32_TO_LE (strings->len);
+    g_byte_array_append (strings, (const guint8 *) value, strlen (value) + 1);
+
+    memcpy (data->data + sizeof (StateBinaryHeader) +
+        i * sizeof (StateBinaryEntry), &entry, sizeof (entry));
+  }
+  g_byte_array_append (data, strings->data, strings->len);
+
+  memcpy (header.magic, BINARY_MAGIC, sizeof (header.magic));
+  header.version = GUINT32_TO_LE (BINARY_VERSION);
+  header.epoch = GUINT64_TO_LE (epoch);
+  header.n_entries = GUINT32_TO_LE (items->len);
+  header.data_size = GUINT32_TO_LE (data->len - sizeof (StateBinaryHeader));
+  header.crc = GUINT32_TO_LE (crc32 (data->data + sizeof (StateBinaryHeader),
+      data->len - sizeof (StateBinaryHeader)));
+  memcpy (data->data, &header, sizeof (header));
+
+  return g_byte_array_free_to_bytes (g_steal_pointer (&data));
+}
+
+static gboolean
+write_all (int fd, const gchar *data, gsize len)
+{
+  while (len > 0) {
+    gssize res = write (fd, data, len);
+    if (res < 0) {
+      if (errno == EINTR)
+        continue;
+      return FALSE;
+    }
+    data += res;
+    len -= res;
+  }
+  return TRUE;
+}
+
+/* rewrites the keyfile atomically and drops the journal; io_lock held */
+static gboolean
+state_writer_compact_locked (WpStateWriter * self, WpProperties * props,
+    GError ** error)
+{
+  g_autoptr (GBytes) data = NULL;
+  GError *err = NULL;
+
+  if (self->format == WP_STATE_FORMAT_BINARY) {
+    data = state_binary_serialize (props, self->epoch + 1);
+  } else {
+    gchar *str = state_keyfile_serialize (self->name, props, self->epoch + 1);
+    data = g_bytes_new_take (str, strlen (str));
+  }
+
+  if (!g_file_set_contents (self->location, g_bytes_get_data (data, NULL),
+          g_bytes_get_size (data), &err)) {
+    g_propagate_prefixed_error (error, err, "could not save %s: ",
+        self->name);
+    return FALSE;
+  }
+
+  self->epoch++;
+  if (remove (self->journal_location) < 0 && errno != ENOENT)
+    wp_warning ("failed to remove %s: %s", self->journal_location,
+        g_strerror (errno));
+  return TRUE;
+}
+
+/* appends a batch of changes to the journal; io_lock held */
+static gboolean
+state_writer_append_locked (WpStateWriter * self, GString * batch,
+    GError ** error)
+{
+  g_autoptr (GString) data = g_string_new (NULL);
+  struct stat st;
+  int fd;
+  gboolean ret;
+
+  fd = open (self->journal_location,
+      O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600);
+  if (fd < 0 || fstat (fd, &st) < 0)
+    goto error;
+
+  if (st.st_size == 0)
+    g_string_append_printf (data, "@%" G_GUINT64_FORMAT "\n", self->epoch);
+  g_string_append_len (data, batch->str, batch->len);
+  g_string_append (data, ".\n");
+
+  ret = write_all (fd, data->str, data->len) && fdatasync (fd) == 0;
+  if (!ret)
+    goto error;
+
+  close (fd);
+  return TRUE;
+
+error:
+  g_set_error (error, WP_DOMAIN_LIBRARY, WP_LIBRARY_ERROR_OPERATION_FAILED,
+      "could not save %s: failed to write %s: %s", self->name,
+      self->journal_location, g_strerror (errno));
+  if (fd >= 0)
+    close (fd);
+  return FALSE;
+}
+
+static void
+state_job_run (GTask * task, gpointer source, gpointer data,
+    GCancellable * cancellable)
+{
+  StateJob *job = data;
+  WpStateWriter *self = job->writer;
+  GError *error = NULL;
+  gboolean ret;
+
+  g_mutex_lock (&self->io_lock);
+  if (job->full)
+    ret = state_writer_compact_locked (self, job->full, &error);
+  else
+    ret = state_writer_append_locked (self, job->batch, &error);
+  self->n_jobs--;
+  g_cond_broadcast (&self->io_cond);
+  g_mutex_unlock (&self->io_lock);
+
+  if (ret)
+    g_task_return_boolean (task, TRUE);
+  else
+    g_task_return_error (task, error);
+}
+
+static void state_writer_save_async (WpStateWriter * self,
+    WpProperties * props);
+
+static void
+on_state_job_done (GObject * source, GAsyncResult * res, gpointer data)
+{
+  WpStateWriter *self = data;
+  g_autoptr (GError) error = NULL;
+
+  if (!g_task_propagate_boolean (G_TASK (res), &error)) {
+    wp_warning ("%s", error->message);
+    /* we don't know what is on disk anymore; rewrite everything next time */
+    g_clear_pointer (&self->saved, g_hash_table_unref);
+  }
+
+  self->in_flight = FALSE;
+
+  if (self->queued_props) {
+    g_autoptr (WpProperties) props = g_steal_pointer (&self->queued_props);
+    state_writer_save_async (self, props);
+  }
+
+  state_writer_unref (self);
+}
+
+/* appends the differences between self->saved and @current to @batch */
+static guint
+state_writer_diff (WpStateWriter * self, GHashTable * current,
+    GString * batch)
+{
+  GHashTableIter iter;
+  gpointer key, value;
+  guint n_changes = 0;
+
+  g_hash_table_iter_init (&iter, current);
+  while (g_hash_table_iter_next (&iter, &key, &value)) {
+    const gchar *old = g_hash_table_lookup (self->saved, key);
+    if (!old || !g_str_equal (old, value)) {
+      g_autofree gchar *k = g_strescape (key, NULL);
+      g_autofree gchar *v = g_strescape (value, NULL);
+      g_string_append_printf (batch, "+%s\t%s\n", k, v);
+      n_changes++;
+    }
+  }
+
+  g_hash_table_iter_init (&iter, self->saved);
+  while (g_hash_table_iter_next (&iter, &key, NULL)) {
+    if (!g_hash_table_contains (current, key)) {
+      g_autofree gchar *k = g_strescape (key, NULL);
+      g_string_append_printf (batch, "-%s\n", k);
+      n_changes++;
+    }
+  }
+
+  return n_changes;
+}
+
+/* saves @props in a worker thread; only one job per state is in flight,
+   further saves are queued and coalesced until it completes */
+static void
+state_writer_save_async (WpStateWriter * self, WpProperties * props)
+{
+  g_autoptr (GTask) task = NULL;
+  g_autoptr (GHashTable) current = NULL;
+  StateJob *job = NULL;
+  guint n_changes = 0;
+
+  if (self->in_flight) {
+    g_clear_pointer (&self->queued_props, wp_properties_unref);
+    self->queued_props = wp_properties_ref (props);
+    return;
+  }
+
+  current = props_to_hash_table (props);
+  job = g_slice_new0 (StateJob);
+  job->writer = state_writer_ref (self);
+
+  if (self->saved) {
+    job->batch = g_string_new (NULL);
+    n_changes = state_writer_diff (self, current, job->batch);
+    if (n_changes == 0) {
+      state_job_free (job);
+      return;
+    }
+  }
+
+  /* compact when there is no known snapshot on disk, or when replaying the
+     journal would cost more than reading a fresh keyfile */
+  if (!self->saved || self->journal_entries + n_changes >
+          MAX (JOURNAL_MIN_COMPACT_ENTRIES, g_hash_table_size (current))) {
+    job->full = wp_properties_copy (props);
+    self->journal_entries = 0;
+  } else {
+    self->journal_entries += n_changes;
+  }
+
+  wp_debug ("saving %s: %s, %u changes", self->name,
+      job->full ? "compacting" : "journal", n_changes);
+
+  g_clear_pointer (&self->saved, g_hash_table_unref);
+  self->saved = g_steal_pointer (&current);
+  self->in_flight = TRUE;
+
+  g_mutex_lock (&self->io_lock);
+  self->n_jobs++;
+  g_mutex_unlock (&self->io_lock);
+
+  task = g_task_new (NULL, NULL, on_state_job_done, state_writer_ref (self));
+  g_task_set_task_data (task, job, (GDestroyNotify) state_job_free);
+  g_task_run_in_thread (task, state_job_run);
+}
+
+/* saves @props synchronously, after any jobs in flight have finished */
+static gboolean
+state_writer_save (WpStateWriter * self, WpProperties * props,
+    GError ** error)
+{
+  gboolean ret;
+
+  g_mutex_lock (&self->io_lock);
+  state_writer_wait_locked (self);
+  ret = state_writer_compact_locked (self, props, error);
+  g_mutex_unlock (&self->io_lock);
+
+  g_clear_pointer (&self->queued_props, wp_properties_unref);
+  g_clear_pointer (&self->saved, g_hash_table_unref);
+  if (ret)
+    self->saved = props_to_hash_table (props);
+  self->journal_entries = 0;
+
+  return ret;
+}
+
+static void
+state_writer_clear (WpStateWriter * self)
+{
+  g_mutex_lock (&self->io_lock);
+  state_writer_wait_locked (self);
+  if (remove (self->location) < 0)
+    wp_warning ("failed to remove %s: %s", self->location, g_strerror (errno));
+  if (remove (self->journal_location) < 0 && errno != ENOENT)
+    wp_warning ("failed to remove %s: %s", self->journal_location,
+        g_strerror (errno));
+  /* make sure that a state in the other format does not get migrated */
+  remove (self->alt_location);
+  remove (self->alt_journal_location);
+  g_mutex_unlock (&self->io_lock);
+
+  g_clear_pointer (&self->queued_props, wp_properties_unref);
+  g_clear_pointer (&self->saved, g_hash_table_unref);
+  self->journal_entries = 0;
+}
+
+static guint64
+parse_epoch (const gchar *data)
+{
+  if (!g_str_has_prefix (data, EPOCH_COMMENT))
+    return 0;
+  return g_ascii_strtoull (data + strlen (EPOCH_COMMENT), NULL, 10);
+}
+
+/* replays the complete batches of a journal on @props; io_lock held */
+static guint
+state_journal_replay (const gchar *location, guint64 epoch,
+    WpProperties * props)
+{
+  g_autofree gchar *data = NULL;
+  g_auto (GStrv) lines = NULL;
+  g_autoptr (GPtrArray) batch = NULL;
+  guint n_entries = 0;
+
+  if (!g_file_get_contents (location, &data, NULL, NULL))
+    return 0;
+
+  lines = g_strsplit (data, "\n", -1);
+  if (!lines[0] || lines[0][0] != '@' ||
+      g_ascii_strtoull (lines[0] + 1, NULL, 10) != epoch) {
+    /* left over by a crash during compaction; the keyfile is newer */
+    wp_info ("dropping stale journal %s", location);
+    if (remove (location) < 0)
+      wp_warning ("failed to remove %s: %s", location,
+          g_strerror (errno));
+    return 0;
+  }
+
+  /* pairs of (key, value), where value is NULL for removed keys */
+  batch = g_ptr_array_new_with_free_func (g_free);
+
+  /* the last element is either empty or an incomplete line */
+  for (guint i = 1; lines[i] && lines[i + 1]; i++) {
+    const gchar *line = lines[i];
+    const gchar *tab = strchr (line, '\t');
+
+    if (g_str_equal (line, ".")) {
+      for (guint j = 0; j < batch->len; j += 2)
+        wp_properties_set (props, batch->pdata[j], batch->pdata[j + 1]);
+      n_entries += batch->len / 2;
+      g_ptr_array_set_size (batch, 0);
+    } else if (line[0] == '+' && tab) {
+      g_autofree gchar *key = g_strndup (line + 1, tab - line - 1);
+      g_ptr_array_add (batch, g_strcompress (key));
+      g_ptr_array_add (batch, g_strcompress (tab + 1));
+    } else if (line[0] == '-') {
+      g_ptr_array_add (batch, g_strcompress (line + 1));
+      g_ptr_array_add (batch, NULL);
+    } else {
+      wp_warning ("%s: corrupted journal entry, ignoring the rest",
+          location);
+      break;
+    }
+  }
+
+  return n_entries;
+}
+
+static gboolean
+state_keyfile_read (const gchar *name, const gchar *location,
+    WpProperties * props, guint64 * epoch)
+{
+  g_autoptr (GKeyFile) keyfile = g_key_file_new ();
+  g_autofree gchar *data = NULL;
+  gsize len = 0;
+  gchar ** keys = NULL;
+
+  /* Open */
+  if (!g_file_get_contents (location, &data, &len, NULL) ||
+      !g_key_file_load_from_data (keyfile, data, len, G_KEY_FILE_NONE, NULL))
+    return FALSE;
+  *epoch = parse_epoch (data);
+
+  /* Load all keys */
+  keys = g_key_file_get_keys (keyfile, name, NULL, NULL);
+  for (guint i = 0; keys && keys[i]; i++) {
+    g_autofree gchar *compressed_key = NULL;
+    const gchar *key = keys[i];
+    g_autofree gchar *val = NULL;
+    val = g_key_file_get_string (keyfile, name, key, NULL);
+    if (!val)
+      continue;
+    compressed_key = compress_string (key);
+    if (compressed_key)
+      wp_properties_set (props, compressed_key, val);
+  }
+  g_strfreev (keys);
+
+  return TRUE;
+}
+
+static gboolean
+state_binary_read (const gchar *location, WpProperties * props,
+    guint64 * epoch)
+{
+  g_autoptr (GMappedFile) file = NULL;
+  g_autoptr (GError) error = NULL;
+  StateBinaryHeader header;
+  const gchar *data, *strings;
+  gsize size, strings_size;
+  guint32 n_entries;
+
+  file = g_mapped_file_new (location, FALSE, &error);
+  if (!file)
+    return FALSE;
+
+  data = g_mapped_file_get_contents (file);
+  size = g_mapped_file_get_length (file);
+  if (size < sizeof (header))
+    goto corrupted;
+
+  memcpy (&header, data, sizeof (header));
+  n_entries = GUINT32_FROM_LE (header.n_entries);
+  if (memcmp (header.magic, BINARY_MAGIC, 4) != 0 ||
+      GUINT32_FROM_LE (header.version) != BINARY_VERSION ||
+      GUINT32_FROM_LE (header.data_size) != size - sizeof (header) ||
+      n_entries > (size - sizeof (header)) / sizeof (StateBinaryEntry) ||
+      GUINT32_FROM_LE (header.crc) != crc32 ((const guint8 *) data +
+          sizeof (header), size - sizeof (header)))
+    goto corrupted;
+
+  strings = data + sizeof (header) + n_entries * sizeof (StateBinaryEntry);
+  strings_size = data + size - strings;
+
+  for (guint32 i = 0; i < n_entries; i++) {
+    StateBinaryEntry entry;
+    guint32 k, v;
+
+    memcpy (&entry, data + sizeof (header) + i * sizeof (entry),
+        sizeof (entry));
+    k = GUINT32_FROM_LE (entry.key);
+    v = GUINT32_FROM_LE (entry.value);
+    if (k >= strings_size || v >= strings_size ||
+        !memchr (strings + k, '\0', strings_size - k) ||
+        !memchr (strings + v, '\0', strings_size - v))
+      goto corrupted;
+
+    wp_properties_set (props, strings + k, strings + v);
+  }
+
+  *epoch = GUINT64_FROM_LE (header.epoch);
+  return TRUE;
+
+corrupted:
+  wp_notice ("%s: corrupted state file, ignoring", location);
+  return FALSE;
+}
+
+static gboolean
+state_writer_read_locked (WpStateWriter * self, WpStateFormat format,
+    const gchar *location, WpProperties * props, guint64 * epoch)
+{
+  if (format == WP_STATE_FORMAT_BINARY)
+    return state_binary_read (location, props, epoch);
+  else
+    return state_keyfile_read (self->name, location, props, epoch);
+}
+
+static WpProperties *
+state_writer_load (WpStateWriter * self)
+{
+  g_autoptr (WpProperties) props = wp_properties_new_empty ();
+  WpStateFormat alt_format = (self->format == WP_STATE_FORMAT_BINARY) ?
+      WP_STATE_FORMAT_KEYFILE : WP_STATE_FORMAT_BINARY;
+  guint64 alt_epoch = 0;
+  guint n_entries = 0;
+  gboolean on_disk = FALSE;
+
+  g_mutex_lock (&self->io_lock);
+  state_writer_wait_locked (self);
+
+  if (state_writer_read_locked (self, self->format, self->location, props,
+          &self->epoch)) {
+    on_disk = TRUE;
+    /* Apply the changes that were saved after the keyfile */
+    n_entries = state_journal_replay (self->journal_location, self->epoch,
+        props);
+  } else if (!g_file_test (self->location, G_FILE_TEST_EXISTS) &&
+      state_writer_read_locked (self, alt_format, self->alt_location,
+          props, &alt_epoch)) {
+    g_autoptr (GError) error = NULL;
+
+    state_journal_replay (self->alt_journal_location, alt_epoch, props);
+
+    /* the state in the other format is left in place, so that it is still
+       there for older versions and for external tools */
+    wp_info ("migrating state %s to %s", self->name, self->location);
+    if (state_writer_compact_locked (self, props, &error)) {
+      on_disk = TRUE;
+    } else {
+      wp_warning ("%s", error->message);
+    }
+  }
+
+  g_mutex_unlock (&self->io_lock);
+
+  /* if nothing is about to be written, what we loaded is what is on disk;
+     otherwise, the next save has to write a full snapshot */
+  if (on_disk && !self->in_flight && !self->queued_props) {
+    g_clear_pointer (&self->saved, g_hash_table_unref);
+    self->saved = props_to_hash_table (props);
+    self->journal_entries = n_entries;
+  }
+
+  return g_steal_pointer (&props);
+}
+
 /*! \defgroup wpstate WpState */
 /*!
  * \struct WpState
@@ -119,12 +874,15 @@ compress_string (const gchar *str)
  * \gproperties
  * \gproperty{name, gchar *, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY,
  *   The file name where the state will be stored.}
+ * \gproperty{format, WpStateFormat, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY,
+ *   The format of the file where the state will be stored.}
  */
 
 enum {
   PROP_0,
   PROP_NAME,
   PROP_TIMEOUT,
+  PROP_FORMAT,
   N_PROPS,
 };
 
@@ -135,8 +893,10 @@ struct _WpState
   /* Props */
   gchar *name;
   guint timeout;
+  WpStateFormat format;
 
   gchar *location;
+  WpStateWriter *writer;
   GSource *timeout_source;
   WpProperties *timeout_props;
 };
@@ -177,9 +937,11 @@ get_new_location (const char *name)
 static void
 wp_state_ensure_location (WpState *self)
 {
-  if (!self->location)
-    self->location = get_new_location (self->name);
-  g_return_if_fail (self->location);
+  if (!self->writer) {
+    g_autofree gchar *location = get_new_location (self->name);
+    self->writer = state_writer_new (self->name, location, self->format);
+    self->location = g_strdup (self->writer->location);
+  }
 }
 
 static void
@@ -196,6 +958,9 @@ wp_state_set_property (GObject * object, guint property_id,
   case PROP_TIMEOUT:
     self->timeout = g_value_get_uint (value);
     break;
+  case PROP_FORMAT:
+    self->format = g_value_get_enum (value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -215,6 +980,9 @@ wp_state_get_property (GObject * object, guint property_id, GValue * value,
   case PROP_TIMEOUT:
     g_value_set_uint (value, self->timeout);
     break;
+  case PROP_FORMAT:
+    g_value_set_enum (value, self->format);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -228,6 +996,7 @@ wp_state_finalize (GObject * object)
 
   g_clear_pointer (&self->name, g_free);
   g_clear_pointer (&self->location, g_free);
+  g_clear_pointer (&self->writer, state_writer_unref);
   g_clear_pointer (&self->timeout_source, g_source_unref);
   g_clear_pointer (&self->timeout_props, wp_properties_unref);
 
@@ -257,6 +1026,11 @@ wp_state_class_init (WpStateClass * klass)
       "The timeout in milliseconds to save the state", 0, G_MAXUINT,
       DEFAULT_TIMEOUT_MS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+  properties[PROP_FORMAT] = g_param_spec_enum ("format", "format",
+      "The format of the file where the state will be stored",
+      WP_TYPE_STATE_FORMAT, WP_STATE_FORMAT_KEYFILE,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (object_class, N_PROPS, properties);
 }
 
@@ -275,6 +1049,29 @@ wp_state_new (const gchar *name)
       NULL);
 }
 
+/*!
+ * \brief Constructs a new state object that is stored in the given format
+ *
+ * If the state is found on disk only in a different format, it is converted
+ * to \a format the first time it is loaded. The file in the other format is
+ * left in place, but it is not updated afterwards.
+ *
+ * \ingroup wpstate
+ * \param name the state name
+ * \param format the format of the state file
+ * \returns (transfer full): the new WpState
+ * \since 0.5.16
+ */
+WpState *
+wp_state_new_full (const gchar *name, WpStateFormat format)
+{
+  g_return_val_if_fail (name, NULL);
+  return g_object_new (wp_state_get_type (),
+      "name", name,
+      "format", format,
+      NULL);
+}
+
 /*!
  * \brief Gets the name of a state object
  * \ingroup wpstate
@@ -314,41 +1111,7 @@ wp_state_clear (WpState *self)
 {
   g_return_if_fail (WP_IS_STATE (self));
   wp_state_ensure_location (self);
-  if (remove (self->location) < 0)
-    wp_warning ("failed to remove %s: %s", self->location, g_strerror (errno));
-}
-
-static gboolean
-wp_state_save_internal (const gchar *name, const gchar *location,
-    WpProperties *props, GError ** error)
-{
-  g_autoptr (GKeyFile) keyfile = g_key_file_new ();
-  g_autoptr (WpIterator) it = NULL;
-  g_auto (GValue) item = G_VALUE_INIT;
-  GError *err = NULL;
-
-  g_return_val_if_fail (name, FALSE);
-  g_return_val_if_fail (location, FALSE);
-  g_return_val_if_fail (props, FALSE);
-
-  /* Set the properties */
-  for (it = wp_properties_new_iterator (props);
-      wp_iterator_next (it, &item);
-      g_value_unset (&item)) {
-    WpPropertiesItem *pi = g_value_get_boxed (&item);
-    const gchar *key = wp_properties_item_get_key (pi);
-    const gchar *val = wp_properties_item_get_value (pi);
-    g_autofree gchar *escaped_key = escape_string (key);
-    if (escaped_key)
-      g_key_file_set_string (keyfile, name, escaped_key, val);
-  }
-
-  if (!g_key_file_save_to_file (keyfile, location, &err)) {
-    g_propagate_prefixed_error (error, err, "could not save %s: ", name);
-    return FALSE;
-  }
-
-  return TRUE;
+  state_writer_clear (self->writer);
 }
 
 /*!
@@ -363,18 +1126,17 @@ gboolean
 wp_state_save (WpState *self, WpProperties *props, GError ** error)
 {
   g_return_val_if_fail (WP_IS_STATE (self), FALSE);
+  g_return_val_if_fail (props, FALSE);
 
   wp_state_ensure_location (self);
-  return wp_state_save_internal (self->name, self->location, props, error);
+  return state_writer_save (self->writer, props, error);
 }
 
 static gboolean
 timeout_save_state_callback (WpState *self)
 {
-  g_autoptr (GError) error = NULL;
-
-  if (!wp_state_save (self, self->timeout_props, &error))
-    wp_warning_object (self, "%s", error->message);
+  wp_state_ensure_location (self);
+  state_writer_save_async (self->writer, self->timeout_props);
 
   g_clear_pointer (&self->timeout_source, g_source_unref);
   g_clear_pointer (&self->timeout_props, wp_properties_unref);
@@ -395,6 +1157,12 @@ timeout_save_state_callback (WpState *self)
  * it will cancel the previous timer and start a new one, resulting in timing
  * out only after the last call.
  *
+ * The state is written by a worker thread, so this never blocks the main
+ * loop. Only the keys that changed since the last save are written, in a
+ * journal that is compacted into the state file when it grows larger than
+ * the state itself. wp_state_load() and wp_state_save() wait for pending
+ * writes to complete.
+ *
  * \ingroup wpstate
  * \param self the state
  * \param core the core, used to add the timeout callback to the main loop
@@ -419,46 +1187,6 @@ wp_state_save_after_timeout (WpState *self, WpCore *core, WpProperties *props)
           G_OBJECT (self)));
 }
 
-static WpProperties *
-wp_state_load_internal (const gchar *name, const gchar *location)
-{
-  g_autoptr (GKeyFile) keyfile = NULL;
-  g_autoptr (WpProperties) props = NULL;
-  gchar ** keys = NULL;
-
-  g_return_val_if_fail (name, NULL);
-  g_return_val_if_fail (location, NULL);
-
-  props = wp_properties_new_empty ();
-
-  /* Open */
-  keyfile = g_key_file_new ();
-  if (!g_key_file_load_from_file (keyfile, location,
-      G_KEY_FILE_NONE, NULL))
-    return g_steal_pointer (&props);
-
-  /* Load all keys */
-  keys = g_key_file_get_keys (keyfile, name, NULL, NULL);
-  if (!keys)
-    return g_steal_pointer (&props);
-
-  for (guint i = 0; keys[i]; i++) {
-    g_autofree gchar *compressed_key = NULL;
-    const gchar *key = keys[i];
-    g_autofree gchar *val = NULL;
-    val = g_key_file_get_string (keyfile, name, key, NULL);
-    if (!val)
-      continue;
-    compressed_key = compress_string (key);
-    if (compressed_key)
-      wp_properties_set (props, compressed_key, val);
-  }
-
-  g_strfreev (keys);
-
-  return g_steal_pointer (&props);
-}
-
 /*!
  * \brief Loads the state data from the file system
  *
@@ -476,7 +1204,7 @@ wp_state_load (WpState *self)
   g_return_val_if_fail (WP_IS_STATE (self), NULL);
 
   wp_state_ensure_location (self);
-  return wp_state_load_internal (self->name, self->location);
+  return state_writer_load (self->writer);
 }
 
 
@@ -489,15 +1217,31 @@ wp_state_load (WpState *self)
  * The WpStateMetadata class saves and loads properties from a file and reflects
  * the state in a metadata object.
  *
+ * Several changes can be grouped with wp_state_metadata_begin() and
+ * wp_state_metadata_commit(). The changes made in between are applied to the
+ * metadata object together when the outermost transaction is committed, and
+ * are saved with a single write.
+ *
  * \gproperties
  * \gproperty{name, gchar *, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY,
  *   The file name where the state will be stored.}
+ * \gproperty{format, WpStateFormat, G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY,
+ *   The format of the file where the state will be stored.}
+ * \gproperty{n-writes, guint64, G_PARAM_READABLE,
+ *   The number of times the state has been written to its file.}
+ * \gproperty{n-coalesced-writes, guint64, G_PARAM_READABLE,
+ *   The number of saves that were avoided: every change that is requested
+ *   would cause a save, but all the changes requested since the last write
+ *   are saved with a single write. It is updated when the state is written.}
  */
 
 enum {
   STATE_METADATA_PROP_0,
   STATE_METADATA_PROP_NAME,
   STATE_METADATA_PROP_TIMEOUT,
+  STATE_METADATA_PROP_FORMAT,
+  STATE_METADATA_PROP_N_WRITES,
+  STATE_METADATA_PROP_N_COALESCED_WRITES,
   STATE_N_PROPS,
 };
 
@@ -510,11 +1254,25 @@ struct _WpStateMetadata
   /* Props */
   gchar *name;
   guint timeout;
+  WpStateFormat format;
 
   gchar *location;
+  WpStateWriter *writer;
   WpProperties *metadata_props;
   WpImplMetadata *metadata;
   GSource *timeout_source;
+
+  /* Transactions */
+  guint transaction_depth;
+  gboolean committing;
+  GHashTable *pending;      /* key -> value, or NULL to unset */
+  GPtrArray *pending_keys;  /* keys of pending, in the order they were set */
+  guint n_pending_changes;  /* changes requested in the current transaction */
+
+  /* Statistics */
+  guint n_unsaved_changes;  /* changes requested since the last write */
+  guint64 n_writes;
+  guint64 n_coalesced_writes;
 };
 
 G_DEFINE_TYPE (WpStateMetadata, wp_state_metadata, WP_TYPE_OBJECT)
@@ -523,6 +1281,9 @@ static void
 wp_state_metadata_init (WpStateMetadata * self)
 {
   self->timeout = DEFAULT_TIMEOUT_MS;
+  self->pending = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+      g_free);
+  self->pending_keys = g_ptr_array_new ();
 }
 
 static void
@@ -539,6 +1300,9 @@ wp_state_metadata_set_property (GObject * object, guint property_id,
   case STATE_METADATA_PROP_TIMEOUT:
     self->timeout = g_value_get_uint (value);
     break;
+  case STATE_METADATA_PROP_FORMAT:
+    self->format = g_value_get_enum (value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -558,6 +1322,15 @@ wp_state_metadata_get_property (GObject * object, guint property_id,
   case STATE_METADATA_PROP_TIMEOUT:
     g_value_set_uint (value, self->timeout);
     break;
+  case STATE_METADATA_PROP_FORMAT:
+    g_value_set_enum (value, self->format);
+    break;
+  case STATE_METADATA_PROP_N_WRITES:
+    g_value_set_uint64 (value, self->n_writes);
+    break;
+  case STATE_METADATA_PROP_N_COALESCED_WRITES:
+    g_value_set_uint64 (value, self->n_coalesced_writes);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
     break;
@@ -588,37 +1361,35 @@ wp_state_metadata_activate_get_next_step (WpObject * object,
 static void
 state_metadata_ensure_location (WpStateMetadata *self)
 {
-  if (!self->location)
-    self->location = get_new_location (self->name);
-  g_return_if_fail (self->location);
+  if (!self->writer) {
+    g_autofree gchar *location = get_new_location (self->name);
+    self->writer = state_writer_new (self->name, location, self->format);
+    self->location = g_strdup (self->writer->location);
+  }
 }
 
 static WpProperties *
 state_metadata_load (WpStateMetadata *self)
 {
   state_metadata_ensure_location (self);
-  return wp_state_load_internal (self->name, self->location);
-}
-
-static gboolean
-state_metadata_save (WpStateMetadata *self, WpProperties *props,
-    GError ** error)
-{
-  state_metadata_ensure_location (self);
-  return wp_state_save_internal (self->name, self->location, props, error);
+  return state_writer_load (self->writer);
 }
 
 static gboolean
 state_metadata_timeout_save_cb (WpStateMetadata *self)
 {
-  g_autoptr (GError) error = NULL;
-
-  if (!state_metadata_save (self, self->metadata_props, &error))
-    wp_warning_object (self, "%s", error->message);
+  state_metadata_ensure_location (self);
+  state_writer_save_async (self->writer, self->metadata_props);
 
   g_clear_pointer (&self->timeout_source, g_source_unref);
 
-  wp_info_object (self, "saved changes on state metadata '%s'", self->name);
+  /* Every requested change would have caused a save of its own */
+  self->n_writes++;
+  if (self->n_unsaved_changes > 1)
+    self->n_coalesced_writes += self->n_unsaved_changes - 1;
+  self->n_unsaved_changes = 0;
+
+  wp_info_object (self, "saving changes on state metadata '%s'", self->name);
   return G_SOURCE_REMOVE;
 }
 
@@ -645,9 +1416,10 @@ state_metadata_clear (WpStateMetadata *self)
   if (self->metadata_props)
     wp_properties_clear (self->metadata_props);
 
+  self->n_unsaved_changes = 0;
+
   state_metadata_ensure_location (self);
-  if (remove (self->location) < 0)
-    wp_warning ("failed to remove %s: %s", self->location, g_strerror (errno));
+  state_writer_clear (self->writer);
 }
 
 static void
@@ -665,7 +1437,12 @@ on_state_metadata_changed (WpMetadata *m, guint32 subject,
     else
       wp_info_object (self, "key removed on state metadata '%s': %s",
           self->name, key);
-    state_metadata_save_after_timeout (self);
+    /* When committing a transaction, the requested changes are counted and
+       the state is saved once all of them are applied */
+    if (!self->committing) {
+      self->n_unsaved_changes++;
+      state_metadata_save_after_timeout (self);
+    }
   } else {
     state_metadata_clear (self);
     wp_info_object (self, "cleared state metadata '%s'", self->name);
@@ -745,6 +1522,12 @@ wp_state_metadata_deactivate (WpObject * object, WpObjectFeatures features)
   g_clear_pointer (&self->metadata_props, wp_properties_unref);
   g_clear_object (&self->metadata);
 
+  /* Uncommitted changes are lost */
+  self->transaction_depth = 0;
+  self->n_pending_changes = 0;
+  g_hash_table_remove_all (self->pending);
+  g_ptr_array_set_size (self->pending_keys, 0);
+
   wp_object_update_features (WP_OBJECT (self), 0, WP_OBJECT_FEATURES_ALL);
 }
 
@@ -755,7 +1538,10 @@ wp_state_metadata_finalize (GObject * object)
 
   g_clear_pointer (&self->name, g_free);
   g_clear_pointer (&self->location, g_free);
+  g_clear_pointer (&self->writer, state_writer_unref);
   g_clear_pointer (&self->timeout_source, g_source_unref);
+  g_clear_pointer (&self->pending, g_hash_table_unref);
+  g_clear_pointer (&self->pending_keys, g_ptr_array_unref);
 
   G_OBJECT_CLASS (wp_state_metadata_parent_class)->finalize (object);
 }
@@ -787,6 +1573,21 @@ wp_state_metadata_class_init (WpStateMetadataClass * klass)
       G_MAXUINT, DEFAULT_TIMEOUT_MS,
       G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS);
 
+  state_properties[STATE_METADATA_PROP_FORMAT] = g_param_spec_enum ("format",
+      "format", "The format of the file where the state metadata will be stored",
+      WP_TYPE_STATE_FORMAT, WP_STATE_FORMAT_KEYFILE,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY | G_PARAM_STATIC_STRINGS);
+
+  state_properties[STATE_METADATA_PROP_N_WRITES] = g_param_spec_uint64 (
+      "n-writes", "n-writes",
+      "The number of times the state metadata has been written", 0,
+      G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
+  state_properties[STATE_METADATA_PROP_N_COALESCED_WRITES] = g_param_spec_uint64 (
+      "n-coalesced-writes", "n-coalesced-writes",
+      "The number of saves that were avoided by saving changes together", 0,
+      G_MAXUINT64, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS);
+
   g_object_class_install_properties (object_class, STATE_N_PROPS, state_properties);
 }
 
@@ -808,6 +1609,30 @@ wp_state_metadata_new (WpCore *core, const gchar *name)
       NULL);
 }
 
+/*!
+ * \brief Constructs a new state metadata object that is stored in the
+ *   given format
+ *
+ * \ingroup wpstatemetadata
+ * \param core the core associated with the state metadata
+ * \param name the state metadata name
+ * \param format the format of the state file
+ * \returns (transfer full): the new WpStateMetadata
+ * \since 0.5.16
+ */
+WpStateMetadata *
+wp_state_metadata_new_full (WpCore *core, const gchar *name,
+    WpStateFormat format)
+{
+  g_return_val_if_fail (core, NULL);
+  g_return_val_if_fail (name, NULL);
+  return g_object_new (wp_state_metadata_get_type (),
+      "core", core,
+      "name", name,
+      "format", format,
+      NULL);
+}
+
 /*!
  * \brief Gets the name of a state metadata object
  * \ingroup wpstatemetadata
@@ -880,6 +1705,14 @@ wp_state_metadata_get (WpStateMetadata *self, const gchar *key)
     return NULL;
 
   g_return_val_if_fail (self->metadata, NULL);
+
+  /* Return the uncommitted value, if any */
+  if (self->transaction_depth > 0) {
+    gpointer value = NULL;
+    if (g_hash_table_lookup_extended (self->pending, key, NULL, &value))
+      return value;
+  }
+
   return wp_metadata_find (WP_METADATA (self->metadata), 0, key, NULL);
 }
 
@@ -889,6 +1722,9 @@ wp_state_metadata_get (WpStateMetadata *self, const gchar *key)
  * If value is NULL, it will unset the given \a key. Note that this will also
  * save the state after the timeout has elapsed.
  *
+ * Inside a transaction, the change is only applied when the transaction is
+ * committed with wp_state_metadata_commit().
+ *
  * If the state metadata has not been loaded, this won't do anything.
  *
  * \ingroup wpstatemetadata
@@ -908,5 +1744,102 @@ wp_state_metadata_set (WpStateMetadata *self, const gchar *key,
     return;
 
   g_return_if_fail (self->metadata);
+
+  if (self->transaction_depth > 0) {
+    self->n_pending_changes++;
+    if (g_hash_table_contains (self->pending, key)) {
+      /* overwritten before being applied; the existing key is kept */
+      g_hash_table_insert (self->pending, g_strdup (key), g_strdup (value));
+    } else {
+      /* the keys in pending_keys are owned by the pending hash table */
+      gchar *k = g_strdup (key);
+      g_ptr_array_add (self->pending_keys, k);
+      g_hash_table_insert (self->pending, k, g_strdup (value));
+    }
+    return;
+  }
+
   wp_metadata_set (WP_METADATA (self->metadata), 0, key, NULL, value);
 }
+
+/*!
+ * \brief Starts a transaction on the state metadata
+ *
+ * Until the matching wp_state_metadata_commit() is called, the changes made
+ * with wp_state_metadata_set() are only recorded; wp_state_metadata_get()
+ * already returns them. Transactions can be nested; the changes are applied
+ * when the outermost transaction is committed.
+ *
+ * If the state metadata has not been loaded, this won't do anything.
+ *
+ * \ingroup wpstatemetadata
+ * \param self the state metadata
+ * \since 0.5.16
+ */
+void
+wp_state_metadata_begin (WpStateMetadata *self)
+{
+  g_return_if_fail (WP_IS_STATE_METADATA (self));
+
+  if (!(wp_object_get_active_features (WP_OBJECT (self)) &
+      WP_STATE_METADATA_LOADED))
+    return;
+
+  self->transaction_depth++;
+}
+
+/*!
+ * \brief Commits a transaction started with wp_state_metadata_begin()
+ *
+ * When the outermost transaction is committed, all the recorded changes are
+ * applied to the metadata object in the order they were first made, and the
+ * state is saved once, after the timeout has elapsed. Changes that would not
+ * modify the stored value are skipped.
+ *
+ * \ingroup wpstatemetadata
+ * \param self the state metadata
+ * \since 0.5.16
+ */
+void
+wp_state_metadata_commit (WpStateMetadata *self)
+{
+  guint n_applied = 0;
+
+  g_return_if_fail (WP_IS_STATE_METADATA (self));
+
+  if (self->transaction_depth == 0)
+    return;
+  if (--self->transaction_depth > 0)
+    return;
+
+  g_return_if_fail (self->metadata);
+
+  self->committing = TRUE;
+
+  for (guint i = 0; i < self->pending_keys->len; i++) {
+    const gchar *key = g_ptr_array_index (self->pending_keys, i);
+    const gchar *value = g_hash_table_lookup (self->pending, key);
+    const gchar *current =
+        wp_metadata_find (WP_METADATA (self->metadata), 0, key, NULL);
+
+    if (g_strcmp0 (current, value) == 0)
+      continue;
+    wp_metadata_set (WP_METADATA (self->metadata), 0, key, NULL, value);
+    n_applied++;
+  }
+
+  self->committing = FALSE;
+  g_ptr_array_set_size (self->pending_keys, 0);
+  g_hash_table_remove_all (self->pending);
+
+  wp_debug_object (self, "committed %u changes on state metadata '%s'",
+      n_applied, self->name);
+
+  /* a transaction that changed nothing does not count towards the next
+     write */
+  if (n_applied > 0) {
+    self->n_unsaved_changes += self->n_pending_changes;
+    state_metadata_save_after_timeout (self);
+  }
+  self->n_pending_changes = 0;
+}
@@ -16,6 +16,18 @@ G_BEGIN_DECLS
 
 /* WpState */
 
+/*!
+ * \brief The formats in which a state can be stored on disk
+ * \ingroup wpstate
+ * \since 0.5.16
+ */
+typedef enum {
+  /*! a text keyfile, which is the default */
+  WP_STATE_FORMAT_KEYFILE = 0,
+  /*! a sorted, CRC-protected binary table that is read without parsing */
+  WP_STATE_FORMAT_BINARY,
+} WpStateFormat;
+
 /*!
  * \brief The WpState GType
  * \ingroup wpstate
@@ -27,6 +39,9 @@ G_DECLARE_FINAL_TYPE (WpState, wp_state, WP, STATE, GObject)
 WP_API
 WpState * wp_state_new (const gchar *name);
 
+WP_API
+WpState * wp_state_new_full (const gchar *name, WpStateFormat format);
+
 WP_API
 const gchar * wp_state_get_name (WpState *self);
 
@@ -70,6 +85,10 @@ G_DECLARE_FINAL_TYPE (WpStateMetadata, wp_state_metadata, WP, STATE_METADATA,
 WP_API
 WpStateMetadata * wp_state_metadata_new (WpCore *core, const gchar *name);
 
+WP_API
+WpStateMetadata * wp_state_metadata_new_full (WpCore *core, const gchar *name,
+    WpStateFormat format);
+
 WP_API
 const gchar * wp_state_metadata_get_name (WpStateMetadata *self);
 
@@ -86,6 +105,12 @@ WP_API
 void wp_state_metadata_set (WpStateMetadata *self, const gchar *key,
     const gchar *value);
 
+WP_API
+void wp_state_metadata_begin (WpStateMetadata *self);
+
+WP_API
+void wp_state_metadata_commit (WpStateMetadata *self);
+
 G_END_DECLS
 
 #endif
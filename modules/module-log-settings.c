@@ -41,6 +41,19 @@ on_metadata_changed (WpMetadata *m, guint32 subject,
 
   if (spa_streq(key, "log.level"))
     wp_log_set_level (value ? value : "2");
+  else if (spa_streq(key, "wireplumber.hooks-stats") && value) {
+    g_autoptr (WpEventDispatcher) dispatcher =
+        wp_event_dispatcher_get_instance (core);
+    g_autoptr (WpSpaJson) stats = wp_event_dispatcher_get_stats (dispatcher);
+    g_autofree gchar *stats_str = wp_spa_json_to_string (stats);
+
+    if (spa_streq(value, "reset"))
+      wp_event_dispatcher_reset_stats (dispatcher);
+
+    /* reply on the same subject; the requester removes both keys */
+    wp_metadata_set (m, subject, "wireplumber.hooks-stats.result",
+        "Spa:String:JSON", stats_str);
+  }
 }
 
 static void
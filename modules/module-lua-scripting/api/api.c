@@ -1662,11 +1662,16 @@ static const luaL_Reg pipewire_object_methods[] = {
 
 /* WpState */
 
+/* the order must match WpStateFormat */
+static const char *const state_format_names[] = { "keyfile", "binary", NULL };
+
 static int
 state_new (lua_State *L)
 {
   const gchar *name = luaL_checkstring (L, 1);
-  WpState *state = wp_state_new (name);
+  WpStateFormat format =
+      luaL_checkoption (L, 2, "keyfile", state_format_names);
+  WpState *state = wp_state_new_full (name, format);
   wplua_pushobject (L, state);
   return 1;
 }
@@ -1735,7 +1740,10 @@ static int
 state_metadata_new (lua_State *L)
 {
   const gchar *name = luaL_checkstring (L, 1);
-  WpStateMetadata *state_meta = wp_state_metadata_new (get_wp_core (L), name);
+  WpStateFormat format =
+      luaL_checkoption (L, 2, "keyfile", state_format_names);
+  WpStateMetadata *state_meta =
+      wp_state_metadata_new_full (get_wp_core (L), name, format);
   wplua_pushobject (L, state_meta);
   return 1;
 }
@@ -1771,10 +1779,30 @@ state_metadata_set (lua_State *L)
   return 0;
 }
 
+static int
+state_metadata_begin (lua_State *L)
+{
+  WpStateMetadata *state_meta = wplua_checkobject (L, 1,
+      WP_TYPE_STATE_METADATA);
+  wp_state_metadata_begin (state_meta);
+  return 0;
+}
+
+static int
+state_metadata_commit (lua_State *L)
+{
+  WpStateMetadata *state_meta = wplua_checkobject (L, 1,
+      WP_TYPE_STATE_METADATA);
+  wp_state_metadata_commit (state_meta);
+  return 0;
+}
+
 static const luaL_Reg state_metadata_methods[] = {
   { "clear", state_metadata_clear },
   { "get", state_metadata_get },
   { "set", state_metadata_set },
+  { "begin", state_metadata_begin },
+  { "commit", state_metadata_commit },
   { NULL, NULL }
 };
 
@@ -1269,6 +1269,230 @@ push_luapod (lua_State *L, WpSpaPod *pod, WpSpaIdValue field_idval)
   }
 }
 
+/* View */
+
+#define SPA_POD_VIEW_METATABLE "WpSpaPodView"
+
+/* A view references a pod nested inside its root pod without copying it;
+ * the root is kept alive for as long as the view exists */
+typedef struct {
+  WpSpaPod *root;
+  WpSpaPod *pod;
+  gboolean properties;
+} SpaPodView;
+
+static void
+push_view (lua_State *L, WpSpaPod *root, WpSpaPod *pod, gboolean properties)
+{
+  SpaPodView *view = lua_newuserdata (L, sizeof (SpaPodView));
+  view->root = wp_spa_pod_ref (root);
+  view->pod = wp_spa_pod_ref (pod);
+  view->properties = properties;
+  luaL_setmetatable (L, SPA_POD_VIEW_METATABLE);
+}
+
+/* objects and structs are wrapped in views, everything else is converted */
+static void
+push_lazy_value (lua_State *L, WpSpaPod *root, WpSpaPod *pod,
+    WpSpaIdValue field_idval)
+{
+  if (wp_spa_pod_is_object (pod) || wp_spa_pod_is_struct (pod))
+    push_view (L, root, pod, FALSE);
+  else
+    push_luapod (L, pod, field_idval);
+}
+
+static void
+push_object_property (lua_State *L, WpSpaPod *root, WpSpaPod *pod,
+    const gchar *key)
+{
+  WpSpaIdTable values_table =
+      wp_spa_type_get_values_table (wp_spa_pod_get_spa_type (pod));
+  g_autoptr (WpSpaPod) val = NULL;
+
+  /* a single property name, not a path */
+  if (*key != '\0' && !strchr (key, '/'))
+    val = wp_spa_pod_lookup_path (pod, key);
+  if (val)
+    push_lazy_value (L, root, val,
+        wp_spa_id_table_find_value_from_short_name (values_table, key));
+  else
+    lua_pushnil (L);
+}
+
+static int
+spa_pod_view_gc (lua_State *L)
+{
+  SpaPodView *view = luaL_checkudata (L, 1, SPA_POD_VIEW_METATABLE);
+  g_clear_pointer (&view->pod, wp_spa_pod_unref);
+  g_clear_pointer (&view->root, wp_spa_pod_unref);
+  return 0;
+}
+
+static int
+spa_pod_view_index (lua_State *L)
+{
+  SpaPodView *view = luaL_checkudata (L, 1, SPA_POD_VIEW_METATABLE);
+
+  if (view->properties) {
+    const gchar *key = luaL_checkstring (L, 2);
+    push_object_property (L, view->root, view->pod, key);
+  }
+  else if (wp_spa_pod_is_object (view->pod)) {
+    const gchar *key = luaL_checkstring (L, 2);
+    if (g_strcmp0 (key, "pod_type") == 0) {
+      lua_pushstring (L, "Object");
+    } else if (g_strcmp0 (key, "object_id") == 0) {
+      const gchar *id_name = NULL;
+      g_warn_if_fail (wp_spa_pod_get_object (view->pod, &id_name, NULL));
+      lua_pushstring (L, id_name);
+    } else if (g_strcmp0 (key, "properties") == 0) {
+      push_view (L, view->root, view->pod, TRUE);
+    } else {
+      lua_pushnil (L);
+    }
+  }
+  else if (lua_type (L, 2) == LUA_TNUMBER) {
+    lua_Integer i = lua_tointeger (L, 2);
+    g_autofree gchar *path = NULL;
+    g_autoptr (WpSpaPod) val = NULL;
+    if (i >= 1) {
+      path = g_strdup_printf ("%" G_GINT64_FORMAT, (gint64) i - 1);
+      val = wp_spa_pod_lookup_path (view->pod, path);
+    }
+    if (val)
+      push_lazy_value (L, view->root, val, NULL);
+    else
+      lua_pushnil (L);
+  }
+  else if (g_strcmp0 (lua_tostring (L, 2), "pod_type") == 0) {
+    lua_pushstring (L, "Struct");
+  }
+  else {
+    lua_pushnil (L);
+  }
+  return 1;
+}
+
+static int
+spa_pod_view_len (lua_State *L)
+{
+  SpaPodView *view = luaL_checkudata (L, 1, SPA_POD_VIEW_METATABLE);
+  lua_Integer n = 0;
+
+  if (!view->properties && wp_spa_pod_is_struct (view->pod)) {
+    g_auto (GValue) item = G_VALUE_INIT;
+    g_autoptr (WpIterator) it = wp_spa_pod_new_iterator (view->pod);
+    for (; wp_iterator_next (it, &item); g_value_unset (&item))
+      n++;
+  }
+  lua_pushinteger (L, n);
+  return 1;
+}
+
+static int
+spa_pod_view_next (lua_State *L)
+{
+  luaL_checktype (L, 1, LUA_TTABLE);
+  lua_settop (L, 2);
+  if (lua_next (L, 1))
+    return 2;
+  lua_pushnil (L);
+  return 1;
+}
+
+/* iterating resolves all the fields of this level, like Pod.parse() does */
+static int
+spa_pod_view_pairs (lua_State *L)
+{
+  SpaPodView *view = luaL_checkudata (L, 1, SPA_POD_VIEW_METATABLE);
+
+  lua_pushcfunction (L, spa_pod_view_next);
+  lua_newtable (L);
+
+  if (view->properties) {
+    WpSpaIdTable values_table =
+        wp_spa_type_get_values_table (wp_spa_pod_get_spa_type (view->pod));
+    g_auto (GValue) item = G_VALUE_INIT;
+    g_autoptr (WpIterator) it = wp_spa_pod_new_iterator (view->pod);
+    for (; wp_iterator_next (it, &item); g_value_unset (&item)) {
+      WpSpaPod *prop = g_value_get_boxed (&item);
+      const gchar *key = NULL;
+      g_autoptr (WpSpaPod) val = NULL;
+      g_warn_if_fail (wp_spa_pod_get_property (prop, &key, &val));
+      if (key) {
+        push_lazy_value (L, view->root, val,
+            wp_spa_id_table_find_value_from_short_name (values_table, key));
+        lua_setfield (L, -2, key);
+      }
+    }
+  }
+  else if (wp_spa_pod_is_object (view->pod)) {
+    const gchar *id_name = NULL;
+    g_warn_if_fail (wp_spa_pod_get_object (view->pod, &id_name, NULL));
+    lua_pushstring (L, "Object");
+    lua_setfield (L, -2, "pod_type");
+    lua_pushstring (L, id_name);
+    lua_setfield (L, -2, "object_id");
+    push_view (L, view->root, view->pod, TRUE);
+    lua_setfield (L, -2, "properties");
+  }
+  else {
+    g_auto (GValue) item = G_VALUE_INIT;
+    g_autoptr (WpIterator) it = wp_spa_pod_new_iterator (view->pod);
+    lua_Integer i = 1;
+    lua_pushstring (L, "Struct");
+    lua_setfield (L, -2, "pod_type");
+    for (; wp_iterator_next (it, &item); g_value_unset (&item)) {
+      push_lazy_value (L, view->root, g_value_get_boxed (&item), NULL);
+      lua_rawseti (L, -2, i++);
+    }
+  }
+
+  lua_pushnil (L);
+  return 3;
+}
+
+static int
+spa_pod_view_tostring (lua_State *L)
+{
+  SpaPodView *view = luaL_checkudata (L, 1, SPA_POD_VIEW_METATABLE);
+  lua_pushfstring (L, "WpSpaPodView (%s%s): %p",
+      wp_spa_type_name (wp_spa_pod_get_spa_type (view->pod)),
+      view->properties ? ", properties" : "", view->pod);
+  return 1;
+}
+
+static const luaL_Reg spa_pod_view_metamethods[] = {
+  { "__gc", spa_pod_view_gc },
+  { "__index", spa_pod_view_index },
+  { "__len", spa_pod_view_len },
+  { "__pairs", spa_pod_view_pairs },
+  { "__tostring", spa_pod_view_tostring },
+  { NULL, NULL }
+};
+
+static int
+spa_pod_view (lua_State *L)
+{
+  WpSpaPod *pod = wplua_checkboxed (L, 1, WP_TYPE_SPA_POD);
+  push_lazy_value (L, pod, pod, NULL);
+  return 1;
+}
+
+static int
+spa_pod_lookup (lua_State *L)
+{
+  WpSpaPod *pod = wplua_checkboxed (L, 1, WP_TYPE_SPA_POD);
+  const gchar *path = luaL_checkstring (L, 2);
+  g_autoptr (WpSpaPod) val = wp_spa_pod_lookup_path (pod, path);
+  if (val)
+    push_lazy_value (L, pod, val, NULL);
+  else
+    lua_pushnil (L);
+  return 1;
+}
+
 static int
 spa_pod_parse (lua_State *L)
 {
@@ -1308,6 +1532,8 @@ spa_pod_filter (lua_State *L)
 static const luaL_Reg spa_pod_methods[] = {
   { "get_type_name", spa_pod_get_type_name },
   { "parse", spa_pod_parse },
+  { "view", spa_pod_view },
+  { "lookup", spa_pod_lookup },
   { "fixate", spa_pod_fixate },
   { "filter", spa_pod_filter },
   { NULL, NULL }
@@ -1354,4 +1580,10 @@ wp_lua_scripting_pod_init (lua_State *L)
   lua_setglobal (L, "WpSpaPod");
 
   wplua_register_type_methods (L, WP_TYPE_SPA_POD, NULL, spa_pod_methods);
+
+  if (!luaL_newmetatable (L, SPA_POD_VIEW_METATABLE))
+    g_error ("Metatable with key " SPA_POD_VIEW_METATABLE
+        " in the registry already exists?");
+  luaL_setfuncs (L, spa_pod_view_metamethods, 0);
+  lua_pop (L, 1);
 }
@@ -184,6 +184,9 @@ collect_node_info (WpMixerApi * self, struct node_info *info,
   info->route_index = -1;
   info->route_device = -1;
 
+  /* the params are only parsed here, the values are copied into info */
+  wp_spa_pod_arena_push ();
+
   if ((str = wp_pipewire_object_get_property (node, PW_KEY_DEVICE_ID))) {
     dev = wp_object_manager_lookup (self->om, WP_TYPE_DEVICE,
         WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=s", str, NULL);
@@ -233,6 +236,8 @@ collect_node_info (WpMixerApi * self, struct node_info *info,
       }
     }
   }
+
+  wp_spa_pod_arena_pop ();
 }
 
 static void on_objects_changed (WpObjectManager * om, WpMixerApi * self);
@@ -481,9 +486,22 @@ wp_mixer_api_set_volume (WpMixerApi * self, guint32 id, GVariant * vvolume)
   }
 
   /* set param */
+  g_autoptr (WpPipewireObject) object = NULL;
   g_autoptr (WpSpaPod) props = NULL;
-  g_autoptr (WpSpaPodBuilder) b =
-      wp_spa_pod_builder_new_object ("Spa:Pod:Object:Param:Props", "Props");
+  g_autoptr (WpSpaPodBuilder) b = NULL;
+
+  if (info->device_id != SPA_ID_INVALID)
+    object = wp_object_manager_lookup (self->om, WP_TYPE_DEVICE,
+        WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", info->device_id, NULL);
+  else
+    object = wp_object_manager_lookup (self->om, WP_TYPE_NODE,
+        WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", id, NULL);
+  g_return_val_if_fail (object != NULL, FALSE);
+
+  /* the param is sent right away, it is not kept */
+  wp_spa_pod_arena_push ();
+
+  b = wp_spa_pod_builder_new_object ("Spa:Pod:Object:Param:Props", "Props");
 
   if (new_volume.channels > 0)
     wp_spa_pod_builder_add (b, "channelVolumes", "a",
@@ -501,12 +519,7 @@ wp_mixer_api_set_volume (WpMixerApi * self, guint32 id, GVariant * vvolume)
   props = wp_spa_pod_builder_end (b);
 
   if (info->device_id != SPA_ID_INVALID) {
-    g_autoptr (WpPipewireObject) device = wp_object_manager_lookup (self->om,
-        WP_TYPE_DEVICE, WP_CONSTRAINT_TYPE_G_PROPERTY,
-        "bound-id", "=u", info->device_id, NULL);
-    g_return_val_if_fail (device != NULL, FALSE);
-
-    wp_pipewire_object_set_param (device, "Route", 0, wp_spa_pod_new_object (
+    wp_pipewire_object_set_param (object, "Route", 0, wp_spa_pod_new_object (
         "Spa:Pod:Object:Param:Route", "Route",
         "index", "i", info->route_index,
         "device", "i", info->route_device,
@@ -514,14 +527,10 @@ wp_mixer_api_set_volume (WpMixerApi * self, guint32 id, GVariant * vvolume)
         "save", "b", true,
         NULL));
   } else {
-    g_autoptr (WpPipewireObject) node = wp_object_manager_lookup (self->om,
-        WP_TYPE_NODE, WP_CONSTRAINT_TYPE_G_PROPERTY,
-        "bound-id", "=u", id, NULL);
-    g_return_val_if_fail (node != NULL, FALSE);
-
-    wp_pipewire_object_set_param (node, "Props", 0, g_steal_pointer (&props));
+    wp_pipewire_object_set_param (object, "Props", 0, g_steal_pointer (&props));
   }
 
+  wp_spa_pod_arena_pop ();
   return TRUE;
 }
 
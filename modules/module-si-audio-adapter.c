@@ -231,6 +231,7 @@ si_audio_adapter_find_format (WpSiAudioAdapter * self, WpNode * node,
     }
     }
   }
+
   if (!have_format && self->have_encoded) {
     wp_info_object (self, ".. passthrough IEC958/DSD/encoded only");
     self->encoded_only = TRUE;
@@ -410,6 +410,11 @@ wp_standard_event_source_enable (WpPlugin * plugin, WpTransition * transition)
       wp_event_dispatcher_get_instance (core);
   g_return_if_fail (dispatcher);
 
+  /* params-changed events only notify that the params need to be re-read;
+     a burst of them for the same object & param id can be handled once */
+  wp_event_dispatcher_set_coalescing (dispatcher, "node-params-changed", TRUE);
+  wp_event_dispatcher_set_coalescing (dispatcher, "device-params-changed", TRUE);
+
   /* install object managers */
   self->n_oms_installed = 0;
   for (gint i = 0; i < N_OBJECT_TYPES; i++) {
@@ -64,7 +64,7 @@ end
 
 function findProfile (device, index, name)
   for p in device:iterate_params ("EnumProfile") do
-    local profile = cutils.parseParam (p, "EnumProfile")
+    local profile = cutils.viewParam (p, "EnumProfile")
     if profile ~= nil then
       if (index ~= nil and profile.index == index) or
          (name ~= nil and profile.name == name) then
@@ -88,7 +88,7 @@ end
 
 function hasProfileInputRoute (device, profile_index)
   for p in device:iterate_params ("EnumRoute") do
-    local route = cutils.parseParam (p, "EnumRoute")
+    local route = cutils.viewParam (p, "EnumRoute")
     if route and route.direction == "Input" and route.profiles then
       for _, v in pairs (route.profiles) do
         if v == profile_index then
@@ -112,7 +112,7 @@ end
 function highestPrioHeadsetProfile (device)
   local found_profile = nil
   for p in device:iterate_params ("EnumRoute") do
-    local route = cutils.parseParam (p, "EnumRoute")
+    local route = cutils.viewParam (p, "EnumRoute")
     if route ~= nil and route.profiles ~= nil and route.direction == "Input" then
       for _, v in pairs (route.profiles) do
         local p = findProfile (device, v)
@@ -130,7 +130,7 @@ end
 function highestPrioNonHeadsetProfile (device)
   local found_profile = nil
   for p in device:iterate_params ("EnumRoute") do
-    local route = cutils.parseParam (p, "EnumRoute")
+    local route = cutils.viewParam (p, "EnumRoute")
     if route ~= nil and route.profiles ~= nil and route.direction ~= "Input" then
       for _, v in pairs (route.profiles) do
         local p = findProfile (device, v)
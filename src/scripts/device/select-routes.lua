@@ -49,7 +49,7 @@ SimpleEventHook {
     -- look at all the routes and update/reset cached information
     for p in device:iterate_params ("EnumRoute") do
       -- parse pod
-      local route = cutils.parseParam (p, "EnumRoute")
+      local route = cutils.viewParam (p, "EnumRoute")
       if not route then
         goto skip_enum_route
       end
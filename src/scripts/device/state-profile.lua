@@ -107,7 +107,7 @@ function updateStoredProfile (device, profile)
   -- find the full profile from EnumProfile, making also sure that the
   -- user / client application has actually set an existing profile
   for p in device:iterate_params ("EnumProfile") do
-    local enum_profile = cutils.parseParam (p, "EnumProfile")
+    local enum_profile = cutils.viewParam (p, "EnumProfile")
     if enum_profile.name == profile.name then
       index = enum_profile.index
     end
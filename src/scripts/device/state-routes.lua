@@ -194,7 +194,7 @@ store_or_restore_routes_hook = AsyncEventHook {
           -- look at all the routes and update/reset cached information
           for p in enum_route_it:iterate() do
             -- parse pod
-            local route = cutils.parseParam (p, "EnumRoute")
+            local route = cutils.viewParam (p, "EnumRoute")
             if not route then
               goto skip_enum_route
             end
@@ -22,6 +22,17 @@ function cutils.parseParam (param, id)
   end
 end
 
+-- Like parseParam(), but returns a read-only view that resolves fields only
+-- when they are accessed, instead of converting the whole param to tables
+function cutils.viewParam (param, id)
+  local view = param:view ()
+  if view.pod_type == "Object" and view.object_id == id then
+    return view.properties
+  else
+    return nil
+  end
+end
+
 function cutils.mediaClassToDirection (media_class)
   if media_class:find ("Sink") or
       media_class:find ("Input") or
@@ -8,7 +8,7 @@ _wpctl() {
   local cur prev words cword
   local commands="status get-volume inspect set-default set-volume set-mute
                   set-profile set-route clear-default settings set-log-level
-                  list reset"
+                  hooks-stats list reset"
 
   _init_completion -n = || return
 
@@ -113,6 +113,11 @@ static struct {
       const char *level;
     } set_log_level;
 
+    struct {
+      gboolean reset;
+      GHashTable *pending;
+    } hooks_stats;
+
     struct {
       gboolean wp_config;
       gboolean pw_config;
@@ -1858,6 +1863,218 @@ out:
   g_main_loop_quit (self->loop);
 }
 
+/* hooks-stats */
+
+#define HOOKS_STATS_KEY "wireplumber.hooks-stats"
+#define HOOKS_STATS_RESULT_KEY "wireplumber.hooks-stats.result"
+
+static gboolean
+hooks_stats_parse_positional (gint argc, gchar ** argv, GError **error)
+{
+  if (argc > 2) {
+    g_set_error (error, wpctl_error_domain_quark(), 0,
+                 "hooks-stats does not take positional arguments");
+    return FALSE;
+  }
+  return TRUE;
+}
+
+static gboolean
+hooks_stats_prepare (WpCtl * self, GError ** error)
+{
+  return set_log_level_prepare (self, error);
+}
+
+static void
+hooks_stats_print (guint32 client_id, WpSpaJson *stats)
+{
+  g_autoptr (WpSpaJson) hooks = NULL;
+  g_autoptr (WpSpaJson) events = NULL;
+  g_autoptr (WpSpaJson) running = NULL;
+  g_autoptr (WpIterator) it = NULL;
+  g_auto (GValue) item = G_VALUE_INIT;
+  gint queued = 0;
+
+  if (!wp_spa_json_is_object (stats) ||
+      !wp_spa_json_object_get (stats,
+          "hooks", "J", &hooks,
+          "events", "J", &events,
+          "queued", "i", &queued,
+          NULL)) {
+    fprintf (stderr, "Invalid statistics received from client %u\n",
+        client_id);
+    return;
+  }
+
+  printf ("WirePlumber client %u (%d queued events)\n", client_id, queued);
+
+  if (wp_spa_json_object_get (stats, "running-hook", "J", &running, NULL)) {
+    g_autofree gchar *name = NULL;
+    g_autofree gchar *event = NULL;
+    float elapsed = 0.0f;
+    wp_spa_json_object_get (running, "name", "s", &name, "event", "s", &event,
+        "elapsed-ms", "f", &elapsed, NULL);
+    printf (" Running: %s for %s, %.3f ms\n", name, event, elapsed);
+  }
+
+  printf (" Hooks:\n");
+  printf ("  %11s %12s %10s %12s %10s  %s\n", "invocations", "total ms",
+      "max ms", "blocking ms", "max ms", "name");
+  it = wp_spa_json_new_iterator (hooks);
+  for (; wp_iterator_next (it, &item); g_value_unset (&item)) {
+    WpSpaJson *h = g_value_get_boxed (&item);
+    g_autofree gchar *name = NULL;
+    gint n = 0;
+    float t_total = 0.0f, t_max = 0.0f, b_total = 0.0f, b_max = 0.0f;
+
+    wp_spa_json_object_get (h,
+        "name", "s", &name,
+        "invocations", "i", &n,
+        "time-total-ms", "f", &t_total,
+        "time-max-ms", "f", &t_max,
+        "blocking-time-total-ms", "f", &b_total,
+        "blocking-time-max-ms", "f", &b_max,
+        NULL);
+    printf ("  %11d %12.3f %10.3f %12.3f %10.3f  %s\n", n, t_total, t_max,
+        b_total, b_max, name);
+  }
+  g_clear_pointer (&it, wp_iterator_unref);
+
+  printf (" Events:\n");
+  printf ("  %8s %9s %12s %10s %12s %10s  %s\n", "count", "coalesced",
+      "wait ms", "max ms", "dispatch ms", "max ms", "type");
+  it = wp_spa_json_new_iterator (events);
+  for (; wp_iterator_next (it, &item); g_value_unset (&item)) {
+    WpSpaJson *e = g_value_get_boxed (&item);
+    g_autofree gchar *type = NULL;
+    gint n = 0, coalesced = 0;
+    float w_total = 0.0f, w_max = 0.0f, d_total = 0.0f, d_max = 0.0f;
+
+    wp_spa_json_object_get (e,
+        "type", "s", &type,
+        "count", "i", &n,
+        "coalesced", "i", &coalesced,
+        "wait-time-total-ms", "f", &w_total,
+        "wait-time-max-ms", "f", &w_max,
+        "dispatch-time-total-ms", "f", &d_total,
+        "dispatch-time-max-ms", "f", &d_max,
+        NULL);
+    printf ("  %8d %9d %12.3f %10.3f %12.3f %10.3f  %s\n", n, coalesced,
+        w_total, w_max, d_total, d_max, type);
+  }
+}
+
+static void
+on_hooks_stats_changed (WpMetadata *m, guint32 subject,
+    const gchar *key, const gchar *type, const gchar *value, WpCtl * self)
+{
+  g_autoptr (WpSpaJson) stats = NULL;
+
+  if (!spa_streq (key, HOOKS_STATS_RESULT_KEY) || !value)
+    return;
+
+  /* ignore replies that we did not ask for or that arrived too late */
+  if (!cmdline.hooks_stats.pending ||
+      !g_hash_table_remove (cmdline.hooks_stats.pending,
+          GUINT_TO_POINTER (subject)))
+    return;
+
+  stats = wp_spa_json_new_from_string (value);
+  hooks_stats_print (subject, stats);
+
+  wp_metadata_set (m, subject, HOOKS_STATS_KEY, NULL, NULL);
+  wp_metadata_set (m, subject, HOOKS_STATS_RESULT_KEY, NULL, NULL);
+
+  if (g_hash_table_size (cmdline.hooks_stats.pending) == 0) {
+    g_clear_pointer (&cmdline.hooks_stats.pending, g_hash_table_unref);
+    wp_core_sync (self->core, NULL, (GAsyncReadyCallback) async_quit, self);
+  }
+}
+
+static gboolean
+on_hooks_stats_timeout (WpCtl * self)
+{
+  g_autoptr (WpMetadata) settings = wp_object_manager_lookup (self->om,
+      WP_TYPE_METADATA, NULL);
+  GHashTableIter iter;
+  gpointer key;
+
+  /* all the replies have already arrived */
+  if (!cmdline.hooks_stats.pending)
+    return G_SOURCE_REMOVE;
+
+  /* do not leave the requests behind */
+  g_hash_table_iter_init (&iter, cmdline.hooks_stats.pending);
+  while (g_hash_table_iter_next (&iter, &key, NULL)) {
+    guint32 client_id = GPOINTER_TO_UINT (key);
+    fprintf (stderr, "Timed out waiting for hook statistics from client %u; "
+        "is the log-settings module loaded?\n", client_id);
+    if (settings)
+      wp_metadata_set (settings, client_id, HOOKS_STATS_KEY, NULL, NULL);
+  }
+  g_clear_pointer (&cmdline.hooks_stats.pending, g_hash_table_unref);
+
+  self->exit_code = 3;
+  wp_core_sync (self->core, NULL, (GAsyncReadyCallback) async_quit, self);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+hooks_stats_run (WpCtl * self)
+{
+  g_autoptr (WpIterator) client_it = NULL;
+  g_auto (GValue) client_val = G_VALUE_INIT;
+  g_autoptr (GSource) timeout = NULL;
+
+  g_autoptr (WpMetadata) settings = wp_object_manager_lookup (self->om, WP_TYPE_METADATA, NULL);
+  if (!settings) {
+    fprintf (stderr, "No settings metadata found\n");
+    goto out;
+  }
+
+  g_signal_connect (settings, "changed",
+      G_CALLBACK (on_hooks_stats_changed), self);
+
+  cmdline.hooks_stats.pending = g_hash_table_new (g_direct_hash,
+      g_direct_equal);
+  client_it = wp_object_manager_new_filtered_iterator (self->om, WP_TYPE_CLIENT, NULL);
+  for (; wp_iterator_next (client_it, &client_val); g_value_unset (&client_val)) {
+    WpPipewireObject *client = g_value_get_object (&client_val);
+    guint32 client_id = wp_proxy_get_bound_id (WP_PROXY (client));
+    g_autoptr (WpProperties) props = NULL;
+
+    if (client_id == SPA_ID_INVALID)
+      continue;
+
+    /* the client context connections of the daemon copy its core properties,
+       but only the main connection of the daemon replies */
+    props = wp_pipewire_object_get_properties (client);
+    if (wp_properties_get (props, "wireplumber.client-context"))
+      continue;
+
+    wp_metadata_set (settings, client_id, HOOKS_STATS_KEY, "",
+        cmdline.hooks_stats.reset ? "reset" : "dump");
+    g_hash_table_add (cmdline.hooks_stats.pending,
+        GUINT_TO_POINTER (client_id));
+  }
+
+  if (g_hash_table_size (cmdline.hooks_stats.pending) == 0) {
+    g_clear_pointer (&cmdline.hooks_stats.pending, g_hash_table_unref);
+    fprintf (stderr, "No WirePlumber instance found\n");
+    goto out;
+  }
+
+  timeout = g_timeout_source_new_seconds (5);
+  g_source_set_callback (timeout, (GSourceFunc) on_hooks_stats_timeout,
+      self, NULL);
+  g_source_attach (timeout, wp_core_get_g_main_context (self->core));
+  return;
+
+out:
+  self->exit_code = 3;
+  g_main_loop_quit (self->loop);
+}
+
 /* reset */
 
 /* Collect all paths under `file` in post-order (children before their parent directory) */
@@ -2210,6 +2427,21 @@ static const struct subcommand {
     .prepare = set_log_level_prepare,
     .run = set_log_level_run,
   },
+  {
+    .name = "hooks-stats",
+    .positional_args = "",
+    .summary = "Shows run time statistics of the WirePlumber event hooks",
+    .description = NULL,
+    .entries = {
+      { "reset", 'r', G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE,
+        &cmdline.hooks_stats.reset,
+        "Resets the statistics after showing them", NULL },
+      { NULL }
+    },
+    .parse_positional = hooks_stats_parse_positional,
+    .prepare = hooks_stats_prepare,
+    .run = hooks_stats_run,
+  },
   {
     .name = "reset",
     .positional_args = "",
@@ -0,0 +1,37 @@
+/* WirePlumber
+ *
+ * Copyright © 2024 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef __WIREPLUMBER_BENCHMARK_H__
+#define __WIREPLUMBER_BENCHMARK_H__
+
+#include <glib.h>
+
+/* number of iterations; larger when running with "-m perf" */
+static inline guint
+wp_bench_iterations (guint quick, guint perf)
+{
+  return g_test_perf () ? perf : quick;
+}
+
+static inline void
+wp_bench_start (void)
+{
+  g_test_timer_start ();
+}
+
+/* stops the timer started by wp_bench_start() and reports the throughput */
+static inline void
+wp_bench_report (const gchar * what, guint n_ops)
+{
+  gdouble elapsed = g_test_timer_elapsed ();
+  gdouble rate = (elapsed > 0) ? n_ops / elapsed : 0;
+
+  g_test_maximized_result (rate, "%s: %u ops in %.3f ms, %.0f ops/s",
+      what, n_ops, elapsed * 1000, rate);
+}
+
+#endif
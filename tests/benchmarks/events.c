@@ -0,0 +1,109 @@
+/* WirePlumber
+ *
+ * Copyright © 2024 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../common/base-test-fixture.h"
+#include "benchmark.h"
+
+typedef struct {
+  WpBaseTestFixture base;
+  guint n_hook_runs;
+} TestFixture;
+
+static void
+bench_events_setup (TestFixture *self, gconstpointer user_data)
+{
+  wp_base_test_fixture_setup (&self->base, 0);
+  self->n_hook_runs = 0;
+}
+
+static void
+bench_events_teardown (TestFixture *self, gconstpointer user_data)
+{
+  wp_base_test_fixture_teardown (&self->base);
+}
+
+static void
+hook_count (WpEvent * event, TestFixture * self)
+{
+  self->n_hook_runs++;
+}
+
+static void
+hook_quit (WpEvent * event, TestFixture * self)
+{
+  g_main_loop_quit (self->base.loop);
+}
+
+static void
+bench_events_dispatch (TestFixture *f, gconstpointer user_data)
+{
+  guint n_hooks = GPOINTER_TO_UINT (user_data);
+  /* keep the total number of hook invocations bounded, so that the
+     fixture's watchdog does not fire in perf mode */
+  guint n_events = wp_bench_iterations (1000, MAX (1000, 1000000 / n_hooks));
+  g_autoptr (WpEventDispatcher) dispatcher =
+      wp_event_dispatcher_get_instance (f->base.core);
+  g_autoptr (WpEventHook) hook = NULL;
+  g_autofree gchar *what = NULL;
+
+  for (guint i = 0; i < n_hooks; i++) {
+    g_autofree gchar *name = g_strdup_printf ("hook-%u", i);
+    hook = wp_simple_event_hook_new (name, NULL, NULL,
+        g_cclosure_new ((GCallback) hook_count, f, NULL));
+    wp_interest_event_hook_add_interest (WP_INTEREST_EVENT_HOOK (hook),
+        WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.type", "=s", "bench", NULL);
+    wp_event_dispatcher_register_hook (dispatcher, hook);
+    g_clear_object (&hook);
+  }
+
+  /* a hook on a different event type, which must never be run */
+  hook = wp_simple_event_hook_new ("hook-other", NULL, NULL,
+      g_cclosure_new ((GCallback) hook_count, f, NULL));
+  wp_interest_event_hook_add_interest (WP_INTEREST_EVENT_HOOK (hook),
+      WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.type", "=s", "other", NULL);
+  wp_event_dispatcher_register_hook (dispatcher, hook);
+  g_clear_object (&hook);
+
+  hook = wp_simple_event_hook_new ("hook-quit", NULL, NULL,
+      g_cclosure_new ((GCallback) hook_quit, f, NULL));
+  wp_interest_event_hook_add_interest (WP_INTEREST_EVENT_HOOK (hook),
+      WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.type", "=s", "quit", NULL);
+  wp_event_dispatcher_register_hook (dispatcher, hook);
+  g_clear_object (&hook);
+
+  wp_bench_start ();
+  for (guint i = 0; i < n_events; i++)
+    wp_event_dispatcher_push_event (dispatcher,
+        wp_event_new ("bench", 20, NULL, NULL, NULL));
+  wp_event_dispatcher_push_event (dispatcher,
+      wp_event_new ("quit", 10, NULL, NULL, NULL));
+  g_main_loop_run (f->base.loop);
+
+  what = g_strdup_printf ("event push + dispatch (%u hooks)", n_hooks);
+  wp_bench_report (what, n_events);
+
+  g_assert_cmpuint (f->n_hook_runs, ==, n_events * n_hooks);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  wp_init (WP_INIT_ALL);
+
+  g_test_add ("/wp/bench/events/dispatch/1", TestFixture,
+      GUINT_TO_POINTER (1),
+      bench_events_setup, bench_events_dispatch, bench_events_teardown);
+  g_test_add ("/wp/bench/events/dispatch/10", TestFixture,
+      GUINT_TO_POINTER (10),
+      bench_events_setup, bench_events_dispatch, bench_events_teardown);
+  g_test_add ("/wp/bench/events/dispatch/100", TestFixture,
+      GUINT_TO_POINTER (100),
+      bench_events_setup, bench_events_dispatch, bench_events_teardown);
+
+  return g_test_run ();
+}
@@ -0,0 +1,62 @@
+/* WirePlumber
+ *
+ * Copyright © 2024 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../common/test-log.h"
+#include "benchmark.h"
+
+static WpProperties *
+make_node_props (guint i)
+{
+  return wp_properties_new (
+      "node.name", (i % 2) ? "alsa_output.analog-stereo" : "bluez_input.a2dp",
+      "media.class", (i % 2) ? "Audio/Sink" : "Audio/Source",
+      "priority.session", (i % 3) ? "1000" : "2000",
+      "device.api", (i % 2) ? "alsa" : "bluez5",
+      NULL);
+}
+
+static void
+bench_object_interest_matches (void)
+{
+  g_autoptr (WpObjectInterest) i = wp_object_interest_new (WP_TYPE_PROPERTIES,
+      WP_CONSTRAINT_TYPE_PW_PROPERTY, "media.class", "=s", "Audio/Sink",
+      WP_CONSTRAINT_TYPE_PW_PROPERTY, "device.api", "c(ss)", "alsa", "bluez5",
+      WP_CONSTRAINT_TYPE_PW_PROPERTY, "priority.session", "~(ii)", 500, 1500,
+      WP_CONSTRAINT_TYPE_PW_PROPERTY, "node.name", "#s", "alsa_*",
+      NULL);
+  WpProperties *props[16];
+  guint n = wp_bench_iterations (10000, 1000000);
+  guint matched = 0;
+
+  g_assert_true (wp_object_interest_validate (i, NULL));
+
+  for (guint j = 0; j < G_N_ELEMENTS (props); j++)
+    props[j] = make_node_props (j);
+
+  wp_bench_start ();
+  for (guint j = 0; j < n; j++) {
+    if (wp_object_interest_matches (i, props[j % G_N_ELEMENTS (props)]))
+      matched++;
+  }
+  wp_bench_report ("wp_object_interest_matches", n);
+
+  g_assert_cmpuint (matched, >, 0);
+  for (guint j = 0; j < G_N_ELEMENTS (props); j++)
+    wp_properties_unref (props[j]);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  wp_init (WP_INIT_ALL);
+
+  g_test_add_func ("/wp/bench/object-interest/matches",
+      bench_object_interest_matches);
+
+  return g_test_run ();
+}
@@ -0,0 +1,123 @@
+/* WirePlumber
+ *
+ * Copyright © 2024 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../common/base-test-fixture.h"
+#include "benchmark.h"
+
+typedef struct {
+  WpBaseTestFixture base;
+  guint n_nodes;
+} TestFixture;
+
+static void
+bench_om_setup (TestFixture *self, gconstpointer user_data)
+{
+  self->n_nodes = wp_bench_iterations (100, 2000);
+
+  wp_base_test_fixture_setup (&self->base, 0);
+
+  /* create synthetic nodes on the server side; they have no implementation,
+     but they are exported as globals, which is all the object manager sees */
+  {
+    g_autoptr (WpTestServerLocker) lock =
+        wp_test_server_locker_new (&self->base.server);
+
+    for (guint i = 0; i < self->n_nodes; i++) {
+      g_autofree gchar *name = g_strdup_printf ("bench-node-%u", i);
+      struct pw_impl_node *node = pw_context_create_node (
+          self->base.server.context,
+          pw_properties_new (
+              PW_KEY_NODE_NAME, name,
+              PW_KEY_MEDIA_CLASS, (i % 2) ? "Audio/Sink" : "Audio/Source",
+              NULL), 0);
+      g_assert_nonnull (node);
+      g_assert_cmpint (pw_impl_node_register (node, NULL), ==, 0);
+    }
+  }
+}
+
+static void
+bench_om_teardown (TestFixture *self, gconstpointer user_data)
+{
+  wp_base_test_fixture_teardown (&self->base);
+}
+
+static WpObjectManager *
+install_nodes_om (TestFixture *f, const gchar * index_key)
+{
+  WpObjectManager *om = wp_object_manager_new ();
+
+  wp_object_manager_add_interest (om, WP_TYPE_NODE, NULL);
+  wp_object_manager_request_object_features (om, WP_TYPE_NODE,
+      WP_PIPEWIRE_OBJECT_FEATURES_MINIMAL);
+  if (index_key)
+    wp_object_manager_add_index (om, WP_CONSTRAINT_TYPE_PW_PROPERTY,
+        index_key);
+
+  test_ensure_object_manager_is_installed (om, f->base.core, f->base.loop);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om), ==, f->n_nodes);
+  return om;
+}
+
+static void
+bench_om_install (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (WpObjectManager) om = NULL;
+
+  wp_bench_start ();
+  om = install_nodes_om (f, NULL);
+  wp_bench_report ("object manager install (nodes)", f->n_nodes);
+}
+
+static void
+do_lookups (TestFixture *f, WpObjectManager *om, const gchar * what)
+{
+  guint n = wp_bench_iterations (1000, 100000);
+  g_autoptr (GPtrArray) names = g_ptr_array_new_with_free_func (g_free);
+
+  for (guint i = 0; i < f->n_nodes; i++)
+    g_ptr_array_add (names, g_strdup_printf ("bench-node-%u", i));
+
+  wp_bench_start ();
+  for (guint i = 0; i < n; i++) {
+    g_autoptr (WpNode) node = wp_object_manager_lookup (om, WP_TYPE_NODE,
+        WP_CONSTRAINT_TYPE_PW_PROPERTY, PW_KEY_NODE_NAME, "=s",
+        names->pdata[i % f->n_nodes], NULL);
+    g_assert_nonnull (node);
+  }
+  wp_bench_report (what, n);
+}
+
+static void
+bench_om_lookup (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (WpObjectManager) om = install_nodes_om (f, NULL);
+  do_lookups (f, om, "wp_object_manager_lookup");
+}
+
+static void
+bench_om_lookup_index (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (WpObjectManager) om = install_nodes_om (f, PW_KEY_NODE_NAME);
+  do_lookups (f, om, "wp_object_manager_lookup (indexed)");
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  wp_init (WP_INIT_ALL);
+
+  g_test_add ("/wp/bench/om/install", TestFixture, NULL,
+      bench_om_setup, bench_om_install, bench_om_teardown);
+  g_test_add ("/wp/bench/om/lookup", TestFixture, NULL,
+      bench_om_setup, bench_om_lookup, bench_om_teardown);
+  g_test_add ("/wp/bench/om/lookup-index", TestFixture, NULL,
+      bench_om_setup, bench_om_lookup_index, bench_om_teardown);
+
+  return g_test_run ();
+}
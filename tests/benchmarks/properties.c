@@ -0,0 +1,68 @@
+/* WirePlumber
+ *
+ * Copyright © 2024 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../common/test-log.h"
+#include "benchmark.h"
+
+#define N_KEYS 32
+
+static void
+bench_properties_set_get (void)
+{
+  g_autoptr (WpProperties) props = wp_properties_new_empty ();
+  g_autoptr (GPtrArray) keys = g_ptr_array_new_with_free_func (g_free);
+  guint n = wp_bench_iterations (10000, 1000000);
+  guint found = 0;
+
+  for (guint i = 0; i < N_KEYS; i++)
+    g_ptr_array_add (keys, g_strdup_printf ("bench.key.%u", i));
+
+  wp_bench_start ();
+  for (guint i = 0; i < n; i++)
+    wp_properties_set (props, keys->pdata[i % N_KEYS], "value");
+  wp_bench_report ("wp_properties_set", n);
+
+  wp_bench_start ();
+  for (guint i = 0; i < n; i++) {
+    if (wp_properties_get (props, keys->pdata[i % N_KEYS]))
+      found++;
+  }
+  wp_bench_report ("wp_properties_get", n);
+
+  g_assert_cmpuint (found, ==, n);
+}
+
+static void
+bench_properties_copy (void)
+{
+  g_autoptr (WpProperties) props = wp_properties_new_empty ();
+  guint n = wp_bench_iterations (1000, 100000);
+
+  for (guint i = 0; i < N_KEYS; i++) {
+    g_autofree gchar *key = g_strdup_printf ("bench.key.%u", i);
+    wp_properties_set (props, key, "value");
+  }
+
+  wp_bench_start ();
+  for (guint i = 0; i < n; i++) {
+    g_autoptr (WpProperties) copy = wp_properties_copy (props);
+    g_assert_nonnull (copy);
+  }
+  wp_bench_report ("wp_properties_copy", n);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  wp_init (WP_INIT_ALL);
+
+  g_test_add_func ("/wp/bench/properties/set_get", bench_properties_set_get);
+  g_test_add_func ("/wp/bench/properties/copy", bench_properties_copy);
+
+  return g_test_run ();
+}
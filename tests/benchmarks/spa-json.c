@@ -0,0 +1,114 @@
+/* WirePlumber
+ *
+ * Copyright © 2024 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../common/test-log.h"
+#include "benchmark.h"
+
+static const gchar *json_str =
+    "{ \"node.name\": \"alsa_output.pci-0000_00_1f.3.analog-stereo\","
+    "  \"media.class\": \"Audio/Sink\", \"priority.session\": 1009,"
+    "  \"audio.rate\": 48000, \"volume\": 0.75, \"mute\": false,"
+    "  \"matches\": [ { \"device.name\": \"~alsa_card.*\" } ],"
+    "  \"actions\": { \"update-props\": { \"api.alsa.period-size\": 256 } } }";
+
+static void
+bench_spa_json_parse (void)
+{
+  guint n = wp_bench_iterations (1000, 100000);
+
+  wp_bench_start ();
+  for (guint i = 0; i < n; i++) {
+    g_autoptr (WpSpaJson) json = wp_spa_json_new_from_string (json_str);
+    g_autofree gchar *name = NULL;
+    gint prio = 0;
+    float volume = 0;
+
+    g_assert_true (wp_spa_json_object_get (json,
+        "node.name", "s", &name,
+        "priority.session", "i", &prio,
+        "volume", "f", &volume,
+        NULL));
+    g_assert_cmpint (prio, ==, 1009);
+  }
+  wp_bench_report ("wp_spa_json parse + object_get", n);
+}
+
+static void
+bench_spa_json_iterate (void)
+{
+  g_autoptr (WpSpaJson) json = wp_spa_json_new_from_string (json_str);
+  guint n = wp_bench_iterations (1000, 100000);
+  guint n_items = 0;
+
+  wp_bench_start ();
+  for (guint i = 0; i < n; i++) {
+    g_autoptr (WpIterator) it = wp_spa_json_new_iterator (json);
+    g_auto (GValue) item = G_VALUE_INIT;
+    for (; wp_iterator_next (it, &item); g_value_unset (&item))
+      n_items++;
+  }
+  wp_bench_report ("wp_spa_json iterate", n);
+
+  g_assert_cmpuint (n_items, ==, n * 16);
+}
+
+static void
+bench_spa_json_cursor (void)
+{
+  gsize len = strlen (json_str);
+  guint n = wp_bench_iterations (1000, 100000);
+  guint n_items = 0;
+
+  wp_bench_start ();
+  for (guint i = 0; i < n; i++) {
+    WpSpaJsonCursor cursor;
+    WpSpaJsonToken token;
+
+    wp_spa_json_cursor_init (&cursor, json_str, len);
+    while (wp_spa_json_cursor_next (&cursor, &token))
+      n_items++;
+  }
+  wp_bench_report ("wp_spa_json cursor", n);
+
+  g_assert_cmpuint (n_items, ==, n * 16);
+}
+
+static void
+bench_spa_json_build (void)
+{
+  guint n = wp_bench_iterations (1000, 100000);
+
+  wp_bench_start ();
+  for (guint i = 0; i < n; i++) {
+    g_autoptr (WpSpaJsonBuilder) b = wp_spa_json_builder_new_object ();
+    g_autoptr (WpSpaJson) json = NULL;
+
+    wp_spa_json_builder_add_property (b, "node.name");
+    wp_spa_json_builder_add_string (b, "bench-node");
+    wp_spa_json_builder_add_property (b, "priority.session");
+    wp_spa_json_builder_add_int (b, 1009);
+    wp_spa_json_builder_add_property (b, "volume");
+    wp_spa_json_builder_add_float (b, 0.75f);
+    json = wp_spa_json_builder_end (b);
+    g_assert_nonnull (json);
+  }
+  wp_bench_report ("wp_spa_json build", n);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  wp_init (WP_INIT_ALL);
+
+  g_test_add_func ("/wp/bench/spa-json/parse", bench_spa_json_parse);
+  g_test_add_func ("/wp/bench/spa-json/iterate", bench_spa_json_iterate);
+  g_test_add_func ("/wp/bench/spa-json/cursor", bench_spa_json_cursor);
+  g_test_add_func ("/wp/bench/spa-json/build", bench_spa_json_build);
+
+  return g_test_run ();
+}
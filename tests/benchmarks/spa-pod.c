@@ -0,0 +1,98 @@
+/* WirePlumber
+ *
+ * Copyright © 2024 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../common/test-log.h"
+#include "benchmark.h"
+
+static void
+bench_spa_pod_build (void)
+{
+  guint n = wp_bench_iterations (1000, 100000);
+
+  wp_bench_start ();
+  for (guint i = 0; i < n; i++) {
+    g_autoptr (WpSpaPod) pod = wp_spa_pod_new_object (
+        "Spa:Pod:Object:Param:Props", "Props",
+        "mute", "b", FALSE,
+        "volume", "f", 0.5,
+        "frequency", "i", 440,
+        "device", "s", "device-name",
+        NULL);
+    g_assert_nonnull (pod);
+  }
+  wp_bench_report ("wp_spa_pod_new_object", n);
+}
+
+static void
+bench_spa_pod_parse (void)
+{
+  g_autoptr (WpSpaPod) pod = wp_spa_pod_new_object (
+      "Spa:Pod:Object:Param:Props", "Props",
+      "mute", "b", FALSE,
+      "volume", "f", 0.5,
+      "frequency", "i", 440,
+      "device", "s", "device-name",
+      NULL);
+  guint n = wp_bench_iterations (1000, 100000);
+
+  wp_bench_start ();
+  for (guint i = 0; i < n; i++) {
+    const gchar *id_name = NULL;
+    gboolean mute = TRUE;
+    float vol = 0.0;
+    gint frequency = 0;
+    const gchar *device = NULL;
+
+    g_assert_true (wp_spa_pod_get_object (pod,
+        &id_name,
+        "mute", "b", &mute,
+        "volume", "f", &vol,
+        "frequency", "i", &frequency,
+        "device", "s", &device,
+        NULL));
+    g_assert_cmpint (frequency, ==, 440);
+  }
+  wp_bench_report ("wp_spa_pod_get_object", n);
+}
+
+static void
+bench_spa_pod_iterate (void)
+{
+  g_autoptr (WpSpaPod) pod = wp_spa_pod_new_object (
+      "Spa:Pod:Object:Param:Props", "Props",
+      "mute", "b", FALSE,
+      "volume", "f", 0.5,
+      "frequency", "i", 440,
+      "device", "s", "device-name",
+      NULL);
+  guint n = wp_bench_iterations (1000, 100000);
+  guint n_props = 0;
+
+  wp_bench_start ();
+  for (guint i = 0; i < n; i++) {
+    g_autoptr (WpIterator) it = wp_spa_pod_new_iterator (pod);
+    g_auto (GValue) item = G_VALUE_INIT;
+    for (; wp_iterator_next (it, &item); g_value_unset (&item))
+      n_props++;
+  }
+  wp_bench_report ("wp_spa_pod iterate object", n);
+
+  g_assert_cmpuint (n_props, ==, n * 4);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  wp_init (WP_INIT_ALL);
+
+  g_test_add_func ("/wp/bench/spa-pod/build", bench_spa_pod_build);
+  g_test_add_func ("/wp/bench/spa-pod/parse", bench_spa_pod_parse);
+  g_test_add_func ("/wp/bench/spa-pod/iterate", bench_spa_pod_iterate);
+
+  return g_test_run ();
+}
@@ -7,6 +7,9 @@
  */
 
 #include "../common/test-log.h"
+#include <glib/gstdio.h>
+#include <fcntl.h>
+#include <sys/stat.h>
 
 typedef struct {
   WpConf *conf;
@@ -410,6 +413,133 @@ test_conf_as_section (TestConfFixture *f, gconstpointer data)
   g_clear_object (&f->conf);
 }
 
+static gint
+get_cached_int (const gchar *file, const gchar *key)
+{
+  g_autoptr (GError) error = NULL;
+  g_autoptr (WpConf) conf = wp_conf_new_open (file, NULL, &error);
+  g_autoptr (WpSpaJson) s = NULL;
+  gint v = -1;
+
+  g_assert_no_error (error);
+  g_assert_nonnull (conf);
+
+  s = wp_conf_get_section (conf, "test.cache");
+  g_assert_nonnull (s);
+  g_assert_true (wp_spa_json_is_object (s));
+  wp_spa_json_object_get (s, key, "i", &v, NULL);
+  return v;
+}
+
+/* overwrites the contents of a file in place without changing its inode,
+ * size or modification time, so that the config cache cannot notice */
+static void
+overwrite_keeping_stat (const gchar *path, const gchar *contents)
+{
+  struct stat before, after;
+  struct timespec times[2];
+  FILE *f;
+
+  g_assert_cmpint (stat (path, &before), ==, 0);
+  g_assert_cmpint (strlen (contents), ==, before.st_size);
+
+  f = fopen (path, "r+");
+  g_assert_nonnull (f);
+  g_assert_cmpint (fputs (contents, f), >=, 0);
+  g_assert_cmpint (fclose (f), ==, 0);
+
+  times[0] = before.st_atim;
+  times[1] = before.st_mtim;
+  g_assert_cmpint (utimensat (AT_FDCWD, path, times, 0), ==, 0);
+
+  g_assert_cmpint (stat (path, &after), ==, 0);
+  g_assert_cmpuint (after.st_ino, ==, before.st_ino);
+  g_assert_cmpint (after.st_size, ==, before.st_size);
+}
+
+static void
+test_conf_cache (void)
+{
+  g_autoptr (GError) error = NULL;
+  g_autofree gchar *tmpdir = g_dir_make_tmp ("wp-conf-cache-XXXXXX", &error);
+  g_autofree gchar *old_cache_home = g_strdup (g_getenv ("XDG_CACHE_HOME"));
+  g_autofree gchar *cache_home = NULL;
+  g_autofree gchar *cache_dir = NULL;
+  g_autofree gchar *file = NULL;
+  g_autofree gchar *frag_dir = NULL;
+  g_autofree gchar *frag = NULL;
+  g_autoptr (GDir) dir = NULL;
+  const gchar *cache_file = NULL;
+  g_autofree gchar *cache_path = NULL;
+
+  g_assert_no_error (error);
+  cache_home = g_build_filename (tmpdir, "cache", NULL);
+  cache_dir = g_build_filename (cache_home, "wireplumber", "conf", NULL);
+  file = g_build_filename (tmpdir, "wireplumber.conf", NULL);
+  frag_dir = g_build_filename (tmpdir, "wireplumber.conf.d", NULL);
+  frag = g_build_filename (frag_dir, "10-test.conf", NULL);
+  g_setenv ("XDG_CACHE_HOME", cache_home, TRUE);
+
+  g_assert_cmpint (g_mkdir (frag_dir, 0700), ==, 0);
+  g_assert_true (g_file_set_contents (file,
+      "test.cache = { a = 1 }\n", -1, NULL));
+  g_assert_true (g_file_set_contents (frag,
+      "test.cache = { b = 2 }\n", -1, NULL));
+
+  /* the first open merges the files and writes the cache */
+  g_assert_cmpint (get_cached_int (file, "a"), ==, 1);
+  g_assert_cmpint (get_cached_int (file, "b"), ==, 2);
+
+  dir = g_dir_open (cache_dir, 0, &error);
+  g_assert_no_error (error);
+  cache_file = g_dir_read_name (dir);
+  g_assert_nonnull (cache_file);
+  g_assert_null (g_dir_read_name (dir));
+  cache_path = g_build_filename (cache_dir, cache_file, NULL);
+  g_clear_pointer (&dir, g_dir_close);
+
+  /* the next open is served from the cache: a change that the cache cannot
+     detect is not seen... */
+  overwrite_keeping_stat (file, "test.cache = { a = 7 }\n");
+  g_assert_cmpint (get_cached_int (file, "a"), ==, 1);
+  g_assert_cmpint (get_cached_int (file, "b"), ==, 2);
+
+  /* put the original contents back; this replaces the file, so the cache is
+     written again by the next open */
+  g_assert_true (g_file_set_contents (file,
+      "test.cache = { a = 1 }\n", -1, NULL));
+
+  /* modifying a fragment invalidates the cache */
+  g_assert_true (g_file_set_contents (frag,
+      "override.test.cache = { c = 3 }\n", -1, NULL));
+  g_assert_cmpint (get_cached_int (file, "a"), ==, -1);
+  g_assert_cmpint (get_cached_int (file, "c"), ==, 3);
+
+  /* and so does removing it */
+  g_assert_cmpint (g_remove (frag), ==, 0);
+  g_assert_cmpint (get_cached_int (file, "a"), ==, 1);
+  g_assert_cmpint (get_cached_int (file, "c"), ==, -1);
+
+  /* a corrupted cache is ignored */
+  g_assert_true (g_file_set_contents (cache_path, "WPCC", -1, NULL));
+  g_assert_cmpint (get_cached_int (file, "a"), ==, 1);
+
+  g_assert_cmpint (g_remove (cache_path), ==, 0);
+  g_assert_cmpint (g_remove (file), ==, 0);
+  g_assert_cmpint (g_rmdir (frag_dir), ==, 0);
+  g_assert_cmpint (g_rmdir (cache_dir), ==, 0);
+  g_clear_pointer (&cache_dir, g_free);
+  cache_dir = g_build_filename (cache_home, "wireplumber", NULL);
+  g_assert_cmpint (g_rmdir (cache_dir), ==, 0);
+  g_assert_cmpint (g_rmdir (cache_home), ==, 0);
+  g_assert_cmpint (g_rmdir (tmpdir), ==, 0);
+
+  if (old_cache_home)
+    g_setenv ("XDG_CACHE_HOME", old_cache_home, TRUE);
+  else
+    g_unsetenv ("XDG_CACHE_HOME");
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -428,6 +558,7 @@ main (gint argc, gchar *argv[])
       test_conf_setup, test_conf_override_nested, test_conf_teardown);
   g_test_add ("/wp/conf/as_section", TestConfFixture, NULL,
       NULL, test_conf_as_section, NULL);
+  g_test_add_func ("/wp/conf/cache", test_conf_cache);
 
   return g_test_run ();
 }
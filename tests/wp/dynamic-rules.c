@@ -204,6 +204,7 @@ test_dynamic_rules_json_rule (TestFixture *f, gconstpointer user_data)
   g_autoptr (WpSpaJson) rule_json = NULL;
   g_autoptr (WpDynamicRules) dr = NULL;
   guint32 rule_id;
+  guint64 n_evaluations = 0, n_evaluations_before = 0;
 
   /* Build the JSON rule */
   {
@@ -282,6 +283,8 @@ test_dynamic_rules_json_rule (TestFixture *f, gconstpointer user_data)
   g_assert_cmpuint (f->apply_count, ==, 0);
   g_assert_cmpuint (f->revert_count, ==, 1);
 
+  g_object_get (dr, "n-evaluations", &n_evaluations_before, NULL);
+
   /* Add object to satisfy condition and make sure apply is triggered */
   trigger_node = create_client_node (f, "test-dynamic-rules-trigger");
   g_assert_nonnull (trigger_node);
@@ -294,6 +297,153 @@ test_dynamic_rules_json_rule (TestFixture *f, gconstpointer user_data)
   g_main_loop_run (f->base.loop);
   g_assert_cmpuint (f->apply_count, ==, 1);
   g_assert_cmpuint (f->revert_count, ==, 2);
+
+  /* The rule was only evaluated again when its condition changed */
+  g_object_get (dr, "n-evaluations", &n_evaluations, NULL);
+  g_assert_cmpuint (n_evaluations - n_evaluations_before, ==, 2);
+}
+
+#define N_MULTI_RULES 4
+
+typedef struct {
+  TestFixture *f;
+  guint32 rule_ids[N_MULTI_RULES];
+  guint apply_counts[N_MULTI_RULES];
+  guint revert_counts[N_MULTI_RULES];
+} MultiRuleData;
+
+static guint
+multi_rule_index (MultiRuleData *d, guint rule_id)
+{
+  for (guint i = 0; i < N_MULTI_RULES; i++) {
+    if (d->rule_ids[i] == rule_id)
+      return i;
+  }
+  g_assert_not_reached ();
+}
+
+static void
+on_multi_apply_actions (WpDynamicRules *rules, guint rule_id,
+    const gchar *action, WpSpaJson *value, WpGlobalProxy *subject,
+    MultiRuleData *d)
+{
+  g_assert_true (subject == d->f->subject_node);
+  d->apply_counts[multi_rule_index (d, rule_id)]++;
+  g_main_loop_quit (d->f->base.loop);
+}
+
+static void
+on_multi_revert_actions (WpDynamicRules *rules, guint rule_id,
+    const gchar *action, WpSpaJson *value, WpGlobalProxy *subject,
+    MultiRuleData *d)
+{
+  g_assert_true (subject == d->f->subject_node);
+  d->revert_counts[multi_rule_index (d, rule_id)]++;
+  g_main_loop_quit (d->f->base.loop);
+}
+
+static void
+assert_multi_rule_counts (MultiRuleData *d, const guint *apply,
+    const guint *revert)
+{
+  for (guint i = 0; i < N_MULTI_RULES; i++) {
+    g_assert_cmpuint (d->apply_counts[i], ==, apply[i]);
+    g_assert_cmpuint (d->revert_counts[i], ==, revert[i]);
+  }
+}
+
+static WpImplMetadata *
+create_trigger_metadata (TestFixture *f, const gchar *name)
+{
+  g_autoptr (WpImplMetadata) m = NULL;
+
+  m = wp_impl_metadata_new_full (f->base.client_core, name, NULL);
+  wp_object_activate (WP_OBJECT (m), WP_OBJECT_FEATURES_ALL,
+      NULL, (GAsyncReadyCallback) test_object_activate_finish_cb, &f->base);
+  g_main_loop_run (f->base.loop);
+
+  return g_steal_pointer (&m);
+}
+
+static void
+get_evaluation_counts (WpDynamicRules *dr, guint64 *n_evaluations,
+    guint64 *n_skipped)
+{
+  g_object_get (dr, "n-evaluations", n_evaluations,
+      "n-skipped-evaluations", n_skipped, NULL);
+}
+
+static void
+test_dynamic_rules_multiple_rules (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (WpDynamicRules) dr = NULL;
+  g_autoptr (WpImplMetadata) trigger = NULL;
+  MultiRuleData d = { .f = f };
+  guint64 n_evaluations_before, n_skipped_before;
+  guint64 n_evaluations, n_skipped;
+
+  dr = wp_dynamic_rules_new (f->base.core);
+  g_signal_connect (dr, "apply-actions",
+      G_CALLBACK (on_multi_apply_actions), &d);
+  g_signal_connect (dr, "revert-actions",
+      G_CALLBACK (on_multi_revert_actions), &d);
+
+  /* Rules 0 to 2 match the subject, each with its own trigger; rule 3 does
+     not match the subject, but shares the trigger of rule 0 */
+  for (guint i = 0; i < N_MULTI_RULES; i++) {
+    g_autoptr (WpSpaJson) rule_json = NULL;
+    g_autofree gchar *rule_str = g_strdup_printf (
+        "{ matches = [ { node.name = \"%s\" } ]"
+        "  conditions = [ { matches = ["
+        "      { metadata.name = \"test-trigger-%u\" } ] } ]"
+        "  actions = { test_action = true } }",
+        i < 3 ? "test-dynamic-rules-subject" : "test-dynamic-rules-other",
+        i < 3 ? i : 0);
+
+    rule_json = wp_spa_json_new_from_string (rule_str);
+    d.rule_ids[i] = wp_dynamic_rules_add_json_rule (dr, rule_json);
+    g_assert_cmpuint (d.rule_ids[i], !=, SPA_ID_INVALID);
+  }
+
+  wp_object_activate (WP_OBJECT (dr), WP_DYNAMIC_RULES_LOADED,
+      NULL, (GAsyncReadyCallback) test_object_activate_finish_cb, &f->base);
+  g_main_loop_run (f->base.loop);
+
+  /* All the matching rules are reverted, as no trigger exists yet */
+  wp_dynamic_rules_add_object (dr, f->subject_node);
+  assert_multi_rule_counts (&d,
+      (const guint[]) { 0, 0, 0, 0 }, (const guint[]) { 1, 1, 1, 0 });
+
+  /* Satisfying the condition of rule 0 only evaluates rule 0; rules 1 and 2
+     have not changed, and rule 3 does not match the subject */
+  get_evaluation_counts (dr, &n_evaluations_before, &n_skipped_before);
+  trigger = create_trigger_metadata (f, "test-trigger-0");
+  g_main_loop_run (f->base.loop);
+  assert_multi_rule_counts (&d,
+      (const guint[]) { 1, 0, 0, 0 }, (const guint[]) { 1, 1, 1, 0 });
+  get_evaluation_counts (dr, &n_evaluations, &n_skipped);
+  g_assert_cmpuint (n_evaluations - n_evaluations_before, ==, 1);
+  g_assert_cmpuint (n_skipped - n_skipped_before, ==, 3);
+
+  /* The same happens when the trigger goes away */
+  get_evaluation_counts (dr, &n_evaluations_before, &n_skipped_before);
+  g_clear_object (&trigger);
+  g_main_loop_run (f->base.loop);
+  assert_multi_rule_counts (&d,
+      (const guint[]) { 1, 0, 0, 0 }, (const guint[]) { 2, 1, 1, 0 });
+  get_evaluation_counts (dr, &n_evaluations, &n_skipped);
+  g_assert_cmpuint (n_evaluations - n_evaluations_before, ==, 1);
+  g_assert_cmpuint (n_skipped - n_skipped_before, ==, 3);
+
+  /* Satisfying the condition of rule 2 only evaluates rule 2 */
+  get_evaluation_counts (dr, &n_evaluations_before, &n_skipped_before);
+  trigger = create_trigger_metadata (f, "test-trigger-2");
+  g_main_loop_run (f->base.loop);
+  assert_multi_rule_counts (&d,
+      (const guint[]) { 1, 0, 1, 0 }, (const guint[]) { 2, 1, 1, 0 });
+  get_evaluation_counts (dr, &n_evaluations, &n_skipped);
+  g_assert_cmpuint (n_evaluations - n_evaluations_before, ==, 1);
+  g_assert_cmpuint (n_skipped - n_skipped_before, ==, 3);
 }
 
 gint
@@ -310,5 +460,9 @@ main (gint argc, gchar *argv[])
       test_dynamic_rules_setup, test_dynamic_rules_json_rule,
       test_dynamic_rules_teardown);
 
+  g_test_add ("/wp/dynamic-rules/multiple-rules", TestFixture, NULL,
+      test_dynamic_rules_setup, test_dynamic_rules_multiple_rules,
+      test_dynamic_rules_teardown);
+
   return g_test_run ();
 }
@@ -424,6 +424,338 @@ test_events_glob_deps (TestFixture *self, gconstpointer user_data)
   g_assert_true (hook_quit == self->hooks_executed->pdata [4]);
 }
 
+static void
+test_events_filter (TestFixture *self, gconstpointer user_data)
+{
+  g_autoptr (WpEventDispatcher) dispatcher = NULL;
+  g_autoptr (WpEventHook) hook = NULL;
+  const gchar **before, **after;
+
+  dispatcher = wp_event_dispatcher_get_instance (self->base.core);
+  g_assert_nonnull (dispatcher);
+
+  before = NULL;
+  after = NULL;
+  hook = wp_simple_event_hook_new ("hook-a", before, after,
+    g_cclosure_new ((GCallback) hook_a, self, NULL));
+  wp_interest_event_hook_add_interest (WP_INTEREST_EVENT_HOOK (hook),
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.type", "=s", "type1",
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "media.class", "=s", "Audio/Sink",
+    NULL);
+  wp_event_dispatcher_register_hook (dispatcher, hook);
+  g_clear_object (&hook);
+
+  before = NULL;
+  after = (const gchar *[]) { "hook-a", NULL };
+  hook = wp_simple_event_hook_new ("hook-b", before, after,
+    g_cclosure_new ((GCallback) hook_b, self, NULL));
+  wp_interest_event_hook_add_interest (WP_INTEREST_EVENT_HOOK (hook),
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.type", "=s", "type1",
+    WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "media.class", "c(ss)",
+        "Audio/Source", "Video/Source",
+    NULL);
+  wp_event_dispatcher_register_hook (dispatcher, hook);
+  g_clear_object (&hook);
+
+  /* the second interest does not define "event.subject.type" */
+  before = NULL;
+  after = (const gchar *[]) { "hook-b", NULL };
+  hook = wp_simple_event_hook_new ("hook-c", before, after,
+    g_cclosure_new ((GCallback) hook_c, self, NULL));
+  wp_interest_event_hook_add_interest (WP_INTEREST_EVENT_HOOK (hook),
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.type", "=s", "type1",
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.subject.type", "=s", "node",
+    NULL);
+  wp_interest_event_hook_add_interest (WP_INTEREST_EVENT_HOOK (hook),
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.type", "=s", "type1",
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "media.class", "#s", "Audio/*",
+    NULL);
+  wp_event_dispatcher_register_hook (dispatcher, hook);
+  g_clear_object (&hook);
+
+  before = NULL;
+  after = (const gchar *[]) { "hook-c", NULL };
+  hook = wp_simple_event_hook_new ("hook-d", before, after,
+    g_cclosure_new ((GCallback) hook_d, self, NULL));
+  wp_interest_event_hook_add_interest (WP_INTEREST_EVENT_HOOK (hook),
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.type", "=s", "type1",
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "media.class", "=s", "Audio/Sink",
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.subject.param-id", "=s", "Props",
+    NULL);
+  wp_event_dispatcher_register_hook (dispatcher, hook);
+  g_clear_object (&hook);
+
+  before = NULL;
+  after = (const gchar *[]) { "hook-a", "hook-b", "hook-c", "hook-d", NULL };
+  hook = wp_simple_event_hook_new ("hook-quit", before, after,
+    g_cclosure_new ((GCallback) hook_quit, self, NULL));
+  wp_interest_event_hook_add_interest (WP_INTEREST_EVENT_HOOK (hook),
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.type", "=s", "type1", NULL);
+  wp_event_dispatcher_register_hook (dispatcher, hook);
+  g_clear_object (&hook);
+
+  /* media.class & subject type match */
+  wp_event_dispatcher_push_event (dispatcher, wp_event_new ("type1", 10,
+      wp_properties_new (
+          "media.class", "Audio/Sink",
+          "event.subject.type", "node",
+          NULL),
+      NULL, NULL));
+
+  g_main_loop_run (self->base.loop);
+  g_assert_cmpint (self->hooks_executed->len, == , 3);
+  g_assert_true (hook_a == self->hooks_executed->pdata [0]);
+  g_assert_true (hook_c == self->hooks_executed->pdata [1]);
+  g_assert_true (hook_quit == self->hooks_executed->pdata [2]);
+  g_ptr_array_set_size (self->hooks_executed, 0);
+  g_ptr_array_set_size (self->events, 0);
+
+  /* in-list match; hook-c's second interest does not match */
+  wp_event_dispatcher_push_event (dispatcher, wp_event_new ("type1", 10,
+      wp_properties_new (
+          "media.class", "Video/Source",
+          "event.subject.type", "device",
+          NULL),
+      NULL, NULL));
+
+  g_main_loop_run (self->base.loop);
+  g_assert_cmpint (self->hooks_executed->len, == , 2);
+  g_assert_true (hook_b == self->hooks_executed->pdata [0]);
+  g_assert_true (hook_quit == self->hooks_executed->pdata [1]);
+  g_ptr_array_set_size (self->hooks_executed, 0);
+  g_ptr_array_set_size (self->events, 0);
+
+  /* all three filter keys present, hook-c matches through "#" */
+  wp_event_dispatcher_push_event (dispatcher, wp_event_new ("type1", 10,
+      wp_properties_new (
+          "media.class", "Audio/Sink",
+          "event.subject.type", "device",
+          "event.subject.param-id", "Props",
+          NULL),
+      NULL, NULL));
+
+  g_main_loop_run (self->base.loop);
+  g_assert_cmpint (self->hooks_executed->len, == , 4);
+  g_assert_true (hook_a == self->hooks_executed->pdata [0]);
+  g_assert_true (hook_c == self->hooks_executed->pdata [1]);
+  g_assert_true (hook_d == self->hooks_executed->pdata [2]);
+  g_assert_true (hook_quit == self->hooks_executed->pdata [3]);
+  g_ptr_array_set_size (self->hooks_executed, 0);
+  g_ptr_array_set_size (self->events, 0);
+
+  /* no properties at all; only the unconstrained hook runs */
+  wp_event_dispatcher_push_event (dispatcher,
+      wp_event_new ("type1", 10, NULL, NULL, NULL));
+
+  g_main_loop_run (self->base.loop);
+  g_assert_cmpint (self->hooks_executed->len, == , 1);
+  g_assert_true (hook_quit == self->hooks_executed->pdata [0]);
+}
+
+static void
+test_events_coalesce (TestFixture *self, gconstpointer user_data)
+{
+  g_autoptr (WpEventDispatcher) dispatcher = NULL;
+  g_autoptr (WpEventHook) hook = NULL;
+  g_autoptr (GObject) subject1 = g_object_new (G_TYPE_OBJECT, NULL);
+  g_autoptr (GObject) subject2 = g_object_new (G_TYPE_OBJECT, NULL);
+  WpEvent *event1, *event2, *event3, *event4, *event5;
+
+  dispatcher = wp_event_dispatcher_get_instance (self->base.core);
+  g_assert_nonnull (dispatcher);
+
+  hook = wp_simple_event_hook_new ("hook-quit", NULL, NULL,
+    g_cclosure_new ((GCallback) hook_quit, self, NULL));
+  wp_interest_event_hook_add_interest (WP_INTEREST_EVENT_HOOK (hook),
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.type", "=s", "type1", NULL);
+  wp_event_dispatcher_register_hook (dispatcher, hook);
+  g_clear_object (&hook);
+
+  wp_event_dispatcher_set_coalescing (dispatcher, "type1", TRUE);
+
+  /* event2 replaces event1; event3 has a different subject;
+     event4 has a different param-id */
+  event1 = wp_event_new ("type1", 10, NULL, NULL, subject1);
+  event2 = wp_event_new ("type1", 10, NULL, NULL, subject1);
+  event3 = wp_event_new ("type1", 10, NULL, NULL, subject2);
+  event4 = wp_event_new ("type1", 10,
+    wp_properties_new ("event.subject.param-id", "Props", NULL),
+    NULL, subject1);
+  wp_event_dispatcher_push_event (dispatcher, event1);
+  wp_event_dispatcher_push_event (dispatcher, event3);
+  wp_event_dispatcher_push_event (dispatcher, event2);
+  wp_event_dispatcher_push_event (dispatcher, event4);
+
+  /* the low priority event is dispatched last, after all the others */
+  event5 = wp_event_new ("type1", 0, NULL, NULL, NULL);
+  wp_event_dispatcher_push_event (dispatcher, event5);
+
+  for (guint i = 0; i < 4; i++)
+    g_main_loop_run (self->base.loop);
+
+  g_assert_cmpint (self->events->len, == , 4);
+  g_assert_true (event2 == self->events->pdata [0]);
+  g_assert_true (event3 == self->events->pdata [1]);
+  g_assert_true (event4 == self->events->pdata [2]);
+  g_assert_true (event5 == self->events->pdata [3]);
+  g_ptr_array_set_size (self->hooks_executed, 0);
+  g_ptr_array_set_size (self->events, 0);
+
+  /* without coalescing, both events are dispatched */
+  wp_event_dispatcher_set_coalescing (dispatcher, "type1", FALSE);
+
+  event1 = wp_event_new ("type1", 10, NULL, NULL, subject1);
+  event2 = wp_event_new ("type1", 10, NULL, NULL, subject1);
+  wp_event_dispatcher_push_event (dispatcher, event1);
+  wp_event_dispatcher_push_event (dispatcher, event2);
+
+  for (guint i = 0; i < 2; i++)
+    g_main_loop_run (self->base.loop);
+
+  g_assert_cmpint (self->events->len, == , 2);
+  g_assert_true (event1 == self->events->pdata [0]);
+  g_assert_true (event2 == self->events->pdata [1]);
+}
+
+static void
+test_events_stats (TestFixture *self, gconstpointer user_data)
+{
+  g_autoptr (WpEventDispatcher) dispatcher = NULL;
+  g_autoptr (WpEventHook) hook = NULL;
+  g_autoptr (WpSpaJson) stats = NULL;
+  g_autoptr (WpSpaJson) hooks = NULL;
+  g_autoptr (WpSpaJson) events = NULL;
+  g_autoptr (WpSpaJson) json = NULL;
+  g_autofree gchar *str = NULL;
+  gint n = 0;
+
+  dispatcher = wp_event_dispatcher_get_instance (self->base.core);
+  g_assert_nonnull (dispatcher);
+
+  hook = wp_simple_event_hook_new ("hook-a", NULL, NULL,
+    g_cclosure_new ((GCallback) hook_a, self, NULL));
+  wp_interest_event_hook_add_interest (WP_INTEREST_EVENT_HOOK (hook),
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.type", "=s", "type1", NULL);
+  wp_event_dispatcher_register_hook (dispatcher, hook);
+  g_clear_object (&hook);
+
+  hook = wp_simple_event_hook_new ("hook-quit",
+    NULL, (const gchar *[]) { "hook-a", NULL },
+    g_cclosure_new ((GCallback) hook_quit, self, NULL));
+  wp_interest_event_hook_add_interest (WP_INTEREST_EVENT_HOOK (hook),
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.type", "=s", "type1", NULL);
+  wp_event_dispatcher_register_hook (dispatcher, hook);
+  g_clear_object (&hook);
+
+  for (guint i = 0; i < 3; i++) {
+    wp_event_dispatcher_push_event (dispatcher,
+        wp_event_new ("type1", 10, NULL, NULL, NULL));
+    g_main_loop_run (self->base.loop);
+  }
+  g_assert_cmpint (self->hooks_executed->len, == , 6);
+
+  stats = wp_event_dispatcher_get_stats (dispatcher);
+  g_assert_nonnull (stats);
+  g_assert_true (wp_spa_json_object_get (stats,
+      "hooks", "J", &hooks,
+      "events", "J", &events,
+      NULL));
+
+  g_assert_true (wp_spa_json_is_array (hooks));
+  g_assert_true (wp_spa_json_parse_array (hooks, "J", &json, NULL));
+  g_assert_true (wp_spa_json_object_get (json, "invocations", "i", &n, NULL));
+  g_assert_cmpint (n, == , 3);
+  g_clear_pointer (&json, wp_spa_json_unref);
+
+  g_assert_true (wp_spa_json_parse_array (events, "J", &json, NULL));
+  g_assert_true (wp_spa_json_object_get (json,
+      "type", "s", &str,
+      "count", "i", &n,
+      NULL));
+  g_assert_cmpstr (str, == , "type1");
+  g_assert_cmpint (n, == , 3);
+  g_clear_pointer (&json, wp_spa_json_unref);
+  g_clear_pointer (&hooks, wp_spa_json_unref);
+  g_clear_pointer (&events, wp_spa_json_unref);
+  g_clear_pointer (&stats, wp_spa_json_unref);
+
+  wp_event_dispatcher_reset_stats (dispatcher);
+  stats = wp_event_dispatcher_get_stats (dispatcher);
+  g_assert_true (wp_spa_json_object_get (stats, "hooks", "J", &hooks, NULL));
+  g_assert_false (wp_spa_json_parse_array (hooks, "J", &json, NULL));
+}
+
+static void
+test_events_late_registration (TestFixture *self, gconstpointer user_data)
+{
+  g_autoptr (WpEventDispatcher) dispatcher = NULL;
+  g_autoptr (WpEventHook) hook = NULL;
+  g_autoptr (WpEventHook) hook_c_obj = NULL;
+
+  dispatcher = wp_event_dispatcher_get_instance (self->base.core);
+  g_assert_nonnull (dispatcher);
+
+  hook = wp_simple_event_hook_new ("hook-a", NULL, NULL,
+    g_cclosure_new ((GCallback) hook_a, self, NULL));
+  wp_interest_event_hook_add_interest (WP_INTEREST_EVENT_HOOK (hook),
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.type", "=s", "type1", NULL);
+  wp_event_dispatcher_register_hook (dispatcher, hook);
+  g_clear_object (&hook);
+
+  /* undefined hook, added to all the event types */
+  hook = wp_simple_event_hook_new ("hook-quit",
+    NULL, (const gchar *[]) { "hook-a", "hook-b", "hook-c", NULL },
+    g_cclosure_new ((GCallback) hook_quit, self, NULL));
+  wp_event_dispatcher_register_hook (dispatcher, hook);
+  g_clear_object (&hook);
+
+  wp_event_dispatcher_push_event (dispatcher,
+      wp_event_new ("type1", 10, NULL, NULL, NULL));
+  g_main_loop_run (self->base.loop);
+  g_assert_cmpint (self->hooks_executed->len, == , 2);
+  g_assert_true (hook_a == self->hooks_executed->pdata [0]);
+  g_assert_true (hook_quit == self->hooks_executed->pdata [1]);
+  g_ptr_array_set_size (self->hooks_executed, 0);
+
+  /* register more hooks after the first dispatch; they must be sorted
+     together with the already sorted ones */
+  hook = wp_simple_event_hook_new ("hook-b",
+    (const gchar *[]) { "hook-a", NULL }, NULL,
+    g_cclosure_new ((GCallback) hook_b, self, NULL));
+  wp_interest_event_hook_add_interest (WP_INTEREST_EVENT_HOOK (hook),
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.type", "=s", "type1", NULL);
+  wp_event_dispatcher_register_hook (dispatcher, hook);
+  g_clear_object (&hook);
+
+  hook_c_obj = wp_simple_event_hook_new ("hook-c",
+    (const gchar *[]) { "hook-b", NULL }, NULL,
+    g_cclosure_new ((GCallback) hook_c, self, NULL));
+  wp_interest_event_hook_add_interest (WP_INTEREST_EVENT_HOOK (hook_c_obj),
+    WP_CONSTRAINT_TYPE_PW_PROPERTY, "event.type", "=s", "type1", NULL);
+  wp_event_dispatcher_register_hook (dispatcher, hook_c_obj);
+
+  wp_event_dispatcher_push_event (dispatcher,
+      wp_event_new ("type1", 10, NULL, NULL, NULL));
+  g_main_loop_run (self->base.loop);
+  g_assert_cmpint (self->hooks_executed->len, == , 4);
+  g_assert_true (hook_c == self->hooks_executed->pdata [0]);
+  g_assert_true (hook_b == self->hooks_executed->pdata [1]);
+  g_assert_true (hook_a == self->hooks_executed->pdata [2]);
+  g_assert_true (hook_quit == self->hooks_executed->pdata [3]);
+  g_ptr_array_set_size (self->hooks_executed, 0);
+
+  /* unregistering before the next dispatch */
+  wp_event_dispatcher_unregister_hook (dispatcher, hook_c_obj);
+
+  wp_event_dispatcher_push_event (dispatcher,
+      wp_event_new ("type1", 10, NULL, NULL, NULL));
+  g_main_loop_run (self->base.loop);
+  g_assert_cmpint (self->hooks_executed->len, == , 3);
+  g_assert_true (hook_b == self->hooks_executed->pdata [0]);
+  g_assert_true (hook_a == self->hooks_executed->pdata [1]);
+  g_assert_true (hook_quit == self->hooks_executed->pdata [2]);
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -438,6 +770,14 @@ main (gint argc, gchar *argv[])
     test_events_setup, test_events_async_hook, test_events_teardown);
   g_test_add ("/wp/events/glob_deps", TestFixture, NULL,
     test_events_setup, test_events_glob_deps, test_events_teardown);
+  g_test_add ("/wp/events/filter", TestFixture, NULL,
+    test_events_setup, test_events_filter, test_events_teardown);
+  g_test_add ("/wp/events/coalesce", TestFixture, NULL,
+    test_events_setup, test_events_coalesce, test_events_teardown);
+  g_test_add ("/wp/events/stats", TestFixture, NULL,
+    test_events_setup, test_events_stats, test_events_teardown);
+  g_test_add ("/wp/events/late_registration", TestFixture, NULL,
+    test_events_setup, test_events_late_registration, test_events_teardown);
 
   return g_test_run ();
 }
@@ -333,6 +333,167 @@ test_match_rules (void)
   }
 }
 
+static gboolean
+collect_actions_cb (gpointer data, const gchar * action, WpSpaJson * value,
+    GError ** error)
+{
+  GString *str = data;
+  g_string_append_printf (str, "%s;", action);
+  return TRUE;
+}
+
+static gchar *
+collect_actions (WpMatchRules * rules, WpProperties * props)
+{
+  g_autoptr (GError) error = NULL;
+  GString *str = g_string_new (NULL);
+  g_assert_true (wp_match_rules_match (rules, props, collect_actions_cb, str,
+      &error));
+  g_assert_no_error (error);
+  return g_string_free (str, FALSE);
+}
+
+static void
+test_match_rules_compiled (void)
+{
+  static const gchar * const rules_json_string =
+      "["
+      "  { matches = [ { node.name = \"a\" media.class = \"Audio/Sink\" } ]"
+      "    actions = { a = 1 } }"
+      "  { matches = [ { node.name = \"b\" } { device.name = \"~usb.*\" } ]"
+      "    actions = { b = 1 } }"
+      "  { matches = [ { node.name = \"!a\" media.class = \"Audio/Sink\" } ]"
+      "    actions = { not-a = 1 } }"
+      "  { matches = [ { node.nick = null node.name = \"~.*\" } ]"
+      "    actions = { no-nick = 1 } }"
+      "  { matches = [ { } ] actions = { never = 1 } }"
+      "  { matches = [ { media.class = \"Audio/Sink\" } ] }"
+      "  { matches = [ { \"node.\\u0061lias\" = \"esc\\\"aped\" } ]"
+      "    actions = { escaped = 1 } }"
+      "]";
+
+  g_autoptr (WpSpaJson) json = wp_spa_json_new_wrap_stringn (rules_json_string,
+      strlen (rules_json_string));
+  g_autoptr (WpMatchRules) rules = wp_match_rules_new (json);
+  g_assert_nonnull (rules);
+
+  /* compiled rules are cached on the JSON object */
+  {
+    g_autoptr (WpMatchRules) rules2 = wp_match_rules_new (json);
+    g_assert_true (rules == rules2);
+  }
+
+  {
+    g_autoptr (WpProperties) props = wp_properties_new (
+        "node.name", "a", "media.class", "Audio/Sink", NULL);
+    g_autofree gchar *res = collect_actions (rules, props);
+    g_assert_cmpstr (res, ==, "a;no-nick;");
+  }
+  {
+    g_autoptr (WpProperties) props = wp_properties_new (
+        "node.name", "c", "media.class", "Audio/Sink", "node.nick", "C",
+        NULL);
+    g_autofree gchar *res = collect_actions (rules, props);
+    g_assert_cmpstr (res, ==, "not-a;");
+  }
+  {
+    g_autoptr (WpProperties) props = wp_properties_new (
+        "device.name", "usb-mic", "node.nick", "mic", NULL);
+    g_autofree gchar *res = collect_actions (rules, props);
+    g_assert_cmpstr (res, ==, "b;");
+  }
+  {
+    g_autoptr (WpProperties) props = wp_properties_new (
+        "node.name", "b", "node.alias", "esc\"aped", NULL);
+    g_autofree gchar *res = collect_actions (rules, props);
+    g_assert_cmpstr (res, ==, "b;no-nick;escaped;");
+  }
+  {
+    g_autoptr (WpProperties) props = wp_properties_new_empty ();
+    g_autofree gchar *res = collect_actions (rules, props);
+    g_assert_cmpstr (res, ==, "");
+  }
+
+  /* not an array: nothing matches */
+  {
+    g_autoptr (WpSpaJson) obj = wp_spa_json_new_from_string ("{ a = b }");
+    g_autoptr (WpMatchRules) empty = wp_match_rules_new (obj);
+    g_autoptr (WpProperties) props = wp_properties_new ("a", "b", NULL);
+    g_autofree gchar *res = collect_actions (empty, props);
+    g_assert_cmpstr (res, ==, "");
+  }
+}
+
+static void
+test_match_rules_chained (void)
+{
+  /* each rule is matched against the properties as updated by the actions
+     of the rules before it */
+  static const gchar * const rules_json_string =
+      "["
+      "  { matches = [ { node.name = \"a\" } ]"
+      "    actions = { update-props = { node.nick = \"A\" } } }"
+      "  { matches = [ { node.nick = \"A\" } ]"
+      "    actions = { update-props = { node.description = \"Nick A\" } } }"
+      "  { matches = [ { node.nick = null } ]"
+      "    actions = { update-props = { node.description = \"No nick\" } } }"
+      "  { matches = [ { node.description = \"~^Nick\" } ]"
+      "    actions = { update-props = { priority.session = 100 } } }"
+      "]";
+
+  g_autoptr (WpSpaJson) json = wp_spa_json_new_wrap_stringn (rules_json_string,
+      strlen (rules_json_string));
+  g_autoptr (WpMatchRules) rules = wp_match_rules_new (json);
+
+  {
+    g_autoptr (WpProperties) props = wp_properties_new (
+        "node.name", "a", NULL);
+    g_assert_cmpint (wp_match_rules_update_properties (rules, props), ==, 3);
+    g_assert_cmpstr (wp_properties_get (props, "node.nick"), ==, "A");
+    g_assert_cmpstr (wp_properties_get (props, "node.description"), ==,
+        "Nick A");
+    g_assert_cmpstr (wp_properties_get (props, "priority.session"), ==, "100");
+  }
+  {
+    g_autoptr (WpProperties) props = wp_properties_new (
+        "node.name", "b", NULL);
+    g_assert_cmpint (wp_match_rules_update_properties (rules, props), ==, 1);
+    g_assert_null (wp_properties_get (props, "node.nick"));
+    g_assert_cmpstr (wp_properties_get (props, "node.description"), ==,
+        "No nick");
+    g_assert_null (wp_properties_get (props, "priority.session"));
+  }
+}
+
+static void
+test_match_rules_invalid_regex (void)
+{
+  /* like in pw_conf_match_rules(), an invalid regex never matches, so its
+     negation always does, even when the property is not set */
+  static const gchar * const rules_json_string =
+      "["
+      "  { matches = [ { node.name = \"~[a-\" } ] actions = { regex = 1 } }"
+      "  { matches = [ { node.name = \"!~[a-\" } ] actions = { not-regex = 1 } }"
+      "]";
+
+  g_autoptr (WpSpaJson) json = wp_spa_json_new_wrap_stringn (rules_json_string,
+      strlen (rules_json_string));
+  g_autoptr (WpMatchRules) rules = wp_match_rules_new (json);
+  g_assert_nonnull (rules);
+
+  {
+    g_autoptr (WpProperties) props = wp_properties_new (
+        "node.name", "[a-", NULL);
+    g_autofree gchar *res = collect_actions (rules, props);
+    g_assert_cmpstr (res, ==, "not-regex;");
+  }
+  {
+    g_autoptr (WpProperties) props = wp_properties_new_empty ();
+    g_autofree gchar *res = collect_actions (rules, props);
+    g_assert_cmpstr (res, ==, "not-regex;");
+  }
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -342,6 +503,12 @@ main (gint argc, gchar *argv[])
   g_test_add_func ("/wp/json-utils/match_rules_update_props",
       test_match_rules_update_properties);
   g_test_add_func ("/wp/json-utils/match_rules", test_match_rules);
+  g_test_add_func ("/wp/json-utils/match_rules_compiled",
+      test_match_rules_compiled);
+  g_test_add_func ("/wp/json-utils/match_rules_chained",
+      test_match_rules_chained);
+  g_test_add_func ("/wp/json-utils/match_rules_invalid_regex",
+      test_match_rules_invalid_regex);
 
   return g_test_run ();
 }
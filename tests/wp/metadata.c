@@ -546,6 +546,244 @@ test_metadata_basic (TestFixture *fixture, gconstpointer data)
   g_assert_null (fixture->proxy_metadata);
 }
 
+static void
+assert_metadata_keys (WpMetadata *metadata, guint32 subject,
+    const gchar * const *expected)
+{
+  g_autoptr (WpIterator) iter = wp_metadata_new_iterator (metadata, subject);
+  g_auto (GValue) val = G_VALUE_INIT;
+  guint i = 0;
+
+  for (; wp_iterator_next (iter, &val); g_value_unset (&val)) {
+    WpMetadataItem *mi = g_value_get_boxed (&val);
+    g_autofree gchar *str = g_strdup_printf ("%u:%s",
+        wp_metadata_item_get_subject (mi), wp_metadata_item_get_key (mi));
+    g_assert_nonnull (expected[i]);
+    g_assert_cmpstr (str, ==, expected[i]);
+    i++;
+  }
+  g_assert_null (expected[i]);
+}
+
+static void
+test_metadata_index (TestFixture *fixture, gconstpointer data)
+{
+  g_autoptr (WpMetadata) metadata =
+      WP_METADATA (wp_impl_metadata_new (fixture->base.core));
+  const gchar *type = NULL;
+
+  for (guint i = 0; i < 100; i++) {
+    g_autofree gchar *value = g_strdup_printf ("%u", i);
+    wp_metadata_set (metadata, i % 3, "target.object", NULL, value);
+    wp_metadata_set (metadata, i, "target.node", "Spa:Id", value);
+  }
+
+  /* updating an item keeps its position */
+  wp_metadata_set (metadata, 0, "target.object", NULL, "updated");
+  wp_metadata_set (metadata, 1, "a.key", NULL, "a.value");
+  wp_metadata_set (metadata, 50, "b.key", NULL, "b.value");
+
+  g_assert_cmpstr (wp_metadata_find (metadata, 0, "target.object", &type),
+      ==, "updated");
+  g_assert_cmpstr (type, ==, "string");
+  g_assert_cmpstr (wp_metadata_find (metadata, 2, "target.object", NULL),
+      ==, "98");
+  g_assert_cmpstr (wp_metadata_find (metadata, 42, "target.node", &type),
+      ==, "42");
+  g_assert_cmpstr (type, ==, "Spa:Id");
+  g_assert_null (wp_metadata_find (metadata, 42, "target.object", NULL));
+  g_assert_null (wp_metadata_find (metadata, 100, "target.node", NULL));
+
+  {
+    const gchar * const expected[] = {
+      "1:target.object", "1:target.node", "1:a.key", NULL
+    };
+    assert_metadata_keys (metadata, 1, expected);
+  }
+
+  /* remove a single key */
+  wp_metadata_set (metadata, 1, "target.node", NULL, NULL);
+  g_assert_null (wp_metadata_find (metadata, 1, "target.node", NULL));
+  {
+    const gchar * const expected[] = { "1:target.object", "1:a.key", NULL };
+    assert_metadata_keys (metadata, 1, expected);
+  }
+
+  /* remove subjects */
+  for (guint i = 1; i < 100; i++)
+    wp_metadata_set (metadata, i, NULL, NULL, NULL);
+  g_assert_null (wp_metadata_find (metadata, 50, "b.key", NULL));
+  {
+    const gchar * const expected[] = { NULL };
+    assert_metadata_keys (metadata, 50, expected);
+  }
+  {
+    const gchar * const expected[] = {
+      "0:target.object", "0:target.node", NULL
+    };
+    assert_metadata_keys (metadata, PW_ID_ANY, expected);
+  }
+
+  /* add again after removal */
+  wp_metadata_set (metadata, 50, "b.key", NULL, "new.value");
+  g_assert_cmpstr (wp_metadata_find (metadata, 50, "b.key", NULL),
+      ==, "new.value");
+  {
+    const gchar * const expected[] = {
+      "0:target.object", "0:target.node", "50:b.key", NULL
+    };
+    assert_metadata_keys (metadata, PW_ID_ANY, expected);
+  }
+}
+
+static void
+on_metadata_changed_clear_subject (WpMetadata * metadata, guint32 subject,
+    const gchar * key, const gchar * type, const gchar * value, gpointer data)
+{
+  if (!g_strcmp0 (key, "trigger"))
+    wp_metadata_set (metadata, GPOINTER_TO_UINT (data), NULL, NULL, NULL);
+}
+
+static gboolean
+fold_remove_next_subject (const GValue * item, GValue * ret, gpointer data)
+{
+  WpMetadataItem *mi = g_value_get_boxed (item);
+  WpMetadata *metadata = data;
+  guint32 subject = wp_metadata_item_get_subject (mi);
+
+  g_value_set_int (ret, g_value_get_int (ret) + 1);
+  wp_metadata_set (metadata, subject + 1, NULL, NULL, NULL);
+  return TRUE;
+}
+
+static void
+test_metadata_remove_while_iterating (TestFixture *fixture,
+    gconstpointer data)
+{
+  g_autoptr (WpMetadata) metadata =
+      WP_METADATA (wp_impl_metadata_new (fixture->base.core));
+  g_autoptr (WpIterator) it = NULL;
+  g_auto (GValue) val = G_VALUE_INIT;
+  g_auto (GValue) ret = G_VALUE_INIT;
+  WpMetadataItem *mi;
+
+  wp_metadata_set (metadata, 1, "a", NULL, "1a");
+  wp_metadata_set (metadata, 1, "b", NULL, "1b");
+  wp_metadata_set (metadata, 2, "c", NULL, "2c");
+  wp_metadata_set (metadata, 3, "d", NULL, "3d");
+  wp_metadata_set (metadata, 4, "e", NULL, "4e");
+
+  it = wp_metadata_new_iterator (metadata, PW_ID_ANY);
+  g_assert_true (wp_iterator_next (it, &val));
+  mi = g_value_get_boxed (&val);
+  g_assert_cmpstr (wp_metadata_item_get_key (mi), ==, "a");
+
+  /* remove the current and the next item; the current item stays valid */
+  wp_metadata_set (metadata, 1, NULL, NULL, NULL);
+  g_assert_cmpuint (wp_metadata_item_get_subject (mi), ==, 1);
+  g_assert_cmpstr (wp_metadata_item_get_key (mi), ==, "a");
+  g_assert_cmpstr (wp_metadata_item_get_value (mi), ==, "1a");
+  g_value_unset (&val);
+
+  g_assert_true (wp_iterator_next (it, &val));
+  mi = g_value_get_boxed (&val);
+  g_assert_cmpstr (wp_metadata_item_get_key (mi), ==, "c");
+
+  /* updating the current item keeps the value that was returned */
+  wp_metadata_set (metadata, 2, "c", NULL, "2c-updated");
+  g_assert_cmpstr (wp_metadata_item_get_value (mi), ==, "2c");
+  g_assert_cmpstr (wp_metadata_item_get_value_type (mi), ==, "string");
+  g_assert_cmpstr (wp_metadata_find (metadata, 2, "c", NULL), ==,
+      "2c-updated");
+
+  /* remove items from a signal handler, and add one at the end */
+  g_signal_connect (metadata, "changed",
+      G_CALLBACK (on_metadata_changed_clear_subject), GUINT_TO_POINTER (3));
+  wp_metadata_set (metadata, 2, "trigger", NULL, "x");
+  g_signal_handlers_disconnect_by_func (metadata,
+      on_metadata_changed_clear_subject, GUINT_TO_POINTER (3));
+  wp_metadata_set (metadata, 2, "c", NULL, NULL);
+  g_value_unset (&val);
+
+  g_assert_true (wp_iterator_next (it, &val));
+  mi = g_value_get_boxed (&val);
+  g_assert_cmpstr (wp_metadata_item_get_key (mi), ==, "e");
+  g_value_unset (&val);
+  g_assert_false (wp_iterator_next (it, &val));
+
+  /* a reset picks up the current items */
+  {
+    const gchar * const expected[] = { "4:e", "2:trigger", NULL };
+    assert_metadata_keys (metadata, PW_ID_ANY, expected);
+  }
+
+  /* remove items from a fold callback */
+  wp_metadata_set (metadata, 5, "f", NULL, "5f");
+  wp_metadata_set (metadata, 6, "g", NULL, "6g");
+  g_clear_pointer (&it, wp_iterator_unref);
+  it = wp_metadata_new_iterator (metadata, PW_ID_ANY);
+  g_value_init (&ret, G_TYPE_INT);
+  g_assert_true (wp_iterator_fold (it, fold_remove_next_subject, &ret,
+      metadata));
+  /* 4:e removes 5:f, 2:trigger removes 3 (nothing), 6:g removes 7 */
+  g_assert_cmpint (g_value_get_int (&ret), ==, 3);
+  {
+    const gchar * const expected[] = { "4:e", "2:trigger", "6:g", NULL };
+    assert_metadata_keys (metadata, PW_ID_ANY, expected);
+  }
+}
+
+static void
+test_metadata_find_any_subject (TestFixture *fixture, gconstpointer data)
+{
+  g_autoptr (WpMetadata) metadata =
+      WP_METADATA (wp_impl_metadata_new (fixture->base.core));
+  const gchar *type = NULL;
+
+  wp_metadata_set (metadata, 7, "other", NULL, "7");
+  wp_metadata_set (metadata, 5, "key", "Spa:Id", "5");
+  wp_metadata_set (metadata, 3, "key", NULL, "3");
+
+  /* PW_ID_ANY finds the first item with the key, of any subject */
+  g_assert_cmpstr (wp_metadata_find (metadata, PW_ID_ANY, "key", &type),
+      ==, "5");
+  g_assert_cmpstr (type, ==, "Spa:Id");
+  g_assert_cmpstr (wp_metadata_find (metadata, PW_ID_ANY, "other", NULL),
+      ==, "7");
+  g_assert_null (wp_metadata_find (metadata, PW_ID_ANY, "missing", NULL));
+
+  wp_metadata_set (metadata, 5, "key", NULL, NULL);
+  g_assert_cmpstr (wp_metadata_find (metadata, PW_ID_ANY, "key", &type),
+      ==, "3");
+  g_assert_cmpstr (type, ==, "string");
+}
+
+static void
+test_metadata_destroy_with_items (TestFixture *fixture, gconstpointer data)
+{
+  WpMetadata *metadata;
+
+  /* finalized while holding items of several subjects */
+  metadata = WP_METADATA (wp_impl_metadata_new (fixture->base.core));
+  for (guint i = 0; i < 10; i++) {
+    g_autofree gchar *value = g_strdup_printf ("%u", i);
+    wp_metadata_set (metadata, i % 3, value, NULL, value);
+  }
+  g_clear_object (&metadata);
+
+  /* destroyed while exported and holding items */
+  metadata = WP_METADATA (wp_impl_metadata_new (fixture->base.core));
+  wp_object_activate (WP_OBJECT (metadata), WP_OBJECT_FEATURES_ALL, NULL,
+      (GAsyncReadyCallback) test_object_activate_finish_cb, &fixture->base);
+  g_main_loop_run (fixture->base.loop);
+  for (guint i = 0; i < 10; i++) {
+    g_autofree gchar *value = g_strdup_printf ("%u", i);
+    wp_metadata_set (metadata, i % 3, value, NULL, value);
+  }
+  g_assert_cmpstr (wp_metadata_find (metadata, 1, "4", NULL), ==, "4");
+  g_clear_object (&metadata);
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -554,6 +792,17 @@ main (gint argc, gchar *argv[])
 
   g_test_add ("/wp/metadata/basic", TestFixture, NULL,
       test_metadata_setup, test_metadata_basic, test_metadata_teardown);
+  g_test_add ("/wp/metadata/index", TestFixture, NULL,
+      test_metadata_setup, test_metadata_index, test_metadata_teardown);
+  g_test_add ("/wp/metadata/remove-while-iterating", TestFixture, NULL,
+      test_metadata_setup, test_metadata_remove_while_iterating,
+      test_metadata_teardown);
+  g_test_add ("/wp/metadata/find-any-subject", TestFixture, NULL,
+      test_metadata_setup, test_metadata_find_any_subject,
+      test_metadata_teardown);
+  g_test_add ("/wp/metadata/destroy-with-items", TestFixture, NULL,
+      test_metadata_setup, test_metadata_destroy_with_items,
+      test_metadata_teardown);
 
   return g_test_run ();
 }
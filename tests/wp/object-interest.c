@@ -698,6 +698,33 @@ test_object_interest_constraint_matches (TestFixture * f, gconstpointer data)
   TEST_EXPECT_NO_MATCH (i);
 }
 
+static void
+test_object_interest_revalidate (TestFixture * f, gconstpointer data)
+{
+  g_autoptr (WpObjectInterest) i = NULL;
+
+  /* the compiled constraints are reused across matches */
+  i = wp_object_interest_new (TEST_TYPE_A,
+      WP_CONSTRAINT_TYPE_G_PROPERTY, "test-string", "#s", "to*",
+      WP_CONSTRAINT_TYPE_G_PROPERTY, "test-uint", "c(uuu)", 10, 50, 90,
+      NULL);
+  g_assert_true (wp_object_interest_matches (i, f->object));
+  g_assert_true (wp_object_interest_matches (i, f->object));
+
+  /* adding a constraint after a match compiles the interest again */
+  wp_object_interest_add_constraint (i, WP_CONSTRAINT_TYPE_G_PROPERTY,
+      "test-int", WP_CONSTRAINT_VERB_IN_RANGE, g_variant_new ("(ii)", 0, 10));
+  g_assert_false (wp_object_interest_matches (i, f->object));
+  g_clear_pointer (&i, wp_object_interest_unref);
+
+  i = wp_object_interest_new (TEST_TYPE_A,
+      WP_CONSTRAINT_TYPE_G_PROPERTY, "test-string", "#s", "to*", NULL);
+  g_assert_true (wp_object_interest_matches (i, f->object));
+  wp_object_interest_add_constraint (i, WP_CONSTRAINT_TYPE_G_PROPERTY,
+      "test-int", WP_CONSTRAINT_VERB_IN_RANGE, g_variant_new ("(ii)", -40, 0));
+  TEST_EXPECT_MATCH (i);
+}
+
 static void
 test_object_interest_constraint_present_absent (TestFixture * f,
     gconstpointer data)
@@ -911,6 +938,12 @@ main (int argc, char *argv[])
       test_object_interest_constraint_matches,
       test_object_interest_teardown);
 
+  g_test_add ("/wp/object-interest/revalidate",
+      TestFixture, NULL,
+      test_object_interest_setup,
+      test_object_interest_revalidate,
+      test_object_interest_teardown);
+
   g_test_add ("/wp/object-interest/present-absent",
       TestFixture, NULL,
       test_object_interest_setup,
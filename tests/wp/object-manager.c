@@ -162,6 +162,99 @@ test_om_iterate_remove (TestFixture *f, gconstpointer user_data)
       WP_CONSTRAINT_TYPE_PW_PROPERTY, "property1", "=s", "1234", NULL));
 }
 
+static void
+test_om_lookup_index (TestFixture *f, gconstpointer user_data)
+{
+  g_autoptr (WpObjectManager) om = NULL;
+  g_autoptr (WpIterator) it = NULL;
+  g_auto (GValue) value = G_VALUE_INIT;
+  guint32 first_id = SPA_ID_INVALID;
+  guint32 last_id = SPA_ID_INVALID;
+  guint n_checked = 0;
+
+  om = wp_object_manager_new ();
+  wp_object_manager_add_interest (om, WP_TYPE_GLOBAL_PROXY, NULL);
+  test_ensure_object_manager_is_installed (om, f->base.core, f->base.loop);
+  g_assert_cmpuint (wp_object_manager_get_n_objects (om), >, 0);
+
+  /* every object must be found through the indexed subjects,
+     regardless of the type of the constraint value */
+  it = wp_object_manager_new_iterator (om);
+  for (; wp_iterator_next (it, &value); g_value_unset (&value)) {
+    WpGlobalProxy *proxy = g_value_get_object (&value);
+    g_autoptr (WpProperties) props =
+        wp_global_proxy_get_global_properties (proxy);
+    const gchar *serial = wp_properties_get (props, PW_KEY_OBJECT_SERIAL);
+    g_autoptr (WpGlobalProxy) found = NULL;
+
+    last_id = wp_proxy_get_bound_id (WP_PROXY (proxy));
+    if (first_id == SPA_ID_INVALID)
+      first_id = last_id;
+
+    found = wp_object_manager_lookup (om, WP_TYPE_GLOBAL_PROXY,
+        WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", last_id, NULL);
+    g_assert_true (found == proxy);
+    g_clear_object (&found);
+
+    found = wp_object_manager_lookup (om, WP_TYPE_GLOBAL_PROXY,
+        WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, PW_KEY_OBJECT_ID,
+        "=x", (gint64) last_id, NULL);
+    g_assert_true (found == proxy);
+    g_clear_object (&found);
+
+    found = wp_object_manager_lookup (om, WP_TYPE_GLOBAL_PROXY,
+        WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, PW_KEY_OBJECT_ID,
+        "c(uu)", last_id, G_MAXUINT32 - 1, NULL);
+    g_assert_true (found == proxy);
+    g_clear_object (&found);
+
+    if (serial) {
+      found = wp_object_manager_lookup (om, WP_TYPE_GLOBAL_PROXY,
+          WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, PW_KEY_OBJECT_SERIAL,
+          "=s", serial, NULL);
+      g_assert_true (found == proxy);
+      g_clear_object (&found);
+    }
+
+    n_checked++;
+  }
+  g_assert_cmpuint (n_checked, ==, wp_object_manager_get_n_objects (om));
+
+  /* with several matches, the first managed object is found first,
+     regardless of the order of the values in the constraint */
+  if (first_id != last_id) {
+    g_autoptr (WpGlobalProxy) found = wp_object_manager_lookup (om,
+        WP_TYPE_GLOBAL_PROXY,
+        WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "c(uu)", last_id, first_id,
+        NULL);
+    g_assert_nonnull (found);
+    g_assert_cmpuint (wp_proxy_get_bound_id (WP_PROXY (found)), ==, first_id);
+  }
+
+  /* values that do not exist must not match */
+  g_assert_null (wp_object_manager_lookup (om, WP_TYPE_GLOBAL_PROXY,
+      WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", G_MAXUINT32 - 1, NULL));
+
+  /* other constraints must still be checked on the indexed candidates */
+  g_assert_null (wp_object_manager_lookup (om, WP_TYPE_GLOBAL_PROXY,
+      WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", last_id,
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, PW_KEY_OBJECT_ID, "-", NULL));
+
+  /* a user-declared index, added while objects are already managed */
+  wp_object_manager_add_index (om, WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY,
+      PW_KEY_OBJECT_PATH);
+  {
+    g_autoptr (WpGlobalProxy) found = wp_object_manager_lookup (om,
+        WP_TYPE_GLOBAL_PROXY,
+        WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, PW_KEY_OBJECT_ID, "=u", last_id,
+        NULL);
+    g_assert_nonnull (found);
+  }
+  g_assert_null (wp_object_manager_lookup (om, WP_TYPE_GLOBAL_PROXY,
+      WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, PW_KEY_OBJECT_PATH, "=s",
+      "this-path-does-not-exist", NULL));
+}
+
 gint
 main (gint argc, gchar *argv[])
 {
@@ -172,6 +265,8 @@ main (gint argc, gchar *argv[])
       test_om_setup, test_om_interest_on_pw_props, test_om_teardown);
   g_test_add ("/wp/om/iterate_remove", TestFixture, NULL,
       test_om_setup, test_om_iterate_remove, test_om_teardown);
+  g_test_add ("/wp/om/lookup-index", TestFixture, NULL,
+      test_om_setup, test_om_lookup_index, test_om_teardown);
 
   return g_test_run ();
 }
@@ -0,0 +1,291 @@
+/* WirePlumber
+ *
+ * Copyright © 2026 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "../common/base-test-fixture.h"
+
+#include <pipewire/global.h>
+
+/*
+ * The permission manager only sends the permissions that differ from the ones
+ * it sent last. These tests record, on the server side, every
+ * update_permissions() call that a client object receives, so that the exact
+ * deltas can be checked.
+ */
+
+#define MAX_HOOKS 4
+
+typedef struct {
+  WpBaseTestFixture base;
+
+  /* server side, only accessed with the server lock held */
+  struct spa_hook hooks[MAX_HOOKS];
+  guint n_hooks;
+  GPtrArray *updates;
+} TestFixture;
+
+static void
+test_permission_manager_setup (TestFixture * f, gconstpointer data)
+{
+  wp_base_test_fixture_setup (&f->base, WP_BASE_TEST_FLAG_CLIENT_CORE);
+  f->updates = g_ptr_array_new_with_free_func (g_free);
+}
+
+static void
+test_permission_manager_teardown (TestFixture * f, gconstpointer data)
+{
+  wp_base_test_fixture_teardown (&f->base);
+  g_clear_pointer (&f->updates, g_ptr_array_unref);
+}
+
+static void
+append_permission (GString * str, const struct pw_permission * p)
+{
+  if (str->len > 0)
+    g_string_append_c (str, ' ');
+
+  if (p->id == PW_ID_ANY)
+    g_string_append (str, "any:");
+  else
+    g_string_append_printf (str, "%u:", p->id);
+
+  if (p->permissions == PW_PERM_INVALID) {
+    g_string_append (str, "inherit");
+    return;
+  }
+
+  g_string_append_printf (str, "%c%c%c%c%c",
+      (p->permissions & PW_PERM_R) ? 'r' : '-',
+      (p->permissions & PW_PERM_W) ? 'w' : '-',
+      (p->permissions & PW_PERM_X) ? 'x' : '-',
+      (p->permissions & PW_PERM_M) ? 'm' : '-',
+      (p->permissions & PW_PERM_L) ? 'l' : '-');
+}
+
+/* runs in the server thread */
+static int
+on_update_permissions (void * data, uint32_t n_permissions,
+    const struct pw_permission * permissions)
+{
+  TestFixture *f = data;
+  GString *str = g_string_new (NULL);
+
+  for (guint i = 0; i < n_permissions; i++)
+    append_permission (str, &permissions[i]);
+
+  g_ptr_array_add (f->updates, g_string_free (str, FALSE));
+  return 0;
+}
+
+static const struct pw_client_methods recorder_methods = {
+  PW_VERSION_CLIENT_METHODS,
+  .update_permissions = on_update_permissions,
+};
+
+static int
+add_recorder (void * data, struct pw_resource * resource)
+{
+  TestFixture *f = data;
+
+  g_assert_cmpuint (f->n_hooks, <, MAX_HOOKS);
+  pw_resource_add_object_listener (resource, &f->hooks[f->n_hooks++],
+      &recorder_methods, f);
+  return 0;
+}
+
+static void
+install_recorder (TestFixture * f, guint32 client_id)
+{
+  g_autoptr (WpTestServerLocker) lock =
+      wp_test_server_locker_new (&f->base.server);
+  struct pw_global *global;
+
+  global = pw_context_find_global (f->base.server.context, client_id);
+  g_assert_nonnull (global);
+  pw_global_for_each_resource (global, add_recorder, f);
+  g_assert_cmpuint (f->n_hooks, >, 0);
+}
+
+static void
+uninstall_recorder (TestFixture * f)
+{
+  g_autoptr (WpTestServerLocker) lock =
+      wp_test_server_locker_new (&f->base.server);
+
+  for (guint i = 0; i < f->n_hooks; i++)
+    spa_hook_remove (&f->hooks[i]);
+  f->n_hooks = 0;
+}
+
+static guint
+n_updates (TestFixture * f)
+{
+  g_autoptr (WpTestServerLocker) lock =
+      wp_test_server_locker_new (&f->base.server);
+  return f->updates->len;
+}
+
+static void
+sync_core (TestFixture * f)
+{
+  wp_core_sync (f->base.core, NULL, (GAsyncReadyCallback) test_core_done_cb,
+      &f->base);
+  g_main_loop_run (f->base.loop);
+}
+
+/*
+ * Waits until at least \a n updates were received by the server, then does one
+ * more round trip, so that any unexpected extra update shows up as well.
+ */
+static void
+wait_for_updates (TestFixture * f, guint n)
+{
+  for (guint i = 0; i < 10 && n_updates (f) < n; i++)
+    sync_core (f);
+  sync_core (f);
+}
+
+static void
+assert_updates (TestFixture * f, const gchar * expected)
+{
+  g_autoptr (WpTestServerLocker) lock =
+      wp_test_server_locker_new (&f->base.server);
+
+  if (expected) {
+    g_assert_cmpuint (f->updates->len, ==, 1);
+    g_assert_cmpstr (g_ptr_array_index (f->updates, 0), ==, expected);
+  } else {
+    g_assert_cmpuint (f->updates->len, ==, 0);
+  }
+
+  g_ptr_array_set_size (f->updates, 0);
+}
+
+static WpImplMetadata *
+export_metadata (TestFixture * f, const gchar * name)
+{
+  WpImplMetadata *m = wp_impl_metadata_new_full (f->base.client_core, name,
+      NULL);
+  wp_object_activate (WP_OBJECT (m), WP_OBJECT_FEATURES_ALL, NULL,
+      (GAsyncReadyCallback) test_object_activate_finish_cb, &f->base);
+  g_main_loop_run (f->base.loop);
+  return m;
+}
+
+static guint32
+add_match (WpPermissionManager * pm, guint32 perms, const gchar * name)
+{
+  return wp_permission_manager_add_interest_match_simple (pm, perms,
+      wp_object_interest_new (WP_TYPE_METADATA,
+          WP_CONSTRAINT_TYPE_PW_GLOBAL_PROPERTY, "metadata.name", "=s", name,
+          NULL));
+}
+
+static void
+test_permission_manager_deltas (TestFixture * f, gconstpointer data)
+{
+  g_autoptr (WpObjectManager) om = NULL;
+  g_autoptr (WpClient) client = NULL;
+  g_autoptr (WpPermissionManager) pm = NULL;
+  g_autoptr (WpImplMetadata) meta_a = NULL;
+  g_autoptr (WpImplMetadata) meta_b = NULL;
+  g_autofree gchar *expected = NULL;
+  guint32 client_id, id_a, id_b, match_a;
+
+  /* find the client object of the second connection */
+  client_id = wp_core_get_own_bound_id (f->base.client_core);
+  om = wp_object_manager_new ();
+  wp_object_manager_add_interest (om, WP_TYPE_CLIENT,
+      WP_CONSTRAINT_TYPE_G_PROPERTY, "bound-id", "=u", client_id, NULL);
+  wp_object_manager_request_object_features (om, WP_TYPE_CLIENT,
+      WP_PROXY_FEATURE_BOUND);
+  test_ensure_object_manager_is_installed (om, f->base.core, f->base.loop);
+  client = wp_object_manager_lookup (om, WP_TYPE_CLIENT, NULL);
+  g_assert_nonnull (client);
+
+  install_recorder (f, client_id);
+
+  meta_a = export_metadata (f, "test-pm-a");
+  id_a = wp_proxy_get_bound_id (WP_PROXY (meta_a));
+
+  pm = wp_permission_manager_new (f->base.core);
+  match_a = add_match (pm, PW_PERM_R, "test-pm-a");
+  wp_object_activate (WP_OBJECT (pm), WP_PERMISSION_MANAGER_LOADED, NULL,
+      (GAsyncReadyCallback) test_object_activate_finish_cb, &f->base);
+  g_main_loop_run (f->base.loop);
+
+  /* everything is sent to a new client, in one update */
+  wp_client_attach_permission_manager (client, pm);
+  wait_for_updates (f, 1);
+  expected = g_strdup_printf ("any:rwx-- %u:r----", id_a);
+  assert_updates (f, expected);
+  g_clear_pointer (&expected, g_free);
+
+  /* a match that does not change any permission sends nothing */
+  add_match (pm, PW_PERM_R, "test-pm-b");
+  wait_for_updates (f, 0);
+  assert_updates (f, NULL);
+
+  wp_permission_manager_update_permissions (pm);
+  wait_for_updates (f, 0);
+  assert_updates (f, NULL);
+
+  /* changing the defaults does not resend the object permissions */
+  wp_permission_manager_set_default_permissions (pm, PW_PERM_R | PW_PERM_X);
+  wait_for_updates (f, 1);
+  assert_updates (f, "any:r-x--");
+
+  /* only the new object is sent when it appears */
+  meta_b = export_metadata (f, "test-pm-b");
+  id_b = wp_proxy_get_bound_id (WP_PROXY (meta_b));
+  wait_for_updates (f, 1);
+  expected = g_strdup_printf ("%u:r----", id_b);
+  assert_updates (f, expected);
+  g_clear_pointer (&expected, g_free);
+
+  /* an object that stops matching is reset to inherit the defaults */
+  wp_permission_manager_remove_match (pm, match_a);
+  wait_for_updates (f, 1);
+  expected = g_strdup_printf ("%u:inherit", id_a);
+  assert_updates (f, expected);
+  g_clear_pointer (&expected, g_free);
+
+  /* and nothing is sent for it afterwards */
+  wp_permission_manager_update_permissions (pm);
+  wait_for_updates (f, 0);
+  assert_updates (f, NULL);
+
+  /* removing an object sends nothing, and the object that replaces it gets
+     its own permissions sent, whether or not the server reused the ID */
+  g_clear_object (&meta_b);
+  wp_core_sync (f->base.client_core, NULL,
+      (GAsyncReadyCallback) test_core_done_cb, &f->base);
+  g_main_loop_run (f->base.loop);
+  wait_for_updates (f, 0);
+  assert_updates (f, NULL);
+
+  meta_b = export_metadata (f, "test-pm-b");
+  id_b = wp_proxy_get_bound_id (WP_PROXY (meta_b));
+  wait_for_updates (f, 1);
+  expected = g_strdup_printf ("%u:r----", id_b);
+  assert_updates (f, expected);
+  g_clear_pointer (&expected, g_free);
+
+  uninstall_recorder (f);
+}
+
+gint
+main (gint argc, gchar *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+  wp_init (WP_INIT_ALL);
+
+  g_test_add ("/wp/permission-manager/deltas", TestFixture, NULL,
+      test_permission_manager_setup, test_permission_manager_deltas,
+      test_permission_manager_teardown);
+
+  return g_test_run ();
+}
@@ -167,6 +167,126 @@ test_properties_iterate (void)
   g_assert_cmpint (i, ==, 5);
 }
 
+static void
+check_lookups (WpProperties * p, guint n_keys)
+{
+  const struct spa_dict *dict = wp_properties_peek_dict (p);
+
+  for (guint i = 0; i < n_keys; i++) {
+    g_autofree gchar *key = g_strdup_printf ("key%u", i);
+    g_assert_cmpstr (wp_properties_get (p, key), ==,
+        spa_dict_lookup (dict, key));
+  }
+  g_assert_null (wp_properties_get (p, "nonexistent"));
+}
+
+static void
+test_properties_index (void)
+{
+  g_autoptr (WpProperties) p = wp_properties_new_empty ();
+  g_autoptr (WpProperties) other = wp_properties_new_empty ();
+  const guint n_keys = 100;
+
+  for (guint i = 0; i < n_keys; i++) {
+    g_autofree gchar *key = g_strdup_printf ("key%u", i);
+    g_autofree gchar *value = g_strdup_printf ("value%u", i);
+    g_assert_cmpint (wp_properties_set (p, key, value), ==, 1);
+    /* query while growing, so that the index is built early and updated */
+    g_assert_cmpstr (wp_properties_get (p, key), ==, value);
+  }
+  check_lookups (p, n_keys);
+
+  /* replace values */
+  for (guint i = 0; i < n_keys; i += 3) {
+    g_autofree gchar *key = g_strdup_printf ("key%u", i);
+    g_assert_cmpint (wp_properties_set (p, key, "replaced"), ==, 1);
+    g_assert_cmpstr (wp_properties_get (p, key), ==, "replaced");
+  }
+  check_lookups (p, n_keys);
+
+  /* remove some keys */
+  for (guint i = 0; i < n_keys; i += 7) {
+    g_autofree gchar *key = g_strdup_printf ("key%u", i);
+    wp_properties_set (p, key, NULL);
+    g_assert_null (wp_properties_get (p, key));
+  }
+  check_lookups (p, n_keys);
+
+  /* re-add them */
+  for (guint i = 0; i < n_keys; i += 7) {
+    g_autofree gchar *key = g_strdup_printf ("key%u", i);
+    g_assert_cmpint (wp_properties_set (p, key, "re-added"), ==, 1);
+    g_assert_cmpstr (wp_properties_get (p, key), ==, "re-added");
+  }
+  check_lookups (p, n_keys);
+
+  /* bulk update */
+  wp_properties_set (other, "key1", "updated");
+  wp_properties_set (other, "key150", "new");
+  g_assert_cmpint (wp_properties_update (p, other), ==, 2);
+  g_assert_cmpstr (wp_properties_get (p, "key1"), ==, "updated");
+  g_assert_cmpstr (wp_properties_get (p, "key150"), ==, "new");
+  check_lookups (p, n_keys);
+
+  /* sort */
+  wp_properties_sort (p);
+  check_lookups (p, n_keys);
+  g_assert_cmpstr (wp_properties_get (p, "key150"), ==, "new");
+
+  /* clear */
+  wp_properties_clear (p);
+  g_assert_null (wp_properties_get (p, "key1"));
+  check_lookups (p, n_keys);
+}
+
+static void
+test_properties_copy_on_write (void)
+{
+  g_autoptr (WpProperties) p = NULL;
+  g_autoptr (WpProperties) copy1 = NULL;
+  g_autoptr (WpProperties) copy2 = NULL;
+
+  p = wp_properties_new ("foo", "bar", "media.class", "Audio/Sink", NULL);
+
+  /* copies share the storage until they are modified */
+  copy1 = wp_properties_copy (p);
+  copy2 = wp_properties_copy (copy1);
+  g_assert_true (wp_properties_peek_dict (copy1) == wp_properties_peek_dict (p));
+  g_assert_true (wp_properties_peek_dict (copy2) == wp_properties_peek_dict (p));
+
+  g_assert_cmpint (wp_properties_set (copy1, "foo", "baz"), ==, 1);
+  g_assert_true (wp_properties_peek_dict (copy1) != wp_properties_peek_dict (p));
+  g_assert_cmpstr (wp_properties_get (copy1, "foo"), ==, "baz");
+  g_assert_cmpstr (wp_properties_get (copy2, "foo"), ==, "bar");
+  g_assert_cmpstr (wp_properties_get (p, "foo"), ==, "bar");
+
+  /* modifying the original does not affect the remaining copy */
+  wp_properties_clear (p);
+  g_assert_null (wp_properties_get (p, "foo"));
+  g_assert_cmpstr (wp_properties_get (copy2, "foo"), ==, "bar");
+  g_assert_cmpstr (wp_properties_get (copy2, "media.class"), ==, "Audio/Sink");
+
+  /* the last holder of the storage modifies it in place */
+  {
+    const struct spa_dict *dict = wp_properties_peek_dict (copy2);
+    g_clear_pointer (&copy1, wp_properties_unref);
+    g_assert_cmpint (wp_properties_set (copy2, "foo", "qux"), ==, 1);
+    g_assert_true (wp_properties_peek_dict (copy2) == dict);
+    g_assert_cmpstr (wp_properties_get (copy2, "foo"), ==, "qux");
+  }
+
+  /* taking the pw_properties out of a shared object gives a private copy */
+  {
+    g_autoptr (WpProperties) copy3 = wp_properties_copy (copy2);
+    struct pw_properties *pw_props =
+        wp_properties_unref_and_take_pw_properties (g_steal_pointer (&copy3));
+    g_assert_true (&pw_props->dict != wp_properties_peek_dict (copy2));
+    pw_properties_set (pw_props, "foo", "other");
+    g_assert_cmpstr (wp_properties_get (copy2, "foo"), ==, "qux");
+    pw_properties_free (pw_props);
+  }
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -180,6 +300,9 @@ main (int argc, char *argv[])
   g_test_add_func ("/wp/properties/take", test_properties_take);
   g_test_add_func ("/wp/properties/to_pw_props", test_properties_to_pw_props);
   g_test_add_func ("/wp/properties/iterate", test_properties_iterate);
+  g_test_add_func ("/wp/properties/index", test_properties_index);
+  g_test_add_func ("/wp/properties/copy_on_write",
+      test_properties_copy_on_write);
 
   return g_test_run ();
 }
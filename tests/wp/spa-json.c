@@ -1306,6 +1306,111 @@ test_spa_json_undefined_parser (void)
   }
 }
 
+static void
+test_spa_json_cursor (void)
+{
+  const gchar json_str[] = "{ \"name\": \"a\\tb\\u00e9\", bare = word, "
+      "int = 8, float = 1.5, bool = true, nothing = null, "
+      "array = [ 1 2 3 ], object = { key = [ x ] } }";
+  WpSpaJsonCursor cursor;
+  WpSpaJsonToken token;
+
+  wp_spa_json_cursor_init (&cursor, json_str, strlen (json_str));
+
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_cmpint (token.type, ==, WP_SPA_JSON_TOKEN_TYPE_STRING);
+  g_assert_true (wp_spa_json_token_equals_string (&token, "name"));
+  g_assert_false (wp_spa_json_token_equals_string (&token, "nam"));
+  g_assert_false (wp_spa_json_token_equals_string (&token, "names"));
+
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_cmpint (token.type, ==, WP_SPA_JSON_TOKEN_TYPE_STRING);
+  g_assert_true (wp_spa_json_token_equals_string (&token, "a\tb\xc3\xa9"));
+  g_assert_false (wp_spa_json_token_equals_string (&token, "a\\tb\xc3\xa9"));
+  {
+    gchar buf[32];
+    g_assert_false (wp_spa_json_token_parse_string (&token, buf, 4));
+    g_assert_true (wp_spa_json_token_parse_string (&token, buf, sizeof (buf)));
+    g_assert_cmpstr (buf, ==, "a\tb\xc3\xa9");
+  }
+
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_true (wp_spa_json_token_equals_string (&token, "bare"));
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_cmpint (token.type, ==, WP_SPA_JSON_TOKEN_TYPE_STRING);
+  g_assert_true (wp_spa_json_token_equals_string (&token, "word"));
+
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_cmpint (token.type, ==, WP_SPA_JSON_TOKEN_TYPE_INT);
+  {
+    gint v = 0;
+    g_assert_true (wp_spa_json_token_parse_int (&token, &v));
+    g_assert_cmpint (v, ==, 8);
+  }
+
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_cmpint (token.type, ==, WP_SPA_JSON_TOKEN_TYPE_FLOAT);
+  {
+    float v = 0;
+    g_assert_true (wp_spa_json_token_parse_float (&token, &v));
+    g_assert_cmpfloat_with_epsilon (v, 1.5, 0.001);
+  }
+
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_cmpint (token.type, ==, WP_SPA_JSON_TOKEN_TYPE_BOOLEAN);
+  {
+    gboolean v = FALSE;
+    g_assert_true (wp_spa_json_token_parse_boolean (&token, &v));
+    g_assert_true (v);
+  }
+
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_cmpint (token.type, ==, WP_SPA_JSON_TOKEN_TYPE_NULL);
+
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_true (wp_spa_json_token_equals_string (&token, "array"));
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_cmpint (token.type, ==, WP_SPA_JSON_TOKEN_TYPE_ARRAY);
+  g_assert_cmpint (token.size, ==, strlen ("[ 1 2 3 ]"));
+  {
+    WpSpaJsonCursor child;
+    WpSpaJsonToken t;
+    gint sum = 0, v;
+
+    wp_spa_json_cursor_init (&child, token.data, token.size);
+    while (wp_spa_json_cursor_next (&child, &t)) {
+      g_assert_true (wp_spa_json_token_parse_int (&t, &v));
+      sum += v;
+    }
+    g_assert_cmpint (sum, ==, 6);
+  }
+
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_true (wp_spa_json_token_equals_string (&token, "object"));
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_cmpint (token.type, ==, WP_SPA_JSON_TOKEN_TYPE_OBJECT);
+  g_assert_true (strncmp (token.data, "{ key = [ x ] }", token.size) == 0);
+
+  g_assert_false (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_false (wp_spa_json_cursor_next (&cursor, NULL));
+
+  /* unbraced objects, like the main config file, are walked as values */
+  wp_spa_json_cursor_init (&cursor, "key0 = val0, key1 = [ 1 ]",
+      strlen ("key0 = val0, key1 = [ 1 ]"));
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_true (wp_spa_json_token_equals_string (&token, "key0"));
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_true (wp_spa_json_token_equals_string (&token, "val0"));
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_true (wp_spa_json_cursor_next (&cursor, &token));
+  g_assert_cmpint (token.type, ==, WP_SPA_JSON_TOKEN_TYPE_ARRAY);
+  g_assert_false (wp_spa_json_cursor_next (&cursor, &token));
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -1325,6 +1430,7 @@ main (int argc, char *argv[])
   g_test_add_func ("/wp/spa-json/to-string", test_spa_json_to_string);
   g_test_add_func ("/wp/spa-json/undefined-parser",
       test_spa_json_undefined_parser);
+  g_test_add_func ("/wp/spa-json/cursor", test_spa_json_cursor);
 
   return g_test_run ();
 }
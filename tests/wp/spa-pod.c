@@ -1073,6 +1073,211 @@ test_spa_pod_port_config (void)
   g_assert_nonnull (pod);
 }
 
+static void
+test_spa_pod_arena (void)
+{
+  g_autoptr (GPtrArray) pods =
+      g_ptr_array_new_with_free_func ((GDestroyNotify) wp_spa_pod_unref);
+
+  wp_spa_pod_arena_push ();
+
+  /* pods are carved out of a chunk one after the other, and the memory of a
+     pod that is gone is not reused while the scope is active */
+  {
+    g_autoptr (WpSpaPod) p0 = wp_spa_pod_new_int (0);
+    g_autoptr (WpSpaPod) p1 = wp_spa_pod_new_int (1);
+    g_autoptr (WpSpaPod) p2 = NULL;
+    guint8 *p1_addr = (guint8 *) p1;
+    gssize stride = (guint8 *) p1 - (guint8 *) p0;
+
+    g_assert_cmpint (stride, >, 0);
+    g_assert_cmpint (stride, <, 1024);
+
+    g_clear_pointer (&p1, wp_spa_pod_unref);
+    p2 = wp_spa_pod_new_int (2);
+    g_assert_true ((guint8 *) p2 == p1_addr + stride);
+  }
+
+  /* enough pods to span several chunks */
+  for (gint i = 0; i < 200; i++) {
+    g_autofree gchar *device = g_strdup_printf ("device-%d", i);
+    g_autoptr (WpSpaPodBuilder) b = wp_spa_pod_builder_new_object (
+        "Spa:Pod:Object:Param:Props", "Props");
+    wp_spa_pod_builder_add_property (b, "volume");
+    wp_spa_pod_builder_add_float (b, 0.5);
+    wp_spa_pod_builder_add_property (b, "frequency");
+    wp_spa_pod_builder_add_int (b, i);
+    wp_spa_pod_builder_add_property (b, "device");
+    wp_spa_pod_builder_add_string (b, device);
+    g_ptr_array_add (pods, wp_spa_pod_builder_end (b));
+  }
+
+  /* a nested scope and a pod too big to be allocated in a chunk */
+  wp_spa_pod_arena_push ();
+  {
+    g_autoptr (WpSpaPodBuilder) b = wp_spa_pod_builder_new_struct ();
+    for (gint i = 0; i < 2000; i++)
+      wp_spa_pod_builder_add_int (b, i);
+    g_ptr_array_add (pods, wp_spa_pod_builder_end (b));
+  }
+  wp_spa_pod_arena_pop ();
+
+  wp_spa_pod_arena_pop ();
+
+  /* the pods are still valid after the scope has ended */
+  for (gint i = 0; i < 200; i++) {
+    WpSpaPod *pod = g_ptr_array_index (pods, i);
+    g_autoptr (WpIterator) it = wp_spa_pod_new_iterator (pod);
+    g_auto (GValue) next = G_VALUE_INIT;
+    g_autofree gchar *expected = g_strdup_printf ("device-%d", i);
+    const char *id_name = NULL;
+    const char *device = NULL;
+    gint32 frequency = -1;
+    guint n_props = 0;
+
+    g_assert_true (wp_spa_pod_get_object (pod, &id_name,
+        "frequency", "i", &frequency,
+        "device", "s", &device,
+        NULL));
+    g_assert_cmpstr (id_name, ==, "Props");
+    g_assert_cmpint (frequency, ==, i);
+    g_assert_cmpstr (device, ==, expected);
+
+    for (; wp_iterator_next (it, &next); g_value_unset (&next))
+      n_props++;
+    g_assert_cmpuint (n_props, ==, 3);
+  }
+  {
+    WpSpaPod *pod = g_ptr_array_index (pods, 200);
+    g_autoptr (WpIterator) it = wp_spa_pod_new_iterator (pod);
+    g_auto (GValue) next = G_VALUE_INIT;
+    gint expected = 0;
+
+    for (; wp_iterator_next (it, &next); g_value_unset (&next)) {
+      WpSpaPod *child = g_value_get_boxed (&next);
+      gint32 value = -1;
+      g_assert_true (wp_spa_pod_get_int (child, &value));
+      g_assert_cmpint (value, ==, expected++);
+    }
+    g_assert_cmpint (expected, ==, 2000);
+  }
+}
+
+static void
+test_spa_pod_lookup_path (void)
+{
+  g_autoptr (WpSpaPod) route = NULL;
+
+  {
+    g_autoptr (WpSpaPodBuilder) volumes_b = wp_spa_pod_builder_new_array ();
+    g_autoptr (WpSpaPodBuilder) params_b = wp_spa_pod_builder_new_struct ();
+    g_autoptr (WpSpaPodBuilder) props_b = wp_spa_pod_builder_new_object (
+        "Spa:Pod:Object:Param:Props", "Props");
+    g_autoptr (WpSpaPod) volumes = NULL;
+    g_autoptr (WpSpaPod) params = NULL;
+    g_autoptr (WpSpaPod) props = NULL;
+
+    wp_spa_pod_builder_add_float (volumes_b, 0.25);
+    wp_spa_pod_builder_add_float (volumes_b, 0.75);
+    volumes = wp_spa_pod_builder_end (volumes_b);
+
+    wp_spa_pod_builder_add_string (params_b, "api.alsa.soft-mixer");
+    wp_spa_pod_builder_add_boolean (params_b, TRUE);
+    params = wp_spa_pod_builder_end (params_b);
+
+    wp_spa_pod_builder_add (props_b,
+        "mute", "b", FALSE,
+        "channelVolumes", "P", volumes,
+        "params", "P", params,
+        NULL);
+    props = wp_spa_pod_builder_end (props_b);
+
+    route = wp_spa_pod_new_object (
+        "Spa:Pod:Object:Param:Route", "Route",
+        "index", "i", 3,
+        "name", "s", "analog-output-speaker",
+        "props", "P", props,
+        NULL);
+    g_assert_nonnull (route);
+  }
+
+  /* top level */
+  {
+    g_autoptr (WpSpaPod) pod = wp_spa_pod_lookup_path (route, "");
+    g_assert_true (pod == route);
+  }
+  {
+    g_autoptr (WpSpaPod) pod = wp_spa_pod_lookup_path (route, "index");
+    gint32 value = 0;
+    g_assert_nonnull (pod);
+    g_assert_true (wp_spa_pod_get_int (pod, &value));
+    g_assert_cmpint (value, ==, 3);
+  }
+
+  /* nested object, with redundant separators */
+  {
+    g_autoptr (WpSpaPod) pod =
+        wp_spa_pod_lookup_path (route, "/props//channelVolumes/");
+    g_autoptr (WpIterator) it = NULL;
+    g_auto (GValue) next = G_VALUE_INIT;
+    const gfloat expected[] = { 0.25, 0.75 };
+    guint i = 0;
+
+    g_assert_nonnull (pod);
+    g_assert_true (wp_spa_pod_is_array (pod));
+    it = wp_spa_pod_new_iterator (pod);
+    for (; wp_iterator_next (it, &next); g_value_unset (&next)) {
+      gfloat *value = g_value_get_pointer (&next);
+      g_assert_cmpuint (i, <, G_N_ELEMENTS (expected));
+      g_assert_cmpfloat_with_epsilon (*value, expected[i++], 0.001);
+    }
+    g_assert_cmpuint (i, ==, 2);
+  }
+
+  /* struct fields by index */
+  {
+    g_autoptr (WpSpaPod) pod =
+        wp_spa_pod_lookup_path (route, "props/params/1");
+    gboolean value = FALSE;
+    g_assert_nonnull (pod);
+    g_assert_true (wp_spa_pod_get_boolean (pod, &value));
+    g_assert_true (value);
+  }
+
+  /* the result outlives the pod it was found in */
+  {
+    g_autoptr (WpSpaPod) copy = wp_spa_pod_copy (route);
+    g_autoptr (WpSpaPod) pod = wp_spa_pod_lookup_path (copy, "props/params/0");
+    const gchar *value = NULL;
+    g_clear_pointer (&copy, wp_spa_pod_unref);
+    g_assert_nonnull (pod);
+    g_assert_true (wp_spa_pod_get_string (pod, &value));
+    g_assert_cmpstr (value, ==, "api.alsa.soft-mixer");
+  }
+
+  /* ... also when it was found in the result of another lookup */
+  {
+    g_autoptr (WpSpaPod) copy = wp_spa_pod_copy (route);
+    g_autoptr (WpSpaPod) props = wp_spa_pod_lookup_path (copy, "props");
+    g_autoptr (WpSpaPod) pod = NULL;
+    const gchar *value = NULL;
+    g_clear_pointer (&copy, wp_spa_pod_unref);
+    g_assert_nonnull (props);
+    pod = wp_spa_pod_lookup_path (props, "params/0");
+    g_clear_pointer (&props, wp_spa_pod_unref);
+    g_assert_nonnull (pod);
+    g_assert_true (wp_spa_pod_get_string (pod, &value));
+    g_assert_cmpstr (value, ==, "api.alsa.soft-mixer");
+  }
+
+  /* missing paths */
+  g_assert_null (wp_spa_pod_lookup_path (route, "volume"));
+  g_assert_null (wp_spa_pod_lookup_path (route, "not-a-property"));
+  g_assert_null (wp_spa_pod_lookup_path (route, "props/params/2"));
+  g_assert_null (wp_spa_pod_lookup_path (route, "props/params/mute"));
+  g_assert_null (wp_spa_pod_lookup_path (route, "index/0"));
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -1088,6 +1293,8 @@ main (int argc, char *argv[])
   g_test_add_func ("/wp/spa-pod/iterator", test_spa_pod_iterator);
   g_test_add_func ("/wp/spa-pod/unique-owner", test_spa_pod_unique_owner);
   g_test_add_func ("/wp/spa-pod/port-config", test_spa_pod_port_config);
+  g_test_add_func ("/wp/spa-pod/arena", test_spa_pod_arena);
+  g_test_add_func ("/wp/spa-pod/lookup-path", test_spa_pod_lookup_path);
 
   return g_test_run ();
 }
@@ -6,7 +6,7 @@
  * SPDX-License-Identifier: MIT
  */
 
-#include "../common/test-log.h"
+#include "../common/base-test-fixture.h"
 
 static void
 test_state_basic (void)
@@ -202,16 +202,283 @@ test_state_escaped (void)
   wp_state_clear (state);
 }
 
+static gboolean
+quit_loop (GMainLoop *loop)
+{
+  g_main_loop_quit (loop);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+run_loop_for (GMainLoop *loop, guint ms)
+{
+  g_autoptr (GSource) source = g_timeout_source_new (ms);
+  g_source_set_callback (source, (GSourceFunc) quit_loop, loop, NULL);
+  g_source_attach (source, g_main_loop_get_context (loop));
+  g_main_loop_run (loop);
+}
+
+static void
+test_state_journal (void)
+{
+  g_autoptr (GMainContext) context = g_main_context_new ();
+  g_autoptr (GMainLoop) loop = g_main_loop_new (context, FALSE);
+  g_autoptr (WpCore) core = NULL;
+  g_autoptr (WpState) state = wp_state_new ("journal");
+  g_autoptr (WpProperties) props = wp_properties_new_empty ();
+  g_autofree gchar *journal = NULL;
+
+  g_main_context_push_thread_default (context);
+  core = wp_core_new (context, NULL, NULL);
+  g_object_set (state, "timeout", 10, NULL);
+  journal = g_strconcat (wp_state_get_location (state), ".journal", NULL);
+
+  /* the first save writes a full snapshot */
+  wp_properties_set (props, "key1", "value1");
+  wp_properties_set (props, "key2", "value2");
+  wp_state_save_after_timeout (state, core, props);
+  run_loop_for (loop, 100);
+  g_assert_false (g_file_test (journal, G_FILE_TEST_EXISTS));
+  {
+    g_autoptr (WpProperties) loaded = wp_state_load (state);
+    g_assert_cmpstr (wp_properties_get (loaded, "key1"), ==, "value1");
+    g_assert_cmpstr (wp_properties_get (loaded, "key2"), ==, "value2");
+  }
+
+  /* further saves only append the changes to the journal */
+  wp_properties_set (props, "key1", "new value\nwith\tescapes");
+  wp_properties_set (props, "key2", NULL);
+  wp_properties_set (props, "key 3", "value3");
+  wp_state_save_after_timeout (state, core, props);
+  run_loop_for (loop, 100);
+  g_assert_true (g_file_test (journal, G_FILE_TEST_EXISTS));
+  {
+    g_autoptr (WpProperties) loaded = wp_state_load (state);
+    g_assert_cmpstr (wp_properties_get (loaded, "key1"), ==,
+        "new value\nwith\tescapes");
+    g_assert_null (wp_properties_get (loaded, "key2"));
+    g_assert_cmpstr (wp_properties_get (loaded, "key 3"), ==, "value3");
+  }
+
+  /* an incomplete batch, as left by a crash, is ignored */
+  {
+    g_autofree gchar *contents = NULL;
+    g_autofree gchar *torn = NULL;
+    g_assert_true (g_file_get_contents (journal, &contents, NULL, NULL));
+    torn = g_strconcat (contents, "+key4\tvalue4\n", NULL);
+    g_assert_true (g_file_set_contents (journal, torn, -1, NULL));
+  }
+  {
+    g_autoptr (WpProperties) loaded = wp_state_load (state);
+    g_assert_cmpstr (wp_properties_get (loaded, "key 3"), ==, "value3");
+    g_assert_null (wp_properties_get (loaded, "key4"));
+  }
+
+  /* a synchronous save compacts the journal */
+  {
+    g_autoptr (GError) error = NULL;
+    g_assert_true (wp_state_save (state, props, &error));
+    g_assert_no_error (error);
+    g_assert_false (g_file_test (journal, G_FILE_TEST_EXISTS));
+  }
+  {
+    g_autoptr (WpProperties) loaded = wp_state_load (state);
+    g_assert_cmpstr (wp_properties_get (loaded, "key1"), ==,
+        "new value\nwith\tescapes");
+    g_assert_cmpstr (wp_properties_get (loaded, "key 3"), ==, "value3");
+  }
+
+  wp_state_clear (state);
+  g_assert_false (g_file_test (journal, G_FILE_TEST_EXISTS));
+
+  g_main_context_pop_thread_default (context);
+}
+
+static void
+test_state_binary (void)
+{
+  g_autoptr (GError) error = NULL;
+  g_autoptr (WpState) keyfile_state = wp_state_new ("binary");
+  g_autoptr (WpState) state = NULL;
+  g_autofree gchar *keyfile_location =
+      g_strdup (wp_state_get_location (keyfile_state));
+
+  /* Save in the keyfile format */
+  {
+    g_autoptr (WpProperties) props = wp_properties_new_empty ();
+    wp_properties_set (props, "key1", "value1");
+    wp_properties_set (props, "key 2", "[value=2]");
+    g_assert_true (wp_state_save (keyfile_state, props, &error));
+    g_assert_no_error (error);
+  }
+
+  /* Load in the binary format; this migrates the file */
+  state = wp_state_new_full ("binary", WP_STATE_FORMAT_BINARY);
+  g_assert_true (g_str_has_suffix (wp_state_get_location (state), "binary.bin"));
+  {
+    g_autoptr (WpProperties) props = wp_state_load (state);
+    g_assert_cmpstr (wp_properties_get (props, "key1"), ==, "value1");
+    g_assert_cmpstr (wp_properties_get (props, "key 2"), ==, "[value=2]");
+  }
+  /* the keyfile is left in place for older versions */
+  g_assert_true (g_file_test (keyfile_location, G_FILE_TEST_EXISTS));
+  g_assert_true (g_file_test (wp_state_get_location (state),
+      G_FILE_TEST_EXISTS));
+
+  /* Re-Save and Re-Load */
+  {
+    g_autoptr (WpProperties) props = wp_properties_new_empty ();
+    wp_properties_set (props, "new-key", "new-value");
+    wp_properties_set (props, "a-key", "");
+    g_assert_true (wp_state_save (state, props, &error));
+    g_assert_no_error (error);
+  }
+  {
+    g_autoptr (WpProperties) props = wp_state_load (state);
+    g_assert_cmpuint (wp_properties_get_count (props), ==, 2);
+    g_assert_cmpstr (wp_properties_get (props, "new-key"), ==, "new-value");
+    g_assert_cmpstr (wp_properties_get (props, "a-key"), ==, "");
+    g_assert_null (wp_properties_get (props, "key1"));
+  }
+
+  /* A corrupted file is ignored, without migrating the old keyfile again */
+  {
+    g_autofree gchar *contents = NULL;
+    gsize len = 0;
+    g_assert_true (g_file_get_contents (wp_state_get_location (state),
+        &contents, &len, NULL));
+    contents[len - 2] ^= 0xff;
+    g_assert_true (g_file_set_contents (wp_state_get_location (state),
+        contents, len, NULL));
+  }
+  {
+    g_autoptr (WpProperties) props = wp_state_load (state);
+    g_assert_cmpuint (wp_properties_get_count (props), ==, 0);
+  }
+
+  wp_state_clear (state);
+  g_assert_false (g_file_test (wp_state_get_location (state),
+      G_FILE_TEST_EXISTS));
+  g_assert_false (g_file_test (keyfile_location, G_FILE_TEST_EXISTS));
+}
+
+typedef struct {
+  WpBaseTestFixture base;
+} TestFixture;
+
+static void
+test_state_metadata_setup (TestFixture *f, gconstpointer data)
+{
+  wp_base_test_fixture_setup (&f->base, 0);
+}
+
+static void
+test_state_metadata_teardown (TestFixture *f, gconstpointer data)
+{
+  wp_base_test_fixture_teardown (&f->base);
+}
+
+static void
+assert_state_metadata_writes (WpStateMetadata *state, guint64 n_writes,
+    guint64 n_coalesced_writes)
+{
+  guint64 writes = 0, coalesced = 0;
+
+  g_object_get (state, "n-writes", &writes,
+      "n-coalesced-writes", &coalesced, NULL);
+  g_assert_cmpuint (writes, ==, n_writes);
+  g_assert_cmpuint (coalesced, ==, n_coalesced_writes);
+}
+
+static void
+test_state_metadata_transactions (TestFixture *f, gconstpointer data)
+{
+  g_autoptr (WpStateMetadata) state =
+      wp_state_metadata_new (f->base.core, "transactions");
+  g_autoptr (WpState) file = wp_state_new ("transactions");
+
+  g_object_set (state, "timeout", 10, NULL);
+  wp_object_activate (WP_OBJECT (state), WP_STATE_METADATA_LOADED, NULL,
+      (GAsyncReadyCallback) test_object_activate_finish_cb, &f->base);
+  g_main_loop_run (f->base.loop);
+  assert_state_metadata_writes (state, 0, 0);
+
+  /* nested transactions only apply and save on the outermost commit */
+  wp_state_metadata_begin (state);
+  wp_state_metadata_set (state, "key1", "value1");
+  wp_state_metadata_begin (state);
+  wp_state_metadata_set (state, "key1", "value2");
+  wp_state_metadata_set (state, "key2", "value3");
+  g_assert_cmpstr (wp_state_metadata_get (state, "key1"), ==, "value2");
+  wp_state_metadata_commit (state);
+  run_loop_for (f->base.loop, 50);
+  assert_state_metadata_writes (state, 0, 0);
+  g_assert_false (g_file_test (wp_state_metadata_get_location (state),
+      G_FILE_TEST_EXISTS));
+
+  wp_state_metadata_commit (state);
+  run_loop_for (f->base.loop, 50);
+  /* 3 changes were requested and saved with 1 write */
+  assert_state_metadata_writes (state, 1, 2);
+  {
+    g_autoptr (WpProperties) loaded = wp_state_load (file);
+    g_assert_cmpstr (wp_properties_get (loaded, "key1"), ==, "value2");
+    g_assert_cmpstr (wp_properties_get (loaded, "key2"), ==, "value3");
+  }
+
+  /* a transaction that does not change anything does not save */
+  wp_state_metadata_begin (state);
+  wp_state_metadata_set (state, "key1", "value2");
+  wp_state_metadata_commit (state);
+  run_loop_for (f->base.loop, 50);
+  assert_state_metadata_writes (state, 1, 2);
+
+  /* ... and does not count as a coalesced change of the next write */
+  wp_state_metadata_set (state, "key3", "value4");
+  run_loop_for (f->base.loop, 50);
+  assert_state_metadata_writes (state, 2, 2);
+
+  /* changes outside of a transaction are coalesced by the timeout */
+  wp_state_metadata_set (state, "key1", NULL);
+  wp_state_metadata_set (state, "key2", "value5");
+  run_loop_for (f->base.loop, 50);
+  assert_state_metadata_writes (state, 3, 3);
+
+  /* a single change is saved with a write of its own */
+  wp_state_metadata_set (state, "key2", "value6");
+  run_loop_for (f->base.loop, 50);
+  assert_state_metadata_writes (state, 4, 3);
+  {
+    g_autoptr (WpProperties) loaded = wp_state_load (file);
+    g_assert_null (wp_properties_get (loaded, "key1"));
+    g_assert_cmpstr (wp_properties_get (loaded, "key2"), ==, "value6");
+    g_assert_cmpstr (wp_properties_get (loaded, "key3"), ==, "value4");
+  }
+
+  /* committing without a transaction does nothing */
+  wp_state_metadata_commit (state);
+  run_loop_for (f->base.loop, 50);
+  assert_state_metadata_writes (state, 4, 3);
+
+  wp_state_metadata_clear (state);
+}
+
 int
 main (int argc, char *argv[])
 {
   g_test_init (&argc, &argv, NULL);
   g_log_set_writer_func (wp_log_writer_default, NULL, NULL);
+  wp_init (WP_INIT_ALL);
 
   g_test_add_func ("/wp/state/basic", test_state_basic);
   g_test_add_func ("/wp/state/empty", test_state_empty);
   g_test_add_func ("/wp/state/spaces", test_state_spaces);
   g_test_add_func ("/wp/state/escaped", test_state_escaped);
+  g_test_add_func ("/wp/state/journal", test_state_journal);
+  g_test_add_func ("/wp/state/binary", test_state_binary);
+  g_test_add ("/wp/state/metadata-transactions", TestFixture, NULL,
+      test_state_metadata_setup, test_state_metadata_transactions,
+      test_state_metadata_teardown);
 
   return g_test_run ();
 }
@@ -281,3 +281,39 @@ assert (val.properties["id-02000000"].properties.device == "my-sub-device")
 assert (val.properties["id-02000000"].properties["id-03000000"] == true)
 assert (val.properties["id-02000000"].properties["id-04000000"] == "string")
 assert (pod:get_type_name() == "Spa:Pod:Object:Param:Props")
+
+-- Views
+view = pod:view()
+assert (view.pod_type == "Object")
+assert (view.object_id == "Props")
+assert (view.properties.device == "my-device")
+assert (view.properties["id-01000000"] == 4)
+assert (view.properties["id-02000000"].pod_type == "Object")
+assert (view.properties["id-02000000"].properties.device == "my-sub-device")
+assert (view.properties["id-02000000"].properties["id-03000000"] == true)
+assert (view.properties.volume == nil)
+assert (pod:lookup ("id-02000000/id-04000000") == "string")
+assert (pod:lookup ("id-02000000/volume") == nil)
+n = 0
+for k, v in pairs (view.properties) do
+  n = n + 1
+end
+assert (n == 3)
+
+pod = Pod.Struct {
+  Pod.Int (7),
+  Pod.Array { "Spa:Float", 0.5, 0.25 },
+  Pod.Struct { "nested" },
+}
+view = pod:view()
+assert (view.pod_type == "Struct")
+assert (#view == 3)
+assert (view[1] == 7)
+assert (view[2].pod_type == "Array")
+assert (view[2][2] == 0.25)
+assert (view[3][1] == "nested")
+assert (view[4] == nil)
+assert (pod:lookup ("2/0") == "nested")
+view = nil
+pod = nil
+collectgarbage ()